@@ -153,6 +153,14 @@ CIccArrayNamedColor::CIccArrayNamedColor(CIccTagArray *pTagArray)
 {
   m_pTag = pTagArray;
   m_list = new icNamedColorStructList;
+  m_pNameIndex = new std::unordered_map<std::string, CIccStructNamedColor*>;
+
+  m_pDeviceIndex = new CIccNearestIndex;
+  m_pDeviceColors = new icNamedColorStructVector;
+  m_pPcsIndex = new CIccNearestIndex;
+  m_pPcsColors = new icNamedColorStructVector;
+  m_pSpectralIndex = new CIccNearestIndex;
+  m_pSpectralColors = new icNamedColorStructVector;
 
   m_nDeviceSamples = 0;
   m_nPcsSamples = 0;
@@ -163,6 +171,14 @@ CIccArrayNamedColor::CIccArrayNamedColor(CIccTagArray *pTagArray)
 CIccArrayNamedColor::~CIccArrayNamedColor()
 {
   delete m_list;
+  delete m_pNameIndex;
+
+  delete m_pDeviceIndex;
+  delete m_pDeviceColors;
+  delete m_pPcsIndex;
+  delete m_pPcsColors;
+  delete m_pSpectralIndex;
+  delete m_pSpectralColors;
 }
 
 
@@ -211,22 +227,98 @@ void CIccArrayNamedColor::SetColorSpaces(icColorSpaceSignature csPcs, icColorSpa
   m_nSpectralSamples = icGetSpaceSamples((icColorSpaceSignature)m_csSpectralPcs);
 }
 
+/**
+******************************************************************************
+* Name: icGetFullTint
+*
+* Purpose: Gets the full tint (last) values of a named color member
+*
+* Return: true if the member has at least one tint of nSamples values
+******************************************************************************
+*/
+static bool icGetFullTint(std::vector<icFloatNumber> &values, const CIccStructNamedColor *pNamedColor,
+                          icSignature sigMember, icUInt32Number nSamples)
+{
+  if (!nSamples)
+    return false;
+
+  CIccTagNumArray *v = pNamedColor->GetNumArray(sigMember);
+  if (!v)
+    return false;
+
+  icUInt32Number nValues = v->GetNumValues();
+  if (nValues<nSamples)
+    return false;
+
+  std::vector<icFloatNumber> tints(nValues);
+  if (!v->GetValues(&tints[0], 0, nValues))
+    return false;
+
+  //Full tint is the last whole set of nSamples values
+  icUInt32Number nLast = (nValues/nSamples - 1) * nSamples;
+  values.insert(values.end(), tints.begin()+nLast, tints.begin()+nLast+nSamples);
+
+  return true;
+}
+
+/**
+******************************************************************************
+* Name: CIccArrayNamedColor::Begin
+*
+* Purpose: Builds the name hash and the nearest color indexes used by the
+*  Find functions from the full tint values of each named color
+******************************************************************************
+*/
 bool CIccArrayNamedColor::Begin()
 {
   m_pZeroTint = (CIccStructNamedColor*)icGetTagStructHandlerOfType(m_pTag->GetIndex(0), icSigTintZeroStruct);
 
   m_list->clear();
+  m_pNameIndex->clear();
+  m_pDeviceColors->clear();
+  m_pPcsColors->clear();
+  m_pSpectralColors->clear();
+
+  std::vector<icFloatNumber> device, pcs, spectral;
 
   int i, n=m_pTag->GetSize();
   for (i=1; i<n; i++) {
     CIccStructNamedColor *pNamedColor = (CIccStructNamedColor*)icGetTagStructHandlerOfType(m_pTag->GetIndex(i), icSigNamedColorStruct);
     if (pNamedColor) {
       std::string name = pNamedColor->getName();
-      if (!name.empty())
+      if (!name.empty()) {
         (*m_list)[name] = pNamedColor;
+        (*m_pNameIndex)[name] = pNamedColor;
+      }
+
+      if (icGetFullTint(device, pNamedColor, icSigNmclDeviceDataMbr, m_nDeviceSamples))
+        m_pDeviceColors->push_back(pNamedColor);
+      else
+        device.resize(m_pDeviceColors->size()*m_nDeviceSamples);
+
+      if (m_nPcsSamples==3 && icGetFullTint(pcs, pNamedColor, icSigNmclPcsDataMbr, 3)) {
+        if (m_csPcs != icSigLabData) {
+          icFloatNumber *pLab = &pcs[pcs.size()-3];
+          icFloatNumber XYZ[3] = {pLab[0], pLab[1], pLab[2]};
+          icXYZtoLab(pLab, XYZ);
+        }
+        m_pPcsColors->push_back(pNamedColor);
+      }
+      else
+        pcs.resize(m_pPcsColors->size()*3);
+
+      if (icGetFullTint(spectral, pNamedColor, icSigNmclSpectralDataMbr, m_nSpectralSamples))
+        m_pSpectralColors->push_back(pNamedColor);
+      else
+        spectral.resize(m_pSpectralColors->size()*m_nSpectralSamples);
     }
   }
 
+  if (!m_pDeviceIndex->Build(device.data(), (icUInt32Number)m_pDeviceColors->size(), m_nDeviceSamples) ||
+      !m_pPcsIndex->Build(pcs.data(), (icUInt32Number)m_pPcsColors->size(), 3) ||
+      !m_pSpectralIndex->Build(spectral.data(), (icUInt32Number)m_pSpectralColors->size(), m_nSpectralSamples))
+    return false;
+
   return true;
 }
 
@@ -234,52 +326,44 @@ CIccStructNamedColor* CIccArrayNamedColor::FindColor(const icChar *szColor) cons
 {
   std::string name(szColor);
 
-  icNamedColorStructList::const_iterator i;
-  i=m_list->find(name);
-  if (i!=m_list->end())
+  std::unordered_map<std::string, CIccStructNamedColor*>::const_iterator i;
+  i=m_pNameIndex->find(name);
+  if (i!=m_pNameIndex->end())
     return i->second;
 
   return NULL;
 }
 
+/**
+******************************************************************************
+* Name: CIccArrayNamedColor::FindDeviceColor
+*
+* Purpose: Finds the named color whose full tint device values match
+*  pDevColor.  Begin() must be called first.
+******************************************************************************
+*/
 CIccStructNamedColor* CIccArrayNamedColor::FindDeviceColor(const icFloatNumber *pDevColor) const
 {
-  icFloatNumber *temp = new icFloatNumber[m_nDeviceSamples];
+  icFloatNumber dDistSq;
+  icInt32Number i = m_pDeviceIndex->FindNearest(pDevColor, &dDistSq);
 
-  if (!temp)
+  if (i<0 || dDistSq!=0.0)
     return NULL;
 
-  icUInt32Number i, j, n=m_pTag->GetSize();
-  for (i=1; i<n; i++) {
-    CIccStructNamedColor *pNamedColor = (CIccStructNamedColor*)icGetTagStructHandlerOfType(m_pTag->GetIndex(i), icSigNamedColorStruct);
-    if (pNamedColor) {
-      CIccTag *pTag = pNamedColor->GetElem(icSigNmclDeviceDataMbr);
-      if (pTag && pTag->IsNumArrayType()) {
-        CIccTagNumArray *v = (CIccTagNumArray*)pTag;
-        icUInt32Number n = v->GetNumValues()/m_nDeviceSamples;
-        if (n) {
-          v->GetValues(temp, (n-1)*m_nDeviceSamples, m_nDeviceSamples);
-
-          for (j=0; j<m_nDeviceSamples; j++) {
-            if (temp[j]!=pDevColor[j])
-              break;
-          }
-          if (n==m_nDeviceSamples) {
-            delete [] temp;
-            return pNamedColor;
-          }
-        }
-      }
-    }
-  }
-  return NULL;
+  return (*m_pDeviceColors)[i];
 }
 
+/**
+******************************************************************************
+* Name: CIccArrayNamedColor::FindPcsColor
+*
+* Purpose: Finds the named color whose full tint PCS value is closest to
+*  pPCS and within dMinDE.  Begin() must be called first.
+******************************************************************************
+*/
 CIccStructNamedColor* CIccArrayNamedColor::FindPcsColor(const icFloatNumber *pPCS, icFloatNumber dMinDE/*=1000.0*/) const
 {
-  icFloatNumber dCalcDE, dLeastDE=dMinDE;
-  icFloatNumber pLabIn[3], pLab[3];
-  CIccStructNamedColor* leastDEindex = NULL;
+  icFloatNumber pLabIn[3], dDistSq;
 
   if (m_csPcs != icSigLabData) {
     icXYZtoLab(pLabIn,pPCS);
@@ -288,64 +372,32 @@ CIccStructNamedColor* CIccArrayNamedColor::FindPcsColor(const icFloatNumber *pPC
     memcpy(pLabIn, pPCS, 3*sizeof(icFloatNumber));
   }
 
-  icUInt32Number i, n=m_pTag->GetSize();
-  for (i=1; i<n; i++) {
-    CIccStructNamedColor *pNamedColor = (CIccStructNamedColor*)icGetTagStructHandlerOfType(m_pTag->GetIndex(i), icSigNamedColorStruct);
-    if (pNamedColor) {
-      CIccTag *pTag = pNamedColor->GetElem(icSigNmclDeviceDataMbr);
-      if (pTag && pTag->IsNumArrayType()) {
-        CIccTagNumArray *v = (CIccTagNumArray*)pTag;
-        icUInt32Number n = v->GetNumValues()/m_nDeviceSamples;
-        if (n) {
-          v->GetValues(pLab, (n-1)*m_nDeviceSamples, 3);
-
-          dCalcDE = icDeltaE(pLabIn, pLab);
-
-          if (dCalcDE<dMinDE && dCalcDE<dLeastDE) {
-            dLeastDE = dCalcDE;
-            leastDEindex = pNamedColor;
-          }
-        }
-      }
-    }
-  }
+  icInt32Number i = m_pPcsIndex->FindNearest(pLabIn, &dDistSq);
+
+  if (i<0 || !(sqrt(dDistSq)<dMinDE))
+    return NULL;
 
-  return leastDEindex;
+  return (*m_pPcsColors)[i];
 }
 
+/**
+******************************************************************************
+* Name: CIccArrayNamedColor::FindSpectralColor
+*
+* Purpose: Finds the named color whose full tint spectral values have the
+*  smallest RMS difference from pSpec, if less than dMinRMS.  Begin() must be
+*  called first.
+******************************************************************************
+*/
 CIccStructNamedColor* CIccArrayNamedColor::FindSpectralColor(const icFloatNumber *pSpec, icFloatNumber dMinRMS/*=1000.0*/) const
 {
-  icFloatNumber dCalcRMS, dLeastRMS=dMinRMS;
-  CIccStructNamedColor* leastRMSindex = NULL;
+  icFloatNumber dDistSq;
+  icInt32Number i = m_pSpectralIndex->FindNearest(pSpec, &dDistSq);
 
-  icFloatNumber *temp = new icFloatNumber[m_nSpectralSamples];
-
-  if (!temp)
+  if (i<0 || !(sqrt(dDistSq/m_nSpectralSamples)<dMinRMS))
     return NULL;
 
-  icUInt32Number i, n=m_pTag->GetSize();
-  for (i=1; i<n; i++) {
-    CIccStructNamedColor *pNamedColor = (CIccStructNamedColor*)icGetTagStructHandlerOfType(m_pTag->GetIndex(i), icSigNamedColorStruct);
-    if (pNamedColor) {
-      CIccTag *pTag = pNamedColor->GetElem(icSigNmclDeviceDataMbr);
-      if (pTag && pTag->IsNumArrayType()) {
-        CIccTagNumArray *v = (CIccTagNumArray*)pTag;
-        icUInt32Number n = v->GetNumValues()/m_nDeviceSamples;
-        if (n) {
-          v->GetValues(temp, (n-1)*m_nSpectralSamples, m_nSpectralSamples);
-
-          dCalcRMS = icRmsDif(pSpec, temp, m_nSpectralSamples);
-
-          if (dCalcRMS<dMinRMS && dCalcRMS<dLeastRMS) {
-            dLeastRMS = dCalcRMS;
-            leastRMSindex = pNamedColor;
-          }
-        }
-      }
-    }
-  }
-
-  return leastRMSindex;
+  return (*m_pSpectralColors)[i];
 }
 
 bool CIccArrayNamedColor::GetDeviceTint(icFloatNumber *dstColor,
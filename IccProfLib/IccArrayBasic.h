@@ -74,6 +74,8 @@
 #include <list>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include "IccDefs.h"
 #include "IccTagComposite.h"
 #ifdef USEREFICCMAXNAMESPACE
@@ -107,8 +109,10 @@ protected:
 
 
 class CIccStructNamedColor;
+class CIccNearestIndex;
 
 typedef std::map<std::string, CIccStructNamedColor*> icNamedColorStructList;
+typedef std::vector<CIccStructNamedColor*> icNamedColorStructVector;
 
 /**
 ****************************************************************************
@@ -177,9 +181,21 @@ protected:
 
   icNamedColorStructList *m_list;
 
+  //Full tint values of the named colors indexed by Begin()
+  CIccNearestIndex *m_pDeviceIndex;
+  icNamedColorStructVector *m_pDeviceColors;
+  CIccNearestIndex *m_pPcsIndex;
+  icNamedColorStructVector *m_pPcsColors;
+  CIccNearestIndex *m_pSpectralIndex;
+  icNamedColorStructVector *m_pSpectralColors;
+
   icUInt32Number m_nDeviceSamples;
   icUInt32Number m_nPcsSamples;
   icUInt32Number m_nSpectralSamples;
+
+private:
+  //Hash of the names in m_list used by FindColor()
+  std::unordered_map<std::string, CIccStructNamedColor*> *m_pNameIndex;
 };
 
 
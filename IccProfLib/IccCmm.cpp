@@ -84,6 +84,9 @@
 #include "IccSparseMatrix.h"
 #include "IccEncoding.h"
 #include "IccMatrixMath.h"
+#include <math.h>
+#include <thread>
+#include <vector>
 
 #ifdef USEREFICCMAXNAMESPACE
 namespace refIccMAX {
@@ -117,6 +120,10 @@ static __inline bool IsSpaceSpectralPCS(icUInt32Number sig)
 
 #define ICCPCSSTEPDUMPFMT ICCMTXSTEPDUMPFMT
 
+//Working block size (pixels and samples per pixel) used by native CIccXform::ApplyN() implementations
+#define icXformBlockPixels 64
+#define icXformBlockStride 16
+
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -155,6 +162,7 @@ void CIccPCS::Reset(icColorSpaceSignature StartSpace, bool bUseLegacyPCS)
 {
   m_bIsV2Lab = IsSpacePCS(StartSpace) && bUseLegacyPCS;
   m_Space = StartSpace;
+  m_bLastPcsXform = false;
 }
 
 /**
@@ -254,6 +262,105 @@ void CIccPCS::CheckLast(icFloatNumber *Pixel, icColorSpaceSignature DestSpace, b
   }
 }
 
+/**
+ **************************************************************************
+ * Name: CIccPCS::CheckN
+ * 
+ * Purpose:
+ *  Buffer version of Check().  The PCS adjustment needed by the next xform
+ *  is determined once and then applied to all of the pixels.
+ * 
+ * Args: 
+ *   SrcPixels = source pixel data (will not be modified),
+ *   pConvert = buffer to hold adjusted pixel data (may be the same as SrcPixels),
+ *   nPixels = number of pixels,
+ *   nStride = number of samples between pixels in SrcPixels and pConvert,
+ *   pXform = the xform that who's ApplyN function will shortly be called
+ * 
+ * Return: 
+ *  SrcPixels or pConvert.
+ **************************************************************************
+ */
+const icFloatNumber *CIccPCS::CheckN(const icFloatNumber *SrcPixels, icFloatNumber *pConvert, icUInt32Number nPixels,
+                                     icUInt32Number nStride, const CIccXform *pXform)
+{
+  icColorSpaceSignature NextSpace = pXform->GetSrcSpace();
+  bool bIsV2 = pXform->UseLegacyPCS();
+  bool bIsNextV2Lab = bIsV2 && (NextSpace == icSigLabData);
+  const icFloatNumber *rv = pConvert;
+  bool bClip = !pXform->NoClipPCS();
+
+  if (m_bLastPcsXform) {
+    rv = SrcPixels;
+  }
+  else if (m_bIsV2Lab && !bIsNextV2Lab) {
+    icPcsLab2ToLab4N(pConvert, SrcPixels, nPixels, nStride, bClip);
+    if (NextSpace==icSigXYZData)
+      icPcsLabToPcsXyzN(pConvert, pConvert, nPixels, nStride, bClip);
+  }
+  else if (!m_bIsV2Lab && bIsNextV2Lab) {
+    if (m_Space==icSigXYZData) {
+      icPcsXyzToPcsLabN(pConvert, SrcPixels, nPixels, nStride, bClip);
+      icPcsLab4ToLab2N(pConvert, pConvert, nPixels, nStride);
+    }
+    else {
+      icPcsLab4ToLab2N(pConvert, SrcPixels, nPixels, nStride);
+    }
+  }
+  else if (m_Space==NextSpace) {
+    rv = SrcPixels;
+  }
+  else if (m_Space==icSigXYZData && NextSpace==icSigLabData) {
+    icPcsXyzToPcsLabN(pConvert, SrcPixels, nPixels, nStride, bClip);
+  }
+  else if (m_Space==icSigLabData && NextSpace==icSigXYZData) {
+    icPcsLabToPcsXyzN(pConvert, SrcPixels, nPixels, nStride, bClip);
+  }
+  else {
+    rv = SrcPixels;
+  }
+
+  m_Space = pXform->GetDstSpace();
+  m_bIsV2Lab = bIsV2 && (m_Space == icSigLabData);
+  m_bLastPcsXform = (pXform->GetXformType()==icXformTypePCS);
+
+  return rv;
+}
+
+/**
+ **************************************************************************
+ * Name: CIccPCS::CheckLastN
+ * 
+ * Purpose: 
+ *   Buffer version of CheckLast().
+ * 
+ * Args: 
+ *  Pixels = Pixel data,
+ *  nPixels = number of pixels,
+ *  nStride = number of samples between pixels,
+ *  DestSpace = destination color space
+ *  bNoClip = indicates whether PCS should be clipped
+ **************************************************************************
+ */
+void CIccPCS::CheckLastN(icFloatNumber *Pixels, icUInt32Number nPixels, icUInt32Number nStride,
+                         icColorSpaceSignature DestSpace, bool bNoClip)
+{
+  if (m_bIsV2Lab) {
+    icPcsLab2ToLab4N(Pixels, Pixels, nPixels, nStride, !bNoClip);
+    if (DestSpace==icSigXYZData)
+      icPcsLabToPcsXyzN(Pixels, Pixels, nPixels, nStride, !bNoClip);
+  }
+  else if (m_Space==DestSpace) {
+    return;
+  }
+  else if (m_Space==icSigXYZData) {
+    icPcsXyzToPcsLabN(Pixels, Pixels, nPixels, nStride, !bNoClip);
+  }
+  else if (m_Space==icSigLabData) {
+    icPcsLabToPcsXyzN(Pixels, Pixels, nPixels, nStride, !bNoClip);
+  }
+}
+
 /**
  **************************************************************************
  * Name: CIccPCS::UnitClip
@@ -578,6 +685,8 @@ CIccXform::CIccXform()
   m_bDstPcsConversion = true;
   m_pConnectionConditions = NULL;
   m_pCmmEnvVarLookup = NULL;
+  m_bLuminanceMatching = false;
+  m_fCurveTableTolerance = 0;
 }
 
 
@@ -1347,6 +1456,7 @@ void CIccXform::SetParams(CIccProfile *pProfile, bool bInput, icRenderingIntent
   m_bAbsToRel = bAbsToRel;
   m_nMCS = nMCS;
   m_bLuminanceMatching = false;
+  m_fCurveTableTolerance = 0;
 
   if (pHintManager) {
     IIccCreateXformHint *pHint=NULL;
@@ -1367,6 +1477,11 @@ void CIccXform::SetParams(CIccProfile *pProfile, bool bInput, icRenderingIntent
     if (pHint) {
       m_bLuminanceMatching = true;
     }
+
+    pHint = pHintManager->GetHint("CIccCurveTableToleranceHint");
+    if (pHint) {
+      m_fCurveTableTolerance = ((CIccCurveTableToleranceHint*)pHint)->GetTolerance();
+    }
   }
 }
 
@@ -1668,6 +1783,89 @@ void CIccXform::CheckDstAbs(icFloatNumber *Pixel) const
 		AdjustPCS(Pixel, Pixel);
   }
 }
+
+/**
+ **************************************************************************
+ * Name: CIccXform::LoadSrcBlock
+ * 
+ * Purpose: 
+ *  Copies a block of source pixels into a working buffer (with a stride of
+ *  icXformBlockStride) applying CheckSrcAbs() to each pixel.
+ * 
+ * Args: 
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  pBlock = working buffer to load,
+ *  SrcPixels = source pixel data (will not be modified),
+ *  nPixels = number of pixels to load (at most icXformBlockPixels),
+ *  nSrcStride = number of samples between source pixels,
+ *  nSamples = number of samples to copy from each pixel
+ **************************************************************************
+ */
+void CIccXform::LoadSrcBlock(CIccApplyXform *pApply, icFloatNumber *pBlock, const icFloatNumber *SrcPixels,
+                             icUInt32Number nPixels, icUInt32Number nSrcStride, icUInt16Number nSamples) const
+{
+  icUInt32Number k;
+  const icFloatNumber *pSrc;
+
+  for (k=0; k<nPixels; k++, SrcPixels+=nSrcStride, pBlock+=icXformBlockStride) {
+    pSrc = CheckSrcAbs(pApply, SrcPixels);
+    memcpy(pBlock, pSrc, nSamples*sizeof(icFloatNumber));
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: CIccXform::StoreDstBlock
+ * 
+ * Purpose: 
+ *  Copies a working buffer (with a stride of icXformBlockStride) to the
+ *  destination pixels applying CheckDstAbs() to each pixel.
+ * 
+ * Args: 
+ *  DstPixels = destination pixel data,
+ *  pBlock = working buffer holding results,
+ *  nPixels = number of pixels to store,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSamples = number of samples to copy to each pixel
+ **************************************************************************
+ */
+void CIccXform::StoreDstBlock(icFloatNumber *DstPixels, const icFloatNumber *pBlock,
+                              icUInt32Number nPixels, icUInt32Number nDstStride, icUInt16Number nSamples) const
+{
+  icUInt32Number k;
+
+  for (k=0; k<nPixels; k++, DstPixels+=nDstStride, pBlock+=icXformBlockStride) {
+    memcpy(DstPixels, pBlock, nSamples*sizeof(icFloatNumber));
+    CheckDstAbs(DstPixels);
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: CIccXform::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the xform to a buffer of pixels.  The base implementation calls
+ *  Apply() for each pixel.  Derived classes with a native batch path override this.
+ * 
+ * Args: 
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixels = destination pixel data,
+ *  SrcPixels = source pixel data,
+ *  nPixels = number of pixels to apply,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels
+ **************************************************************************
+ */
+void CIccXform::ApplyN(CIccApplyXform *pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                       icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icUInt32Number k;
+
+  for (k=0; k<nPixels; k++, DstPixels+=nDstStride, SrcPixels+=nSrcStride) {
+    Apply(pApply, DstPixels, SrcPixels);
+  }
+}
         
 /**
 **************************************************************************
@@ -4778,26 +4976,11 @@ CIccCurve *CIccXformMonochrome::GetCurve(icSignature sig) const
 CIccCurve *CIccXformMonochrome::GetInvCurve(icSignature sig) const
 {
 	CIccCurve *pCurve;
-	CIccTagCurve *pInvCurve;
 
 	if (!(pCurve = GetCurve(sig)))
 		return NULL;
 
-	pCurve->Begin();
-
-	pInvCurve = new CIccTagCurve(2048);
-
-	int i;
-	icFloatNumber x;
-	icFloatNumber *Lut = &(*pInvCurve)[0];
-
-	for (i=0; i<2048; i++) {
-		x=(icFloatNumber)i / 2047;
-
-		Lut[i] = pCurve->Find(x);
-	}
-
-	return pInvCurve;
+	return pCurve->NewInverse(icDefaultInvCurveSize);
 }
 
 /**
@@ -5062,6 +5245,78 @@ void CIccXformMatrixTRC::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel,
   CheckDstAbs(DstPixel);
 }
 
+/**
+ **************************************************************************
+ * Name: CIccXformMatrixTRC::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the Xform to a buffer of pixels.
+ *  
+ * Args:
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixels = Destination pixels where the results are stored,
+ *  SrcPixels = Source pixels which are to be applied,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels.
+ **************************************************************************
+ */
+void CIccXformMatrixTRC::ApplyN(CIccApplyXform* pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                                icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  const icFloatNumber *pSrc;
+  icUInt32Number k;
+
+  if (m_bInput) {
+    double LinR, LinG, LinB;
+
+    for (k=0; k<nPixels; k++, DstPixels+=nDstStride, SrcPixels+=nSrcStride) {
+      pSrc = CheckSrcAbs(pApply, SrcPixels);
+
+      if (m_ApplyCurvePtr) {
+        LinR = m_ApplyCurvePtr[0]->Apply(pSrc[0]);
+        LinG = m_ApplyCurvePtr[1]->Apply(pSrc[1]);
+        LinB = m_ApplyCurvePtr[2]->Apply(pSrc[2]);
+      }
+      else {
+        LinR = pSrc[0];
+        LinG = pSrc[1];
+        LinB = pSrc[2];
+      }
+
+      DstPixels[0] = XYZScale((icFloatNumber)(m_e[0] * LinR + m_e[1] * LinG + m_e[2] * LinB));
+      DstPixels[1] = XYZScale((icFloatNumber)(m_e[3] * LinR + m_e[4] * LinG + m_e[5] * LinB));
+      DstPixels[2] = XYZScale((icFloatNumber)(m_e[6] * LinR + m_e[7] * LinG + m_e[8] * LinB));
+
+      CheckDstAbs(DstPixels);
+    }
+  }
+  else {
+    double X, Y, Z;
+
+    for (k=0; k<nPixels; k++, DstPixels+=nDstStride, SrcPixels+=nSrcStride) {
+      pSrc = CheckSrcAbs(pApply, SrcPixels);
+
+      X = XYZDescale(pSrc[0]);
+      Y = XYZDescale(pSrc[1]);
+      Z = XYZDescale(pSrc[2]);
+
+      if (m_ApplyCurvePtr) {
+        DstPixels[0] = RGBClip((icFloatNumber)(m_e[0] * X + m_e[1] * Y + m_e[2] * Z), m_ApplyCurvePtr[0]);
+        DstPixels[1] = RGBClip((icFloatNumber)(m_e[3] * X + m_e[4] * Y + m_e[5] * Z), m_ApplyCurvePtr[1]);
+        DstPixels[2] = RGBClip((icFloatNumber)(m_e[6] * X + m_e[7] * Y + m_e[8] * Z), m_ApplyCurvePtr[2]);
+      }
+      else {
+        DstPixels[0] = (icFloatNumber)(m_e[0] * X + m_e[1] * Y + m_e[2] * Z);
+        DstPixels[1] = (icFloatNumber)(m_e[3] * X + m_e[4] * Y + m_e[5] * Z);
+        DstPixels[2] = (icFloatNumber)(m_e[6] * X + m_e[7] * Y + m_e[8] * Z);
+      }
+
+      CheckDstAbs(DstPixels);
+    }
+  }
+}
+
 /**
  **************************************************************************
  * Name: CIccXformMatrixTRC::GetCurve
@@ -5129,26 +5384,11 @@ CIccTagXYZ *CIccXformMatrixTRC::GetColumn(icSignature sig) const
 CIccCurve *CIccXformMatrixTRC::GetInvCurve(icSignature sig) const
 {
   CIccCurve *pCurve;
-  CIccTagCurve *pInvCurve;
 
   if (!(pCurve = GetCurve(sig)))
     return NULL;
 
-  pCurve->Begin();
-
-  pInvCurve = new CIccTagCurve(2048);
-
-  int i;
-  icFloatNumber x;
-  icFloatNumber *Lut = &(*pInvCurve)[0];
-
-  for (i=0; i<2048; i++) {
-    x=(icFloatNumber)i / 2047;
-
-    Lut[i] = pCurve->Find(x);
-  }
-
-  return pInvCurve;
+  return pCurve->NewInverse(icDefaultInvCurveSize);
 }
 
 /**
@@ -5389,6 +5629,45 @@ CIccXform3DLut::~CIccXform3DLut()
   return icCmmStatOk;
 }
 
+/**
+ **************************************************************************
+ * Name: icApplyCurvesN
+ * 
+ * Purpose: 
+ *  Applies a set of curves to a block of pixels (stride icXformBlockStride)
+ *  one channel at a time.
+ **************************************************************************
+ */
+static void icApplyCurvesN(const LPIccCurve *pCurves, icFloatNumber *pBlock, icUInt32Number nPixels, int nChannels)
+{
+  icUInt32Number k;
+  icFloatNumber *pPixel;
+  int i;
+
+  for (i=0; i<nChannels; i++) {
+    const CIccCurve *pCurve = pCurves[i];
+
+    for (k=0, pPixel=pBlock+i; k<nPixels; k++, pPixel+=icXformBlockStride)
+      *pPixel = pCurve->Apply(*pPixel);
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icApplyMatrixN
+ * 
+ * Purpose: 
+ *  Applies a matrix to a block of pixels (stride icXformBlockStride)
+ **************************************************************************
+ */
+static void icApplyMatrixN(const CIccMatrix *pMatrix, icFloatNumber *pBlock, icUInt32Number nPixels)
+{
+  icUInt32Number k;
+
+  for (k=0; k<nPixels; k++, pBlock+=icXformBlockStride)
+    pMatrix->Apply(pBlock);
+}
+
 /**
  **************************************************************************
  * Name: CIccXform3DLut::Apply
@@ -5481,6 +5760,85 @@ void CIccXform3DLut::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, cons
   CheckDstAbs(DstPixel);
 }
 
+/**
+ **************************************************************************
+ * Name: CIccXform3DLut::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the Xform to a buffer of pixels.  Pixels are processed in blocks
+ *  with each stage of the lut applied to the whole block in turn.
+ *  
+ * Args:
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixels = Destination pixels where the results are stored,
+ *  SrcPixels = Source pixels which are to be applied,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels.
+ **************************************************************************
+ */
+void CIccXform3DLut::ApplyN(CIccApplyXform* pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                            icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icFloatNumber Block[icXformBlockPixels*icXformBlockStride];
+  icUInt32Number n;
+  int nOutput = m_pTag->m_nOutput;
+  CIccCLUT *pCLUT = m_pTag->m_CLUT;
+
+  while (nPixels) {
+    n = nPixels<icXformBlockPixels ? nPixels : icXformBlockPixels;
+
+    LoadSrcBlock(pApply, Block, SrcPixels, n, nSrcStride, 3);
+
+    if (m_pTag->m_bInputMatrix) {
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, 3);
+
+      if (m_ApplyMatrixPtr)
+        icApplyMatrixN(m_ApplyMatrixPtr, Block, n);
+
+      if (m_ApplyCurvePtrM)
+        icApplyCurvesN(m_ApplyCurvePtrM, Block, n, 3);
+
+      if (pCLUT) {
+        if (m_nInterp==icInterpLinear)
+          pCLUT->Interp3dN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+        else
+          pCLUT->Interp3dTetraN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+      }
+
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, nOutput);
+    }
+    else {
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, 3);
+
+      if (pCLUT) {
+        if (m_nInterp==icInterpLinear)
+          pCLUT->Interp3dN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+        else
+          pCLUT->Interp3dTetraN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+      }
+
+      if (m_ApplyCurvePtrM)
+        icApplyCurvesN(m_ApplyCurvePtrM, Block, n, nOutput);
+
+      if (m_ApplyMatrixPtr)
+        icApplyMatrixN(m_ApplyMatrixPtr, Block, n);
+
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, nOutput);
+    }
+
+    StoreDstBlock(DstPixels, Block, n, nDstStride, nOutput);
+
+    SrcPixels += n*nSrcStride;
+    DstPixels += n*nDstStride;
+    nPixels -= n;
+  }
+}
+
 /**
 **************************************************************************
 * Name: CIccXform3DLut::ExtractInputCurves
@@ -5816,6 +6174,71 @@ void CIccXform4DLut::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, cons
   CheckDstAbs(DstPixel);
 }
 
+/**
+ **************************************************************************
+ * Name: CIccXform4DLut::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the Xform to a buffer of pixels.  Pixels are processed in blocks
+ *  with each stage of the lut applied to the whole block in turn.
+ *  
+ * Args:
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixels = Destination pixels where the results are stored,
+ *  SrcPixels = Source pixels which are to be applied,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels.
+ **************************************************************************
+ */
+void CIccXform4DLut::ApplyN(CIccApplyXform* pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                            icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icFloatNumber Block[icXformBlockPixels*icXformBlockStride];
+  icUInt32Number n;
+  int nOutput = m_pTag->m_nOutput;
+  CIccCLUT *pCLUT = m_pTag->m_CLUT;
+
+  while (nPixels) {
+    n = nPixels<icXformBlockPixels ? nPixels : icXformBlockPixels;
+
+    LoadSrcBlock(pApply, Block, SrcPixels, n, nSrcStride, 4);
+
+    if (m_pTag->m_bInputMatrix) {
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, 4);
+
+      if (pCLUT)
+        pCLUT->Interp4dN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, nOutput);
+    }
+    else {
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, 4);
+
+      if (pCLUT)
+        pCLUT->Interp4dN(Block, Block, n, icXformBlockStride, icXformBlockStride);
+
+      if (m_ApplyCurvePtrM)
+        icApplyCurvesN(m_ApplyCurvePtrM, Block, n, nOutput);
+
+      if (m_ApplyMatrixPtr)
+        icApplyMatrixN(m_ApplyMatrixPtr, Block, n);
+
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, nOutput);
+    }
+
+    StoreDstBlock(DstPixels, Block, n, nDstStride, nOutput);
+
+    SrcPixels += n*nSrcStride;
+    DstPixels += n*nDstStride;
+    nPixels -= n;
+  }
+}
+
 /**
 **************************************************************************
 * Name: CIccXform4DLut::ExtractInputCurves
@@ -6076,14 +6499,86 @@ icStatusCMM CIccXformNDLut::Begin()
 
 /**
  **************************************************************************
- * Name: CIccXformNDLut::Apply
+ * Name: CIccXformNDLut::GetNewApply
  * 
  * Purpose: 
- *  Does the actual application of the Xform.
- *  
- * Args:
- *  pApply = ApplyXform object containging temporary storage used during Apply
- *  DstPixel = Destination pixel where the result is stored,
+ *  Allocates an apply object with the CLUT interpolation scratch storage
+ *  needed by luts with more than six inputs.
+ **************************************************************************
+ */
+CIccApplyXform *CIccXformNDLut::GetNewApply(icStatusCMM &status)
+{
+  CIccApplyCLUT *pApplyCLUT = NULL;
+
+  if (m_pTag->m_CLUT && m_nNumInput>6) {
+    pApplyCLUT = m_pTag->m_CLUT->GetNewApply();
+
+    if (!pApplyCLUT) {
+      status = icCmmStatAllocErr;
+      return NULL;
+    }
+  }
+
+  CIccApplyNDLutXform *rv = new CIccApplyNDLutXform(this, pApplyCLUT);
+
+  if (!rv) {
+    if (pApplyCLUT)
+      delete pApplyCLUT;
+    status = icCmmStatAllocErr;
+    return NULL;
+  }
+
+  status = icCmmStatOk;
+  return rv;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccXformNDLut::InterpCLUT
+ * 
+ * Purpose: 
+ *  Interpolates a pixel through the lut's CLUT (in place).
+ *  
+ * Args:
+ *  pApply = ApplyXform object holding CLUT scratch storage
+ *  Pixel = pixel to interpolate
+ **************************************************************************
+ */
+void CIccXformNDLut::InterpCLUT(CIccApplyXform *pApply, icFloatNumber *Pixel) const
+{
+  const CIccCLUT *pCLUT = m_pTag->m_CLUT;
+
+  if (m_nInterp==icInterpSimplex) {
+    pCLUT->InterpNDSimplex(Pixel, Pixel);
+    return;
+  }
+
+  switch(m_nNumInput) {
+  case 5:
+    pCLUT->Interp5d(Pixel, Pixel);
+    break;
+  case 6:
+    pCLUT->Interp6d(Pixel, Pixel);
+    break;
+  default:
+    //Note: pApply should be a CIccApplyNDLutXform type here
+    pCLUT->InterpND(Pixel, Pixel, ((CIccApplyNDLutXform*)pApply)->m_pApply);
+    break;
+  }
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccXformNDLut::Apply
+ * 
+ * Purpose: 
+ *  Does the actual application of the Xform.
+ *  
+ * Args:
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixel = Destination pixel where the result is stored,
  *  SrcPixel = Source pixel which is to be applied.
  **************************************************************************
  */
@@ -6103,17 +6598,7 @@ void CIccXformNDLut::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, cons
     }
 
     if (m_pTag->m_CLUT) {
-      switch(m_nNumInput) {
-      case 5:
-        m_pTag->m_CLUT->Interp5d(Pixel, Pixel);
-        break;
-      case 6:
-        m_pTag->m_CLUT->Interp6d(Pixel, Pixel);
-        break;
-      default:
-        m_pTag->m_CLUT->InterpND(Pixel, Pixel);
-        break;
-      }
+      InterpCLUT(pApply, Pixel);
     }
 
     if (m_ApplyCurvePtrA) {
@@ -6130,17 +6615,7 @@ void CIccXformNDLut::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, cons
     }
 
     if (m_pTag->m_CLUT) {
-      switch(m_nNumInput) {
-      case 5:
-        m_pTag->m_CLUT->Interp5d(Pixel, Pixel);
-        break;
-      case 6:
-        m_pTag->m_CLUT->Interp6d(Pixel, Pixel);
-        break;
-      default:
-        m_pTag->m_CLUT->InterpND(Pixel, Pixel);
-        break;
-      }
+      InterpCLUT(pApply, Pixel);
     }
 
     if (m_ApplyCurvePtrM) {
@@ -6167,6 +6642,74 @@ void CIccXformNDLut::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, cons
   CheckDstAbs(DstPixel);
 }
 
+/**
+ **************************************************************************
+ * Name: CIccXformNDLut::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the Xform to a buffer of pixels.  Pixels are processed in blocks
+ *  with each stage of the lut applied to the whole block in turn.
+ *  
+ * Args:
+ *  pApply = ApplyXform object containging temporary storage used during Apply
+ *  DstPixels = Destination pixels where the results are stored,
+ *  SrcPixels = Source pixels which are to be applied,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels.
+ **************************************************************************
+ */
+void CIccXformNDLut::ApplyN(CIccApplyXform* pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                            icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icFloatNumber Block[icXformBlockPixels*icXformBlockStride];
+  icFloatNumber *pPixel;
+  icUInt32Number k, n;
+  int nOutput = m_pTag->m_nOutput;
+  CIccCLUT *pCLUT = m_pTag->m_CLUT;
+
+  while (nPixels) {
+    n = nPixels<icXformBlockPixels ? nPixels : icXformBlockPixels;
+
+    LoadSrcBlock(pApply, Block, SrcPixels, n, nSrcStride, m_nNumInput);
+
+    if (m_pTag->m_bInputMatrix) {
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, m_nNumInput);
+    }
+    else {
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, m_nNumInput);
+    }
+
+    if (pCLUT) {
+      for (k=0, pPixel=Block; k<n; k++, pPixel+=icXformBlockStride)
+        InterpCLUT(pApply, pPixel);
+    }
+
+    if (m_pTag->m_bInputMatrix) {
+      if (m_ApplyCurvePtrA)
+        icApplyCurvesN(m_ApplyCurvePtrA, Block, n, nOutput);
+    }
+    else {
+      if (m_ApplyCurvePtrM)
+        icApplyCurvesN(m_ApplyCurvePtrM, Block, n, nOutput);
+
+      if (m_ApplyMatrixPtr)
+        icApplyMatrixN(m_ApplyMatrixPtr, Block, n);
+
+      if (m_ApplyCurvePtrB)
+        icApplyCurvesN(m_ApplyCurvePtrB, Block, n, nOutput);
+    }
+
+    StoreDstBlock(DstPixels, Block, n, nDstStride, nOutput);
+
+    SrcPixels += n*nSrcStride;
+    DstPixels += n*nDstStride;
+    nPixels -= n;
+  }
+}
+
 /**
 **************************************************************************
 * Name: CIccXformNDLut::ExtractInputCurves
@@ -7034,6 +7577,9 @@ icStatusCMM CIccXformMpe::Begin()
     return icCmmStatInvalidLut;
   }
 
+  if (m_fCurveTableTolerance>0)
+    m_pTag->SetTableTolerance(m_fCurveTableTolerance);
+
   if (!m_pTag->Begin(icElemInterpLinear, GetProfileCC(), GetConnectionConditions(), GetCmmEnvVarLookup())) {
     return icCmmStatInvalidProfile;
   }
@@ -7070,6 +7616,14 @@ CIccApplyXform *CIccXformMpe::GetNewApply(icStatusCMM &status)
     return NULL;
   }
 
+  rv->m_pSrcBlock = (icFloatNumber*)malloc(icXformBlockPixels*(m_pTag->NumInputChannels()+1)*sizeof(icFloatNumber));
+  rv->m_pDstBlock = (icFloatNumber*)malloc(icXformBlockPixels*(m_pTag->NumOutputChannels()+1)*sizeof(icFloatNumber));
+  if (!rv->m_pSrcBlock || !rv->m_pDstBlock) {
+    status = icCmmStatAllocErr;
+    delete rv;
+    return NULL;
+  }
+
   status = icCmmStatOk;
   return rv;
 }
@@ -7091,6 +7645,7 @@ CIccApplyXform *CIccXformMpe::GetNewApply(icStatusCMM &status)
 void CIccXformMpe::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const
 {
   const CIccTagMultiProcessElement *pTag = m_pTag;
+  icFloatNumber temp[3];
 
   if (!m_bInput) { //PCS comming in?
     if (m_nIntent != icAbsoluteColorimetric)  //B2D3 tags don't need abs conversion
@@ -7098,7 +7653,6 @@ void CIccXformMpe::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, const
 
     //Since MPE tags use "real" values for PCS we need to convert from 
     //internal encoding used by IccProfLib
-    icFloatNumber temp[3];
     switch (GetSrcSpace()) {
       case icSigXYZData:
         memcpy(&temp[0], SrcPixel, 3*sizeof(icFloatNumber));
@@ -7144,6 +7698,122 @@ void CIccXformMpe::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, const
   }
 }
 
+/**
+**************************************************************************
+* Name: CIccXformMpe::ApplyN
+* 
+* Purpose: 
+*  Applies the Xform to a buffer of pixels.  PCS encoding decisions are made
+*  once for the whole buffer.
+*  
+* Args:
+*  pApply = ApplyXform object containging temporary storage used during Apply
+*  DstPixels = Destination pixels where the results are stored,
+*  SrcPixels = Source pixels which are to be applied,
+*  nPixels = number of pixels,
+*  nDstStride = number of samples between destination pixels,
+*  nSrcStride = number of samples between source pixels.
+**************************************************************************
+*/
+void CIccXformMpe::ApplyN(CIccApplyXform* pApply, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                          icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  const CIccTagMultiProcessElement *pTag = m_pTag;
+  bool bAbsConvert = m_nIntent != icAbsoluteColorimetric;  //B2D3/D2B3 tags don't need abs conversion
+  icColorSpaceSignature nSrcSpace = !m_bInput ? GetSrcSpace() : icSigUnknownData;
+  icColorSpaceSignature nDstSpace = m_bInput ? GetDstSpace() : icSigUnknownData;
+  icUInt16Number nIn = pTag->NumInputChannels();
+  icUInt16Number nOut = pTag->NumOutputChannels();
+  bool bOverlap = DstPixels < SrcPixels + nPixels*nSrcStride && SrcPixels < DstPixels + nPixels*nDstStride;
+  bool bDirectSrc = m_bInput && nSrcStride==nIn && (!bOverlap || (DstPixels==SrcPixels && nOut<=nIn));
+  bool bDirectDst = nDstStride==nOut;
+  const icFloatNumber *pSrc;
+  icFloatNumber *pDst, *pPixel;
+  icUInt32Number k, n;
+
+  //Note: pApply should be a CIccApplyXformMpe type here
+  CIccApplyXformMpe *pApplyMpe = (CIccApplyXformMpe *)pApply;
+  CIccApplyTagMpe *pApplyTag = pApplyMpe->m_pApply;
+
+  while (nPixels) {
+    n = nPixels<icXformBlockPixels ? nPixels : icXformBlockPixels;
+
+    //Gather source pixels into a contiguous block converting from internal PCS encoding
+    if (bDirectSrc) {
+      pSrc = SrcPixels;
+    }
+    else {
+      const icFloatNumber *pSrcPixel = SrcPixels;
+
+      for (k=0, pPixel=pApplyMpe->m_pSrcBlock; k<n; k++, pPixel+=nIn, pSrcPixel+=nSrcStride) {
+        const icFloatNumber *pIn = pSrcPixel;
+
+        if (!m_bInput && bAbsConvert)
+          pIn = CheckSrcAbs(pApply, pIn);
+
+        memcpy(pPixel, pIn, nIn*sizeof(icFloatNumber));
+      }
+      pSrc = pApplyMpe->m_pSrcBlock;
+
+      if (nSrcSpace==icSigXYZData)
+        icXyzFromPcsN(pApplyMpe->m_pSrcBlock, n, nIn);
+      else if (nSrcSpace==icSigLabData)
+        icLabFromPcsN(pApplyMpe->m_pSrcBlock, n, nIn);
+    }
+
+    pDst = bDirectDst ? DstPixels : pApplyMpe->m_pDstBlock;
+
+    pTag->ApplyN(pApplyTag, pDst, pSrc, n);
+
+    //Convert to internal PCS encoding and scatter destination pixels
+    if (nDstSpace==icSigXYZData)
+      icXyzToPcsN(pDst, n, nOut);
+    else if (nDstSpace==icSigLabData)
+      icLabToPcsN(pDst, n, nOut);
+
+    if (m_bInput && bAbsConvert) {
+      for (k=0, pPixel=pDst; k<n; k++, pPixel+=nOut)
+        CheckDstAbs(pPixel);
+    }
+
+    if (!bDirectDst) {
+      for (k=0, pPixel=pDst; k<n; k++, pPixel+=nOut)
+        memcpy(DstPixels + k*nDstStride, pPixel, nOut*sizeof(icFloatNumber));
+    }
+
+    SrcPixels += n*nSrcStride;
+    DstPixels += n*nDstStride;
+    nPixels -= n;
+  }
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNDLutXform::CIccApplyNDLutXform
+* 
+* Purpose: 
+*  Constructor (takes ownership of pApply)
+**************************************************************************
+*/
+CIccApplyNDLutXform::CIccApplyNDLutXform(CIccXformNDLut *pXform, CIccApplyCLUT *pApply) : CIccApplyXform(pXform)
+{
+  m_pApply = pApply;
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNDLutXform::~CIccApplyNDLutXform
+* 
+* Purpose: 
+*  Destructor
+**************************************************************************
+*/
+CIccApplyNDLutXform::~CIccApplyNDLutXform()
+{
+  if (m_pApply)
+    delete m_pApply;
+}
+
 /**
 **************************************************************************
 * Name: CIccApplyXformMpe::CIccApplyXformMpe
@@ -7154,6 +7824,9 @@ void CIccXformMpe::Apply(CIccApplyXform* pApply, icFloatNumber *DstPixel, const
 */
 CIccApplyXformMpe::CIccApplyXformMpe(CIccXformMpe *pXform) : CIccApplyXform(pXform)
 {
+  m_pApply = NULL;
+  m_pSrcBlock = NULL;
+  m_pDstBlock = NULL;
 }
 
 /**
@@ -7166,265 +7839,354 @@ CIccApplyXformMpe::CIccApplyXformMpe(CIccXformMpe *pXform) : CIccApplyXform(pXfo
 */
 CIccApplyXformMpe::~CIccApplyXformMpe()
 {
+  if (m_pSrcBlock)
+    free(m_pSrcBlock);
+  if (m_pDstBlock)
+    free(m_pDstBlock);
 }
 
 
 /**
 **************************************************************************
-* Name: CIccApplyCmm::CIccApplyCmm
+* Name: CIccIntLink::CIccIntLink
 * 
 * Purpose: 
 *  Constructor
 *
 * Args:
-*  pCmm = ptr to CMM to apply against
+*  nInput = number of input channels (1 to icIntLinkMaxInputs),
+*  nOutput = number of output channels (1 to icIntLinkMaxOutputs)
 **************************************************************************
 */
-CIccApplyCmm::CIccApplyCmm(CIccCmm *pCmm)
+CIccIntLink::CIccIntLink(icUInt8Number nInput, icUInt8Number nOutput)
 {
-  m_pCmm = pCmm;
-  m_pPCS = m_pCmm->GetPCS();
-
-  m_Xforms = new CIccApplyXformList;
-  m_Xforms->clear();
+  m_nInput = nInput;
+  m_nOutput = nOutput;
+  m_nGridPoints = 0;
 
-  m_Pixel = NULL;
-  m_Pixel2 = NULL;
+  memset(m_DimSize, 0, sizeof(m_DimSize));
+  m_pData = NULL;
+  m_pInCurve = NULL;
+  m_pPos8 = NULL;
 }
 
+
 /**
 **************************************************************************
-* Name: CIccApplyCmm::~CIccApplyCmm
+* Name: CIccIntLink::~CIccIntLink
 * 
 * Purpose: 
 *  Destructor
 **************************************************************************
 */
-CIccApplyCmm::~CIccApplyCmm()
+CIccIntLink::~CIccIntLink()
 {
-  if (m_Xforms) {
-    CIccApplyXformList::iterator i;
+  if (m_pData)
+    free(m_pData);
+  if (m_pInCurve)
+    free(m_pInCurve);
+  if (m_pPos8)
+    free(m_pPos8);
+}
 
-    for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
-      if (i->ptr)
-        delete i->ptr;
-    }
 
-    delete m_Xforms;
-  }
+/**
+**************************************************************************
+* Name: CIccIntLink::Init
+* 
+* Purpose: 
+*  Allocates the grid and builds the 8 bit input tables.
+*
+* Args:
+*  nGridPoints = number of grid points per input channel (at least 2),
+*  pInputCurves = optional input curves with icIntLinkCurveEntries entries
+*   per input channel.  Entry k is the grid position (0 to 65535 spanning
+*   the grid) of input value k/(icIntLinkCurveEntries-1).  Curves must be
+*   non-decreasing.  NULL locates input values linearly in the grid.
+**************************************************************************
+*/
+bool CIccIntLink::Init(icUInt8Number nGridPoints, const icUInt16Number *pInputCurves/*=NULL*/)
+{
+  if (!m_nInput || m_nInput>icIntLinkMaxInputs || !m_nOutput || m_nOutput>icIntLinkMaxOutputs || nGridPoints<2)
+    return false;
 
-  if (m_pPCS)
-    delete m_pPCS;
+  if (m_pData) {
+    free(m_pData);
+    m_pData = NULL;
+  }
+  if (m_pInCurve) {
+    free(m_pInCurve);
+    m_pInCurve = NULL;
+  }
+  if (m_pPos8) {
+    free(m_pPos8);
+    m_pPos8 = NULL;
+  }
 
-  if (m_Pixel)
-    free(m_Pixel);
-  if (m_Pixel2)
-    free(m_Pixel2);
-}
+  m_nGridPoints = nGridPoints;
 
-bool CIccApplyCmm::InitPixel()
-{
-  if (m_Pixel && m_Pixel2)
-    return true;
+  icUInt32Number i, j;
 
-  icUInt16Number nSamples = 16;
-  CIccApplyXformList::iterator i;
+  if (pInputCurves) {
+    m_pInCurve = (icUInt16Number*)malloc(m_nInput * (icIntLinkCurveEntries+1) * sizeof(icUInt16Number));
+    if (!m_pInCurve)
+      return false;
 
-  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
-    if (i->ptr->GetXform()) {
-      icUInt16Number nXformSamples = i->ptr->GetXform()->GetNumDstSamples();
-      if (nXformSamples>nSamples)
-        nSamples=nXformSamples;
+    for (i=0; i<m_nInput; i++) {
+      icUInt16Number *pCurve = m_pInCurve + i*(icIntLinkCurveEntries+1);
+      for (j=0; j<icIntLinkCurveEntries; j++)
+        pCurve[j] = pInputCurves[i*icIntLinkCurveEntries + j];
+      pCurve[icIntLinkCurveEntries] = pCurve[icIntLinkCurveEntries-1];
     }
   }
-  m_Pixel = (icFloatNumber*)malloc(nSamples*sizeof(icFloatNumber));
-  m_Pixel2 = (icFloatNumber*)malloc(nSamples*sizeof(icFloatNumber));
 
-  if (!m_Pixel || !m_Pixel2)
+  icUInt32Number nSize = m_nOutput;
+  for (i=m_nInput; i>0; i--) {
+    m_DimSize[i-1] = nSize;
+    nSize *= nGridPoints;
+  }
+
+  m_pData = (icUInt16Number*)calloc(nSize, sizeof(icUInt16Number));
+  m_pPos8 = (icIntLinkPos*)malloc(m_nInput * 256 * sizeof(icIntLinkPos));
+  if (!m_pData || !m_pPos8)
     return false;
 
+  icUInt16Number Pixel[icIntLinkMaxInputs];
+  icIntLinkPos Pos[icIntLinkMaxInputs];
+  icUInt32Number v;
+
+  for (v=0; v<256; v++) {
+    for (i=0; i<m_nInput; i++)
+      Pixel[i] = (icUInt16Number)(v * 257);
+
+    GetPos(Pos, Pixel);
+
+    for (i=0; i<m_nInput; i++)
+      m_pPos8[i*256 + v] = Pos[i];
+  }
+
   return true;
 }
 
 
 /**
 **************************************************************************
-* Name: CIccApplyCmm::Apply
+* Name: CIccIntLink::GetPos
 * 
 * Purpose: 
-*  Does the actual application of the Xforms in the list.
-*  
-* Args:
-*  DstPixel = Destination pixel where the result is stored,
-*  SrcPixel = Source pixel which is to be applied.
+*  Locates an 8 bit pixel in the grid using the input tables
 **************************************************************************
 */
-icStatusCMM CIccApplyCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel)
+void CIccIntLink::GetPos(icIntLinkPos *pPos, const icUInt8Number *SrcPixel) const
 {
-  icFloatNumber *pDst, *pTmp;
-  const icFloatNumber *pSrc;
-  CIccApplyXformList::iterator i;
-  const CIccXform *pLastXform;
-  int j, n = (int)m_Xforms->size();
-  bool bNoClip;
+  icUInt32Number i;
 
-  if (!n)
-    return icCmmStatBadXform;
+  for (i=0; i<m_nInput; i++)
+    pPos[i] = m_pPos8[i*256 + SrcPixel[i]];
+}
 
-  if (!m_Pixel && !InitPixel()) {
-    return icCmmStatAllocErr;
-  }
 
-  m_pPCS->Reset(m_pCmm->m_nSrcSpace);
+/**
+**************************************************************************
+* Name: CIccIntLink::GetPos
+* 
+* Purpose: 
+*  Locates a 16 bit pixel in the grid.  Values are first mapped through
+*  the input curves (if any) by interpolating the two nearest curve
+*  entries with 8 bits of fraction.  Each value is then scaled to a 16.16
+*  fixed point grid position where 0xffff maps exactly to the last node.
+**************************************************************************
+*/
+void CIccIntLink::GetPos(icIntLinkPos *pPos, const icUInt16Number *SrcPixel) const
+{
+  icUInt32Number i, a, x, n, v, nLast = m_nGridPoints - 1;
 
-  pSrc = SrcPixel;
-  pDst = m_Pixel;
+  for (i=0; i<m_nInput; i++) {
+    v = SrcPixel[i];
 
-  if (n>1) {
-    for (j=0, i=m_Xforms->begin(); j<n-1 && i!=m_Xforms->end(); i++, j++) {
+    if (m_pInCurve) {
+      //Scale 0 to 0xffff onto 0 to 0x10000 so that curve entries are 0x100 apart
+      x = v + (v>>15);
+      n = x & 0xff;
+      const icUInt16Number *pCurve = m_pInCurve + i*(icIntLinkCurveEntries+1) + (x>>8);
+      v = (pCurve[0]*(0x100-n) + pCurve[1]*n + 0x80) >> 8;
+    }
 
-      i->ptr->Apply(pDst, m_pPCS->Check(pSrc, i->ptr->GetXform()));
-      pTmp = (icFloatNumber*)pSrc;
-      pSrc = pDst;
-      if (pTmp == SrcPixel)
-        pDst = m_Pixel2;
-      else
-        pDst = pTmp;
-    }
-
-    pLastXform = i->ptr->GetXform();   
-    i->ptr->Apply(DstPixel, m_pPCS->Check(pSrc, pLastXform));
-    bNoClip = pLastXform->NoClipPCS();
-  }
-  else if (n==1) {
-    i = m_Xforms->begin();
+    a = v * nLast;
+    x = a + (a + 0x7fff) / 0xffff;
+    n = x >> 16;
 
-    pLastXform = i->ptr->GetXform();
-    i->ptr->Apply(DstPixel, m_pPCS->Check(SrcPixel, pLastXform));
-    bNoClip = pLastXform->NoClipPCS();
-  }
-  else {
-    bNoClip = true;
+    pPos[i].nOffset = n * m_DimSize[i];
+    pPos[i].nNext = n<nLast ? m_DimSize[i] : 0;
+    pPos[i].nFrac = x & 0xffff;
   }
-
-  m_pPCS->CheckLast(DstPixel, m_pCmm->m_nDestSpace, bNoClip);
-
-  return icCmmStatOk;
 }
 
+
 /**
 **************************************************************************
-* Name: CIccApplyCmm::Apply
+* Name: CIccIntLink::Interp
 * 
 * Purpose: 
-*  Does the actual application of the Xforms in the list.
-*  
-* Args:
-*  DstPixel = Destination pixel where the result is stored,
-*  SrcPixel = Source pixel which is to be applied.
+*  Simplex interpolation of the grid at the given position.  The simplex
+*  is found by sorting the fractions in descending order, and the weights
+*  of its m_nInput+1 nodes sum to 0x10000 so the weighted sum of 16 bit
+*  node values fits in 32 bits.  For three inputs this is tetrahedral
+*  interpolation.
 **************************************************************************
 */
-icStatusCMM CIccApplyCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels)
+void CIccIntLink::Interp(icUInt16Number *DstPixel, const icIntLinkPos *pPos) const
 {
-  icFloatNumber *pDst, *pTmp;
-  const icFloatNumber *pSrc;
-  CIccApplyXformList::iterator i;
-  int j, n = (int)m_Xforms->size();
-  icUInt32Number k;
-
-  if (!n)
-    return icCmmStatBadXform;
+  icUInt32Number nFrac[icIntLinkMaxInputs+1], nNext[icIntLinkMaxInputs];
+  icUInt32Number nNode[icIntLinkMaxInputs+1], nWeight[icIntLinkMaxInputs+1];
+  icUInt32Number i, j, k, f, d, nOffset = 0;
+  icUInt32Number nInput = m_nInput;
 
-  if (!m_Pixel && !InitPixel()) {
-    return icCmmStatAllocErr;
+  //Insertion sort of the positions by descending fraction
+  for (i=0; i<nInput; i++) {
+    nOffset += pPos[i].nOffset;
+    f = pPos[i].nFrac;
+    d = pPos[i].nNext;
+    for (j=i; j>0 && nFrac[j-1]<f; j--) {
+      nFrac[j] = nFrac[j-1];
+      nNext[j] = nNext[j-1];
+    }
+    nFrac[j] = f;
+    nNext[j] = d;
   }
+  nFrac[nInput] = 0;
 
-  for (k=0; k<nPixels; k++) {
-    m_pPCS->Reset(m_pCmm->m_nSrcSpace);
-
-    pSrc = SrcPixel;
-    pDst = m_Pixel;
+  nNode[0] = 0;
+  nWeight[0] = 0x10000 - nFrac[0];
+  for (i=0; i<nInput; i++) {
+    nNode[i+1] = nNode[i] + nNext[i];
+    nWeight[i+1] = nFrac[i] - nFrac[i+1];
+  }
 
-    if (n>1) {
-      for (j=0, i=m_Xforms->begin(); j<n-1 && i!=m_Xforms->end(); i++, j++) {
+  const icUInt16Number *pData = m_pData + nOffset;
 
-        i->ptr->Apply(pDst, m_pPCS->Check(pSrc, i->ptr->GetXform()));
-        pTmp = (icFloatNumber*)pSrc;
-        pSrc = pDst;
-        if (pTmp==SrcPixel)
-          pDst = m_Pixel2;
-        else
-          pDst = pTmp;
-      }
+  if (nInput==3) {
+    const icUInt16Number *p0 = pData, *p1 = pData+nNode[1], *p2 = pData+nNode[2], *p3 = pData+nNode[3];
+    icUInt32Number w0 = nWeight[0], w1 = nWeight[1], w2 = nWeight[2], w3 = nWeight[3];
 
-      i->ptr->Apply(DstPixel, m_pPCS->Check(pSrc, i->ptr->GetXform()));
+    for (k=0; k<m_nOutput; k++) {
+      DstPixel[k] = (icUInt16Number)((w0*p0[k] + w1*p1[k] + w2*p2[k] + w3*p3[k] + 0x8000) >> 16);
     }
-    else if (n==1) {
-      i = m_Xforms->begin();
-      i->ptr->Apply(DstPixel, m_pPCS->Check(SrcPixel, i->ptr->GetXform()));
+  }
+  else {
+    for (k=0; k<m_nOutput; k++) {
+      icUInt32Number nSum = 0x8000;
+      for (i=0; i<=nInput; i++)
+        nSum += nWeight[i] * pData[nNode[i]+k];
+      DstPixel[k] = (icUInt16Number)(nSum >> 16);
     }
+  }
+}
 
-    m_pPCS->CheckLast(DstPixel, m_pCmm->m_nDestSpace);
 
-    DstPixel += m_pCmm->GetDestSamples();
-    SrcPixel += m_pCmm->GetSourceSamples();
-  }
+static __inline void icIntLinkStore(icUInt16Number *DstPixel, const icUInt16Number *Pixel, icUInt32Number nSamples)
+{
+  memcpy(DstPixel, Pixel, nSamples*sizeof(icUInt16Number));
+}
 
-  return icCmmStatOk;
+static __inline void icIntLinkStore(icUInt8Number *DstPixel, const icUInt16Number *Pixel, icUInt32Number nSamples)
+{
+  icUInt32Number i;
+
+  //Rounded division by 257
+  for (i=0; i<nSamples; i++)
+    DstPixel[i] = (icUInt8Number)(((icUInt32Number)Pixel[i] * 65281 + 8388608) >> 24);
 }
 
-void CIccApplyCmm::AppendApplyXform(CIccApplyXform *pApplyXform)
+template <class TDst, class TSrc>
+static void icIntLinkApply(const CIccIntLink *pLink, TDst *DstPixels, const TSrc *SrcPixels, icUInt32Number nPixels)
 {
-  CIccApplyXformPtr ptr;
-  ptr.ptr = pApplyXform;
+  icIntLinkPos Pos[icIntLinkMaxInputs];
+  icUInt16Number Pixel[icIntLinkMaxOutputs];
+  icUInt32Number nInput = pLink->GetInputDim();
+  icUInt32Number nOutput = pLink->GetOutputChannels();
+  icUInt32Number n;
 
-  m_Xforms->push_back(ptr);
+  for (n=0; n<nPixels; n++) {
+    pLink->GetPos(Pos, SrcPixels);
+    pLink->Interp(Pixel, Pos);
+    icIntLinkStore(DstPixels, Pixel, nOutput);
+
+    SrcPixels += nInput;
+    DstPixels += nOutput;
+  }
 }
 
+
 /**
- **************************************************************************
- * Name: CIccCmm::CIccCmm
- * 
- * Purpose: 
- *  Constructor
- *
- * Args:
- *  nSrcSpace = signature of the source color space,
- *  nDestSpace = signature of the destination color space,
- *  bFirstInput = true if the first profile added is an input profile
- **************************************************************************
- */
-CIccCmm::CIccCmm(icColorSpaceSignature nSrcSpace /*=icSigUnknownData*/,
-                 icColorSpaceSignature nDestSpace /*=icSigUnknownData*/,
-                 bool bFirstInput /*=true*/)
+**************************************************************************
+* Name: CIccIntLink::Apply
+* 
+* Purpose: 
+*  Applies the pipeline to nPixels interleaved pixels
+**************************************************************************
+*/
+void CIccIntLink::Apply(icUInt8Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels) const
 {
-  m_bValid = false;
+  icIntLinkApply(this, DstPixels, SrcPixels, nPixels);
+}
 
-  m_bLastInput = !bFirstInput;
-  m_nSrcSpace = nSrcSpace;
-  m_nDestSpace = nDestSpace;
+void CIccIntLink::Apply(icUInt16Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels) const
+{
+  icIntLinkApply(this, DstPixels, SrcPixels, nPixels);
+}
 
-  m_nLastSpace = nSrcSpace;
-  m_nLastIntent = icUnknownIntent;
+void CIccIntLink::Apply(icUInt16Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels) const
+{
+  icIntLinkApply(this, DstPixels, SrcPixels, nPixels);
+}
 
-  m_Xforms = new CIccXformList;
+void CIccIntLink::Apply(icUInt8Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels) const
+{
+  icIntLinkApply(this, DstPixels, SrcPixels, nPixels);
+}
+
+
+/**
+**************************************************************************
+* Name: CIccApplyCmm::CIccApplyCmm
+* 
+* Purpose: 
+*  Constructor
+*
+* Args:
+*  pCmm = ptr to CMM to apply against
+**************************************************************************
+*/
+CIccApplyCmm::CIccApplyCmm(CIccCmm *pCmm)
+{
+  m_pCmm = pCmm;
+  m_pPCS = m_pCmm->GetPCS();
+
+  m_Xforms = new CIccApplyXformList;
   m_Xforms->clear();
 
-  m_pApply = NULL;
+  m_Pixel = NULL;
+  m_Pixel2 = NULL;
+
+  m_pBatch = NULL;
+  m_nBatchStride = 0;
+
+  m_pLinkApply = NULL;
 }
 
 /**
- **************************************************************************
- * Name: CIccCmm::~CIccCmm
- * 
- * Purpose: 
- *  Destructor
- **************************************************************************
- */
-CIccCmm::~CIccCmm()
+**************************************************************************
+* Name: CIccApplyCmm::~CIccApplyCmm
+* 
+* Purpose: 
+*  Destructor
+**************************************************************************
+*/
+CIccApplyCmm::~CIccApplyCmm()
 {
   if (m_Xforms) {
-    CIccXformList::iterator i;
+    CIccApplyXformList::iterator i;
 
     for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
       if (i->ptr)
@@ -7434,595 +8196,1634 @@ CIccCmm::~CIccCmm()
     delete m_Xforms;
   }
 
-  if (m_pApply)
-    delete m_pApply;
+  if (m_pPCS)
+    delete m_pPCS;
+
+  if (m_Pixel)
+    free(m_Pixel);
+  if (m_Pixel2)
+    free(m_Pixel2);
+  if (m_pBatch)
+    free(m_pBatch);
+  if (m_pLinkApply)
+    delete m_pLinkApply;
 }
 
-/**
- **************************************************************************
- * Name: CIccCmm::AddXform
- * 
- * Purpose: 
- *  Adds a profile at the end of the Xform list 
- * 
- * Args: 
- *  szProfilePath = file name of the profile to be added,
- *  nIntent = rendering intent to be used with the profile,
- *  nInterp = type of interpolation to be used with the profile,
- *  nLutType = selection of which transform lut to use
- *  pHintManager = hints for creating the xform
- * 
- * Return: 
- *  icCmmStatOk, if the profile was added to the list succesfully
- **************************************************************************
- */
-icStatusCMM CIccCmm::AddXform(const icChar *szProfilePath,
-                              icRenderingIntent nIntent /*=icUnknownIntent*/,
-                              icXformInterp nInterp /*icXformInterp*/,
-                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
-                              icXformLutType nLutType /*=icXformLutColor*/,
-                              bool bUseMpeTags /*=true*/,
-                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+bool CIccApplyCmm::InitPixel()
 {
-  CIccProfile *pProfile = OpenIccProfile(szProfilePath);
+  if (m_Pixel && m_Pixel2)
+    return true;
 
-  if (!pProfile) 
-    return icCmmStatCantOpenProfile;
+  icUInt16Number nSamples = 16;
+  CIccApplyXformList::iterator i;
 
-  icStatusCMM rv = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+    if (i->ptr->GetXform()) {
+      icUInt16Number nXformSamples = i->ptr->GetXform()->GetNumDstSamples();
+      if (nXformSamples>nSamples)
+        nSamples=nXformSamples;
+    }
+  }
+  m_Pixel = (icFloatNumber*)malloc(nSamples*sizeof(icFloatNumber));
+  m_Pixel2 = (icFloatNumber*)malloc(nSamples*sizeof(icFloatNumber));
 
-  if (rv != icCmmStatOk)
-    delete pProfile;
+  if (!m_Pixel || !m_Pixel2)
+    return false;
 
-  return rv;
+  return true;
 }
 
-
 /**
 **************************************************************************
-* Name: CIccCmm::AddXform
+* Name: CIccApplyCmm::InitBatch
 * 
 * Purpose: 
-*  Adds a profile at the end of the Xform list 
-* 
-* Args: 
-*  pProfileMem = ptr to profile loaded into memory. Note: this memory
-*   needs to be available until after the Begin() function is called.
-*  nProfileLen = size in bytes of profile loaded into memory
-*  nIntent = rendering intent to be used with the profile,
-*  nInterp = type of interpolation to be used with the profile,
-*  nLutType = selection of which transform lut to use
-*  bUseMpeTags = flag to indicate the use MPE flags if available
-*  pHintManager = hints for creating the xform
-* 
-* Return: 
-*  icCmmStatOk, if the profile was added to the list succesfully
+*  Allocates the two intermediate buffers and the PCS conversion buffer used
+*  by the multi-pixel Apply().  Each buffer holds icApplyBatchPixels pixels.
 **************************************************************************
 */
-icStatusCMM CIccCmm::AddXform(icUInt8Number *pProfileMem,
-                              icUInt32Number nProfileLen,
-                              icRenderingIntent nIntent /*=icUnknownIntent*/,
-                              icXformInterp nInterp /*icXformInterp*/,
-                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
-                              icXformLutType nLutType /*=icXformLutColor*/,
-                              bool bUseMpeTags /*=true*/,
-                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+bool CIccApplyCmm::InitBatch()
 {
-  CIccMemIO *pFile = new CIccMemIO;
-
-  if (!pFile || !pFile->Attach(pProfileMem, nProfileLen))
-    return icCmmStatCantOpenProfile;
-
-  CIccProfile *pProfile = new CIccProfile;
+  if (m_pBatch)
+    return true;
 
-  if (!pProfile)
-    return icCmmStatCantOpenProfile;
+  icUInt16Number nSamples = 16;
+  CIccApplyXformList::iterator i;
 
-  if (!pProfile->Attach(pFile)) {
-    delete pFile;
-    delete pProfile;
-    return icCmmStatCantOpenProfile;
+  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+    if (i->ptr->GetXform()) {
+      icUInt16Number nXformSamples = i->ptr->GetXform()->GetNumDstSamples();
+      if (nXformSamples>nSamples)
+        nSamples=nXformSamples;
+    }
   }
+  if (m_pCmm->GetSourceSamples()>nSamples)
+    nSamples = m_pCmm->GetSourceSamples();
 
-  icStatusCMM rv = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+  m_pBatch = (icFloatNumber*)malloc(3*icApplyBatchPixels*nSamples*sizeof(icFloatNumber));
 
-  if (rv != icCmmStatOk)
-    delete pProfile;
+  if (!m_pBatch)
+    return false;
+
+  m_nBatchStride = nSamples;
+
+  return true;
+}
+
+
+/**
+**************************************************************************
+* Name: CIccApplyCmm::Apply
+* 
+* Purpose: 
+*  Does the actual application of the Xforms in the list.
+*  
+* Args:
+*  DstPixel = Destination pixel where the result is stored,
+*  SrcPixel = Source pixel which is to be applied.
+**************************************************************************
+*/
+icStatusCMM CIccApplyCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel)
+{
+  icFloatNumber *pDst, *pTmp;
+  const icFloatNumber *pSrc;
+  CIccApplyXformList::iterator i;
+  const CIccXform *pLastXform;
+  int j, n = (int)m_Xforms->size();
+  bool bNoClip;
+
+  if (!n)
+    return icCmmStatBadXform;
+
+  if (m_pCmm->m_pLink)
+    return ApplyLink(DstPixel, SrcPixel);
+
+  if (!m_Pixel && !InitPixel()) {
+    return icCmmStatAllocErr;
+  }
+
+  m_pPCS->Reset(m_pCmm->m_nSrcSpace);
+
+  pSrc = SrcPixel;
+  pDst = m_Pixel;
+
+  if (n>1) {
+    for (j=0, i=m_Xforms->begin(); j<n-1 && i!=m_Xforms->end(); i++, j++) {
+
+      i->ptr->Apply(pDst, m_pPCS->Check(pSrc, i->ptr->GetXform()));
+      pTmp = (icFloatNumber*)pSrc;
+      pSrc = pDst;
+      if (pTmp == SrcPixel)
+        pDst = m_Pixel2;
+      else
+        pDst = pTmp;
+    }
+
+    pLastXform = i->ptr->GetXform();   
+    i->ptr->Apply(DstPixel, m_pPCS->Check(pSrc, pLastXform));
+    bNoClip = pLastXform->NoClipPCS();
+  }
+  else if (n==1) {
+    i = m_Xforms->begin();
+
+    pLastXform = i->ptr->GetXform();
+    i->ptr->Apply(DstPixel, m_pPCS->Check(SrcPixel, pLastXform));
+    bNoClip = pLastXform->NoClipPCS();
+  }
+  else {
+    bNoClip = true;
+  }
+
+  m_pPCS->CheckLast(DstPixel, m_pCmm->m_nDestSpace, bNoClip);
+
+  return icCmmStatOk;
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyCmm::Apply
+* 
+* Purpose: 
+*  Does the actual application of the Xforms in the list.  Pixels are pushed
+*  through each xform (and PCS adjustment) icApplyBatchPixels at a time.
+*  
+* Args:
+*  DstPixel = Destination pixel where the result is stored,
+*  SrcPixel = Source pixel which is to be applied,
+*  nPixels = number of pixels to apply.
+**************************************************************************
+*/
+icStatusCMM CIccApplyCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels)
+{
+  icFloatNumber *pDst, *pConvert;
+  const icFloatNumber *pSrc;
+  CIccApplyXformList::iterator i;
+  const CIccXform *pXform;
+  int j, n = (int)m_Xforms->size();
+  icUInt32Number k, nBatch, nSrcStride;
+
+  if (!n)
+    return icCmmStatBadXform;
+
+  icUInt16Number nSrcSamples = m_pCmm->GetSourceSamples();
+  icUInt16Number nDstSamples = m_pCmm->GetDestSamples();
+
+  if (m_pCmm->m_pLink)
+    return ApplyLink(DstPixel, SrcPixel, nPixels);
+
+  if (!m_pBatch && !InitBatch()) {
+    return icCmmStatAllocErr;
+  }
+
+  icFloatNumber *pBatch1 = m_pBatch;
+  icFloatNumber *pBatch2 = m_pBatch + icApplyBatchPixels*m_nBatchStride;
+  pConvert = pBatch2 + icApplyBatchPixels*m_nBatchStride;
+
+  while (nPixels) {
+    nBatch = nPixels<icApplyBatchPixels ? nPixels : icApplyBatchPixels;
+
+    m_pPCS->Reset(m_pCmm->m_nSrcSpace);
+
+    pSrc = SrcPixel;
+    nSrcStride = nSrcSamples;
+    pDst = pBatch1;
+
+    for (j=0, i=m_Xforms->begin(); j<n && i!=m_Xforms->end(); i++, j++) {
+      pXform = i->ptr->GetXform();
+
+      if (j<n-1) {
+        i->ptr->ApplyN(pDst, m_pPCS->CheckN(pSrc, pConvert, nBatch, nSrcStride, pXform), nBatch, m_nBatchStride, nSrcStride);
+        pSrc = pDst;
+        nSrcStride = m_nBatchStride;
+        pDst = (pDst==pBatch1 ? pBatch2 : pBatch1);
+      }
+      else {
+        i->ptr->ApplyN(DstPixel, m_pPCS->CheckN(pSrc, pConvert, nBatch, nSrcStride, pXform), nBatch, nDstSamples, nSrcStride);
+      }
+    }
+
+    m_pPCS->CheckLastN(DstPixel, nBatch, nDstSamples, m_pCmm->m_nDestSpace);
+
+    DstPixel += nBatch*nDstSamples;
+    SrcPixel += nBatch*nSrcSamples;
+    nPixels -= nBatch;
+  }
+
+  return icCmmStatOk;
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyCmm::ApplyLink
+* 
+* Purpose: 
+*  Applies the CMM's device link CLUT to nPixels interleaved pixels in
+*  place of the xform chain.  Must only be called when the CMM has one.
+**************************************************************************
+*/
+icStatusCMM CIccApplyCmm::ApplyLink(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels/*=1*/)
+{
+  if (!m_pLinkApply && !(m_pLinkApply = m_pCmm->m_pLink->GetNewApply()))
+    return icCmmStatAllocErr;
+
+  icUInt16Number nSrcSamples = m_pCmm->GetSourceSamples();
+  icUInt16Number nDstSamples = m_pCmm->GetDestSamples();
+  icUInt32Number k;
+
+  for (k=0; k<nPixels; k++) {
+    m_pCmm->ApplyDeviceLink(m_pLinkApply, DstPixel, SrcPixel);
+    DstPixel += nDstSamples;
+    SrcPixel += nSrcSamples;
+  }
+
+  return icCmmStatOk;
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyCmm::ApplyInt
+* 
+* Purpose: 
+*  Applies the CMM's integer pipeline to nPixels interleaved pixels.
+* 
+* Return: 
+*  icCmmStatIncorrectApply if Begin() did not build an integer pipeline
+**************************************************************************
+*/
+icStatusCMM CIccApplyCmm::ApplyInt(icUInt8Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels)
+{
+  if (!m_pCmm->m_pIntLink)
+    return icCmmStatIncorrectApply;
+
+  m_pCmm->m_pIntLink->Apply(DstPixels, SrcPixels, nPixels);
+
+  return icCmmStatOk;
+}
+
+icStatusCMM CIccApplyCmm::ApplyInt(icUInt16Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels)
+{
+  if (!m_pCmm->m_pIntLink)
+    return icCmmStatIncorrectApply;
+
+  m_pCmm->m_pIntLink->Apply(DstPixels, SrcPixels, nPixels);
+
+  return icCmmStatOk;
+}
+
+icStatusCMM CIccApplyCmm::ApplyInt(icUInt16Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels)
+{
+  if (!m_pCmm->m_pIntLink)
+    return icCmmStatIncorrectApply;
+
+  m_pCmm->m_pIntLink->Apply(DstPixels, SrcPixels, nPixels);
+
+  return icCmmStatOk;
+}
+
+icStatusCMM CIccApplyCmm::ApplyInt(icUInt8Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels)
+{
+  if (!m_pCmm->m_pIntLink)
+    return icCmmStatIncorrectApply;
+
+  m_pCmm->m_pIntLink->Apply(DstPixels, SrcPixels, nPixels);
+
+  return icCmmStatOk;
+}
+
+
+void CIccApplyCmm::AppendApplyXform(CIccApplyXform *pApplyXform)
+{
+  CIccApplyXformPtr ptr;
+  ptr.ptr = pApplyXform;
+
+  m_Xforms->push_back(ptr);
+}
+
+/**
+ **************************************************************************
+ * Name: CIccCmm::CIccCmm
+ * 
+ * Purpose: 
+ *  Constructor
+ *
+ * Args:
+ *  nSrcSpace = signature of the source color space,
+ *  nDestSpace = signature of the destination color space,
+ *  bFirstInput = true if the first profile added is an input profile
+ **************************************************************************
+ */
+CIccCmm::CIccCmm(icColorSpaceSignature nSrcSpace /*=icSigUnknownData*/,
+                 icColorSpaceSignature nDestSpace /*=icSigUnknownData*/,
+                 bool bFirstInput /*=true*/)
+{
+  m_bValid = false;
+
+  m_bLastInput = !bFirstInput;
+  m_nSrcSpace = nSrcSpace;
+  m_nDestSpace = nDestSpace;
+
+  m_nLastSpace = nSrcSpace;
+  m_nLastIntent = icUnknownIntent;
+
+  m_Xforms = new CIccXformList;
+  m_Xforms->clear();
+
+  m_pApply = NULL;
+
+  m_nLinkGridPoints = 0;
+  m_nLinkInterp = icInterpTetrahedral;
+  m_pLink = NULL;
+  m_fLinkMaxDE = 0;
+  m_fLinkMeanDE = 0;
+
+  m_nIntGridPoints = 0;
+  m_fIntMaxAllowed = icIntLinkDefaultMaxDif;
+  m_pIntLink = NULL;
+  m_fIntMaxDif = 0;
+  m_fIntMeanDif = 0;
+}
+
+/**
+ **************************************************************************
+ * Name: CIccCmm::~CIccCmm
+ * 
+ * Purpose: 
+ *  Destructor
+ **************************************************************************
+ */
+CIccCmm::~CIccCmm()
+{
+  if (m_Xforms) {
+    CIccXformList::iterator i;
+
+    for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+      if (i->ptr)
+        delete i->ptr;
+    }
+
+    delete m_Xforms;
+  }
+
+  if (m_pApply)
+    delete m_pApply;
+
+  if (m_pLink)
+    delete m_pLink;
+
+  if (m_pIntLink)
+    delete m_pIntLink;
+}
+
+/**
+ **************************************************************************
+ * Name: CIccCmm::AddXform
+ * 
+ * Purpose: 
+ *  Adds a profile at the end of the Xform list 
+ * 
+ * Args: 
+ *  szProfilePath = file name of the profile to be added,
+ *  nIntent = rendering intent to be used with the profile,
+ *  nInterp = type of interpolation to be used with the profile,
+ *  nLutType = selection of which transform lut to use
+ *  pHintManager = hints for creating the xform
+ * 
+ * Return: 
+ *  icCmmStatOk, if the profile was added to the list succesfully
+ **************************************************************************
+ */
+icStatusCMM CIccCmm::AddXform(const icChar *szProfilePath,
+                              icRenderingIntent nIntent /*=icUnknownIntent*/,
+                              icXformInterp nInterp /*icXformInterp*/,
+                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                              icXformLutType nLutType /*=icXformLutColor*/,
+                              bool bUseMpeTags /*=true*/,
+                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+{
+  CIccProfile *pProfile = OpenIccProfile(szProfilePath);
+
+  if (!pProfile) 
+    return icCmmStatCantOpenProfile;
+
+  icStatusCMM rv = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+
+  if (rv != icCmmStatOk)
+    delete pProfile;
+
+  return rv;
+}
+
+
+/**
+**************************************************************************
+* Name: CIccCmm::AddXform
+* 
+* Purpose: 
+*  Adds a profile at the end of the Xform list 
+* 
+* Args: 
+*  pProfileMem = ptr to profile loaded into memory. Note: this memory
+*   needs to be available until after the Begin() function is called.
+*  nProfileLen = size in bytes of profile loaded into memory
+*  nIntent = rendering intent to be used with the profile,
+*  nInterp = type of interpolation to be used with the profile,
+*  nLutType = selection of which transform lut to use
+*  bUseMpeTags = flag to indicate the use MPE flags if available
+*  pHintManager = hints for creating the xform
+* 
+* Return: 
+*  icCmmStatOk, if the profile was added to the list succesfully
+**************************************************************************
+*/
+icStatusCMM CIccCmm::AddXform(icUInt8Number *pProfileMem,
+                              icUInt32Number nProfileLen,
+                              icRenderingIntent nIntent /*=icUnknownIntent*/,
+                              icXformInterp nInterp /*icXformInterp*/,
+                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                              icXformLutType nLutType /*=icXformLutColor*/,
+                              bool bUseMpeTags /*=true*/,
+                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+{
+  CIccMemIO *pFile = new CIccMemIO;
+
+  if (!pFile || !pFile->Attach(pProfileMem, nProfileLen))
+    return icCmmStatCantOpenProfile;
+
+  CIccProfile *pProfile = new CIccProfile;
+
+  if (!pProfile)
+    return icCmmStatCantOpenProfile;
+
+  if (!pProfile->Attach(pFile)) {
+    delete pFile;
+    delete pProfile;
+    return icCmmStatCantOpenProfile;
+  }
+
+  icStatusCMM rv = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+
+  if (rv != icCmmStatOk)
+    delete pProfile;
+
+  return rv;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmm::AddXform
+ * 
+ * Purpose: 
+ *  Adds a profile at the end of the Xform list 
+ * 
+ * Args: 
+ *  pProfile = pointer to the CIccProfile object to be added,
+ *  nIntent = rendering intent to be used with the profile,
+ *  nInterp = type of interpolation to be used with the profile,
+ *  nLutType = selection of which transform lut to use
+ *  bUseMpeTags = flag to indicate the use MPE flags if available
+ *  pHintManager = hints for creating the xform
+ * 
+ * Return: 
+ *  icCmmStatOk, if the profile was added to the list succesfully
+ **************************************************************************
+ */
+icStatusCMM CIccCmm::AddXform(CIccProfile *pProfile,
+                              icRenderingIntent nIntent /*=icUnknownIntent*/,
+                              icXformInterp nInterp /*=icInterpLinear*/,
+                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                              icXformLutType nLutType /*=icXformLutColor*/,
+                              bool bUseMpeTags /*=true*/,
+                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+{
+  icColorSpaceSignature nSrcSpace, nDstSpace;
+  bool bInput = !m_bLastInput;
+
+  if (!pProfile)
+    return icCmmStatInvalidProfile;
+
+  switch(pProfile->m_Header.deviceClass) {
+    case icSigMaterialIdentificationClass:
+    case icSigMaterialVisualizationClass:
+    case icSigMaterialLinkClass:
+      nIntent = icPerceptual;
+      nLutType = icXformLutMCS;
+
+    default:
+      break;
+  }
+
+  switch (nLutType) {
+    case icXformLutColor:
+    {
+      //Check pProfile if nIntent and input can be found.
+      if (bInput) {
+        nSrcSpace = pProfile->m_Header.colorSpace;
+
+        if (bUseMpeTags && pProfile->m_Header.spectralPCS)
+          nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
+        else
+          nDstSpace = pProfile->m_Header.pcs;
+      }
+      else {
+        if (pProfile->m_Header.deviceClass == icSigLinkClass) {
+          return icCmmStatBadSpaceLink;
+        }
+        if (pProfile->m_Header.deviceClass == icSigAbstractClass) {
+          bInput = true;
+          nIntent = icPerceptual; // Note: icPerceptualIntent = 0
+        }
+
+        if (bUseMpeTags && pProfile->m_Header.spectralPCS)
+          nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
+        else
+          nSrcSpace = pProfile->m_Header.pcs;
+
+        nDstSpace = pProfile->m_Header.colorSpace;
+      }
+    }
+    break;
+
+    case icXformLutPreview:
+      nSrcSpace = pProfile->m_Header.pcs;
+      nDstSpace = pProfile->m_Header.pcs;
+      bInput = false;
+      break;
+
+    case icXformLutGamut:
+      nSrcSpace = pProfile->m_Header.pcs;
+      nDstSpace = icSigGamutData;
+      bInput = true;
+      break;
+
+    case icXformLutBRDFParam:
+      if (!bInput)
+        return icCmmStatBadSpaceLink;
+      nSrcSpace = pProfile->m_Header.colorSpace;
+      nDstSpace = icSigBRDFParameters;
+      bInput = true;
+      break;
+
+    case icXformLutBRDFDirect:
+      if (!bInput)
+        return icCmmStatBadSpaceLink;
+      nSrcSpace = icSigBRDFDirect;
+      nDstSpace = pProfile->m_Header.pcs;
+      bInput = true;
+      break;
+
+    case icXformLutBRDFMcsParam:
+      if (!bInput)
+        return icCmmStatBadSpaceLink;
+      nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
+      nDstSpace = icSigBRDFParameters;
+      break;
+
+    case icXformLutMCS:
+      if (bInput) {
+        nSrcSpace = pProfile->m_Header.colorSpace;
+        nDstSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
+      }
+      else {
+        if (m_Xforms->size()) {
+          CIccXformList::iterator prev = --(m_Xforms->end());
+          
+          //Make sure previous profile connects with an icXformLutMCS
+          if (prev->ptr->GetXformType()!=icXformLutMCS) {
+            //check to see if we can convert previous xform to connect via an MCS
+            if (!prev->ptr->GetProfile()->m_Header.mcs) {
+              return icCmmStatBadMCSLink;
+            }
+
+            CIccXform *pPrev = prev->ptr;
+            CIccXform *pNew = CIccXform::Create(pPrev->GetProfilePtr(), pPrev->IsInput(), pPrev->GetIntent(), pPrev->GetInterp(),
+                                                pPrev->GetConnectionConditions(), icXformLutMCS, bUseMpeTags, pHintManager);
+
+            if (pNew) {
+              pPrev->DetachAll();
+              delete pPrev;
+            }
+
+            prev->ptr = pNew;
+
+          }
+        }
+        else {
+          return icCmmStatBadMCSLink;
+        }
+
+        nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
+        if (pProfile->m_Header.deviceClass==icSigMaterialVisualizationClass) {
+          if (bUseMpeTags && pProfile->m_Header.spectralPCS) {
+            nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
+          }
+          else {
+            nDstSpace = pProfile->m_Header.pcs;
+          }
+        }
+        else if (pProfile->m_Header.deviceClass==icSigMaterialLinkClass) {
+          nDstSpace = pProfile->m_Header.colorSpace;
+        }
+        else {
+          return icCmmStatBadSpaceLink;
+        }
+      }
+      break;
+
+    default:
+      return icCmmStatBadLutType;
+  }
+
+  //Make sure colorspaces match with previous xforms
+  if (!m_Xforms->size()) {
+    if (m_nSrcSpace == icSigUnknownData) {
+      m_nLastSpace = nSrcSpace;
+      m_nSrcSpace = nSrcSpace;
+    }
+    else if (!IsCompatSpace(m_nSrcSpace, nSrcSpace)) {
+      return icCmmStatBadSpaceLink;
+    }
+  }
+  else if (!IsCompatSpace(m_nLastSpace, nSrcSpace)) {
+    return icCmmStatBadSpaceLink;
+  }
+
+  if (nSrcSpace==icSigNamedData)
+    return icCmmStatBadSpaceLink;
+  
+  //Automatic creation of intent from header/last profile
+  if (nIntent==icUnknownIntent) {
+    if (bInput) {
+      nIntent = (icRenderingIntent)pProfile->m_Header.renderingIntent;
+    }
+    else {
+      nIntent = m_nLastIntent;
+    }
+    if (nIntent == icUnknownIntent)
+      nIntent = icPerceptual;
+  }
+
+  CIccXformPtr Xform;
+  
+  Xform.ptr = CIccXform::Create(pProfile, bInput, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+
+  if (!Xform.ptr) {
+    return icCmmStatBadXform;
+  }
+
+  if (pProfile->m_Header.deviceClass==icSigMaterialVisualizationClass) {
+    bInput = true;
+  }
+
+  m_nLastSpace = nDstSpace;
+  m_nLastIntent = nIntent;
+  m_bLastInput = bInput;
+
+  m_Xforms->push_back(Xform);
+
+  return icCmmStatOk;
+}
+
+/**
+**************************************************************************
+* Name: CIccCmm::AddXform
+*
+* Purpose:
+*  Adds a profile at the end of the Xform list
+*
+* Args:
+*  pProfile = pointer to the CIccProfile object to be added,
+*  nIntent = rendering intent to be used with the profile,
+*  nInterp = type of interpolation to be used with the profile,
+*  nLutType = selection of which transform lut to use
+*  bUseMpeTags = flag to indicate the use MPE flags if available
+*  pHintManager = hints for creating the xform
+*
+* Return:
+*  icCmmStatOk, if the profile was added to the list succesfully
+**************************************************************************
+*/
+icStatusCMM CIccCmm::AddXform(CIccProfile *pProfile,
+                              CIccTag *pXformTag,
+                              icRenderingIntent nIntent/*= icUnknownIntent*/,
+                              icXformInterp nInterp /*=icInterpLinear*/,
+                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                              bool bUseSpectralPCS /*=false*/,
+                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+{
+  icColorSpaceSignature nSrcSpace, nDstSpace;
+  bool bInput = !m_bLastInput;
+
+  if (!pProfile)
+    return icCmmStatInvalidProfile;
+
+  switch (pProfile->m_Header.deviceClass) {
+  case icSigMaterialIdentificationClass:
+  case icSigMaterialVisualizationClass:
+  case icSigMaterialLinkClass:
+    return icCmmStatBadLutType;
+
+  default:
+    break;
+  }
+
+  //Check pProfile if nIntent and input can be found.
+  if (bInput) {
+    nSrcSpace = pProfile->m_Header.colorSpace;
+
+    if (bUseSpectralPCS && pProfile->m_Header.spectralPCS)
+      nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
+    else {
+      nDstSpace = pProfile->m_Header.pcs;
+      bUseSpectralPCS = false;
+    }
+  }
+  else {
+    if (pProfile->m_Header.deviceClass == icSigLinkClass) {
+      return icCmmStatBadSpaceLink;
+    }
+    if (pProfile->m_Header.deviceClass == icSigAbstractClass) {
+      bInput = true;
+      nIntent = icPerceptual; // Note: icPerceptualIntent = 0
+    }
+
+    if (bUseSpectralPCS && pProfile->m_Header.spectralPCS)
+      nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
+    else {
+      nSrcSpace = pProfile->m_Header.pcs;
+      bUseSpectralPCS = false;
+    }
+
+    nDstSpace = pProfile->m_Header.colorSpace;
+  }
+
+  //Make sure colorspaces match with previous xforms
+  if (!m_Xforms->size()) {
+    if (m_nSrcSpace == icSigUnknownData) {
+      m_nLastSpace = nSrcSpace;
+      m_nSrcSpace = nSrcSpace;
+    }
+    else if (!IsCompatSpace(m_nSrcSpace, nSrcSpace)) {
+      return icCmmStatBadSpaceLink;
+    }
+  }
+  else if (!IsCompatSpace(m_nLastSpace, nSrcSpace)) {
+    return icCmmStatBadSpaceLink;
+  }
+
+  if (nSrcSpace == icSigNamedData)
+    return icCmmStatBadSpaceLink;
+
+  //Automatic creation of intent from header/last profile
+  if (nIntent == icUnknownIntent) {
+    if (bInput) {
+      nIntent = (icRenderingIntent)pProfile->m_Header.renderingIntent;
+    }
+    else {
+      nIntent = m_nLastIntent;
+    }
+    if (nIntent == icUnknownIntent)
+      nIntent = icPerceptual;
+  }
+
+  CIccXformPtr Xform;
+
+  Xform.ptr = CIccXform::Create(pProfile, pXformTag, bInput, nIntent, nInterp, pPcc, bUseSpectralPCS, pHintManager);
+
+  if (!Xform.ptr) {
+    return icCmmStatBadXform;
+  }
+
+  m_nLastSpace = nDstSpace;
+  m_nLastIntent = nIntent;
+  m_bLastInput = bInput;
+
+  m_Xforms->push_back(Xform);
+
+  return icCmmStatOk;
+}
+
+/**
+ **************************************************************************
+ * Name: CIccCmm::AddXform
+ * 
+ * Purpose: 
+ *  Adds a profile at the end of the Xform list 
+ * 
+ * Args: 
+ *  Profile = reference a CIccProfile object that will be copies and added,
+ *  nIntent = rendering intent to be used with the profile,
+ *  nInterp = type of interpolation to be used with the profile,
+ *  nLutType = selection of which transform lut to use
+ *  bUseMpeTags = flag to indicate the use MPE flags if available
+ *  pHintManager = hints for creating the xform
+ * 
+ * Return: 
+ *  icCmmStatOk, if the profile was added to the list succesfully
+ **************************************************************************
+ */
+icStatusCMM CIccCmm::AddXform(CIccProfile &Profile,
+                              icRenderingIntent nIntent /*=icUnknownIntent*/,
+                              icXformInterp nInterp /*=icInterpLinear*/,
+                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                              icXformLutType nLutType /*=icXformLutColor*/,
+                              bool bUseMpeTags /*=true*/,
+                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+{
+  CIccProfile *pProfile = new CIccProfile(Profile);
+
+  if (!pProfile) 
+    return icCmmStatAllocErr;
+
+ icStatusCMM stat = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+
+  if (stat != icCmmStatOk)
+    delete pProfile;
+
+  return stat;
+}
+
+icStatusCMM CIccCmm::CheckPCSConnections(bool bUsePCSConversions/*=false*/)
+{
+  icStatusCMM rv = icCmmStatOk;
+
+  CIccXformList::iterator last, next;
+  CIccXformList xforms;
+  CIccXformPtr ptr;
+  bool bUsesPcsXforms = false;
+
+  next=m_Xforms->begin();
+
+  if (next!=m_Xforms->end()) {
+    last = next;
+    next++;
+
+    xforms.push_back(*last);
+
+    for (;next!=m_Xforms->end(); last=next, next++) {
+      if ((last->ptr->IsInput() && last->ptr->IsMCS() && next->ptr->IsMCS()) ||
+          (IsSpaceSpectralPCS(last->ptr->GetDstSpace()) || IsSpaceSpectralPCS(next->ptr->GetSrcSpace())) ||
+          (!bUsePCSConversions && 
+           (IsSpaceColorimetricPCS(last->ptr->GetDstSpace()) || IsSpaceColorimetricPCS(next->ptr->GetSrcSpace())))) {
+          last->ptr->SetDstPCSConversion(false);
+          next->ptr->SetSrcPCSConversion(false);
+          CIccPcsXform *pPcs = new CIccPcsXform();
+
+          if (!pPcs) {
+            return icCmmStatAllocErr;
+          }
+
+          rv = pPcs->Connect(last->ptr, next->ptr);
+
+          if (rv!=icCmmStatOk && rv!=icCmmStatIdentityXform)
+            return rv;
+
+          if (rv!=icCmmStatIdentityXform) {
+            ptr.ptr = pPcs;
+            xforms.push_back(ptr);
+          }
+          else {
+            delete pPcs;
+          }
+
+          bUsesPcsXforms = true;
+      }
+      xforms.push_back(*next);
+    }
+  }
+
+  if (bUsesPcsXforms) {
+    *m_Xforms = xforms;
+  }
+
+  return rv;
+}
+
+/**
+**************************************************************************
+* Name: CIccCmm::SetLateBindingCC
+* 
+* Purpose: 
+*  Initializes the LateBinding Connection Conditions used by 
+*  colorimetric based transforms
+*
+**************************************************************************
+*/
+void CIccCmm::SetLateBindingCC()
+{
+  CIccXformList::iterator i;
+  CIccXform *pLastXform = NULL;
+
+  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+    if (i->ptr->IsInput()) {
+      if (i->ptr->IsLateBinding()) {
+        CIccXformList::iterator j=i;
+        j++;
+        if (j!=m_Xforms->end()) {
+          if (j->ptr->IsLateBinding()) {
+            i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+            j->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+            pLastXform = i->ptr;
+          }
+          else {
+            i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+            j->ptr->SetAppliedCC(j->ptr->GetConnectionConditions());
+            pLastXform = NULL;
+          }
+        }
+        else {
+          i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+          pLastXform = NULL;
+        }
+      }
+      else if (IsSpaceSpectralPCS(i->ptr->GetDstSpace())) {
+        CIccXformList::iterator j=i;
+        j++;
+        if (j!=m_Xforms->end()) {
+          if (j->ptr->IsLateBinding()) {
+            j->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+            pLastXform = i->ptr;
+          }
+          else if (!j->ptr->IsAbstract()){
+            j->ptr->SetAppliedCC(j->ptr->GetConnectionConditions());
+            pLastXform = NULL;
+          }
+        }
+      }
+      else {
+        pLastXform = NULL;
+      }
+    }
+    else {
+      if (!pLastXform) 
+        i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+      else
+        pLastXform = NULL;
+    }
+  }
+}
+
+
+/**
+**************************************************************************
+* Name: CIccCmm::Begin
+* 
+* Purpose: 
+*  Does the initialization of the Xforms before Apply() is called.
+*  Must be called before Apply().
+*
+**************************************************************************
+*/
+icStatusCMM CIccCmm::Begin(bool bAllocApplyCmm/*=true*/, bool bUsePCSConversions/*=false*/)
+{
+  if (m_pApply)
+    return icCmmStatOk;
+
+  //Links from an earlier Begin() must not outlive a Begin() that fails
+  FreeSampledLinks();
+
+  if (m_nDestSpace==icSigUnknownData) {
+    m_nDestSpace = m_nLastSpace;
+  }
+  else if (!IsCompatSpace(m_nDestSpace, m_nLastSpace)) {
+    return icCmmStatBadSpaceLink;
+  }
+
+  if (m_nSrcSpace==icSigNamedData || m_nDestSpace==icSigNamedData) {
+    return icCmmStatBadSpaceLink;
+  }
+
+  SetLateBindingCC();
+
+  icStatusCMM rv;
+  CIccXformList::iterator i;
+
+  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+
+    rv = i->ptr->Begin();
+
+    if (rv!= icCmmStatOk)
+      return rv;
+  }
+
+  rv = CheckPCSConnections(bUsePCSConversions);
+  if (rv != icCmmStatOk && rv!=icCmmStatIdentityXform)
+    return rv;
+
+  if (bAllocApplyCmm) {
+    m_pApply = GetNewApplyCmm(rv);
+  }
+  else {
+    rv = icCmmStatOk;
+    m_bValid = true;
+  }
+
+  //The integer pipeline is built first so that it is sampled from the exact xform chain
+  if (rv==icCmmStatOk && m_nIntGridPoints) {
+    rv = BuildIntegerPipeline();
+  }
+
+  if (rv==icCmmStatOk && m_nLinkGridPoints) {
+    rv = BuildDeviceLink();
+  }
 
   return rv;
 }
 
 
 /**
- **************************************************************************
- * Name: CIccCmm::AddXform
- * 
- * Purpose: 
- *  Adds a profile at the end of the Xform list 
- * 
- * Args: 
- *  pProfile = pointer to the CIccProfile object to be added,
- *  nIntent = rendering intent to be used with the profile,
- *  nInterp = type of interpolation to be used with the profile,
- *  nLutType = selection of which transform lut to use
- *  bUseMpeTags = flag to indicate the use MPE flags if available
- *  pHintManager = hints for creating the xform
- * 
- * Return: 
- *  icCmmStatOk, if the profile was added to the list succesfully
- **************************************************************************
- */
-icStatusCMM CIccCmm::AddXform(CIccProfile *pProfile,
-                              icRenderingIntent nIntent /*=icUnknownIntent*/,
-                              icXformInterp nInterp /*=icInterpLinear*/,
-                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
-                              icXformLutType nLutType /*=icXformLutColor*/,
-                              bool bUseMpeTags /*=true*/,
-                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+**************************************************************************
+* Name: CIccCmm::FreeSampledLinks
+* 
+* Purpose: 
+*  Releases the device link CLUT and integer pipeline built by an earlier
+*  Begin() so that a failed Begin() leaves Apply() on the exact xform chain.
+**************************************************************************
+*/
+void CIccCmm::FreeSampledLinks()
 {
-  icColorSpaceSignature nSrcSpace, nDstSpace;
-  bool bInput = !m_bLastInput;
+  if (m_pLink) {
+    delete m_pLink;
+    m_pLink = NULL;
+  }
+  m_fLinkMaxDE = 0;
+  m_fLinkMeanDE = 0;
 
-  if (!pProfile)
-    return icCmmStatInvalidProfile;
+  if (m_pIntLink) {
+    delete m_pIntLink;
+    m_pIntLink = NULL;
+  }
+  m_fIntMaxDif = 0;
+  m_fIntMeanDif = 0;
+}
 
-  switch(pProfile->m_Header.deviceClass) {
-    case icSigMaterialIdentificationClass:
-    case icSigMaterialVisualizationClass:
-    case icSigMaterialLinkClass:
-      nIntent = icPerceptual;
-      nLutType = icXformLutMCS;
 
+/**
+**************************************************************************
+* Type: Class
+*
+* Purpose: IIccCLUTExec used to populate a device link CLUT by applying
+*  the exact xform chain at each grid point.
+**************************************************************************
+*/
+class CIccDeviceLinkSampler : public IIccCLUTExec
+{
+public:
+  CIccDeviceLinkSampler(CIccApplyCmm *pApply) { m_pApply = pApply; }
+  virtual ~CIccDeviceLinkSampler() {}
+
+  virtual void PixelOp(icFloatNumber* pGridAdr, icFloatNumber* pData) { m_pApply->Apply(pData, pGridAdr); }
+
+protected:
+  CIccApplyCmm *m_pApply;
+};
+
+//Maximum number of CLUT entries (grid points * output channels) in a device link
+#define icMaxDeviceLinkEntries  0x1000000
+
+//Maximum number of points used to measure the error of a device link
+#define icMaxDeviceLinkSamples  100000
+
+static void icInterpDeviceLink(const CIccCLUT *pLink, CIccApplyCLUT *pApply, icXformInterp nInterp,
+                               icFloatNumber *DstPixel, const icFloatNumber *SrcPixel)
+{
+  if (nInterp==icInterpSimplex && pLink->GetInputDim()>4) {
+    pLink->InterpNDSimplex(DstPixel, SrcPixel);
+    return;
+  }
+
+  switch(pLink->GetInputDim()) {
+    case 1:
+      pLink->Interp1d(DstPixel, SrcPixel);
+      break;
+    case 2:
+      pLink->Interp2d(DstPixel, SrcPixel);
+      break;
+    case 3:
+      if (nInterp!=icInterpLinear)
+        pLink->Interp3dTetra(DstPixel, SrcPixel);
+      else
+        pLink->Interp3d(DstPixel, SrcPixel);
+      break;
+    case 4:
+      pLink->Interp4d(DstPixel, SrcPixel);
+      break;
+    case 5:
+      pLink->Interp5d(DstPixel, SrcPixel);
+      break;
+    case 6:
+      pLink->Interp6d(DstPixel, SrcPixel);
+      break;
     default:
+      pLink->InterpND(DstPixel, SrcPixel, pApply);
       break;
   }
+}
 
-  switch (nLutType) {
-    case icXformLutColor:
-    {
-      //Check pProfile if nIntent and input can be found.
-      if (bInput) {
-        nSrcSpace = pProfile->m_Header.colorSpace;
-
-        if (bUseMpeTags && pProfile->m_Header.spectralPCS)
-          nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
-        else
-          nDstSpace = pProfile->m_Header.pcs;
-      }
-      else {
-        if (pProfile->m_Header.deviceClass == icSigLinkClass) {
-          return icCmmStatBadSpaceLink;
-        }
-        if (pProfile->m_Header.deviceClass == icSigAbstractClass) {
-          bInput = true;
-          nIntent = icPerceptual; // Note: icPerceptualIntent = 0
-        }
 
-        if (bUseMpeTags && pProfile->m_Header.spectralPCS)
-          nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
-        else
-          nSrcSpace = pProfile->m_Header.pcs;
+/**
+**************************************************************************
+* Name: CIccCmm::BuildDeviceLink
+* 
+* Purpose: 
+*  Samples the begun xform chain onto a CLUT with m_nLinkGridPoints grid
+*  points per input channel.  Once built the CLUT replaces the xform chain
+*  in all Apply() calls.  The error of the CLUT is measured against the
+*  exact xform chain at the centers of the CLUT grid cells.
+*
+*  The chain is left uncollapsed if the source space cannot be sampled
+*  (spectral PCS or more than 15 channels) or the CLUT would be too large.
+**************************************************************************
+*/
+icStatusCMM CIccCmm::BuildDeviceLink()
+{
+  icUInt16Number nSrcSamples = GetSourceSamples();
+  icUInt16Number nDstSamples = GetDestSamples();
+  icUInt16Number i;
 
-        nDstSpace = pProfile->m_Header.colorSpace;
-      }
-    }
-    break;
+  if (m_pLink) {
+    delete m_pLink;
+    m_pLink = NULL;
+  }
 
-    case icXformLutPreview:
-      nSrcSpace = pProfile->m_Header.pcs;
-      nDstSpace = pProfile->m_Header.pcs;
-      bInput = false;
-      break;
+  if (m_nLinkGridPoints<2 || !nSrcSamples || nSrcSamples>15 || !nDstSamples ||
+      IsSpaceSpectralPCS(m_nSrcSpace) || IsSpaceSpectralPCS(m_nDestSpace))
+    return icCmmStatOk;
 
-    case icXformLutGamut:
-      nSrcSpace = pProfile->m_Header.pcs;
-      nDstSpace = icSigGamutData;
-      bInput = true;
-      break;
+  icFloatNumber fEntries = nDstSamples;
+  for (i=0; i<nSrcSamples; i++) {
+    fEntries *= m_nLinkGridPoints;
+    if (fEntries > icMaxDeviceLinkEntries)
+      return icCmmStatOk;
+  }
 
-    case icXformLutBRDFParam:
-      if (!bInput)
-        return icCmmStatBadSpaceLink;
-      nSrcSpace = pProfile->m_Header.colorSpace;
-      nDstSpace = icSigBRDFParameters;
-      bInput = true;
-      break;
+  icStatusCMM rv = icCmmStatOk;
+  CIccApplyCmm *pApply = m_pApply;
 
-    case icXformLutBRDFDirect:
-      if (!bInput)
-        return icCmmStatBadSpaceLink;
-      nSrcSpace = icSigBRDFDirect;
-      nDstSpace = pProfile->m_Header.pcs;
-      bInput = true;
-      break;
+  if (!pApply) {
+    pApply = GetNewApplyCmm(rv);
+    if (!pApply)
+      return rv;
+  }
 
-    case icXformLutBRDFMcsParam:
-      if (!bInput)
-        return icCmmStatBadSpaceLink;
-      nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
-      nDstSpace = icSigBRDFParameters;
-      break;
+  CIccCLUT *pLink = new CIccCLUT((icUInt8Number)nSrcSamples, nDstSamples);
 
-    case icXformLutMCS:
-      if (bInput) {
-        nSrcSpace = pProfile->m_Header.colorSpace;
-        nDstSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
-      }
-      else {
-        if (m_Xforms->size()) {
-          CIccXformList::iterator prev = --(m_Xforms->end());
-          
-          //Make sure previous profile connects with an icXformLutMCS
-          if (prev->ptr->GetXformType()!=icXformLutMCS) {
-            //check to see if we can convert previous xform to connect via an MCS
-            if (!prev->ptr->GetProfile()->m_Header.mcs) {
-              return icCmmStatBadMCSLink;
-            }
+  if (!pLink || !pLink->Init(m_nLinkGridPoints)) {
+    if (pLink)
+      delete pLink;
+    if (pApply!=m_pApply)
+      delete pApply;
+    return icCmmStatAllocErr;
+  }
 
-            CIccXform *pPrev = prev->ptr;
-            CIccXform *pNew = CIccXform::Create(pPrev->GetProfilePtr(), pPrev->IsInput(), pPrev->GetIntent(), pPrev->GetInterp(),
-                                                pPrev->GetConnectionConditions(), icXformLutMCS, bUseMpeTags, pHintManager);
+  CIccDeviceLinkSampler sampler(pApply);
 
-            if (pNew) {
-              pPrev->DetachAll();
-              delete pPrev;
-            }
+  pLink->Iterate(&sampler);
+  pLink->Begin();
 
-            prev->ptr = pNew;
+  CIccApplyCLUT *pLinkApply = pLink->GetNewApply();
 
-          }
-        }
-        else {
-          return icCmmStatBadMCSLink;
-        }
+  //Find number of error samples per channel
+  icUInt32Number nSteps = m_nLinkGridPoints - 1;
+  icUInt32Number nTotal;
 
-        nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.mcs;
-        if (pProfile->m_Header.deviceClass==icSigMaterialVisualizationClass) {
-          if (bUseMpeTags && pProfile->m_Header.spectralPCS) {
-            nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
-          }
-          else {
-            nDstSpace = pProfile->m_Header.pcs;
-          }
-        }
-        else if (pProfile->m_Header.deviceClass==icSigMaterialLinkClass) {
-          nDstSpace = pProfile->m_Header.colorSpace;
-        }
-        else {
-          return icCmmStatBadSpaceLink;
-        }
-      }
+  for (;;) {
+    nTotal = 1;
+    for (i=0; i<nSrcSamples && nTotal<=icMaxDeviceLinkSamples; i++)
+      nTotal *= nSteps;
+    if (nTotal<=icMaxDeviceLinkSamples || nSteps==1)
       break;
-
-    default:
-      return icCmmStatBadLutType;
+    nSteps--;
   }
 
-  //Make sure colorspaces match with previous xforms
-  if (!m_Xforms->size()) {
-    if (m_nSrcSpace == icSigUnknownData) {
-      m_nLastSpace = nSrcSpace;
-      m_nSrcSpace = nSrcSpace;
-    }
-    else if (!IsCompatSpace(m_nSrcSpace, nSrcSpace)) {
-      return icCmmStatBadSpaceLink;
+  icFloatNumber *pSrc = new icFloatNumber[nSrcSamples];
+  icFloatNumber *pExact = new icFloatNumber[nDstSamples];
+  icFloatNumber *pLinked = new icFloatNumber[nDstSamples];
+  icUInt32Number idx[16], n;
+  icFloatNumber dif, maxDif=0;
+  double sumDif = 0;
+
+  memset(idx, 0, sizeof(idx));
+
+  for (n=0; n<nTotal; n++) {
+    for (i=0; i<nSrcSamples; i++)
+      pSrc[i] = (icFloatNumber)((idx[i] + 0.5) / nSteps);
+
+    pApply->Apply(pExact, pSrc);
+    icInterpDeviceLink(pLink, pLinkApply, m_nLinkInterp, pLinked, pSrc);
+
+    dif = DeviceLinkDif(pExact, pLinked);
+    if (dif>maxDif)
+      maxDif = dif;
+    sumDif += dif;
+
+    //Advance to next sample
+    for (i=0; i<nSrcSamples; i++) {
+      if (++idx[i]<nSteps)
+        break;
+      idx[i] = 0;
     }
   }
-  else if (!IsCompatSpace(m_nLastSpace, nSrcSpace)) {
-    return icCmmStatBadSpaceLink;
-  }
 
-  if (nSrcSpace==icSigNamedData)
-    return icCmmStatBadSpaceLink;
-  
-  //Automatic creation of intent from header/last profile
-  if (nIntent==icUnknownIntent) {
-    if (bInput) {
-      nIntent = (icRenderingIntent)pProfile->m_Header.renderingIntent;
+  delete [] pSrc;
+  delete [] pExact;
+  delete [] pLinked;
+  if (pLinkApply)
+    delete pLinkApply;
+
+  if (pApply!=m_pApply)
+    delete pApply;
+
+  m_fLinkMaxDE = maxDif;
+  m_fLinkMeanDE = (icFloatNumber)(nTotal ? sumDif / nTotal : 0.0);
+  m_pLink = pLink;
+
+  return icCmmStatOk;
+}
+
+
+/**
+**************************************************************************
+* Name: CIccCmm::DeviceLinkDif
+* 
+* Purpose: 
+*  Computes the difference between two destination pixels.  When the
+*  destination is a colorimetric PCS the difference is the CIELAB deltaE,
+*  otherwise it is the RMS difference of the channel values scaled to
+*  a 0 to 100 range.
+**************************************************************************
+*/
+icFloatNumber CIccCmm::DeviceLinkDif(const icFloatNumber *Pixel1, const icFloatNumber *Pixel2) const
+{
+  if (m_nDestSpace==icSigLabData || m_nDestSpace==icSigXYZData) {
+    icFloatNumber Lab1[3], Lab2[3];
+
+    memcpy(Lab1, Pixel1, sizeof(Lab1));
+    memcpy(Lab2, Pixel2, sizeof(Lab2));
+
+    if (m_nDestSpace==icSigXYZData) {
+      icXyzFromPcs(Lab1);
+      icXYZtoLab(Lab1, Lab1);
+      icXyzFromPcs(Lab2);
+      icXYZtoLab(Lab2, Lab2);
     }
     else {
-      nIntent = m_nLastIntent;
+      icLabFromPcs(Lab1);
+      icLabFromPcs(Lab2);
     }
-    if (nIntent == icUnknownIntent)
-      nIntent = icPerceptual;
-  }
-
-  CIccXformPtr Xform;
-  
-  Xform.ptr = CIccXform::Create(pProfile, bInput, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
 
-  if (!Xform.ptr) {
-    return icCmmStatBadXform;
+    return icDeltaE(Lab1, Lab2);
   }
 
-  if (pProfile->m_Header.deviceClass==icSigMaterialVisualizationClass) {
-    bInput = true;
+  icUInt16Number i, nSamples = GetDestSamples();
+  double sum = 0;
+
+  for (i=0; i<nSamples; i++) {
+    sum += (Pixel1[i] - Pixel2[i]) * (Pixel1[i] - Pixel2[i]);
   }
 
-  m_nLastSpace = nDstSpace;
-  m_nLastIntent = nIntent;
-  m_bLastInput = bInput;
+  return (icFloatNumber)(sqrt(sum / nSamples) * 100.0);
+}
 
-  m_Xforms->push_back(Xform);
 
-  return icCmmStatOk;
+/**
+**************************************************************************
+* Name: CIccCmm::ApplyDeviceLink
+* 
+* Purpose: 
+*  Applies the device link CLUT built by BuildDeviceLink()
+**************************************************************************
+*/
+void CIccCmm::ApplyDeviceLink(CIccApplyCLUT *pApply, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const
+{
+  icInterpDeviceLink(m_pLink, pApply, m_nLinkInterp, DstPixel, SrcPixel);
 }
 
+
 /**
 **************************************************************************
-* Name: CIccCmm::AddXform
-*
-* Purpose:
-*  Adds a profile at the end of the Xform list
-*
-* Args:
-*  pProfile = pointer to the CIccProfile object to be added,
-*  nIntent = rendering intent to be used with the profile,
-*  nInterp = type of interpolation to be used with the profile,
-*  nLutType = selection of which transform lut to use
-*  bUseMpeTags = flag to indicate the use MPE flags if available
-*  pHintManager = hints for creating the xform
+* Name: CIccCmm::GetDeviceLinkError
+* 
+* Purpose: 
+*  Gets the max and mean error of the device link CLUT relative to the
+*  exact xform chain (see DeviceLinkDif for units).
 *
 * Return:
-*  icCmmStatOk, if the profile was added to the list succesfully
+*  false if Begin() did not collapse the xform chain into a device link
 **************************************************************************
 */
-icStatusCMM CIccCmm::AddXform(CIccProfile *pProfile,
-                              CIccTag *pXformTag,
-                              icRenderingIntent nIntent/*= icUnknownIntent*/,
-                              icXformInterp nInterp /*=icInterpLinear*/,
-                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
-                              bool bUseSpectralPCS /*=false*/,
-                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+bool CIccCmm::GetDeviceLinkError(icFloatNumber &maxDE, icFloatNumber &meanDE) const
 {
-  icColorSpaceSignature nSrcSpace, nDstSpace;
-  bool bInput = !m_bLastInput;
+  if (!m_pLink)
+    return false;
 
-  if (!pProfile)
-    return icCmmStatInvalidProfile;
+  maxDE = m_fLinkMaxDE;
+  meanDE = m_fLinkMeanDE;
 
-  switch (pProfile->m_Header.deviceClass) {
-  case icSigMaterialIdentificationClass:
-  case icSigMaterialVisualizationClass:
-  case icSigMaterialLinkClass:
-    return icCmmStatBadLutType;
+  return true;
+}
 
-  default:
-    break;
-  }
 
-  //Check pProfile if nIntent and input can be found.
-  if (bInput) {
-    nSrcSpace = pProfile->m_Header.colorSpace;
+//Number of levels of the other input channels used when deriving input curves
+#define icIntLinkCurveLevels 5
 
-    if (bUseSpectralPCS && pProfile->m_Header.spectralPCS)
-      nDstSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
-    else {
-      nDstSpace = pProfile->m_Header.pcs;
-      bUseSpectralPCS = false;
+/**
+**************************************************************************
+* Name: icIntLinkInputCurves
+* 
+* Purpose: 
+*  Derives integer pipeline input curves from the begun xform chain.  Each
+*  input channel is swept through the whole chain along icIntLinkCurveLevels
+*  lines with the other channels held at evenly spaced levels from 0.0 to
+*  1.0 (the cube edges and lines through its interior) and along the neutral
+*  axis where all channels change together.  The accumulated change of the
+*  clipped output is used as the grid position, so that grid nodes are
+*  spaced evenly in output change rather than in input value.  A constant
+*  slope of a quarter of the average is added so that the curves are
+*  strictly increasing and every part of the input range keeps some nodes.
+*
+* Args:
+*  pApply = apply object of the xform chain,
+*  nSrcSamples = number of input channels,
+*  nDstSamples = number of output channels,
+*  nGridPoints = number of grid points per input channel,
+*  pCurves = receives icIntLinkCurveEntries entries per input channel,
+*  pNodePos = receives the input value of each grid node (nGridPoints
+*   entries per input channel)
+*
+* Return:
+*  false if the xform chain doesn't change along any input channel
+**************************************************************************
+*/
+static bool icIntLinkInputCurves(CIccApplyCmm *pApply, icUInt32Number nSrcSamples, icUInt32Number nDstSamples,
+                                 icUInt32Number nGridPoints, icUInt16Number *pCurves, icFloatNumber *pNodePos)
+{
+  const icUInt32Number nSteps = icIntLinkCurveEntries - 1;
+  icFloatNumber Src[icIntLinkMaxInputs], Dst[icIntLinkMaxOutputs], Prev[icIntLinkMaxOutputs];
+  double Pos[icIntLinkCurveEntries], v, dif, total;
+  icUInt32Number i, j, k, s, c;
+
+  for (s=0; s<=nSteps; s++)
+    Pos[s] = 0.0;
+
+  //Lines j<icIntLinkCurveLevels sweep channel c with the other channels at a level
+  for (c=0; c<nSrcSamples; c++) {
+    for (j=0; j<icIntLinkCurveLevels; j++) {
+      for (i=0; i<nSrcSamples; i++)
+        Src[i] = (icFloatNumber)j / (icIntLinkCurveLevels-1);
+
+      for (s=0; s<=nSteps; s++) {
+        Src[c] = (icFloatNumber)s / nSteps;
+        pApply->Apply(Dst, Src);
+
+        dif = 0.0;
+        for (k=0; k<nDstSamples; k++) {
+          if (Dst[k]<0.0)
+            Dst[k] = 0.0;
+          else if (Dst[k]>1.0)
+            Dst[k] = 1.0;
+          if (s)
+            dif += fabs(Dst[k] - Prev[k]);
+          Prev[k] = Dst[k];
+        }
+        Pos[s] += dif;
+      }
     }
   }
-  else {
-    if (pProfile->m_Header.deviceClass == icSigLinkClass) {
-      return icCmmStatBadSpaceLink;
-    }
-    if (pProfile->m_Header.deviceClass == icSigAbstractClass) {
-      bInput = true;
-      nIntent = icPerceptual; // Note: icPerceptualIntent = 0
-    }
-
-    if (bUseSpectralPCS && pProfile->m_Header.spectralPCS)
-      nSrcSpace = (icColorSpaceSignature)pProfile->m_Header.spectralPCS;
-    else {
-      nSrcSpace = pProfile->m_Header.pcs;
-      bUseSpectralPCS = false;
-    }
 
-    nDstSpace = pProfile->m_Header.colorSpace;
-  }
+  //The neutral axis where all channels change together is given the weight of all the other lines
+  for (s=0; s<=nSteps; s++) {
+    for (i=0; i<nSrcSamples; i++)
+      Src[i] = (icFloatNumber)s / nSteps;
+    pApply->Apply(Dst, Src);
 
-  //Make sure colorspaces match with previous xforms
-  if (!m_Xforms->size()) {
-    if (m_nSrcSpace == icSigUnknownData) {
-      m_nLastSpace = nSrcSpace;
-      m_nSrcSpace = nSrcSpace;
+    dif = 0.0;
+    for (k=0; k<nDstSamples; k++) {
+      if (Dst[k]<0.0)
+        Dst[k] = 0.0;
+      else if (Dst[k]>1.0)
+        Dst[k] = 1.0;
+      if (s)
+        dif += fabs(Dst[k] - Prev[k]);
+      Prev[k] = Dst[k];
     }
-    else if (!IsCompatSpace(m_nSrcSpace, nSrcSpace)) {
-      return icCmmStatBadSpaceLink;
-    }
-  }
-  else if (!IsCompatSpace(m_nLastSpace, nSrcSpace)) {
-    return icCmmStatBadSpaceLink;
+    Pos[s] += dif * nSrcSamples * icIntLinkCurveLevels;
   }
 
-  if (nSrcSpace == icSigNamedData)
-    return icCmmStatBadSpaceLink;
-
-  //Automatic creation of intent from header/last profile
-  if (nIntent == icUnknownIntent) {
-    if (bInput) {
-      nIntent = (icRenderingIntent)pProfile->m_Header.renderingIntent;
-    }
-    else {
-      nIntent = m_nLastIntent;
-    }
-    if (nIntent == icUnknownIntent)
-      nIntent = icPerceptual;
-  }
+  total = 0.0;
+  for (s=1; s<=nSteps; s++)
+    total += Pos[s];
 
-  CIccXformPtr Xform;
+  if (!(total>0.0))
+    return false;
 
-  Xform.ptr = CIccXform::Create(pProfile, pXformTag, bInput, nIntent, nInterp, pPcc, bUseSpectralPCS, pHintManager);
+  //Accumulate with the minimum slope and convert to 16 bit grid positions
+  icUInt16Number *pCurve = pCurves;
+  icFloatNumber *pNode = pNodePos;
 
-  if (!Xform.ptr) {
-    return icCmmStatBadXform;
+  v = 0.0;
+  Pos[0] = 0.0;
+  for (s=1; s<=nSteps; s++) {
+    v += Pos[s] + 0.25 * total / nSteps;
+    Pos[s] = v;
   }
+  for (s=0; s<=nSteps; s++)
+    pCurve[s] = (icUInt16Number)(Pos[s] / v * 65535.0 + 0.5);
 
-  m_nLastSpace = nDstSpace;
-  m_nLastIntent = nIntent;
-  m_bLastInput = bInput;
+  //Find the input value of each grid node by inverting the 16 bit curve
+  for (i=0, s=0; i<nGridPoints; i++) {
+    v = (double)i * 65535.0 / (nGridPoints-1);
+    while (s<nSteps-1 && pCurve[s+1]<v)
+      s++;
+    v = (v - pCurve[s]) / (pCurve[s+1] - pCurve[s]);
+    if (v<0.0)
+      v = 0.0;
+    else if (v>1.0)
+      v = 1.0;
+    pNode[i] = (icFloatNumber)((s + v) / nSteps);
+  }
 
-  m_Xforms->push_back(Xform);
+  //All channels share the curve so that neutral input stays on the grid diagonal
+  for (c=1; c<nSrcSamples; c++) {
+    memcpy(pCurves + c*icIntLinkCurveEntries, pCurve, icIntLinkCurveEntries*sizeof(icUInt16Number));
+    memcpy(pNodePos + c*nGridPoints, pNode, nGridPoints*sizeof(icFloatNumber));
+  }
 
-  return icCmmStatOk;
+  return true;
 }
 
+
 /**
- **************************************************************************
- * Name: CIccCmm::AddXform
- * 
- * Purpose: 
- *  Adds a profile at the end of the Xform list 
- * 
- * Args: 
- *  Profile = reference a CIccProfile object that will be copies and added,
- *  nIntent = rendering intent to be used with the profile,
- *  nInterp = type of interpolation to be used with the profile,
- *  nLutType = selection of which transform lut to use
- *  bUseMpeTags = flag to indicate the use MPE flags if available
- *  pHintManager = hints for creating the xform
- * 
- * Return: 
- *  icCmmStatOk, if the profile was added to the list succesfully
- **************************************************************************
- */
-icStatusCMM CIccCmm::AddXform(CIccProfile &Profile,
-                              icRenderingIntent nIntent /*=icUnknownIntent*/,
-                              icXformInterp nInterp /*=icInterpLinear*/,
-                              IIccProfileConnectionConditions *pPcc/*=NULL*/,
-                              icXformLutType nLutType /*=icXformLutColor*/,
-                              bool bUseMpeTags /*=true*/,
-                              CIccCreateXformHintManager *pHintManager /*=NULL*/)
+**************************************************************************
+* Name: CIccCmm::BuildIntegerPipeline
+* 
+* Purpose: 
+*  Samples the begun xform chain onto a CIccIntLink with m_nIntGridPoints
+*  grid points per input channel.  Two pipelines are built, one with
+*  linearly spaced grid nodes and one with input curves derived from the
+*  xform chain (see icIntLinkInputCurves), and the one with the smaller
+*  max error is kept.  The error is measured by MeasureIntegerPipeline.
+*  If it is larger than the error allowed by SetIntegerPipeline() no
+*  pipeline is kept and ApplyInt() isn't available.
+*
+*  Beyond the interpolation error of the grid itself the fixed point
+*  arithmetic is within 2 16 bit code values of floating point
+*  interpolation of the same grid (node, position and result rounding)
+*  plus up to 1 code value of input curve rounding.  8 bit output is
+*  additionally rounded to the nearest 8 bit value.  Nodes are clipped to
+*  the 0.0 to 1.0 range, so near the gamut boundary of an unclipped xform
+*  chain results differ from clipping the interpolated floating point
+*  value.
+*
+*  No pipeline is built if either color space is a PCS, the number of
+*  channels isn't supported or the grid would be too large.
+**************************************************************************
+*/
+icStatusCMM CIccCmm::BuildIntegerPipeline()
 {
-  CIccProfile *pProfile = new CIccProfile(Profile);
-
-  if (!pProfile) 
-    return icCmmStatAllocErr;
+  icUInt16Number nSrcSamples = GetSourceSamples();
+  icUInt16Number nDstSamples = GetDestSamples();
+  icUInt32Number i;
 
- icStatusCMM stat = AddXform(pProfile, nIntent, nInterp, pPcc, nLutType, bUseMpeTags, pHintManager);
+  if (m_pIntLink) {
+    delete m_pIntLink;
+    m_pIntLink = NULL;
+  }
 
-  if (stat != icCmmStatOk)
-    delete pProfile;
+  if (m_nIntGridPoints<2 || !nSrcSamples || nSrcSamples>icIntLinkMaxInputs || 
+      !nDstSamples || nDstSamples>icIntLinkMaxOutputs ||
+      IsSpacePCS(m_nSrcSpace) || IsSpacePCS(m_nDestSpace))
+    return icCmmStatOk;
 
-  return stat;
-}
+  icFloatNumber fEntries = nDstSamples;
+  for (i=0; i<nSrcSamples; i++) {
+    fEntries *= m_nIntGridPoints;
+    if (fEntries > icMaxDeviceLinkEntries)
+      return icCmmStatOk;
+  }
 
-icStatusCMM CIccCmm::CheckPCSConnections(bool bUsePCSConversions/*=false*/)
-{
   icStatusCMM rv = icCmmStatOk;
+  CIccApplyCmm *pApply = m_pApply;
 
-  CIccXformList::iterator last, next;
-  CIccXformList xforms;
-  CIccXformPtr ptr;
-  bool bUsesPcsXforms = false;
-
-  next=m_Xforms->begin();
+  if (!pApply) {
+    pApply = GetNewApplyCmm(rv);
+    if (!pApply)
+      return rv;
+  }
 
-  if (next!=m_Xforms->end()) {
-    last = next;
-    next++;
+  CIccIntLink *pIntLink = new CIccIntLink((icUInt8Number)nSrcSamples, (icUInt8Number)nDstSamples);
 
-    xforms.push_back(*last);
+  if (!pIntLink || !pIntLink->Init(m_nIntGridPoints)) {
+    if (pIntLink)
+      delete pIntLink;
+    if (pApply!=m_pApply)
+      delete pApply;
+    return icCmmStatAllocErr;
+  }
 
-    for (;next!=m_Xforms->end(); last=next, next++) {
-      if ((last->ptr->IsInput() && last->ptr->IsMCS() && next->ptr->IsMCS()) ||
-          (IsSpaceSpectralPCS(last->ptr->GetDstSpace()) || IsSpaceSpectralPCS(next->ptr->GetSrcSpace())) ||
-          (!bUsePCSConversions && 
-           (IsSpaceColorimetricPCS(last->ptr->GetDstSpace()) || IsSpaceColorimetricPCS(next->ptr->GetSrcSpace())))) {
-          last->ptr->SetDstPCSConversion(false);
-          next->ptr->SetSrcPCSConversion(false);
-          CIccPcsXform *pPcs = new CIccPcsXform();
+  icFloatNumber maxDif, meanDif;
 
-          if (!pPcs) {
-            return icCmmStatAllocErr;
-          }
+  SampleIntegerPipeline(pApply, pIntLink, NULL);
+  MeasureIntegerPipeline(pApply, pIntLink, maxDif, meanDif);
 
-          rv = pPcs->Connect(last->ptr, next->ptr);
+  //Try prelinearizing the input with curves derived from the xform chain
+  icUInt16Number *pCurves = new icUInt16Number[nSrcSamples * icIntLinkCurveEntries];
+  icFloatNumber *pNodePos = new icFloatNumber[nSrcSamples * m_nIntGridPoints];
 
-          if (rv!=icCmmStatOk && rv!=icCmmStatIdentityXform)
-            return rv;
+  if (icIntLinkInputCurves(pApply, nSrcSamples, nDstSamples, m_nIntGridPoints, pCurves, pNodePos)) {
+    CIccIntLink *pCurveLink = new CIccIntLink((icUInt8Number)nSrcSamples, (icUInt8Number)nDstSamples);
+    icFloatNumber curveMaxDif, curveMeanDif;
 
-          if (rv!=icCmmStatIdentityXform) {
-            ptr.ptr = pPcs;
-            xforms.push_back(ptr);
-          }
-          else {
-            delete pPcs;
-          }
+    if (pCurveLink && pCurveLink->Init(m_nIntGridPoints, pCurves)) {
+      SampleIntegerPipeline(pApply, pCurveLink, pNodePos);
+      MeasureIntegerPipeline(pApply, pCurveLink, curveMaxDif, curveMeanDif);
 
-          bUsesPcsXforms = true;
+      if (curveMaxDif<maxDif) {
+        delete pIntLink;
+        pIntLink = pCurveLink;
+        pCurveLink = NULL;
+        maxDif = curveMaxDif;
+        meanDif = curveMeanDif;
       }
-      xforms.push_back(*next);
     }
+    if (pCurveLink)
+      delete pCurveLink;
   }
 
-  if (bUsesPcsXforms) {
-    *m_Xforms = xforms;
+  delete [] pCurves;
+  delete [] pNodePos;
+
+  if (pApply!=m_pApply)
+    delete pApply;
+
+  m_fIntMaxDif = maxDif;
+  m_fIntMeanDif = meanDif;
+
+  //The xform chain is too nonlinear for the grid so the floating point path is used
+  if (!(maxDif<=m_fIntMaxAllowed)) {
+    delete pIntLink;
+    return icCmmStatOk;
   }
 
-  return rv;
+  m_pIntLink = pIntLink;
+
+  return icCmmStatOk;
 }
 
+
 /**
 **************************************************************************
-* Name: CIccCmm::SetLateBindingCC
+* Name: CIccCmm::SampleIntegerPipeline
 * 
 * Purpose: 
-*  Initializes the LateBinding Connection Conditions used by 
-*  colorimetric based transforms
+*  Samples the xform chain at the grid nodes of pIntLink with the last
+*  input channel varying fastest.
 *
+* Args:
+*  pApply = apply object of the xform chain,
+*  pIntLink = initialized integer pipeline to fill,
+*  pNodePos = input value of each grid node (GetGridPoints() entries per
+*   input channel), or NULL for linearly spaced nodes
 **************************************************************************
 */
-void CIccCmm::SetLateBindingCC()
+void CIccCmm::SampleIntegerPipeline(CIccApplyCmm *pApply, CIccIntLink *pIntLink, const icFloatNumber *pNodePos)
 {
-  CIccXformList::iterator i;
-  CIccXform *pLastXform = NULL;
+  icUInt32Number nSrcSamples = pIntLink->GetInputDim();
+  icUInt32Number nDstSamples = pIntLink->GetOutputChannels();
+  icUInt32Number nGridPoints = pIntLink->GetGridPoints();
+  icFloatNumber Src[icIntLinkMaxInputs], Dst[icIntLinkMaxOutputs];
+  icUInt16Number *pData = pIntLink->GetData();
+  icUInt32Number idx[icIntLinkMaxInputs], i, k, n, nNodes = 1;
+  icFloatNumber v, fLast = (icFloatNumber)(nGridPoints - 1);
 
-  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
-    if (i->ptr->IsInput()) {
-      if (i->ptr->IsLateBinding()) {
-        CIccXformList::iterator j=i;
-        j++;
-        if (j!=m_Xforms->end()) {
-          if (j->ptr->IsLateBinding()) {
-            i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
-            j->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
-            pLastXform = i->ptr;
-          }
-          else {
-            i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
-            j->ptr->SetAppliedCC(j->ptr->GetConnectionConditions());
-            pLastXform = NULL;
-          }
-        }
-        else {
-          i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
-          pLastXform = NULL;
-        }
-      }
-      else if (IsSpaceSpectralPCS(i->ptr->GetDstSpace())) {
-        CIccXformList::iterator j=i;
-        j++;
-        if (j!=m_Xforms->end()) {
-          if (j->ptr->IsLateBinding()) {
-            j->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
-            pLastXform = i->ptr;
-          }
-          else if (!j->ptr->IsAbstract()){
-            j->ptr->SetAppliedCC(j->ptr->GetConnectionConditions());
-            pLastXform = NULL;
-          }
-        }
-      }
-      else {
-        pLastXform = NULL;
-      }
-    }
-    else {
-      if (!pLastXform) 
-        i->ptr->SetAppliedCC(i->ptr->GetConnectionConditions());
+  for (i=0; i<nSrcSamples; i++)
+    nNodes *= nGridPoints;
+
+  memset(idx, 0, sizeof(idx));
+
+  for (n=0; n<nNodes; n++) {
+    for (i=0; i<nSrcSamples; i++) {
+      if (pNodePos)
+        Src[i] = pNodePos[i*nGridPoints + idx[i]];
       else
-        pLastXform = NULL;
+        Src[i] = (icFloatNumber)idx[i] / fLast;
+    }
+
+    pApply->Apply(Dst, Src);
+
+    for (k=0; k<nDstSamples; k++) {
+      v = Dst[k];
+      if (v<0.0)
+        v = 0.0;
+      else if (v>1.0)
+        v = 1.0;
+      *pData++ = (icUInt16Number)(v * 65535.0 + 0.5);
+    }
+
+    for (i=nSrcSamples; i>0; i--) {
+      if (++idx[i-1]<nGridPoints)
+        break;
+      idx[i-1] = 0;
     }
   }
 }
@@ -8030,54 +9831,95 @@ void CIccCmm::SetLateBindingCC()
 
 /**
 **************************************************************************
-* Name: CIccCmm::Begin
+* Name: CIccCmm::MeasureIntegerPipeline
 * 
 * Purpose: 
-*  Does the initialization of the Xforms before Apply() is called.
-*  Must be called before Apply().
-*
+*  Measures the error of an integer pipeline against the exact xform chain
+*  using 16 bit input and output (see DeviceLinkDif for units).  Samples
+*  are taken at the centers of a lattice with as many cells per channel as
+*  the pipeline's grid, which are off the grid nodes, and at four points
+*  per grid cell along the neutral axis.
 **************************************************************************
 */
-icStatusCMM CIccCmm::Begin(bool bAllocApplyCmm/*=true*/, bool bUsePCSConversions/*=false*/)
+void CIccCmm::MeasureIntegerPipeline(CIccApplyCmm *pApply, const CIccIntLink *pIntLink,
+                                     icFloatNumber &maxDif, icFloatNumber &meanDif)
 {
-  if (m_pApply)
-    return icCmmStatOk;
+  icUInt32Number nSrcSamples = pIntLink->GetInputDim();
+  icUInt32Number nDstSamples = pIntLink->GetOutputChannels();
+  icUInt32Number nSteps = pIntLink->GetGridPoints() - 1;
+  icUInt32Number nNeutral = 4 * nSteps;
+  icUInt32Number idx[icIntLinkMaxInputs], i, k, n, nLattice;
 
-  if (m_nDestSpace==icSigUnknownData) {
-    m_nDestSpace = m_nLastSpace;
-  }
-  else if (!IsCompatSpace(m_nDestSpace, m_nLastSpace)) {
-    return icCmmStatBadSpaceLink;
-  }
+  for (nLattice=1, i=0; i<nSrcSamples; i++)
+    nLattice *= nSteps;
 
-  if (m_nSrcSpace==icSigNamedData || m_nDestSpace==icSigNamedData) {
-    return icCmmStatBadSpaceLink;
-  }
+  icUInt16Number SrcPixel[icIntLinkMaxInputs], DstPixel[icIntLinkMaxOutputs];
+  icFloatNumber Src[icIntLinkMaxInputs], Exact[icIntLinkMaxOutputs], Linked[icIntLinkMaxOutputs];
+  icFloatNumber dif;
+  double sumDif = 0;
 
-  SetLateBindingCC();
+  maxDif = 0;
+  memset(idx, 0, sizeof(idx));
 
-  icStatusCMM rv;
-  CIccXformList::iterator i;
+  for (n=0; n<nLattice+nNeutral; n++) {
+    for (i=0; i<nSrcSamples; i++) {
+      if (n<nLattice)
+        SrcPixel[i] = (icUInt16Number)((idx[i] + 0.5) / nSteps * 65535.0 + 0.5);
+      else
+        SrcPixel[i] = (icUInt16Number)((n - nLattice + 0.5) / nNeutral * 65535.0 + 0.5);
+      Src[i] = (icFloatNumber)SrcPixel[i] / 65535.0f;
+    }
 
-  for (i=m_Xforms->begin(); i!=m_Xforms->end(); i++) {
+    pApply->Apply(Exact, Src);
+    pIntLink->Apply(DstPixel, SrcPixel, 1);
 
-    rv = i->ptr->Begin();
+    //Integer data cannot represent values outside of 0.0 to 1.0 so the exact result is clipped
+    for (k=0; k<nDstSamples; k++) {
+      if (Exact[k]<0.0)
+        Exact[k] = 0.0;
+      else if (Exact[k]>1.0)
+        Exact[k] = 1.0;
+      Linked[k] = (icFloatNumber)DstPixel[k] / 65535.0f;
+    }
 
-    if (rv!= icCmmStatOk)
-      return rv;
+    dif = DeviceLinkDif(Exact, Linked);
+    if (dif>maxDif)
+      maxDif = dif;
+    sumDif += dif;
+
+    //Advance to next lattice sample
+    for (i=0; i<nSrcSamples; i++) {
+      if (++idx[i]<nSteps)
+        break;
+      idx[i] = 0;
+    }
   }
 
-  rv = CheckPCSConnections(bUsePCSConversions);
-  if (rv != icCmmStatOk && rv!=icCmmStatIdentityXform)
-    return rv;
+  meanDif = (icFloatNumber)(sumDif / (nLattice+nNeutral));
+}
 
-  if (bAllocApplyCmm) {
-    m_pApply = GetNewApplyCmm(rv);
-  }
-  else
-    rv = icCmmStatOk;
 
-  return rv;
+/**
+**************************************************************************
+* Name: CIccCmm::GetIntegerPipelineError
+* 
+* Purpose: 
+*  Gets the max and mean error of the integer pipeline relative to the
+*  exact xform chain (see DeviceLinkDif for units).
+*
+* Return:
+*  false if Begin() did not build an integer pipeline
+**************************************************************************
+*/
+bool CIccCmm::GetIntegerPipelineError(icFloatNumber &maxDif, icFloatNumber &meanDif) const
+{
+  if (!m_pIntLink)
+    return false;
+
+  maxDif = m_fIntMaxDif;
+  meanDif = m_fIntMeanDif;
+
+  return true;
 }
 
 
@@ -8113,7 +9955,9 @@ CIccApplyCmm *CIccCmm::GetNewApplyCmm(icStatusCMM &status)
     pApply->AppendApplyXform(pXform);
   }
 
-  m_bValid = true;
+  //Begin(false) has already set this for CMMs that are shared between threads
+  if (!m_bValid)
+    m_bValid = true;
 
   status = icCmmStatOk;
 
@@ -8983,6 +10827,7 @@ icColorSpaceSignature CIccCmm::GetLastXformDest()
 */
 CIccApplyNamedColorCmm::CIccApplyNamedColorCmm(CIccNamedColorCmm *pCmm) : CIccApplyCmm(pCmm)
 {
+  m_pBatchNames = NULL;
 }
 
 
@@ -8996,6 +10841,8 @@ CIccApplyNamedColorCmm::CIccApplyNamedColorCmm(CIccNamedColorCmm *pCmm) : CIccAp
 */
 CIccApplyNamedColorCmm::~CIccApplyNamedColorCmm()
 {
+  if (m_pBatchNames)
+    free(m_pBatchNames);
 }
 
 
@@ -9024,6 +10871,9 @@ icStatusCMM CIccApplyNamedColorCmm::Apply(icFloatNumber *DstPixel, const icFloat
   if (!n)
     return icCmmStatBadXform;
 
+  if (m_pCmm->IsDeviceLink())
+    return ApplyLink(DstPixel, SrcPixel);
+
   if (!m_Pixel && !InitPixel()) {
     return icCmmStatAllocErr;
   }
@@ -9153,6 +11003,9 @@ icStatusCMM CIccApplyNamedColorCmm::Apply(icFloatNumber *DstPixel, const icFloat
   if (!n)
     return icCmmStatBadXform;
 
+  if (m_pCmm->IsDeviceLink())
+    return ApplyLink(DstPixel, SrcPixel, nPixels);
+
   if (!m_Pixel && !InitPixel()) {
     return icCmmStatAllocErr;
   }
@@ -9517,62 +11370,326 @@ icStatusCMM CIccApplyNamedColorCmm::Apply(icChar *DstColorName, const icChar *Sr
   const icFloatNumber *pSrc;
   CIccApplyXformList::iterator i;
   int j, n = (int)m_Xforms->size();
-  icChar NamedColor[256];
-  icStatusCMM rv;
+  icChar NamedColor[256];
+  icStatusCMM rv;
+  CIccApplyXform *pApply;
+  const CIccXform *pApplyXform;
+  CIccXformNamedColor *pXform;
+
+  if (!n)
+    return icCmmStatBadXform;
+
+  if (!m_Pixel && !InitPixel()) {
+    return icCmmStatAllocErr;
+  }
+
+  i=m_Xforms->begin();
+
+  pApply = i->ptr;
+  pApplyXform = pApply->GetXform();
+  if (pApplyXform->GetXformType()!=icXformTypeNamedColor)
+    return icCmmStatIncorrectApply;
+
+  pXform = (CIccXformNamedColor*)pApplyXform;
+
+  m_pPCS->Reset(pXform->GetSrcSpace(), pXform->UseLegacyPCS());
+
+  pDst = m_Pixel;
+
+  if (n>1) {
+    rv = pXform->Apply(pApply, pDst, SrcColorName, tint);
+
+    if (rv) {
+      return rv;
+    }
+
+    pSrc = pDst;
+    pDst = m_Pixel2;
+
+    for (j=0, i++; j<n-2 && i!=m_Xforms->end(); i++, j++) {
+
+      pApply = i->ptr;
+      pApplyXform = pApply->GetXform();
+      if (pApplyXform->GetXformType()==icXformTypeNamedColor) {
+        pXform = (CIccXformNamedColor*)pApplyXform;
+        switch(pXform->GetInterface()) {
+        case icApplyPixel2Pixel:
+          pXform->Apply(pApply, pDst, m_pPCS->Check(pSrc, pXform));
+          break;
+
+
+        case icApplyPixel2Named:
+          pXform->Apply(pApply, NamedColor, m_pPCS->Check(pSrc, pXform));
+          break;
+
+        case icApplyNamed2Pixel:
+          rv = pXform->Apply(pApply, pDst, NamedColor);
+          if (rv) {
+            return rv;
+          }
+          break;
+
+        default:
+          break;
+        }
+      }
+      else {
+        pApplyXform->Apply(pApply, pDst, m_pPCS->Check(pSrc, pApplyXform));
+      }
+      pTmp = (icFloatNumber*)pSrc;
+      pSrc = pDst;
+      pDst = pTmp;
+    }
+
+    pApply = i->ptr;
+    pApplyXform = pApply->GetXform();
+    if (pApplyXform->GetXformType()==icXformTypeNamedColor) {
+      pXform = (CIccXformNamedColor*)pApplyXform;
+      switch(pXform->GetInterface()) {
+      case icApplyPixel2Named:
+        pXform->Apply(pApply, DstColorName, m_pPCS->Check(pSrc, pXform));
+        break;
+
+      case icApplyPixel2Pixel:
+      case icApplyNamed2Pixel:
+      default:
+        return icCmmStatIncorrectApply;
+        break;
+      }
+    }
+    else {
+      return icCmmStatIncorrectApply;
+    }
+
+  }
+  else if (n==1) {
+    return icCmmStatIncorrectApply;
+  }
+
+  return icCmmStatOk;
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch version of Apply() converting color names to pixels.
+*  
+* Args:
+*  DstPixels = Destination pixels where the results are stored,
+*  SrcColorNames = Source color names which are to be searched,
+*  SrcTints = tint of each color (NULL for full tint),
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color.
+**************************************************************************
+*/
+icStatusCMM CIccApplyNamedColorCmm::Apply(icFloatNumber *DstPixels, const icChar * const *SrcColorNames,
+                                          const icFloatNumber *SrcTints, icUInt32Number nColors,
+                                          icStatusCMM *pStatus/*=NULL*/)
+{
+  return ApplyBatch(DstPixels, NULL, NULL, SrcColorNames, SrcTints, nColors, pStatus);
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch version of Apply() converting pixels to color names.
+*  
+* Args:
+*  DstColorNames = Destination strings where the results are stored,
+*  SrcPixels = Source pixels which are to be applied,
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color.
+**************************************************************************
+*/
+icStatusCMM CIccApplyNamedColorCmm::Apply(icChar **DstColorNames, const icFloatNumber *SrcPixels,
+                                          icUInt32Number nColors, icStatusCMM *pStatus/*=NULL*/)
+{
+  return ApplyBatch(NULL, DstColorNames, SrcPixels, NULL, NULL, nColors, pStatus);
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch version of Apply() converting color names to color names.
+*  
+* Args:
+*  DstColorNames = Destination strings where the results are stored,
+*  SrcColorNames = Source color names which are to be searched,
+*  SrcTints = tint of each color (NULL for full tint),
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color.
+**************************************************************************
+*/
+icStatusCMM CIccApplyNamedColorCmm::Apply(icChar **DstColorNames, const icChar * const *SrcColorNames,
+                                          const icFloatNumber *SrcTints, icUInt32Number nColors,
+                                          icStatusCMM *pStatus/*=NULL*/)
+{
+  return ApplyBatch(NULL, DstColorNames, NULL, SrcColorNames, SrcTints, nColors, pStatus);
+}
+
+/**
+**************************************************************************
+* Name: CIccApplyNamedColorCmm::ApplyBatch
+* 
+* Purpose: 
+*  Common implementation of the batch named color Apply() interfaces.
+*  Colors are pushed through each xform (and PCS adjustment)
+*  icApplyBatchPixels at a time so that each stage (named color search or
+*  pixel xform) is run over the whole batch before moving to the next.
+*  The same xform sequences are accepted as by the single color Apply().
+*  Colors that fail at one stage are skipped by later named color stages.
+*  
+* Args:
+*  DstPixels = Destination pixels (NULL if DstColorNames is used),
+*  DstColorNames = Destination strings (NULL if DstPixels is used),
+*  SrcPixels = Source pixels (NULL if SrcColorNames is used),
+*  SrcColorNames = Source color names (NULL if SrcPixels is used),
+*  SrcTints = tint of each source color name (NULL for full tint),
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color.
+**************************************************************************
+*/
+icStatusCMM CIccApplyNamedColorCmm::ApplyBatch(icFloatNumber *DstPixels, icChar **DstColorNames,
+                                               const icFloatNumber *SrcPixels, const icChar * const *SrcColorNames,
+                                               const icFloatNumber *SrcTints, icUInt32Number nColors,
+                                               icStatusCMM *pStatus)
+{
+  icFloatNumber *pDst, *pOut, *pConvert;
+  const icFloatNumber *pSrc, *pIn;
+  CIccApplyXformList::iterator i;
+  int j, n = (int)m_Xforms->size();
   CIccApplyXform *pApply;
   const CIccXform *pApplyXform;
   CIccXformNamedColor *pXform;
+  icUInt32Number k, nBatch, nSrcStride, nOutStride;
+  icStatusCMM stat[icApplyBatchPixels];
+  icStatusCMM rv = icCmmStatOk;
+  bool bSrcNames = SrcColorNames!=NULL;
+  bool bDstNames = DstColorNames!=NULL;
+  bool bLast;
 
   if (!n)
     return icCmmStatBadXform;
 
-  if (!m_Pixel && !InitPixel()) {
-    return icCmmStatAllocErr;
+  //Check that the xform sequence can produce the requested result
+  for (j=0, i=m_Xforms->begin(); i!=m_Xforms->end(); i++, j++) {
+    pApplyXform = i->ptr->GetXform();
+    bool bNamed = pApplyXform->GetXformType()==icXformTypeNamedColor;
+    icApplyInterface nInterface = bNamed ? ((CIccXformNamedColor*)pApplyXform)->GetInterface() : icApplyPixel2Pixel;
+
+    if (!j) {
+      if (bSrcNames ? !bNamed : (bNamed && (n==1 ? !bDstNames : nInterface==icApplyNamed2Pixel)))
+        return icCmmStatIncorrectApply;
+      if (!bSrcNames && bDstNames && n==1 && (!bNamed || nInterface!=icApplyPixel2Named))
+        return icCmmStatIncorrectApply;
+    }
+    if (j==n-1 && j) {
+      if (bDstNames ? (!bNamed || nInterface!=icApplyPixel2Named) : (bNamed && nInterface==icApplyPixel2Named))
+        return icCmmStatIncorrectApply;
+    }
   }
+  if (n==1 && bSrcNames && bDstNames)
+    return icCmmStatIncorrectApply;
 
-  i=m_Xforms->begin();
+  if (!m_pBatch && !InitBatch())
+    return icCmmStatAllocErr;
 
-  pApply = i->ptr;
-  pApplyXform = pApply->GetXform();
-  if (pApplyXform->GetXformType()!=icXformTypeNamedColor)
-    return icCmmStatIncorrectApply;
+  if (!m_pBatchNames && !(m_pBatchNames = (icChar*)calloc(icApplyBatchPixels, icNamedColorNameSize)))
+    return icCmmStatAllocErr;
 
-  pXform = (CIccXformNamedColor*)pApplyXform;
+  icUInt16Number nSrcSamples = m_pCmm->GetSourceSamples();
+  icUInt16Number nDstSamples = m_pCmm->GetDestSamples();
 
-  m_pPCS->Reset(pXform->GetSrcSpace(), pXform->UseLegacyPCS());
+  icFloatNumber *pBatch1 = m_pBatch;
+  icFloatNumber *pBatch2 = m_pBatch + icApplyBatchPixels*m_nBatchStride;
+  pConvert = pBatch2 + icApplyBatchPixels*m_nBatchStride;
 
-  pDst = m_Pixel;
+  while (nColors) {
+    nBatch = nColors<icApplyBatchPixels ? nColors : icApplyBatchPixels;
 
-  if (n>1) {
-    rv = pXform->Apply(pApply, pDst, SrcColorName, tint);
+    for (k=0; k<nBatch; k++)
+      stat[k] = icCmmStatOk;
 
-    if (rv) {
-      return rv;
-    }
+    i = m_Xforms->begin();
+    pSrc = SrcPixels;
+    nSrcStride = nSrcSamples;
+    pDst = pBatch1;
 
-    pSrc = pDst;
-    pDst = m_Pixel2;
+    if (bSrcNames) {
+      pApply = i->ptr;
+      pXform = (CIccXformNamedColor*)pApply->GetXform();
+      m_pPCS->Reset(pXform->GetSrcSpace(), pXform->UseLegacyPCS());
 
-    for (j=0, i++; j<n-2 && i!=m_Xforms->end(); i++, j++) {
+      pOut = n==1 ? DstPixels : pDst;
+      nOutStride = n==1 ? nDstSamples : m_nBatchStride;
+
+      for (k=0; k<nBatch; k++) {
+        stat[k] = pXform->Apply(pApply, pOut + k*nOutStride, SrcColorNames[k], SrcTints ? SrcTints[k] : (icFloatNumber)1.0);
+        if (stat[k])
+          memset(pOut + k*nOutStride, 0, nOutStride*sizeof(icFloatNumber));
+      }
+
+      if (n==1) {
+        //Only updates the PCS state as done by the single color Apply()
+        m_pPCS->CheckN(pOut, pConvert, nBatch, nOutStride, pXform);
+      }
+      else {
+        pSrc = pDst;
+        nSrcStride = m_nBatchStride;
+        pDst = pBatch2;
+      }
+
+      i++;
+      j = 1;
+    }
+    else {
+      m_pPCS->Reset(m_pCmm->GetSourceSpace());
+      j = 0;
+    }
 
+    for (; j<n && i!=m_Xforms->end(); i++, j++) {
+      bLast = (j==n-1);
       pApply = i->ptr;
       pApplyXform = pApply->GetXform();
+
+      pOut = bLast ? DstPixels : pDst;
+      nOutStride = bLast ? nDstSamples : m_nBatchStride;
+
       if (pApplyXform->GetXformType()==icXformTypeNamedColor) {
         pXform = (CIccXformNamedColor*)pApplyXform;
+
         switch(pXform->GetInterface()) {
         case icApplyPixel2Pixel:
-          pXform->Apply(pApply, pDst, m_pPCS->Check(pSrc, pXform));
+          pIn = m_pPCS->CheckN(pSrc, pConvert, nBatch, nSrcStride, pXform);
+          for (k=0; k<nBatch; k++) {
+            if (!stat[k])
+              pXform->Apply(pApply, pOut + k*nOutStride, pIn + k*nSrcStride);
+          }
           break;
 
-
         case icApplyPixel2Named:
-          pXform->Apply(pApply, NamedColor, m_pPCS->Check(pSrc, pXform));
+          pIn = m_pPCS->CheckN(pSrc, pConvert, nBatch, nSrcStride, pXform);
+          for (k=0; k<nBatch; k++) {
+            icChar *szName = bLast ? DstColorNames[k] : m_pBatchNames + k*icNamedColorNameSize;
+            if (!stat[k])
+              stat[k] = pXform->Apply(pApply, szName, pIn + k*nSrcStride);
+            if (stat[k])
+              szName[0] = '\0';
+          }
           break;
 
         case icApplyNamed2Pixel:
-          rv = pXform->Apply(pApply, pDst, NamedColor);
-          if (rv) {
-            return rv;
+          for (k=0; k<nBatch; k++) {
+            if (!stat[k])
+              stat[k] = pXform->Apply(pApply, pOut + k*nOutStride, m_pBatchNames + k*icNamedColorNameSize);
+            if (stat[k])
+              memset(pOut + k*nOutStride, 0, nOutStride*sizeof(icFloatNumber));
           }
           break;
 
@@ -9581,39 +11698,45 @@ icStatusCMM CIccApplyNamedColorCmm::Apply(icChar *DstColorName, const icChar *Sr
         }
       }
       else {
-        pApplyXform->Apply(pApply, pDst, m_pPCS->Check(pSrc, pXform));
+        pApply->ApplyN(pOut, m_pPCS->CheckN(pSrc, pConvert, nBatch, nSrcStride, pApplyXform), nBatch, nOutStride, nSrcStride);
+      }
+
+      if (!bLast) {
+        pSrc = pDst;
+        nSrcStride = m_nBatchStride;
+        pDst = (pDst==pBatch1 ? pBatch2 : pBatch1);
       }
-      pTmp = (icFloatNumber*)pSrc;
-      pSrc = pDst;
-      pDst = pTmp;
     }
 
-    pApply = i->ptr;
-    pApplyXform = pApply->GetXform();
-    if (pApplyXform->GetXformType()==icXformTypeNamedColor) {
-      pXform = (CIccXformNamedColor*)pApplyXform;
-      switch(pXform->GetInterface()) {
-      case icApplyPixel2Named:
-        pXform->Apply(pApply, DstColorName, m_pPCS->Check(pSrc, pXform));
-        break;
+    if (!bDstNames)
+      m_pPCS->CheckLastN(DstPixels, nBatch, nDstSamples, m_pCmm->GetDestSpace());
 
-      case icApplyPixel2Pixel:
-      case icApplyNamed2Pixel:
-      default:
-        return icCmmStatIncorrectApply;
-        break;
-      }
+    for (k=0; k<nBatch; k++) {
+      if (stat[k] && !rv)
+        rv = stat[k];
     }
-    else {
-      return icCmmStatIncorrectApply;
+    if (pStatus) {
+      memcpy(pStatus, stat, nBatch*sizeof(icStatusCMM));
+      pStatus += nBatch;
     }
 
-  }
-  else if (n==1) {
-    return icCmmStatIncorrectApply;
+    if (bSrcNames) {
+      SrcColorNames += nBatch;
+      if (SrcTints)
+        SrcTints += nBatch;
+    }
+    else
+      SrcPixels += nBatch*nSrcSamples;
+
+    if (bDstNames)
+      DstColorNames += nBatch;
+    else
+      DstPixels += nBatch*nDstSamples;
+
+    nColors -= nBatch;
   }
 
-  return icCmmStatOk;
+  return rv;
 }
 
 /**
@@ -9937,6 +12060,8 @@ icStatusCMM CIccNamedColorCmm::AddXform(CIccProfile *pProfile,
  */
  icStatusCMM CIccNamedColorCmm::Begin(bool bAllocNewApply/* =true */, bool bUsePcsConversion/*=false*/)
 {
+  FreeSampledLinks();
+
   if (m_nDestSpace==icSigUnknownData) {
     m_nDestSpace = m_nLastSpace;
   }
@@ -9983,8 +12108,18 @@ icStatusCMM CIccNamedColorCmm::AddXform(CIccProfile *pProfile,
 
     m_pApply = GetNewApplyCmm(rv);
   }
-  else
+  else {
     rv = icCmmStatOk;
+    m_bValid = true;
+  }
+
+  if (rv==icCmmStatOk && m_nIntGridPoints && m_nApplyInterface==icApplyPixel2Pixel) {
+    rv = BuildIntegerPipeline();
+  }
+
+  if (rv==icCmmStatOk && m_nLinkGridPoints && m_nApplyInterface==icApplyPixel2Pixel) {
+    rv = BuildDeviceLink();
+  }
 
   return rv;
 }
@@ -10014,7 +12149,9 @@ icStatusCMM CIccNamedColorCmm::AddXform(CIccProfile *pProfile,
     pApply->AppendApplyXform(pXform);
   }
 
-  m_bValid = true;
+  //Begin(false) has already set this for CMMs that are shared between threads
+  if (!m_bValid)
+    m_bValid = true;
 
   status = icCmmStatOk;
   return pApply;
@@ -10075,6 +12212,179 @@ icStatusCMM CIccNamedColorCmm::Apply(icChar* DstColorName, const icChar *SrcColo
 }
 
 
+/**
+**************************************************************************
+* Name: CIccNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch conversion of color names to pixels.
+*  
+* Args:
+*  DstPixels = Destination pixels where the results are stored,
+*  SrcColorNames = Source color names which are to be searched,
+*  SrcTints = tint of each color (NULL for full tint),
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color,
+*  nThreads = number of worker apply objects to use.
+**************************************************************************
+*/
+icStatusCMM CIccNamedColorCmm::Apply(icFloatNumber *DstPixels, const icChar * const *SrcColorNames,
+                                     const icFloatNumber *SrcTints, icUInt32Number nColors,
+                                     icStatusCMM *pStatus/*=NULL*/, icUInt32Number nThreads/*=1*/)
+{
+  return ApplyBatch(DstPixels, NULL, NULL, SrcColorNames, SrcTints, nColors, pStatus, nThreads);
+}
+
+
+/**
+**************************************************************************
+* Name: CIccNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch conversion of pixels to color names.
+*  
+* Args:
+*  DstColorNames = Destination strings where the results are stored,
+*  SrcPixels = Source pixels which are to be applied,
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color,
+*  nThreads = number of worker apply objects to use.
+**************************************************************************
+*/
+icStatusCMM CIccNamedColorCmm::Apply(icChar **DstColorNames, const icFloatNumber *SrcPixels, icUInt32Number nColors,
+                                     icStatusCMM *pStatus/*=NULL*/, icUInt32Number nThreads/*=1*/)
+{
+  return ApplyBatch(NULL, DstColorNames, SrcPixels, NULL, NULL, nColors, pStatus, nThreads);
+}
+
+
+/**
+**************************************************************************
+* Name: CIccNamedColorCmm::Apply
+* 
+* Purpose: 
+*  Batch conversion of color names to color names.
+*  
+* Args:
+*  DstColorNames = Destination strings where the results are stored,
+*  SrcColorNames = Source color names which are to be searched,
+*  SrcTints = tint of each color (NULL for full tint),
+*  nColors = number of colors,
+*  pStatus = optional array to receive the status of each color,
+*  nThreads = number of worker apply objects to use.
+**************************************************************************
+*/
+icStatusCMM CIccNamedColorCmm::Apply(icChar **DstColorNames, const icChar * const *SrcColorNames,
+                                     const icFloatNumber *SrcTints, icUInt32Number nColors,
+                                     icStatusCMM *pStatus/*=NULL*/, icUInt32Number nThreads/*=1*/)
+{
+  return ApplyBatch(NULL, DstColorNames, NULL, SrcColorNames, SrcTints, nColors, pStatus, nThreads);
+}
+
+
+/**
+**************************************************************************
+* Name: CIccNamedColorCmm::ApplyBatch
+* 
+* Purpose: 
+*  Divides a batch of named color conversions into contiguous ranges that
+*  are applied by separate worker apply objects.  The first range uses the
+*  CMM's own apply object on the calling thread.
+*  
+* Args:
+*  See CIccApplyNamedColorCmm::ApplyBatch(),
+*  nThreads = number of workers (zero uses one per hardware thread).
+* 
+* Return:
+*  The first failing status in color order, or icCmmStatOk.
+**************************************************************************
+*/
+icStatusCMM CIccNamedColorCmm::ApplyBatch(icFloatNumber *DstPixels, icChar **DstColorNames,
+                                          const icFloatNumber *SrcPixels, const icChar * const *SrcColorNames,
+                                          const icFloatNumber *SrcTints, icUInt32Number nColors, icStatusCMM *pStatus,
+                                          icUInt32Number nThreads)
+{
+  CIccApplyNamedColorCmm *pApply = (CIccApplyNamedColorCmm*)m_pApply;
+
+  if (!pApply)
+    return icCmmStatBad;
+
+  if (!nThreads) {
+    nThreads = std::thread::hardware_concurrency();
+    if (!nThreads)
+      nThreads = 1;
+  }
+
+  //Give each worker at least a full batch
+  icUInt32Number nPerThread = (nColors + nThreads - 1) / nThreads;
+  if (nPerThread < icApplyBatchPixels)
+    nPerThread = icApplyBatchPixels;
+  nThreads = (nColors + nPerThread - 1) / nPerThread;
+
+  if (nThreads<=1)
+    return pApply->ApplyBatch(DstPixels, DstColorNames, SrcPixels, SrcColorNames, SrcTints, nColors, pStatus);
+
+  std::vector<CIccApplyNamedColorCmm*> workers(nThreads, (CIccApplyNamedColorCmm*)NULL);
+  std::vector<icStatusCMM> results(nThreads, icCmmStatOk);
+  std::vector<std::thread> threads;
+  icStatusCMM rv = icCmmStatOk;
+  icUInt32Number t;
+
+  workers[0] = pApply;
+  for (t=1; t<nThreads; t++) {
+    icStatusCMM stat = icCmmStatOk;
+    workers[t] = (CIccApplyNamedColorCmm*)GetNewApplyCmm(stat);
+    if (!workers[t]) {
+      rv = stat ? stat : icCmmStatAllocErr;
+      break;
+    }
+  }
+
+  if (!rv) {
+    icUInt16Number nSrcSamples = GetSourceSamples();
+    icUInt16Number nDstSamples = GetDestSamples();
+
+    for (t=nThreads; t>0;) {
+      t--;
+      icUInt32Number nStart = t*nPerThread;
+      icUInt32Number nCount = (nColors - nStart < nPerThread) ? nColors - nStart : nPerThread;
+
+      icFloatNumber *pDstPixels = DstPixels ? DstPixels + nStart*nDstSamples : NULL;
+      icChar **pDstNames = DstColorNames ? DstColorNames + nStart : NULL;
+      const icFloatNumber *pSrcPixels = SrcPixels ? SrcPixels + nStart*nSrcSamples : NULL;
+      const icChar * const *pSrcNames = SrcColorNames ? SrcColorNames + nStart : NULL;
+      const icFloatNumber *pSrcTints = SrcTints ? SrcTints + nStart : NULL;
+      icStatusCMM *pStat = pStatus ? pStatus + nStart : NULL;
+      CIccApplyNamedColorCmm *pWorker = workers[t];
+      icStatusCMM *pResult = &results[t];
+
+      if (t) {
+        threads.push_back(std::thread([=]() {
+          *pResult = pWorker->ApplyBatch(pDstPixels, pDstNames, pSrcPixels, pSrcNames, pSrcTints, nCount, pStat);
+        }));
+      }
+      else {
+        *pResult = pWorker->ApplyBatch(pDstPixels, pDstNames, pSrcPixels, pSrcNames, pSrcTints, nCount, pStat);
+      }
+    }
+
+    std::vector<std::thread>::iterator th;
+    for (th=threads.begin(); th!=threads.end(); th++)
+      th->join();
+
+    for (t=0; t<nThreads && !rv; t++)
+      rv = results[t];
+  }
+
+  for (t=1; t<nThreads; t++) {
+    if (workers[t])
+      delete workers[t];
+  }
+
+  return rv;
+}
+
+
 /**
  **************************************************************************
  * Name: CIccNamedColorCmm::SetLastXformDest
@@ -10151,7 +12461,7 @@ CIccMruCmm::~CIccMruCmm()
 * 
 * Args:
 *  pCmm - pointer to cmm object that we are attaching to.
-*  nCacheSize - number of most recently used transformations to cache
+*  nCacheSize - number of pixel transformations to cache
 *
 * Return:
 *  A CIccMruCmm object that represents a cached form of the pCmm passed in.
@@ -10160,7 +12470,7 @@ CIccMruCmm::~CIccMruCmm()
 *  If this function fails the pCmm object will be deleted.
 *****************************************************************************
 */
-CIccMruCmm* CIccMruCmm::Attach(CIccCmm *pCmm, icUInt8Number nCacheSize/* =4 */)
+CIccMruCmm* CIccMruCmm::Attach(CIccCmm *pCmm, icUInt32Number nCacheSize/* =icMruDefaultCacheSize */)
 {
   if (!pCmm || !nCacheSize)
     return NULL;
@@ -10216,9 +12526,16 @@ CIccApplyCmm *CIccMruCmm::GetNewApplyCmm(icStatusCMM &status)
 template<class T>
 CIccMruCache<T>::CIccMruCache()
 {
-  m_cache = NULL;
-
   m_pixelData = NULL;
+  m_pValid = NULL;
+  m_pKey = NULL;
+
+  m_nCacheSize = 0;
+  m_nCacheMask = 0;
+  m_nPending = 0;
+
+  m_nHits = 0;
+  m_nMisses = 0;
 }
 
 /**
@@ -10231,11 +12548,14 @@ CIccMruCache<T>::CIccMruCache()
 template<class T>
 CIccMruCache<T>::~CIccMruCache()
 {
-  if (m_cache)
-    delete[] m_cache;
-
   if (m_pixelData)
     free(m_pixelData);
+
+  if (m_pValid)
+    free(m_pValid);
+
+  if (m_pKey)
+    free(m_pKey);
 }
 
 /**
@@ -10245,15 +12565,17 @@ CIccMruCache<T>::~CIccMruCache()
 * Purpose: Initialize the object and set up the cache
 *
 * Args:
-*  pCmm - pointer to cmm object that we are attaching to.
-*  nCacheSize - number of most recently used transformations to cache
+*  nSrcSamples - number of samples in source pixels
+*  nDstSamples - number of samples in destination pixels
+*  nCacheSize - number of transformations to cache (rounded up to a
+*   power of two)
 *
 * Return:
 *  true if successful
 *****************************************************************************
 */
 template<class T>
-bool CIccMruCache<T>::Init(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt16Number nCacheSize)
+bool CIccMruCache<T>::Init(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt32Number nCacheSize)
 {
   m_nSrcSamples = nSrcSamples;
   m_nSrcSize = nSrcSamples * sizeof(T);
@@ -10261,25 +12583,26 @@ bool CIccMruCache<T>::Init(icUInt16Number nSrcSamples, icUInt16Number nDstSample
 
   m_nTotalSamples = m_nSrcSamples + nDstSamples;
 
-  m_nNumPixel = 0;
-  m_nCacheSize = nCacheSize;
-
-  m_pFirst = NULL;
-  m_cache = new CIccMruPixel<T>[nCacheSize];
-
-  if (!m_cache)
+  if (!nCacheSize || nCacheSize>0x40000000)
     return false;
 
-  m_pixelData = (T*)malloc(nCacheSize * m_nTotalSamples * sizeof(T));
+  m_nCacheSize = icMruCacheProbes;
+  while (m_nCacheSize < nCacheSize)
+    m_nCacheSize <<= 1;
+  m_nCacheMask = m_nCacheSize - 1;
+
+  m_pixelData = (T*)malloc((size_t)m_nCacheSize * m_nTotalSamples * sizeof(T));
+  m_pValid = (icUInt8Number*)calloc(m_nCacheSize, sizeof(icUInt8Number));
+  m_pKey = (T*)malloc(m_nSrcSize ? m_nSrcSize : sizeof(T));
 
-  if (!m_pixelData)
+  if (!m_pixelData || !m_pValid || !m_pKey)
     return false;
 
   return true;
 }
 
 template<class T>
-CIccMruCache<T> *CIccMruCache<T>::NewMruCache(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt16Number nCacheSize /* = 4 */)
+CIccMruCache<T> *CIccMruCache<T>::NewMruCache(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt32Number nCacheSize /* = icMruDefaultCacheSize */)
 {
   CIccMruCache<T> *rv = new CIccMruCache<T>;
 
@@ -10291,6 +12614,44 @@ CIccMruCache<T> *CIccMruCache<T>::NewMruCache(icUInt16Number nSrcSamples, icUInt
   return rv;
 }
 
+//Cache key of integer samples is the samples themselves
+template<class T>
+static inline void icMruCacheKey(T *pKey, const T *pSrc, icUInt32Number nSamples)
+{
+  memcpy(pKey, pSrc, nSamples*sizeof(T));
+}
+
+//Cache key of floating point samples is the samples rounded to multiples of
+//1/icMruFloatQuantum scaled by icMruFloatQuantum.  Rounding also maps -0 to 0.
+static inline void icMruCacheKey(icFloatNumber *pKey, const icFloatNumber *pSrc, icUInt32Number nSamples)
+{
+  icUInt32Number i;
+
+  for (i=0; i<nSamples; i++)
+    pKey[i] = (icFloatNumber)(floor(pSrc[i]*icMruFloatQuantum + 0.5));
+}
+
+/**
+****************************************************************************
+* Name: CIccMruCache::Hash
+*
+* Purpose: FNV-1a hash of the bytes of a cache key
+*****************************************************************************
+*/
+template<class T>
+icUInt32Number CIccMruCache<T>::Hash(const T *pKey) const
+{
+  const icUInt8Number *ptr = (const icUInt8Number*)pKey;
+  icUInt32Number i, h = 2166136261U;
+
+  for (i=0; i<m_nSrcSize; i++) {
+    h ^= ptr[i];
+    h *= 16777619U;
+  }
+
+  return h ^ (h >> 16);
+}
+
 /**
 ****************************************************************************
 * Name: CIccMruCache::Apply
@@ -10302,51 +12663,48 @@ CIccMruCache<T> *CIccMruCache<T>::NewMruCache(icUInt16Number nSrcSamples, icUInt
 *  SrcPixel - Location to get pixel values from
 *
 * Return:
-*  true if SrcPixel found in cache and DstPixel initialized with value
-*  fails if SrcPixel not found (DstPixel not touched)
+*  true if a pixel with the same cache key as SrcPixel is found in cache and
+*  DstPixel initialized with value
+*  fails if SrcPixel not found (DstPixel not touched).  In this case
+*  a slot is reserved for SrcPixel and Update() should be called with
+*  the transformed pixel.
 *****************************************************************************
 */
 template<class T>
 bool CIccMruCache<T>::Apply(T *DstPixel, const T *SrcPixel)
 {
-  CIccMruPixel<T> *ptr, *prev = NULL, *last = NULL;
-  int i;
-  T *pixel;
+  icMruCacheKey(m_pKey, SrcPixel, m_nSrcSamples);
 
-  for (ptr = m_pFirst, i = 0; ptr; ptr = ptr->pNext, i++) {
-    if (!memcmp(SrcPixel, ptr->pPixelData, m_nSrcSize)) {
-      memcpy(DstPixel, &ptr->pPixelData[m_nSrcSamples], m_nDstSize);
-      return true;
-    }
-    prev = last;
-    last = ptr;
-  }
+  icUInt32Number h = Hash(m_pKey);
+  icUInt32Number i, nSlot, nFree = m_nCacheSize;
+  T *pixel;
 
-  //If we get here SrcPixel is not in the cache
-  if (i < m_nCacheSize) {
-    pixel = &m_pixelData[i*m_nTotalSamples];
+  for (i=0; i<icMruCacheProbes; i++) {
+    nSlot = (h + i) & m_nCacheMask;
 
-    ptr = &m_cache[i];
-    ptr->pPixelData = pixel;
+    if (m_pValid[nSlot]) {
+      pixel = &m_pixelData[(size_t)nSlot*m_nTotalSamples];
 
-    if (!last) {
-      m_pFirst = ptr;
+      if (!memcmp(m_pKey, pixel, m_nSrcSize)) {
+        memcpy(DstPixel, &pixel[m_nSrcSamples], m_nDstSize);
+        m_nHits++;
+        return true;
+      }
     }
-    else {
-
-      last->pNext = ptr;
+    else if (nFree==m_nCacheSize) {
+      nFree = nSlot;
     }
   }
-  else {  //Reuse oldest value and put it at the front of the list
-    prev->pNext = NULL;
-    last->pNext = m_pFirst;
 
-    m_pFirst = last;
-    pixel = last->pPixelData;
-  }
-  T *dest = &pixel[m_nSrcSamples];
+  //If we get here SrcPixel is not in the cache so use a free slot or replace one of the probed slots
+  if (nFree==m_nCacheSize)
+    nFree = (h + ((icUInt32Number)m_nMisses & (icMruCacheProbes-1))) & m_nCacheMask;
+
+  m_nMisses++;
+  m_nPending = nFree;
+  m_pValid[nFree] = 0;
 
-  memcpy(pixel, SrcPixel, m_nSrcSize);
+  memcpy(&m_pixelData[(size_t)nFree*m_nTotalSamples], m_pKey, m_nSrcSize);
 
   return false;
 }
@@ -10354,7 +12712,8 @@ bool CIccMruCache<T>::Apply(T *DstPixel, const T *SrcPixel)
 template<class T>
 void CIccMruCache<T>::Update(T* DstPixel)
 {
-  memcpy(&m_pFirst->pPixelData[m_nSrcSamples], DstPixel, m_nDstSize);
+  memcpy(&m_pixelData[(size_t)m_nPending*m_nTotalSamples + m_nSrcSamples], DstPixel, m_nDstSize);
+  m_pValid[m_nPending] = 1;
 }
 
 //Make sure typedef classes get built
@@ -10366,6 +12725,7 @@ template class CIccMruCache<icUInt16Number>;
 CIccApplyMruCmm::CIccApplyMruCmm(CIccMruCmm *pCmm) : CIccApplyCmm(pCmm)
 {
   m_pCachedCmm = NULL;
+  m_pCachedApply = NULL;
   m_pCache = NULL;
 }
 
@@ -10381,13 +12741,17 @@ CIccApplyMruCmm::~CIccApplyMruCmm()
   if (m_pCache)
     delete m_pCache;
 
+  if (m_pCachedApply)
+    delete m_pCachedApply;
 }
 
 /**
 ****************************************************************************
 * Name: CIccApplyMruCmm::Init
 * 
-* Purpose: Initialize the object and set up the cache
+* Purpose: Initialize the object and set up the cache.  Each apply object
+*  gets its own apply object from the cached CMM so that apply objects can
+*  be used by separate threads.
 * 
 * Args:
 *  pCmm - pointer to cmm object that we are attaching to.
@@ -10397,10 +12761,17 @@ CIccApplyMruCmm::~CIccApplyMruCmm()
 *  true if successful
 *****************************************************************************
 */
-bool CIccApplyMruCmm::Init(CIccCmm *pCachedCmm, icUInt16Number nCacheSize)
+bool CIccApplyMruCmm::Init(CIccCmm *pCachedCmm, icUInt32Number nCacheSize)
 {
+  icStatusCMM stat;
+
   m_pCachedCmm = pCachedCmm;
 
+  m_pCachedApply = pCachedCmm->GetNewApplyCmm(stat);
+
+  if (!m_pCachedApply)
+    return false;
+
   m_pCache = CIccMruCacheFloat::NewMruCache(m_pCmm->GetSourceSamples(), m_pCmm->GetDestSamples(), nCacheSize);
 
   if (!m_pCache)
@@ -10432,7 +12803,7 @@ icStatusCMM CIccApplyMruCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber
 
   if (!m_pCache->Apply(DstPixel, SrcPixel)) {
 
-    m_pCachedCmm->Apply(DstPixel, SrcPixel);
+    m_pCachedApply->Apply(DstPixel, SrcPixel);
 
     m_pCache->Update(DstPixel);
   }
@@ -10464,19 +12835,75 @@ icStatusCMM CIccApplyMruCmm::Apply(icFloatNumber *DstPixel, const icFloatNumber
     return icCmmStatInvalidLut;
 #endif
 
+  icUInt16Number nSrcSamples = m_pCmm->GetSourceSamples();
+  icUInt16Number nDstSamples = m_pCmm->GetDestSamples();
+
   for (k=0; k<nPixels;k++) {
     if (!m_pCache->Apply(DstPixel, SrcPixel)) {
-      m_pCachedCmm->Apply(DstPixel, SrcPixel);
+      m_pCachedApply->Apply(DstPixel, SrcPixel);
       m_pCache->Update(DstPixel);
     }
-    SrcPixel += m_pCmm->GetSourceSamples();
-    DstPixel += m_pCmm->GetDestSamples();
+    SrcPixel += nSrcSamples;
+    DstPixel += nDstSamples;
   }
 
   return icCmmStatOk;
 }
 
 
+/**
+****************************************************************************
+* Name: CIccApplyMruCmm::GetCacheStats
+* 
+* Purpose: Gets the number of pixels that were found (hits) and not found
+*  (misses) in the cache since it was created or last reset.
+*****************************************************************************
+*/
+void CIccApplyMruCmm::GetCacheStats(icUInt64Number &nHits, icUInt64Number &nMisses) const
+{
+  nHits = m_pCache ? m_pCache->GetHits() : 0;
+  nMisses = m_pCache ? m_pCache->GetMisses() : 0;
+}
+
+
+void CIccApplyMruCmm::ResetCacheStats()
+{
+  if (m_pCache)
+    m_pCache->ResetStats();
+}
+
+
+/**
+****************************************************************************
+* Name: CIccMruCmm::GetCacheStats
+* 
+* Purpose: Gets the cache statistics of the apply object used by the
+*  Apply() functions of this CMM.
+*
+* Return:
+*  false if there is no apply object
+*****************************************************************************
+*/
+bool CIccMruCmm::GetCacheStats(icUInt64Number &nHits, icUInt64Number &nMisses) const
+{
+  if (!m_pApply) {
+    nHits = nMisses = 0;
+    return false;
+  }
+
+  ((CIccApplyMruCmm*)m_pApply)->GetCacheStats(nHits, nMisses);
+
+  return true;
+}
+
+
+void CIccMruCmm::ResetCacheStats()
+{
+  if (m_pApply)
+    ((CIccApplyMruCmm*)m_pApply)->ResetCacheStats();
+}
+
+
 #ifdef USEREFICCMAXNAMESPACE
 } //namespace refIccMAX
 #endif
@@ -112,6 +112,7 @@ typedef enum {
 typedef enum {
   icInterpLinear               = 0,
   icInterpTetrahedral          = 1,
+  icInterpSimplex              = 2,  //Tetrahedral for 3D luts, N+1 node simplex for 5 or more inputs
 } icXformInterp;
 
 typedef enum {
@@ -141,6 +142,12 @@ typedef enum {
 #define icPerceptualRefWhiteY 1.0000
 #define icPerceptualRefWhiteZ 0.8249
 
+///Number of pixels pushed through each xform at a time by CIccApplyCmm's multi-pixel Apply()
+#define icApplyBatchPixels 256
+
+///Size of the color name buffers used by the batch named color Apply() interfaces
+#define icNamedColorNameSize 256
+
 // CMM Xform types
 typedef enum {
   icXformTypeMatrixTRC  = 0,
@@ -301,6 +308,27 @@ public:
   virtual const char *GetHintType() const { return "CIccLuminanceMatchingHint"; }
 };
 
+/**
+**************************************************************************
+* Type: Class
+*
+* Purpose:
+*		 Hint for tabulating segmented curves of MPE transforms.  The tolerance
+*    is the largest error measured at the table interval quarter points.
+**************************************************************************
+*/
+class ICCPROFLIB_API CIccCurveTableToleranceHint : public IIccCreateXformHint
+{
+public:
+  CIccCurveTableToleranceHint(icFloatNumber fMaxError) { m_fMaxError = fMaxError; }
+  virtual const char *GetHintType() const { return "CIccCurveTableToleranceHint"; }
+
+  icFloatNumber GetTolerance() const { return m_fMaxError; }
+
+protected:
+  icFloatNumber m_fMaxError;
+};
+
 
 
 //forward reference to CIccXform used by CIccApplyXform
@@ -360,6 +388,10 @@ public:
 
   virtual void Apply(CIccApplyXform *pXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const = 0;
 
+  ///Applies the xform to nPixels pixels.  Strides give the number of samples between successive pixels.
+  virtual void ApplyN(CIccApplyXform *pXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
+
   //Detach and remove CIccIO object associated with xform's profile.  Must call after Begin()
   virtual bool RemoveIO() { return m_pProfile ? m_pProfile->Detach() : false; }
 
@@ -412,6 +444,7 @@ public:
   void SetDstPCSConversion(bool bPcsConvert) { m_bDstPcsConversion = bPcsConvert; }
   bool NeedAdjustPCS() { return m_bAdjustPCS; }
   bool LuminanceMatching() { return m_bLuminanceMatching; }
+  icFloatNumber CurveTableTolerance() const { return m_fCurveTableTolerance; }
 
   virtual IIccProfileConnectionConditions *GetConnectionConditions() const { return m_pConnectionConditions; }
 
@@ -424,6 +457,10 @@ protected:
 
   const icFloatNumber *CheckSrcAbs(CIccApplyXform *pApply, const icFloatNumber *Pixel) const;
   void CheckDstAbs(icFloatNumber *Pixel) const;
+  void LoadSrcBlock(CIccApplyXform *pApply, icFloatNumber *pBlock, const icFloatNumber *SrcPixels,
+                    icUInt32Number nPixels, icUInt32Number nSrcStride, icUInt16Number nSamples) const;
+  void StoreDstBlock(icFloatNumber *DstPixels, const icFloatNumber *pBlock,
+                     icUInt32Number nPixels, icUInt32Number nDstStride, icUInt16Number nSamples) const;
 	void AdjustPCS(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
 
   virtual bool HasPerceptualHandling() { return true; }
@@ -438,6 +475,7 @@ protected:
   bool m_bAbsToRel;
   icMCSConnectionType m_nMCS;
   bool m_bLuminanceMatching;
+  icFloatNumber m_fCurveTableTolerance;
   
   //Temporary field
   bool m_bSrcPcsConversion;
@@ -493,6 +531,9 @@ public:
   virtual icXformType GetXformType() const { return icXformTypeUnknown; }
 
   void __inline Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) { m_pXform->Apply(this, DstPixel, SrcPixel); }
+  void __inline ApplyN(icFloatNumber *DstPixels, const icFloatNumber *SrcPixels, icUInt32Number nPixels,
+                       icUInt32Number nDstStride, icUInt32Number nSrcStride)
+    { m_pXform->ApplyN(this, DstPixels, SrcPixels, nPixels, nDstStride, nSrcStride); }
 
   const CIccXform *GetXform() { return m_pXform; }
 
@@ -1114,6 +1155,8 @@ public:
 
   virtual icStatusCMM Begin();
   virtual void Apply(CIccApplyXform *pApplyXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  virtual void ApplyN(CIccApplyXform *pApplyXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
   
   virtual LPIccCurve* ExtractInputCurves();
   virtual LPIccCurve* ExtractOutputCurves();
@@ -1152,6 +1195,8 @@ public:
 
   virtual icStatusCMM Begin();
   virtual void Apply(CIccApplyXform *pApplyXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  virtual void ApplyN(CIccApplyXform *pApplyXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
 
   virtual bool UseLegacyPCS() const { return m_pTag->UseLegacyPCS(); }
 
@@ -1187,6 +1232,8 @@ public:
 
   virtual icStatusCMM Begin();
   virtual void Apply(CIccApplyXform *pApplyXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  virtual void ApplyN(CIccApplyXform *pApplyXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
 
   virtual bool UseLegacyPCS() const { return m_pTag->UseLegacyPCS(); }
 
@@ -1220,13 +1267,18 @@ public:
   virtual icXformType GetXformType() const { return icXformTypeNDLut; }
 
   virtual icStatusCMM Begin();
+  virtual CIccApplyXform *GetNewApply(icStatusCMM &status);
   virtual void Apply(CIccApplyXform *pApplyXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  virtual void ApplyN(CIccApplyXform *pApplyXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
 
   virtual bool UseLegacyPCS() const { return m_pTag->UseLegacyPCS(); }
 
   virtual LPIccCurve* ExtractInputCurves();
   virtual LPIccCurve* ExtractOutputCurves();
 protected:
+  void InterpCLUT(CIccApplyXform *pApplyXform, icFloatNumber *Pixel) const;
+
   const CIccMBB *m_pTag;
   int m_nNumInput;
 
@@ -1342,6 +1394,8 @@ public:
 
   virtual CIccApplyXform *GetNewApply(icStatusCMM &status);
   virtual void Apply(CIccApplyXform *pApplyXform, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  virtual void ApplyN(CIccApplyXform *pApplyXform, icFloatNumber *DstPixels, const icFloatNumber *SrcPixels,
+                      icUInt32Number nPixels, icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
 
   virtual bool UseLegacyPCS() const { return false; }
   virtual LPIccCurve* ExtractInputCurves() {return NULL;}
@@ -1362,6 +1416,26 @@ protected:
   bool m_bDeleteAppliedPCC;
 };
 
+/**
+**************************************************************************
+* Type: Class
+* 
+* Purpose: The Apply ND Lut Xform object (holds CLUT interpolation scratch storage)
+**************************************************************************
+*/
+class ICCPROFLIB_API CIccApplyNDLutXform : public CIccApplyXform
+{
+  friend class CIccXformNDLut;
+public:
+  virtual ~CIccApplyNDLutXform();
+  virtual icXformType GetXformType() const { return icXformTypeNDLut; }
+
+protected:
+  CIccApplyNDLutXform(CIccXformNDLut *pXform, CIccApplyCLUT *pApply);
+
+  CIccApplyCLUT *m_pApply;
+};
+
 /**
 **************************************************************************
 * Type: Class
@@ -1380,6 +1454,10 @@ protected:
   CIccApplyXformMpe(CIccXformMpe *pXform);
 
   CIccApplyTagMpe *m_pApply;
+
+  //Contiguous pixel blocks used by CIccXformMpe::ApplyN()
+  icFloatNumber *m_pSrcBlock;
+  icFloatNumber *m_pDstBlock;
 };
 
 /**
@@ -1403,6 +1481,13 @@ public:
   virtual const icFloatNumber *Check(const icFloatNumber *SrcPixel, const CIccXform *pXform);
   void CheckLast(icFloatNumber *SrcPixel, icColorSpaceSignature Space, bool bNoClip=false);
 
+  ///Buffer versions of Check() and CheckLast().  Converted pixels are written to pConvert using nStride.
+  ///Classes that override Check() should also override CheckN().
+  virtual const icFloatNumber *CheckN(const icFloatNumber *SrcPixels, icFloatNumber *pConvert, icUInt32Number nPixels,
+                                      icUInt32Number nStride, const CIccXform *pXform);
+  void CheckLastN(icFloatNumber *Pixels, icUInt32Number nPixels, icUInt32Number nStride,
+                  icColorSpaceSignature Space, bool bNoClip=false);
+
   static void LabToXyz(icFloatNumber *Dst, const icFloatNumber *Src, bool bNoClip=false);
   static void XyzToLab(icFloatNumber *Dst, const icFloatNumber *Src, bool bNoClip=false);
   static void Lab2ToXyz(icFloatNumber *Dst, const icFloatNumber *Src, bool bNoClip=false);
@@ -1475,6 +1560,89 @@ typedef enum
 //Forward Reference of CIccCmm for CIccCmmApply
 class CIccCmm;
 
+///Maximum number of input channels supported by an integer pipeline
+#define icIntLinkMaxInputs  8
+///Maximum number of output channels supported by an integer pipeline
+#define icIntLinkMaxOutputs 16
+///Number of nodes in each input curve of an integer pipeline
+#define icIntLinkCurveEntries 257
+///Default largest measured error (see CIccCmm::SetIntegerPipeline) for which an integer pipeline is used
+#define icIntLinkDefaultMaxDif 1.0f
+
+/**
+**************************************************************************
+* Type: Structure
+* 
+* Purpose: Location of an input value within one dimension of a
+*  CIccIntLink grid.
+**************************************************************************
+*/
+typedef struct {
+  icUInt32Number nOffset;   //Offset of the lower grid node
+  icUInt32Number nNext;     //Offset from the lower to the upper grid node (zero at the last node)
+  icUInt32Number nFrac;     //Position between the nodes (0 to 0xffff)
+} icIntLinkPos;
+
+/**
+**************************************************************************
+* Type: Class 
+* 
+* Purpose: Integer (fixed point) pipeline used by CIccCmm to apply 8 and
+*  16 bit device data.  The pipeline is a grid of 16 bit nodes sampled from
+*  the xform chain.  Input values are optionally prelinearized with per
+*  channel input curves (icIntLinkCurveEntries nodes interpolated in fixed
+*  point), located in the grid using per channel input tables (8 bit data)
+*  or 16.16 fixed point arithmetic (16 bit data), interpolated with integer
+*  simplex interpolation (tetrahedral for three inputs) and converted to the
+*  output data size with rounding.
+*
+*  There is no separate output stage.  Nodes hold final output values, so
+*  any output curves of the xform chain are part of the grid.
+*
+*  Integer data uses the CMM's internal 0.0 to 1.0 encoding scaled to 0 to
+*  255 or 0 to 65535.
+**************************************************************************
+*/
+class ICCPROFLIB_API CIccIntLink
+{
+public:
+  CIccIntLink(icUInt8Number nInput, icUInt8Number nOutput);
+  virtual ~CIccIntLink();
+
+  bool Init(icUInt8Number nGridPoints, const icUInt16Number *pInputCurves=NULL);
+
+  icUInt8Number GetInputDim() const { return m_nInput; }
+  icUInt8Number GetOutputChannels() const { return m_nOutput; }
+  icUInt8Number GetGridPoints() const { return m_nGridPoints; }
+  bool HasInputCurves() const { return m_pInCurve!=NULL; }
+
+  ///Node data with the last input channel varying fastest
+  icUInt16Number *GetData() { return m_pData; }
+
+  void GetPos(icIntLinkPos *pPos, const icUInt8Number *SrcPixel) const;
+  void GetPos(icIntLinkPos *pPos, const icUInt16Number *SrcPixel) const;
+  void Interp(icUInt16Number *DstPixel, const icIntLinkPos *pPos) const;
+
+  void Apply(icUInt8Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels) const;
+  void Apply(icUInt16Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels) const;
+  void Apply(icUInt16Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels) const;
+  void Apply(icUInt8Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels) const;
+
+protected:
+  icUInt8Number m_nInput;
+  icUInt8Number m_nOutput;
+  icUInt8Number m_nGridPoints;
+
+  icUInt32Number m_DimSize[icIntLinkMaxInputs];
+  icUInt16Number *m_pData;
+
+  //Input curves (icIntLinkCurveEntries+1 entries per input channel, last entry repeated)
+  icUInt16Number *m_pInCurve;
+
+  //Input tables for 8 bit data (256 entries per input channel)
+  icIntLinkPos *m_pPos8;
+};
+
 /**
 **************************************************************************
 * Type: Class 
@@ -1496,6 +1664,12 @@ public:
   //Make sure that when DstPixel==SrcPixel the sizeof DstPixel is less than size of SrcPixel
   virtual icStatusCMM Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels);
 
+  //Apply interleaved 8/16 bit pixels using the CMM's integer pipeline (see CIccCmm::SetIntegerPipeline)
+  icStatusCMM ApplyInt(icUInt8Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels);
+  icStatusCMM ApplyInt(icUInt16Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels);
+  icStatusCMM ApplyInt(icUInt16Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels);
+  icStatusCMM ApplyInt(icUInt8Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels);
+
   void AppendApplyXform(CIccApplyXform *pApplyXform);
 
   CIccCmm *GetCmm() { return m_pCmm; }
@@ -1505,6 +1679,10 @@ public:
 protected:
   CIccApplyCmm(CIccCmm *pCmm);
 
+  bool InitBatch();
+
+  icStatusCMM ApplyLink(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels=1);
+
   CIccApplyXformList *m_Xforms;
   CIccCmm *m_pCmm;
 
@@ -1512,6 +1690,13 @@ protected:
 
   icFloatNumber *m_Pixel;
   icFloatNumber *m_Pixel2;
+
+  //Pixel buffers used by the multi-pixel Apply()
+  icFloatNumber *m_pBatch;
+  icUInt16Number m_nBatchStride;
+
+  //Interpolation scratch storage for the CMM's device link CLUT
+  CIccApplyCLUT *m_pLinkApply;
 };
 
 /**
@@ -1582,6 +1767,16 @@ public:
   virtual icStatusCMM Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel);
   virtual icStatusCMM Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels);
 
+  //The following integer apply functions should only be called if using Begin(true) and HasIntegerPipeline() is true
+  icStatusCMM ApplyInt(icUInt8Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels)
+    { return m_pApply->ApplyInt(DstPixels, SrcPixels, nPixels); }
+  icStatusCMM ApplyInt(icUInt16Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels)
+    { return m_pApply->ApplyInt(DstPixels, SrcPixels, nPixels); }
+  icStatusCMM ApplyInt(icUInt16Number *DstPixels, const icUInt8Number *SrcPixels, icUInt32Number nPixels)
+    { return m_pApply->ApplyInt(DstPixels, SrcPixels, nPixels); }
+  icStatusCMM ApplyInt(icUInt8Number *DstPixels, const icUInt16Number *SrcPixels, icUInt32Number nPixels)
+    { return m_pApply->ApplyInt(DstPixels, SrcPixels, nPixels); }
+
   //Call to Detach and remove all pending IO objects attached to the profiles used by the CMM. Should be called only after Begin()
   virtual icStatusCMM RemoveAllIO();
 
@@ -1637,11 +1832,41 @@ public:
   virtual icColorSpaceSignature GetFirstXformSource();
   virtual icColorSpaceSignature GetLastXformDest();
 
+  ///Requests that Begin() collapse the xform chain into a single sampled CLUT (device link).
+  ///Must be called before Begin().  A nGridPoints value of zero disables the collapse.
+  void SetDeviceLink(icUInt8Number nGridPoints, icXformInterp nInterp=icInterpTetrahedral)
+    { m_nLinkGridPoints = nGridPoints; m_nLinkInterp = nInterp; }
+  ///Returns true if Begin() replaced the xform chain with a sampled CLUT
+  bool IsDeviceLink() const { return m_pLink!=NULL; }
+  ///Returns the max and mean error of the sampled CLUT measured against the exact xform chain
+  bool GetDeviceLinkError(icFloatNumber &maxDE, icFloatNumber &meanDE) const;
+
+  ///Requests that Begin() build an integer pipeline sampled with nGridPoints grid points per
+  ///input channel for use by ApplyInt().  Must be called before Begin().  Zero disables it.
+  ///The pipeline is discarded, leaving the floating point path, if its measured max error
+  ///(RMS difference of the channels in percent of range) is larger than fMaxDif.
+  void SetIntegerPipeline(icUInt8Number nGridPoints=33, icFloatNumber fMaxDif=icIntLinkDefaultMaxDif)
+    { m_nIntGridPoints = nGridPoints; m_fIntMaxAllowed = fMaxDif; }
+  ///Returns true if Begin() built an integer pipeline
+  bool HasIntegerPipeline() const { return m_pIntLink!=NULL; }
+  ///Returns the max and mean error of the integer pipeline measured against the exact xform chain
+  bool GetIntegerPipelineError(icFloatNumber &maxDif, icFloatNumber &meanDif) const;
+
 protected:
   void SetLateBindingCC();
 
   icStatusCMM CheckPCSConnections(bool bUsePCSConversions=false);
 
+  void FreeSampledLinks();
+
+  icStatusCMM BuildDeviceLink();
+  void ApplyDeviceLink(CIccApplyCLUT *pApply, icFloatNumber *DstPixel, const icFloatNumber *SrcPixel) const;
+  icFloatNumber DeviceLinkDif(const icFloatNumber *Pixel1, const icFloatNumber *Pixel2) const;
+
+  icStatusCMM BuildIntegerPipeline();
+  void SampleIntegerPipeline(CIccApplyCmm *pApply, CIccIntLink *pIntLink, const icFloatNumber *pNodePos);
+  void MeasureIntegerPipeline(CIccApplyCmm *pApply, const CIccIntLink *pIntLink, icFloatNumber &maxDif, icFloatNumber &meanDif);
+
   CIccApplyCmm *m_pApply;
 
   bool m_bValid;
@@ -1654,6 +1879,20 @@ protected:
   icRenderingIntent m_nLastIntent;
 
   CIccXformList *m_Xforms;
+
+  //Device link (collapsed xform chain) support
+  icUInt8Number m_nLinkGridPoints;
+  icXformInterp m_nLinkInterp;
+  CIccCLUT *m_pLink;
+  icFloatNumber m_fLinkMaxDE;
+  icFloatNumber m_fLinkMeanDE;
+
+  //Integer pipeline support
+  icUInt8Number m_nIntGridPoints;
+  icFloatNumber m_fIntMaxAllowed;
+  CIccIntLink *m_pIntLink;
+  icFloatNumber m_fIntMaxDif;
+  icFloatNumber m_fIntMeanDif;
 };
 
 //Forward Class for CIccApplyNamedColorCmm
@@ -1684,8 +1923,26 @@ public:
   virtual icStatusCMM Apply(icFloatNumber *DstPixel, const icChar *SrcColorName, icFloatNumber tint=1.0);
   virtual icStatusCMM Apply(icChar* DstColorName, const icChar *SrcColorName, icFloatNumber tint=1.0);
 
+  ///Batch versions of the named color interfaces.  Colors are pushed through each xform
+  ///icApplyBatchPixels at a time.  SrcTints may be NULL (full tint).  DstColorNames entries
+  ///must each hold icNamedColorNameSize characters.  The status of each color is
+  ///returned in pStatus (if not NULL) and the first failing status is returned.
+  virtual icStatusCMM Apply(icFloatNumber *DstPixels, const icChar * const *SrcColorNames, const icFloatNumber *SrcTints,
+                            icUInt32Number nColors, icStatusCMM *pStatus=NULL);
+  virtual icStatusCMM Apply(icChar **DstColorNames, const icFloatNumber *SrcPixels, icUInt32Number nColors,
+                            icStatusCMM *pStatus=NULL);
+  virtual icStatusCMM Apply(icChar **DstColorNames, const icChar * const *SrcColorNames, const icFloatNumber *SrcTints,
+                            icUInt32Number nColors, icStatusCMM *pStatus=NULL);
+
 protected:
   CIccApplyNamedColorCmm(CIccNamedColorCmm *pCmm);
+
+  icStatusCMM ApplyBatch(icFloatNumber *DstPixels, icChar **DstColorNames,
+                         const icFloatNumber *SrcPixels, const icChar * const *SrcColorNames,
+                         const icFloatNumber *SrcTints, icUInt32Number nColors, icStatusCMM *pStatus);
+
+  //Intermediate color names used by the batch Apply()
+  icChar *m_pBatchNames;
 };
 
 /**
@@ -1736,28 +1993,37 @@ public:
   virtual icStatusCMM Apply(icChar* DstColorName, const icFloatNumber *SrcPixel);
   virtual icStatusCMM Apply(icChar* DstColorName, const icChar *SrcColorName, icFloatNumber tint=1.0);
 
+  ///Batch named color interfaces (see CIccApplyNamedColorCmm).  When nThreads is not 1 the colors
+  ///are divided between worker apply objects (zero uses one worker per hardware thread).
+  icStatusCMM Apply(icFloatNumber *DstPixels, const icChar * const *SrcColorNames, const icFloatNumber *SrcTints,
+                    icUInt32Number nColors, icStatusCMM *pStatus=NULL, icUInt32Number nThreads=1);
+  icStatusCMM Apply(icChar **DstColorNames, const icFloatNumber *SrcPixels, icUInt32Number nColors,
+                    icStatusCMM *pStatus=NULL, icUInt32Number nThreads=1);
+  icStatusCMM Apply(icChar **DstColorNames, const icChar * const *SrcColorNames, const icFloatNumber *SrcTints,
+                    icUInt32Number nColors, icStatusCMM *pStatus=NULL, icUInt32Number nThreads=1);
+
   ///Returns the type of interface that will be applied
   icApplyInterface GetInterface() const {return m_nApplyInterface;}
 
   icStatusCMM SetLastXformDest(icColorSpaceSignature nDestSpace); 
 
 protected:
+  icStatusCMM ApplyBatch(icFloatNumber *DstPixels, icChar **DstColorNames,
+                         const icFloatNumber *SrcPixels, const icChar * const *SrcColorNames,
+                         const icFloatNumber *SrcTints, icUInt32Number nColors, icStatusCMM *pStatus,
+                         icUInt32Number nThreads);
+
   icApplyInterface m_nApplyInterface;
 };
 
-template<class T>
-class ICCPROFLIB_API CIccMruPixel
-{
-public:
-  CIccMruPixel() { pPixelData = NULL; pNext = NULL; }
+///Default number of pixel transformations cached by a CIccMruCache
+#define icMruDefaultCacheSize 4096
 
-  T *pPixelData;
-  CIccMruPixel *pNext;
-};
+///Number of slots probed for a pixel in a CIccMruCache
+#define icMruCacheProbes 4
 
-typedef CIccMruPixel<icFloatNumber> CIccMruPixelFloat;
-typedef CIccMruPixel<icUInt8Number> CIccMruPixel8;
-typedef CIccMruPixel<icUInt16Number> CIccMruPixel16;
+///Floating point samples are rounded to multiples of 1/icMruFloatQuantum to form a CIccMruCache key
+#define icMruFloatQuantum 65536.0
 
 /**
 **************************************************************************
@@ -1766,31 +2032,53 @@ typedef CIccMruPixel<icUInt16Number> CIccMruPixel16;
 * Purpose: Defines a class that provides and interface for caching
 * application pf pixel transformations through a CMM.
 *
+*  Pixels are kept in an open addressing hash table keyed on the source
+*  sample values.  Floating point samples are first rounded to multiples of
+*  1/icMruFloatQuantum so that pixels differing by less than that (including
+*  0 and -0) share a cache entry.  Integer samples are used exactly.  Each pixel has icMruCacheProbes candidate slots and when
+*  they are all in use one of them is replaced.  A cache is not thread safe
+*  so each thread should use its own cache.
+*
 **************************************************************************
 */
 template <class T>
 class ICCPROFLIB_API CIccMruCache
 {
 public:
-  static CIccMruCache<T> *NewMruCache(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt16Number nCacheSize = 4);
+  static CIccMruCache<T> *NewMruCache(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt32Number nCacheSize = icMruDefaultCacheSize);
 
   virtual ~CIccMruCache();
 
   virtual bool Apply(T *DstPixel, const T *SrcPixel);
   virtual void Update(T *DstPixel);
 
+  icUInt32Number GetCacheSize() const { return m_nCacheSize; }
+
+  icUInt64Number GetHits() const { return m_nHits; }
+  icUInt64Number GetMisses() const { return m_nMisses; }
+  void ResetStats() { m_nHits = 0; m_nMisses = 0; }
+
 protected:
   CIccMruCache();
-  bool Init(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt16Number nCacheSize = 4);
+  bool Init(icUInt16Number nSrcSamples, icUInt16Number nDstSamples, icUInt32Number nCacheSize = icMruDefaultCacheSize);
+
+  icUInt32Number Hash(const T *pKey) const;
 
-  icUInt16Number m_nCacheSize;
+  //Number of slots (a power of two)
+  icUInt32Number m_nCacheSize;
+  icUInt32Number m_nCacheMask;
 
   T *m_pixelData;
+  icUInt8Number *m_pValid;
+
+  //Cache key of the pixel passed to the last call to Apply()
+  T *m_pKey;
 
-  CIccMruPixel<T> *m_pFirst;
-  CIccMruPixel<T> *m_cache;
+  //Slot reserved by the last call to Apply() that missed
+  icUInt32Number m_nPending;
 
-  icUInt16Number m_nNumPixel;
+  icUInt64Number m_nHits;
+  icUInt64Number m_nMisses;
 
   icUInt32Number m_nTotalSamples;
   icUInt32Number m_nSrcSamples;
@@ -1826,12 +2114,17 @@ public:
   //Make sure that when DstPixel==SrcPixel the sizeof DstPixel is greater than size of SrcPixel
   virtual icStatusCMM Apply(icFloatNumber *DstPixel, const icFloatNumber *SrcPixel, icUInt32Number nPixels);
 
+  ///Gets the number of pixels found (hits) and not found (misses) in the cache
+  void GetCacheStats(icUInt64Number &nHits, icUInt64Number &nMisses) const;
+  void ResetCacheStats();
+
 protected:
   CIccApplyMruCmm(CIccMruCmm *pCmm);
 
-  bool Init(CIccCmm *pCachedCmm, icUInt16Number nCacheSize);
+  bool Init(CIccCmm *pCachedCmm, icUInt32Number nCacheSize);
 
   CIccCmm *m_pCachedCmm;
+  CIccApplyCmm *m_pCachedApply;
   CIccMruCacheFloat *m_pCache;
 };
 
@@ -1852,7 +2145,7 @@ public:
   virtual ~CIccMruCmm();
 
   //This is the function used to create a new CIccMruCmm.  The pCmm must be valid and its Begin() already called.
-  static CIccMruCmm* Attach(CIccCmm *pCmm, icUInt8Number nCacheSize=6);  //The returned object will own pCmm, and pCmm is deleted on failure.
+  static CIccMruCmm* Attach(CIccCmm *pCmm, icUInt32Number nCacheSize=icMruDefaultCacheSize);  //The returned object will own pCmm, and pCmm is deleted on failure.
 
   //override AddXform/Begin functions to return bad status.
   virtual icStatusCMM AddXform(const icChar *szProfilePath, icRenderingIntent nIntent=icUnknownIntent,
@@ -1878,9 +2171,14 @@ public:
   virtual icColorSpaceSignature GetFirstXformSource() { return m_pCmm->GetFirstXformSource(); }
   virtual icColorSpaceSignature GetLastXformDest() { return m_pCmm->GetLastXformDest(); }
 
+  ///Gets the cache hits and misses of the Apply() functions of this object.  Apply objects
+  ///from GetNewApplyCmm() each have their own cache and statistics.
+  bool GetCacheStats(icUInt64Number &nHits, icUInt64Number &nMisses) const;
+  void ResetCacheStats();
+
 protected:
   CIccCmm *m_pCmm;
-  icUInt16Number m_nCacheSize;
+  icUInt32Number m_nCacheSize;
 
 };
 
@@ -0,0 +1,926 @@
+/** @file
+    File:       IccCmmCache.cpp
+
+    Contains:   Implementation of process wide caches of parsed profiles and
+                begun CIccCmm objects
+
+    Version:    V1
+
+    Copyright:  (c) see ICC Software License
+*/
+
+
+
+/*
+ * The ICC Software License, Version 0.2
+ *
+ *
+ * Copyright (c) 2003-2016 The International Color Consortium. All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. In the absence of prior written permission, the names "ICC" and "The
+ *    International Color Consortium" must not be used to imply that the
+ *    ICC organization endorses or promotes products derived from this
+ *    software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE INTERNATIONAL COLOR CONSORTIUM OR
+ * ITS CONTRIBUTING MEMBERS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by many
+ * individuals on behalf of the The International Color Consortium. 
+ *
+ *
+ * Membership in the ICC is encouraged when this software is used for
+ * commercial purposes. 
+ *
+ *  
+ * For more information on The International Color Consortium, please
+ * see <http://www.color.org/>.
+ *  
+ * 
+ */
+
+////////////////////////////////////////////////////////////////////// 
+// HISTORY:
+//
+// -Initial implementation of profile and link caches
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "IccCmmCache.h"
+#include "IccIO.h"
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef USEREFICCMAXNAMESPACE
+namespace refIccMAX {
+#endif
+
+static std::string icProfileIDKey(const icProfileID &profileID)
+{
+  return std::string((const char*)&profileID.ID8[0], sizeof(profileID.ID8));
+}
+
+
+static CIccIO *icOpenCacheIO(const icChar *szFilename)
+{
+  CIccMappedIO *pMappedIO = new CIccMappedIO;
+
+  if (pMappedIO->Open(szFilename))
+    return pMappedIO;
+
+  delete pMappedIO;
+
+  CIccFileIO *pFileIO = new CIccFileIO;
+
+  if (!pFileIO->Open(szFilename, "rb")) {
+    delete pFileIO;
+    return NULL;
+  }
+
+  return pFileIO;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::CIccProfileCache
+ * 
+ * Purpose: 
+ *  Constructor
+ *
+ * Args:
+ *  nMaxBytes = memory budget for cached profiles.  Zero disables caching.
+ **************************************************************************
+ */
+CIccProfileCache::CIccProfileCache(icUInt64Number nMaxBytes/*=icDefaultProfileCacheBytes*/)
+{
+  m_nMaxBytes = nMaxBytes;
+  m_nBytes = 0;
+  m_nHits = 0;
+  m_nMisses = 0;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::~CIccProfileCache
+ * 
+ * Purpose: 
+ *  Destructor
+ **************************************************************************
+ */
+CIccProfileCache::~CIccProfileCache()
+{
+  Clear();
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetInstance
+ * 
+ * Purpose: 
+ *  Returns the process wide profile cache.  The cache is created on first
+ *  use and lives until the process exits.
+ **************************************************************************
+ */
+CIccProfileCache *CIccProfileCache::GetInstance()
+{
+  static CIccProfileCache theCache;
+
+  return &theCache;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetProfile
+ * 
+ * Purpose: 
+ *  Returns a copy of the profile in a file reading the profile into the
+ *  cache if needed.
+ *
+ * Args:
+ *  szFilename = name of the profile file,
+ *  pProfileID = optional place to return the ID that the profile is keyed by
+ * 
+ * Return: 
+ *  A new CIccProfile owned by the caller, or NULL if the profile cannot be
+ *  read.
+ **************************************************************************
+ */
+CIccProfile *CIccProfileCache::GetProfile(const icChar *szFilename, icProfileID *pProfileID/*=NULL*/)
+{
+  CIccIO *pIO = icOpenCacheIO(szFilename);
+
+  if (!pIO)
+    return NULL;
+
+  icProfileID profileID;
+  CIccProfile *pProfile = NULL;
+
+  if (GetID(pIO, szFilename, profileID)) {
+    pProfile = GetCopy(pIO, profileID);
+
+    if (pProfile && pProfileID)
+      *pProfileID = profileID;
+  }
+
+  delete pIO;
+
+  return pProfile;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetProfile
+ * 
+ * Purpose: 
+ *  Returns a copy of a profile in memory reading the profile into the
+ *  cache if needed.  The memory does not need to outlive the call.
+ **************************************************************************
+ */
+CIccProfile *CIccProfileCache::GetProfile(const icUInt8Number *pMem, icUInt32Number nSize,
+                                          icProfileID *pProfileID/*=NULL*/)
+{
+  CIccMemIO IO;
+
+  if (!IO.Attach((icUInt8Number*)pMem, nSize))
+    return NULL;
+
+  return GetProfile(&IO, pProfileID);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetProfile
+ * 
+ * Purpose: 
+ *  Returns a copy of the profile read from pIO reading the profile into the
+ *  cache if needed.
+ **************************************************************************
+ */
+CIccProfile *CIccProfileCache::GetProfile(CIccIO *pIO, icProfileID *pProfileID/*=NULL*/)
+{
+  icProfileID profileID;
+
+  if (!GetID(pIO, NULL, profileID))
+    return NULL;
+
+  if (pProfileID)
+    *pProfileID = profileID;
+
+  return GetCopy(pIO, profileID);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetCopy
+ * 
+ * Purpose: 
+ *  Returns a copy of the cached profile with the ID.  On a cache miss the
+ *  whole profile is read from pIO and added to the cache.  Profiles that are
+ *  larger than the memory budget are returned without being cached.
+ **************************************************************************
+ */
+CIccProfile *CIccProfileCache::GetCopy(CIccIO *pIO, const icProfileID &profileID)
+{
+  CIccProfilePtr pCached = Lookup(profileID);
+
+  if (!pCached) {
+    CIccProfile *pProfile = new CIccProfile;
+
+    if (pIO->Seek(0, icSeekSet)<0 || !pProfile->Read(pIO)) {
+      delete pProfile;
+      return NULL;
+    }
+
+    icUInt64Number nBytes = pIO->GetLength();
+
+    if (nBytes > m_nMaxBytes)
+      return pProfile;
+
+    pCached = Insert(profileID, pProfile, nBytes);
+  }
+
+  return new CIccProfile(*pCached);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::FindProfile
+ * 
+ * Purpose: 
+ *  Returns a copy of a cached profile (owned by the caller) or NULL if no
+ *  profile with the ID is cached.
+ **************************************************************************
+ */
+CIccProfile *CIccProfileCache::FindProfile(const icProfileID &profileID)
+{
+  CIccProfilePtr pCached = Lookup(profileID);
+
+  if (!pCached)
+    return NULL;
+
+  return new CIccProfile(*pCached);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetProfileID
+ * 
+ * Purpose: 
+ *  Gets the ID that a profile file is keyed by.  Only the header is read
+ *  unless the header has no profile ID.
+ **************************************************************************
+ */
+bool CIccProfileCache::GetProfileID(const icChar *szFilename, icProfileID &profileID)
+{
+  CIccIO *pIO = icOpenCacheIO(szFilename);
+
+  if (!pIO)
+    return false;
+
+  bool rv = GetID(pIO, szFilename, profileID);
+
+  delete pIO;
+
+  return rv;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::GetID
+ * 
+ * Purpose: 
+ *  Gets the profile ID from the header in pIO.  A missing ID is calculated
+ *  with CalcProfileID().  Calculated IDs of named files are remembered
+ *  against the file name, the file size and modification time and the raw
+ *  header bytes.  The oldest remembered ID is dropped when there are more
+ *  than icMaxProfileCacheCalcIDs.
+ **************************************************************************
+ */
+bool CIccProfileCache::GetID(CIccIO *pIO, const icChar *szFilename, icProfileID &profileID)
+{
+  icUInt8Number header[128];
+
+  if (pIO->Seek(0, icSeekSet)<0 || pIO->Read8(header, sizeof(header))!=sizeof(header))
+    return false;
+
+  memcpy(&profileID.ID8[0], header+84, sizeof(profileID.ID8));
+
+  int i;
+  for (i=0; i<(int)sizeof(profileID.ID8); i++) {
+    if (profileID.ID8[i])
+      return true;
+  }
+
+  std::string sKey;
+  struct stat st;
+
+  if (szFilename && stat(szFilename, &st))
+    szFilename = NULL;
+
+  if (szFilename) {
+    icInt64Number nSize = (icInt64Number)st.st_size;
+    icInt64Number nTime = (icInt64Number)st.st_mtime;
+
+    sKey = szFilename;
+    sKey.append(1, '\0');
+    sKey.append((const char*)&nSize, sizeof(nSize));
+    sKey.append((const char*)&nTime, sizeof(nTime));
+    sKey.append((const char*)header, sizeof(header));
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::map<std::string, std::string>::iterator id = m_CalcIDs.find(sKey);
+    if (id!=m_CalcIDs.end()) {
+      memcpy(&profileID.ID8[0], id->second.data(), sizeof(profileID.ID8));
+      return true;
+    }
+  }
+
+  CalcProfileID(pIO, &profileID);
+
+  if (szFilename) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_CalcIDs.find(sKey)==m_CalcIDs.end()) {
+      m_CalcIDs[sKey] = icProfileIDKey(profileID);
+      m_CalcIDOrder.push_back(sKey);
+
+      if (m_CalcIDOrder.size() > icMaxProfileCacheCalcIDs) {
+        m_CalcIDs.erase(m_CalcIDOrder.front());
+        m_CalcIDOrder.pop_front();
+      }
+    }
+  }
+
+  return true;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::Lookup
+ * 
+ * Purpose: 
+ *  Finds a cached profile and marks it as most recently used.
+ **************************************************************************
+ */
+CIccProfileCache::CIccProfilePtr CIccProfileCache::Lookup(const icProfileID &profileID)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CIccProfileCacheMap::iterator entry = m_Profiles.find(icProfileIDKey(profileID));
+
+  if (entry==m_Profiles.end()) {
+    m_nMisses++;
+    return CIccProfilePtr();
+  }
+
+  m_nHits++;
+  m_LRU.splice(m_LRU.begin(), m_LRU, entry->second.lru);
+
+  return entry->second.pProfile;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::Insert
+ * 
+ * Purpose: 
+ *  Adds a profile (which becomes owned by the cache) and drops least
+ *  recently used profiles to stay within the memory budget.  If another
+ *  thread cached the same profile first then pProfile is deleted and the
+ *  cached profile is returned.
+ **************************************************************************
+ */
+CIccProfileCache::CIccProfilePtr CIccProfileCache::Insert(const icProfileID &profileID, CIccProfile *pProfile,
+                                                          icUInt64Number nBytes)
+{
+  CIccProfilePtr pNew(pProfile);
+  std::string sKey = icProfileIDKey(profileID);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CIccProfileCacheMap::iterator entry = m_Profiles.find(sKey);
+
+  if (entry!=m_Profiles.end())
+    return entry->second.pProfile;
+
+  m_LRU.push_front(sKey);
+
+  icProfileCacheEntry &newEntry = m_Profiles[sKey];
+  newEntry.pProfile = pNew;
+  newEntry.nBytes = nBytes;
+  newEntry.lru = m_LRU.begin();
+  m_nBytes += nBytes;
+
+  Trim();
+
+  return pNew;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccProfileCache::Trim
+ * 
+ * Purpose: 
+ *  Drops least recently used profiles until the cache is within its
+ *  memory budget.  Copies handed out are not affected.  Must be called with
+ *  the mutex locked.
+ **************************************************************************
+ */
+void CIccProfileCache::Trim()
+{
+  while (m_nBytes > m_nMaxBytes && !m_LRU.empty()) {
+    CIccProfileCacheMap::iterator entry = m_Profiles.find(m_LRU.back());
+
+    m_nBytes -= entry->second.nBytes;
+    m_Profiles.erase(entry);
+    m_LRU.pop_back();
+  }
+}
+
+
+void CIccProfileCache::SetMaxBytes(icUInt64Number nMaxBytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_nMaxBytes = nMaxBytes;
+  Trim();
+}
+
+
+void CIccProfileCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_Profiles.clear();
+  m_LRU.clear();
+  m_CalcIDs.clear();
+  m_CalcIDOrder.clear();
+  m_nBytes = 0;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCacheLink::CIccCmmCacheLink
+ * 
+ * Purpose: 
+ *  Constructor.  The arguments match those of the CIccCmm constructor.
+ **************************************************************************
+ */
+CIccCmmCacheLink::CIccCmmCacheLink(icColorSpaceSignature nSrcSpace/*=icSigUnknownData*/,
+                                   icColorSpaceSignature nDestSpace/*=icSigUnknownData*/,
+                                   bool bFirstInput/*=true*/)
+{
+  m_nSrcSpace = nSrcSpace;
+  m_nDestSpace = nDestSpace;
+  m_bFirstInput = bFirstInput;
+
+  m_nLinkGridPoints = 0;
+  m_nLinkInterp = icInterpTetrahedral;
+  m_nIntGridPoints = 0;
+  m_bUsePcsConversion = false;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCacheLink::AddXform
+ * 
+ * Purpose: 
+ *  Adds a profile file to the link.  The arguments match those of
+ *  CIccCmm::AddXform().  Links that use a hint manager or connection
+ *  conditions are not cached.
+ **************************************************************************
+ */
+void CIccCmmCacheLink::AddXform(const icChar *szProfilePath,
+                                icRenderingIntent nIntent/*=icUnknownIntent*/,
+                                icXformInterp nInterp/*=icInterpLinear*/,
+                                IIccProfileConnectionConditions *pPcc/*=NULL*/,
+                                icXformLutType nLutType/*=icXformLutColor*/,
+                                bool bUseMpeTags/*=true*/,
+                                CIccCreateXformHintManager *pHintManager/*=NULL*/)
+{
+  icCmmCacheXform xform;
+
+  xform.sPath = szProfilePath ? szProfilePath : "";
+  xform.nIntent = nIntent;
+  xform.nInterp = nInterp;
+  xform.pPcc = pPcc;
+  xform.nLutType = nLutType;
+  xform.bUseMpeTags = bUseMpeTags;
+  xform.pHintManager = pHintManager;
+
+  m_Xforms.push_back(xform);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCacheLink::IsCacheable
+ * 
+ * Purpose: 
+ *  Returns true if no transform uses a hint manager or connection
+ *  conditions.
+ **************************************************************************
+ */
+bool CIccCmmCacheLink::IsCacheable() const
+{
+  std::vector<icCmmCacheXform>::const_iterator i;
+
+  for (i=m_Xforms.begin(); i!=m_Xforms.end(); i++) {
+    if (i->pHintManager || i->pPcc)
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::CIccCmmCache
+ * 
+ * Purpose: 
+ *  Constructor
+ *
+ * Args:
+ *  pProfileCache = cache to get profiles from (NULL uses the process wide
+ *   profile cache),
+ *  nMaxBytes = memory budget for cached CMMs.  Zero disables caching,
+ *  nMaxLinks = maximum number of cached CMMs
+ **************************************************************************
+ */
+CIccCmmCache::CIccCmmCache(CIccProfileCache *pProfileCache/*=NULL*/,
+                           icUInt64Number nMaxBytes/*=icDefaultCmmCacheBytes*/,
+                           icUInt32Number nMaxLinks/*=icDefaultCmmCacheLinks*/)
+{
+  m_pProfileCache = pProfileCache ? pProfileCache : CIccProfileCache::GetInstance();
+
+  m_nMaxBytes = nMaxBytes;
+  m_nMaxLinks = nMaxLinks;
+  m_nBytes = 0;
+  m_nHits = 0;
+  m_nMisses = 0;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::~CIccCmmCache
+ * 
+ * Purpose: 
+ *  Destructor.  CMMs that have not been released are deleted as well.
+ **************************************************************************
+ */
+CIccCmmCache::~CIccCmmCache()
+{
+  Clear();
+  m_Uses.clear();
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::GetInstance
+ * 
+ * Purpose: 
+ *  Returns the process wide link cache
+ **************************************************************************
+ */
+CIccCmmCache *CIccCmmCache::GetInstance()
+{
+  static CIccCmmCache theCache;
+
+  return &theCache;
+}
+
+
+static void icAppendKey(std::string &sKey, const void *pData, size_t nSize)
+{
+  sKey.append((const char*)pData, nSize);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::GetKey
+ * 
+ * Purpose: 
+ *  Builds the key of a link from the IDs of its profiles, the arguments of
+ *  each transform and the CMM options.
+ * 
+ * Return: 
+ *  false if the link cannot be cached or a profile cannot be opened
+ **************************************************************************
+ */
+bool CIccCmmCache::GetKey(const CIccCmmCacheLink &link, std::string &sKey)
+{
+  if (!link.IsCacheable())
+    return false;
+
+  sKey.clear();
+
+  icUInt32Number nVal;
+  nVal = link.m_nSrcSpace;          icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_nDestSpace;         icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_bFirstInput;        icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_nLinkGridPoints;    icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_nLinkInterp;        icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_nIntGridPoints;     icAppendKey(sKey, &nVal, sizeof(nVal));
+  nVal = link.m_bUsePcsConversion;  icAppendKey(sKey, &nVal, sizeof(nVal));
+
+  std::vector<CIccCmmCacheLink::icCmmCacheXform>::const_iterator i;
+  for (i=link.m_Xforms.begin(); i!=link.m_Xforms.end(); i++) {
+    icProfileID profileID;
+
+    if (!m_pProfileCache->GetProfileID(i->sPath.c_str(), profileID))
+      return false;
+
+    icAppendKey(sKey, &profileID.ID8[0], sizeof(profileID.ID8));
+
+    nVal = i->nIntent;      icAppendKey(sKey, &nVal, sizeof(nVal));
+    nVal = i->nInterp;      icAppendKey(sKey, &nVal, sizeof(nVal));
+    nVal = i->nLutType;     icAppendKey(sKey, &nVal, sizeof(nVal));
+    nVal = i->bUseMpeTags;  icAppendKey(sKey, &nVal, sizeof(nVal));
+  }
+
+  return true;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::Build
+ * 
+ * Purpose: 
+ *  Creates and begins a new CIccCmm for a link with profiles from the
+ *  profile cache.  nBytes is set to an estimate of the memory used by the
+ *  CMM: the size of its profiles plus any sampled tables built by Begin().
+ **************************************************************************
+ */
+CIccCmm *CIccCmmCache::Build(const CIccCmmCacheLink &link, icStatusCMM &status, icUInt64Number &nBytes)
+{
+  CIccCmm *pCmm = new CIccCmm(link.m_nSrcSpace, link.m_nDestSpace, link.m_bFirstInput);
+
+  nBytes = sizeof(CIccCmm);
+
+  std::vector<CIccCmmCacheLink::icCmmCacheXform>::const_iterator i;
+  for (i=link.m_Xforms.begin(); i!=link.m_Xforms.end(); i++) {
+    CIccProfile *pProfile = m_pProfileCache->GetProfile(i->sPath.c_str());
+
+    if (!pProfile) {
+      delete pCmm;
+      status = icCmmStatCantOpenProfile;
+      return NULL;
+    }
+
+    nBytes += pProfile->m_Header.size;
+
+    status = pCmm->AddXform(pProfile, i->nIntent, i->nInterp, i->pPcc, i->nLutType, i->bUseMpeTags,
+                            i->pHintManager);
+
+    if (status != icCmmStatOk) {
+      delete pProfile;
+      delete pCmm;
+      return NULL;
+    }
+  }
+
+  if (link.m_nLinkGridPoints)
+    pCmm->SetDeviceLink(link.m_nLinkGridPoints, link.m_nLinkInterp);
+  if (link.m_nIntGridPoints)
+    pCmm->SetIntegerPipeline(link.m_nIntGridPoints);
+
+  status = pCmm->Begin(false, link.m_bUsePcsConversion);
+
+  if (status != icCmmStatOk) {
+    delete pCmm;
+    return NULL;
+  }
+
+  icUInt64Number nGrid = 1, nGridPoints;
+  icUInt16Number nIn = pCmm->GetSourceSamples(), nOut = pCmm->GetDestSamples();
+  int j;
+
+  if (pCmm->IsDeviceLink()) {
+    for (nGridPoints=link.m_nLinkGridPoints, j=0; j<nIn; j++)
+      nGrid *= nGridPoints;
+    nBytes += nGrid * nOut * sizeof(icFloatNumber);
+  }
+  if (pCmm->HasIntegerPipeline()) {
+    for (nGrid=1, nGridPoints=link.m_nIntGridPoints, j=0; j<nIn; j++)
+      nGrid *= nGridPoints;
+    nBytes += nGrid * nOut * sizeof(icUInt16Number);
+  }
+
+  return pCmm;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::GetCmm
+ * 
+ * Purpose: 
+ *  Finds or builds a begun CMM for a link.  Links that cannot be cached
+ *  (see CIccCmmCacheLink::IsCacheable()) or that exceed the memory budget
+ *  are built for the caller alone but must still be handed back with
+ *  ReleaseCmm().
+ * 
+ * Return: 
+ *  A begun CIccCmm without an internal apply object, or NULL with the
+ *  error in status.
+ **************************************************************************
+ */
+CIccCmm *CIccCmmCache::GetCmm(const CIccCmmCacheLink &link, icStatusCMM &status)
+{
+  std::string sKey;
+  bool bCacheable = GetKey(link, sKey);
+
+  status = icCmmStatOk;
+
+  if (bCacheable) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    CIccCmmCacheMap::iterator entry = m_Links.find(sKey);
+
+    if (entry!=m_Links.end()) {
+      m_nHits++;
+      m_LRU.splice(m_LRU.begin(), m_LRU, entry->second.lru);
+      return AddUse(entry->second.pCmm);
+    }
+    m_nMisses++;
+  }
+
+  //Build outside of the lock so that other links can be served meanwhile
+  icUInt64Number nBytes;
+  CIccCmm *pNewCmm = Build(link, status, nBytes);
+
+  if (!pNewCmm)
+    return NULL;
+
+  CIccCmmPtr pCmm(pNewCmm);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  if (bCacheable && nBytes <= m_nMaxBytes && m_nMaxLinks) {
+    CIccCmmCacheMap::iterator entry = m_Links.find(sKey);
+
+    //Another thread may have built the same link first
+    if (entry!=m_Links.end())
+      return AddUse(entry->second.pCmm);
+
+    m_LRU.push_front(sKey);
+
+    icCmmCacheEntry &newEntry = m_Links[sKey];
+    newEntry.pCmm = pCmm;
+    newEntry.nBytes = nBytes;
+    newEntry.lru = m_LRU.begin();
+    m_nBytes += nBytes;
+
+    Trim();
+  }
+
+  return AddUse(pCmm);
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::AddUse
+ * 
+ * Purpose: 
+ *  Records that a CMM has been handed out.  Must be called with the mutex
+ *  locked.
+ **************************************************************************
+ */
+CIccCmm *CIccCmmCache::AddUse(const CIccCmmPtr &pCmm)
+{
+  icCmmCacheUse &use = m_Uses[pCmm.get()];
+
+  if (!use.pCmm) {
+    use.pCmm = pCmm;
+    use.nRefs = 0;
+  }
+  use.nRefs++;
+
+  return pCmm.get();
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::ReleaseCmm
+ * 
+ * Purpose: 
+ *  Hands back a CMM returned by GetCmm().  The CMM is deleted once it has
+ *  been released by all users and is no longer cached.
+ **************************************************************************
+ */
+void CIccCmmCache::ReleaseCmm(CIccCmm *pCmm)
+{
+  CIccCmmPtr pLast;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CIccCmmUseMap::iterator use = m_Uses.find(pCmm);
+
+  if (use==m_Uses.end())
+    return;
+
+  if (!--use->second.nRefs) {
+    //Keep the CMM alive until the mutex is unlocked
+    pLast = use->second.pCmm;
+    m_Uses.erase(use);
+  }
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccCmmCache::Trim
+ * 
+ * Purpose: 
+ *  Drops least recently used links until the cache is within its link
+ *  count and memory budget.  Must be called with the mutex locked.
+ **************************************************************************
+ */
+void CIccCmmCache::Trim()
+{
+  while ((m_nBytes > m_nMaxBytes || m_Links.size() > m_nMaxLinks) && !m_LRU.empty()) {
+    CIccCmmCacheMap::iterator entry = m_Links.find(m_LRU.back());
+
+    m_nBytes -= entry->second.nBytes;
+    m_Links.erase(entry);
+    m_LRU.pop_back();
+  }
+}
+
+
+void CIccCmmCache::SetMaxBytes(icUInt64Number nMaxBytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_nMaxBytes = nMaxBytes;
+  Trim();
+}
+
+
+void CIccCmmCache::SetMaxLinks(icUInt32Number nMaxLinks)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_nMaxLinks = nMaxLinks;
+  Trim();
+}
+
+
+void CIccCmmCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_Links.clear();
+  m_LRU.clear();
+  m_nBytes = 0;
+}
+
+
+#ifdef USEREFICCMAXNAMESPACE
+} //namespace refIccMAX
+#endif
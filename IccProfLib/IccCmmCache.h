@@ -0,0 +1,335 @@
+/** @file
+    File:       IccCmmCache.h
+
+    Contains:   Header for implementation of process wide caches of parsed
+                profiles and begun CIccCmm objects
+
+    Version:    V1
+
+    Copyright:  (c) see ICC Software License
+*/
+
+
+
+/*
+ * The ICC Software License, Version 0.2
+ *
+ *
+ * Copyright (c) 2003-2016 The International Color Consortium. All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. In the absence of prior written permission, the names "ICC" and "The
+ *    International Color Consortium" must not be used to imply that the
+ *    ICC organization endorses or promotes products derived from this
+ *    software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE INTERNATIONAL COLOR CONSORTIUM OR
+ * ITS CONTRIBUTING MEMBERS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by many
+ * individuals on behalf of the The International Color Consortium. 
+ *
+ *
+ * Membership in the ICC is encouraged when this software is used for
+ * commercial purposes. 
+ *
+ *  
+ * For more information on The International Color Consortium, please
+ * see <http://www.color.org/>.
+ *  
+ * 
+ */
+
+////////////////////////////////////////////////////////////////////// 
+// HISTORY:
+//
+// -Initial implementation of profile and link caches
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(_ICCCMMCACHE_H)
+#define _ICCCMMCACHE_H
+
+#include "IccDefs.h"
+#include "IccCmm.h"
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#ifdef USEREFICCMAXNAMESPACE
+namespace refIccMAX {
+#endif
+
+///Default memory budget of the profile cache in bytes
+#define icDefaultProfileCacheBytes  (64*1024*1024)
+
+///Default memory budget of the link cache in bytes
+#define icDefaultCmmCacheBytes      (128*1024*1024)
+
+///Default maximum number of links held by the link cache
+#define icDefaultCmmCacheLinks      64
+
+///Maximum number of calculated profile IDs remembered by the profile cache
+#define icMaxProfileCacheCalcIDs    256
+
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Thread safe cache of fully read CIccProfile objects keyed by
+ *  the profile ID found in the header.  When a profile has no ID in its
+ *  header the ID is calculated with CalcProfileID().  The result is
+ *  remembered against the file name, file size, modification time and raw
+ *  header so that unchanged files without an ID are only hashed once.  At
+ *  most icMaxProfileCacheCalcIDs calculated IDs are remembered.
+ *
+ *  Cached profiles are never handed out directly.  GetProfile() returns a
+ *  copy owned by the caller (typically passed on to CIccCmm::AddXform()),
+ *  so cached profiles stay immutable and can be shared between threads.
+ *  Least recently used profiles are dropped when the size of the cached
+ *  profiles exceeds the memory budget.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccProfileCache
+{
+public:
+  CIccProfileCache(icUInt64Number nMaxBytes=icDefaultProfileCacheBytes);
+  virtual ~CIccProfileCache();
+
+  ///Returns the process wide profile cache
+  static CIccProfileCache *GetInstance();
+
+  ///Returns a copy of the profile (owned by the caller) reading it into the cache if needed
+  CIccProfile *GetProfile(const icChar *szFilename, icProfileID *pProfileID=NULL);
+  CIccProfile *GetProfile(const icUInt8Number *pMem, icUInt32Number nSize, icProfileID *pProfileID=NULL);
+  CIccProfile *GetProfile(CIccIO *pIO, icProfileID *pProfileID=NULL);
+
+  ///Returns a copy of a cached profile or NULL if no profile with the ID is cached
+  CIccProfile *FindProfile(const icProfileID &profileID);
+
+  ///Gets the ID used to key a profile file without reading the whole profile
+  bool GetProfileID(const icChar *szFilename, icProfileID &profileID);
+
+  void SetMaxBytes(icUInt64Number nMaxBytes);
+  icUInt64Number GetMaxBytes() const { return m_nMaxBytes; }
+  icUInt64Number GetBytes() const { return m_nBytes; }
+  icUInt32Number GetNumProfiles() const { return (icUInt32Number)m_Profiles.size(); }
+
+  icUInt64Number GetHits() const { return m_nHits; }
+  icUInt64Number GetMisses() const { return m_nMisses; }
+
+  void Clear();
+
+protected:
+  typedef std::shared_ptr<const CIccProfile> CIccProfilePtr;
+  typedef std::list<std::string> CIccProfileKeyList;
+
+  typedef struct {
+    CIccProfilePtr pProfile;
+    icUInt64Number nBytes;
+    CIccProfileKeyList::iterator lru;
+  } icProfileCacheEntry;
+
+  typedef std::map<std::string, icProfileCacheEntry> CIccProfileCacheMap;
+
+  bool GetID(CIccIO *pIO, const icChar *szFilename, icProfileID &profileID);
+  CIccProfile *GetCopy(CIccIO *pIO, const icProfileID &profileID);
+  CIccProfilePtr Lookup(const icProfileID &profileID);
+  CIccProfilePtr Insert(const icProfileID &profileID, CIccProfile *pProfile, icUInt64Number nBytes);
+  void Trim();
+
+  std::mutex m_Mutex;
+
+  CIccProfileCacheMap m_Profiles;
+  CIccProfileKeyList m_LRU;
+
+  //IDs calculated for files without an ID keyed by file name, size, time and raw header
+  std::map<std::string, std::string> m_CalcIDs;
+  std::list<std::string> m_CalcIDOrder;
+
+  icUInt64Number m_nMaxBytes;
+  icUInt64Number m_nBytes;
+  icUInt64Number m_nHits;
+  icUInt64Number m_nMisses;
+};
+
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Describes a CIccCmm to be built or found by CIccCmmCache.  
+ *  AddXform() mirrors CIccCmm::AddXform() for profile files.  A CMM keeps
+ *  pointers to the hint manager and profile connection conditions it was
+ *  built with, and the cache cannot tell whether they are still valid or
+ *  equal for another caller.  Links that use either are therefore built
+ *  for the caller alone and never cached.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccCmmCacheLink
+{
+public:
+  CIccCmmCacheLink(icColorSpaceSignature nSrcSpace=icSigUnknownData,
+                   icColorSpaceSignature nDestSpace=icSigUnknownData,
+                   bool bFirstInput=true);
+  virtual ~CIccCmmCacheLink() {}
+
+  void AddXform(const icChar *szProfilePath,
+                icRenderingIntent nIntent=icUnknownIntent,
+                icXformInterp nInterp=icInterpLinear,
+                IIccProfileConnectionConditions *pPcc=NULL,
+                icXformLutType nLutType=icXformLutColor,
+                bool bUseMpeTags=true,
+                CIccCreateXformHintManager *pHintManager=NULL);
+
+  ///Options that are passed on to the CIccCmm before Begin()
+  void SetDeviceLink(icUInt8Number nGridPoints, icXformInterp nInterp=icInterpTetrahedral)
+    { m_nLinkGridPoints = nGridPoints; m_nLinkInterp = nInterp; }
+  void SetIntegerPipeline(icUInt8Number nGridPoints=33) { m_nIntGridPoints = nGridPoints; }
+  void SetUsePcsConversion(bool bUsePcsConversion) { m_bUsePcsConversion = bUsePcsConversion; }
+
+  bool IsCacheable() const;
+
+protected:
+  friend class CIccCmmCache;
+
+  typedef struct {
+    std::string sPath;
+    icRenderingIntent nIntent;
+    icXformInterp nInterp;
+    IIccProfileConnectionConditions *pPcc;
+    icXformLutType nLutType;
+    bool bUseMpeTags;
+    CIccCreateXformHintManager *pHintManager;
+  } icCmmCacheXform;
+
+  icColorSpaceSignature m_nSrcSpace;
+  icColorSpaceSignature m_nDestSpace;
+  bool m_bFirstInput;
+
+  icUInt8Number m_nLinkGridPoints;
+  icXformInterp m_nLinkInterp;
+  icUInt8Number m_nIntGridPoints;
+  bool m_bUsePcsConversion;
+
+  std::vector<icCmmCacheXform> m_Xforms;
+};
+
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Thread safe cache of begun CIccCmm objects keyed by the profile
+ *  IDs, rendering intents, interpolation, lut types and CMM options of a
+ *  CIccCmmCacheLink.  Profiles are obtained from a
+ *  CIccProfileCache.
+ *
+ *  GetCmm() returns a shared CMM that has been begun without an internal
+ *  apply object.  It must be treated as immutable: pixels are applied
+ *  through apply objects from CIccCmm::GetNewApplyCmm() (or with a
+ *  CIccImageEngine) and the CMM is handed back with ReleaseCmm().  Least
+ *  recently used CMMs are dropped when the number of links or their
+ *  estimated size exceeds the budget.  CMMs that are still in use when
+ *  dropped are deleted once they are released.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccCmmCache
+{
+public:
+  CIccCmmCache(CIccProfileCache *pProfileCache=NULL,
+               icUInt64Number nMaxBytes=icDefaultCmmCacheBytes,
+               icUInt32Number nMaxLinks=icDefaultCmmCacheLinks);
+  virtual ~CIccCmmCache();
+
+  ///Returns the process wide link cache (which uses the process wide profile cache)
+  static CIccCmmCache *GetInstance();
+
+  ///Returns a begun CMM that must be handed back with ReleaseCmm(), or NULL with the error in status
+  CIccCmm *GetCmm(const CIccCmmCacheLink &link, icStatusCMM &status);
+  void ReleaseCmm(CIccCmm *pCmm);
+
+  void SetMaxBytes(icUInt64Number nMaxBytes);
+  void SetMaxLinks(icUInt32Number nMaxLinks);
+  icUInt64Number GetMaxBytes() const { return m_nMaxBytes; }
+  icUInt32Number GetMaxLinks() const { return m_nMaxLinks; }
+  icUInt64Number GetBytes() const { return m_nBytes; }
+  icUInt32Number GetNumLinks() const { return (icUInt32Number)m_Links.size(); }
+
+  icUInt64Number GetHits() const { return m_nHits; }
+  icUInt64Number GetMisses() const { return m_nMisses; }
+
+  void Clear();
+
+protected:
+  typedef std::shared_ptr<CIccCmm> CIccCmmPtr;
+  typedef std::list<std::string> CIccCmmKeyList;
+
+  typedef struct {
+    CIccCmmPtr pCmm;
+    icUInt64Number nBytes;
+    CIccCmmKeyList::iterator lru;
+  } icCmmCacheEntry;
+
+  typedef struct {
+    CIccCmmPtr pCmm;
+    icUInt32Number nRefs;
+  } icCmmCacheUse;
+
+  typedef std::map<std::string, icCmmCacheEntry> CIccCmmCacheMap;
+  typedef std::map<CIccCmm*, icCmmCacheUse> CIccCmmUseMap;
+
+  bool GetKey(const CIccCmmCacheLink &link, std::string &sKey);
+  CIccCmm *Build(const CIccCmmCacheLink &link, icStatusCMM &status, icUInt64Number &nBytes);
+  CIccCmm *AddUse(const CIccCmmPtr &pCmm);
+  void Trim();
+
+  CIccProfileCache *m_pProfileCache;
+
+  std::mutex m_Mutex;
+
+  CIccCmmCacheMap m_Links;
+  CIccCmmKeyList m_LRU;
+  CIccCmmUseMap m_Uses;
+
+  icUInt64Number m_nMaxBytes;
+  icUInt32Number m_nMaxLinks;
+  icUInt64Number m_nBytes;
+  icUInt64Number m_nHits;
+  icUInt64Number m_nMisses;
+};
+
+
+#ifdef USEREFICCMAXNAMESPACE
+} //namespace refIccMAX
+#endif
+
+#endif // !defined(_ICCCMMCACHE_H)
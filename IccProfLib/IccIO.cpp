@@ -68,6 +68,16 @@
 //
 //////////////////////////////////////////////////////////////////////
 
+#ifdef WIN32
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
 #include "IccIO.h"
 #include "IccUtil.h"
 #include <stdlib.h>
@@ -111,6 +121,104 @@ icInt32Number CIccIO::ReadLine(void *pBuf8, icInt32Number nNum/*=256*/)
   return n;
 }
 
+///Size of the stack buffer used to stage conversions to and from file order
+#define icIOStageSize 8192
+
+//stdio seek and tell with 64 bit offsets
+#ifdef WIN32
+#define icFSeek64 _fseeki64
+#define icFTell64 _ftelli64
+#else
+#define icFSeek64 fseeko
+#define icFTell64 ftello
+#endif
+
+static icInt32Number icWriteSwab(CIccIO *pIO, void *pBuf, icInt32Number nNum, icInt32Number nSize)
+{
+  icUInt8Number tmp[icIOStageSize];
+  icUInt8Number *ptr = (icUInt8Number*)pBuf;
+  icInt32Number i, n, nDone;
+
+  for (i=0; i<nNum; i+=n, ptr+=n*nSize) {
+    n = __min(nNum-i, icIOStageSize/nSize);
+
+    switch (nSize) {
+      case 2: icSwab16Copy(tmp, ptr, n); break;
+      case 4: icSwab32Copy(tmp, ptr, n); break;
+      default: icSwab64Copy(tmp, ptr, n); break;
+    }
+
+    nDone = pIO->Write8(tmp, n*nSize) / nSize;
+    if (nDone!=n)
+      return i + nDone;
+  }
+
+  return i;
+}
+
+static void icUInt8ToFloat(icFloatNumber *pDst, const icUInt8Number *pSrc, icInt32Number nNum)
+{
+  icInt32Number i;
+  for (i=0; i<nNum; i++)
+    pDst[i] = (icFloatNumber)((icFloatNumber)pSrc[i] / 255.0);
+}
+
+static void icUInt16BEToFloat(icFloatNumber *pDst, const icUInt8Number *pSrc, icInt32Number nNum)
+{
+  icInt32Number i;
+  for (i=0; i<nNum; i++, pSrc+=2)
+    pDst[i] = (icFloatNumber)((icFloatNumber)(icUInt16Number)((pSrc[0]<<8) | pSrc[1]) / 65535.0);
+}
+
+static void icFloat16BEToFloat(icFloatNumber *pDst, const icUInt8Number *pSrc, icInt32Number nNum)
+{
+  icInt32Number i;
+  for (i=0; i<nNum; i++, pSrc+=2)
+    pDst[i] = icF16toF((icFloat16Number)((pSrc[0]<<8) | pSrc[1]));
+}
+
+static void icFloat32BEToFloat(icFloatNumber *pDst, const icUInt8Number *pSrc, icInt32Number nNum)
+{
+  icInt32Number i;
+  icUInt32Number v;
+  icFloat32Number tmp;
+
+  for (i=0; i<nNum; i++, pSrc+=4) {
+    v = ((icUInt32Number)pSrc[0]<<24) | ((icUInt32Number)pSrc[1]<<16) | ((icUInt32Number)pSrc[2]<<8) | pSrc[3];
+    memcpy(&tmp, &v, sizeof(tmp));
+    pDst[i] = (icFloatNumber)tmp;
+  }
+}
+
+typedef void (*icIOToFloatFunc)(icFloatNumber *pDst, const icUInt8Number *pSrc, icInt32Number nNum);
+
+/** Reads nNum values of nSize bytes each and converts them to float, using
+ * the data in place if the IO object holds it in memory and otherwise
+ * reading it in blocks through a stack buffer. */
+static icInt32Number icReadToFloat(CIccIO *pIO, icFloatNumber *pDst, icInt32Number nNum, icInt32Number nSize,
+                                   icIOToFloatFunc convert)
+{
+  const icUInt8Number *pData = nNum>0 ? pIO->ReadDirect(nNum*nSize) : NULL;
+  if (pData) {
+    convert(pDst, pData, nNum);
+    return nNum;
+  }
+
+  icUInt8Number tmp[icIOStageSize];
+  icInt32Number i, n, nDone;
+
+  for (i=0; i<nNum; i+=n, pDst+=n) {
+    n = __min(nNum-i, icIOStageSize/nSize);
+
+    nDone = pIO->Read8(tmp, n*nSize) / nSize;
+    convert(pDst, tmp, nDone);
+    if (nDone!=n)
+      return i + nDone;
+  }
+
+  return i;
+}
+
 icInt32Number CIccIO::Read16(void *pBuf16, icInt32Number nNum)
 {
   nNum = Read8(pBuf16, nNum<<1)>>1;
@@ -124,19 +232,7 @@ icInt32Number CIccIO::Write16(void *pBuf16, icInt32Number nNum)
 #ifndef ICC_BYTE_ORDER_LITTLE_ENDIAN
   return Write8(pBuf16, nNum<<1)>>1;
 #else
-  icUInt16Number *ptr = (icUInt16Number*)pBuf16;
-  icUInt16Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    tmp = *ptr;
-    icSwab16(tmp);
-    if (Write8(&tmp, 2)!=2)
-      break;
-    ptr++;
-  }
-
-  return i;
+  return icWriteSwab(this, pBuf16, nNum, 2);
 #endif
 }
 
@@ -154,19 +250,7 @@ icInt32Number CIccIO::Write32(void *pBuf32, icInt32Number nNum)
 #ifndef ICC_BYTE_ORDER_LITTLE_ENDIAN
   return Write8(pBuf32, nNum<<2)>>2;
 #else
-  icUInt32Number *ptr = (icUInt32Number*)pBuf32;
-  icUInt32Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    tmp = *ptr;
-    icSwab32(tmp);
-    if (Write8(&tmp, 4)!=4)
-      break;
-    ptr++;
-  }
-
-  return i;
+  return icWriteSwab(this, pBuf32, nNum, 4);
 #endif
 }
 
@@ -184,50 +268,30 @@ icInt32Number CIccIO::Write64(void *pBuf64, icInt32Number nNum)
 #ifndef ICC_BYTE_ORDER_LITTLE_ENDIAN
   return Write8(pBuf64, nNum<<3)>>3;
 #else
-  icUInt64Number *ptr = (icUInt64Number*)pBuf64;
-  icUInt64Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    tmp = *ptr;
-    icSwab64(tmp);
-    if (Write8(&tmp, 8)!=8)
-      break;
-    ptr++;
-  }
-
-  return i;
+  return icWriteSwab(this, pBuf64, nNum, 8);
 #endif
 }
 
 icInt32Number CIccIO::ReadUInt8Float(void *pBufFloat, icInt32Number nNum)
 {
-  icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icUInt8Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    if (Read8(&tmp, 1)!=1)
-      break;
-    *ptr = (icFloatNumber)((icFloatNumber)tmp / 255.0);
-    ptr++;
-  }
-
-  return i;
+  return icReadToFloat(this, (icFloatNumber*)pBufFloat, nNum, 1, icUInt8ToFloat);
 }
 
 icInt32Number CIccIO::WriteUInt8Float(void *pBufFloat, icInt32Number nNum)
 {
   icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icUInt8Number tmp;
-  icInt32Number i;
+  icUInt8Number tmp[icIOStageSize];
+  icInt32Number i, j, n, nDone;
 
-  for (i=0; i<nNum; i++) {
-    tmp = (icUInt8Number)(__max(0.0, __min(1.0, *ptr)) * 255.0 + 0.5);
+  for (i=0; i<nNum; i+=n, ptr+=n) {
+    n = __min(nNum-i, icIOStageSize);
 
-    if (Write8(&tmp, 1)!=1)
-      break;
-    ptr++;
+    for (j=0; j<n; j++)
+      tmp[j] = (icUInt8Number)(__max(0.0, __min(1.0, ptr[j])) * 255.0 + 0.5);
+
+    nDone = Write8(tmp, n);
+    if (nDone!=n)
+      return i + nDone;
   }
 
   return i;
@@ -235,32 +299,28 @@ icInt32Number CIccIO::WriteUInt8Float(void *pBufFloat, icInt32Number nNum)
 
 icInt32Number CIccIO::ReadUInt16Float(void *pBufFloat, icInt32Number nNum)
 {
-  icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icUInt16Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    if (Read16(&tmp, 1)!=1)
-      break;
-    *ptr = (icFloatNumber)((icFloatNumber)tmp / 65535.0);
-    ptr++;
-  }
-
-  return i;
+  return icReadToFloat(this, (icFloatNumber*)pBufFloat, nNum, 2, icUInt16BEToFloat);
 }
 
 icInt32Number CIccIO::WriteUInt16Float(void *pBufFloat, icInt32Number nNum)
 {
   icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icUInt16Number tmp;
-  icInt32Number i;
+  icUInt8Number tmp[icIOStageSize];
+  icUInt16Number v;
+  icInt32Number i, j, n, nDone;
 
-  for (i=0; i<nNum; i++) {
-    tmp = (icUInt16Number)(__max(0.0, __min(1.0, *ptr)) * 65535.0 + 0.5);
+  for (i=0; i<nNum; i+=n, ptr+=n) {
+    n = __min(nNum-i, icIOStageSize/2);
 
-    if (Write16(&tmp, 1)!=1)
-      break;
-    ptr++;
+    for (j=0; j<n; j++) {
+      v = (icUInt16Number)(__max(0.0, __min(1.0, ptr[j])) * 65535.0 + 0.5);
+      tmp[j*2] = (icUInt8Number)(v>>8);
+      tmp[j*2+1] = (icUInt8Number)v;
+    }
+
+    nDone = Write8(tmp, n*2)/2;
+    if (nDone!=n)
+      return i + nDone;
   }
 
   return i;
@@ -268,32 +328,28 @@ icInt32Number CIccIO::WriteUInt16Float(void *pBufFloat, icInt32Number nNum)
 
 icInt32Number CIccIO::ReadFloat16Float(void *pBufFloat, icInt32Number nNum)
 {
-  icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icFloat16Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    if (Read16(&tmp, 1)!=1)
-      break;
-    *ptr = icF16toF(tmp);
-    ptr++;
-  }
-
-  return i;
+  return icReadToFloat(this, (icFloatNumber*)pBufFloat, nNum, 2, icFloat16BEToFloat);
 }
 
 icInt32Number CIccIO::WriteFloat16Float(void *pBufFloat, icInt32Number nNum)
 {
   icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icUInt16Number tmp;
-  icInt32Number i;
+  icUInt8Number tmp[icIOStageSize];
+  icFloat16Number v;
+  icInt32Number i, j, n, nDone;
 
-  for (i=0; i<nNum; i++) {
-    tmp = icFtoF16(*ptr);
+  for (i=0; i<nNum; i+=n, ptr+=n) {
+    n = __min(nNum-i, icIOStageSize/2);
 
-    if (Write16(&tmp, 1)!=1)
-      break;
-    ptr++;
+    for (j=0; j<n; j++) {
+      v = icFtoF16(ptr[j]);
+      tmp[j*2] = (icUInt8Number)(v>>8);
+      tmp[j*2+1] = (icUInt8Number)v;
+    }
+
+    nDone = Write8(tmp, n*2)/2;
+    if (nDone!=n)
+      return i + nDone;
   }
 
   return i;
@@ -301,21 +357,16 @@ icInt32Number CIccIO::WriteFloat16Float(void *pBufFloat, icInt32Number nNum)
 
 icInt32Number CIccIO::ReadFloat32Float(void *pBufFloat, icInt32Number nNum)
 {
-  if (sizeof(icFloat32Number)==sizeof(icFloatNumber))
+  if (sizeof(icFloat32Number)==sizeof(icFloatNumber)) {
+    const icUInt8Number *pData = nNum>0 ? ReadDirect(nNum*4) : NULL;
+    if (pData) {
+      icSwab32Copy(pBufFloat, pData, nNum);
+      return nNum;
+    }
     return Read32(pBufFloat, nNum);
-
-  icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icFloat32Number tmp;
-  icInt32Number i;
-
-  for (i=0; i<nNum; i++) {
-    if (Read32(&tmp, 1)!=1)
-      break;
-    *ptr = (icFloatNumber)tmp;
-    ptr++;
   }
 
-  return i;
+  return icReadToFloat(this, (icFloatNumber*)pBufFloat, nNum, 4, icFloat32BEToFloat);
 }
 
 icInt32Number CIccIO::WriteFloat32Float(void *pBufFloat, icInt32Number nNum)
@@ -324,15 +375,18 @@ icInt32Number CIccIO::WriteFloat32Float(void *pBufFloat, icInt32Number nNum)
     return Write32(pBufFloat, nNum);
 
   icFloatNumber *ptr = (icFloatNumber*)pBufFloat;
-  icFloat32Number tmp;
-  icInt32Number i;
+  icFloat32Number tmp[icIOStageSize/4];
+  icInt32Number i, j, n, nDone;
 
-  for (i=0; i<nNum; i++) {
-    tmp = (icFloat32Number)*ptr;
+  for (i=0; i<nNum; i+=n, ptr+=n) {
+    n = __min(nNum-i, icIOStageSize/4);
 
-    if (Write32(&tmp, 1)!=1)
-      break;
-    ptr++;
+    for (j=0; j<n; j++)
+      tmp[j] = (icFloat32Number)ptr[j];
+
+    nDone = Write32(tmp, n);
+    if (nDone!=n)
+      return i + nDone;
   }
 
   return i;
@@ -340,7 +394,7 @@ icInt32Number CIccIO::WriteFloat32Float(void *pBufFloat, icInt32Number nNum)
 
 bool CIccIO::Align32()
 {
-  int mod = GetLength() % 4;
+  int mod = (int)(GetLength() % 4);
   if (mod != 0) {
     icUInt8Number buf[4]={0,0,0,0};
     if (Seek(0, icSeekEnd)<0)
@@ -358,7 +412,7 @@ bool CIccIO::Sync32(icUInt32Number nOffset)
 {
   nOffset &= 0x3;
 
-  icUInt32Number nPos = ((Tell() - nOffset + 3)>>2)<<2;
+  icInt64Number nPos = ((Tell() - nOffset + 3)>>2)<<2;
   if (Seek(nPos + nOffset, icSeekSet)<0)
     return false;
   return true;
@@ -372,6 +426,7 @@ bool CIccIO::Sync32(icUInt32Number nOffset)
 CIccFileIO::CIccFileIO() : CIccIO()
 {
   m_fFile = NULL;
+  m_pFileBuf = NULL;
 }
 
 CIccFileIO::~CIccFileIO()
@@ -392,12 +447,11 @@ bool CIccFileIO::Open(const icChar *szFilename, const icChar *szAttr)
   }
 #endif
 
-  if (m_fFile)
-    fclose(m_fFile);
+  Close();
 
   m_fFile = fopen(szFilename, szAttr);
 
-  return m_fFile != NULL;
+  return SetBuffer();
 }
 
 
@@ -413,22 +467,42 @@ bool CIccFileIO::Open(const icWChar *szFilename, const icWChar *szAttr)
     szAttr = myAttr;
   }
 
-  if (m_fFile)
-    fclose(m_fFile);
+  Close();
 
   m_fFile = _wfopen(szFilename, szAttr);
 
-  return m_fFile != NULL;
+  return SetBuffer();
 }
 #endif
 
 
+/** Replaces the small default stdio buffer with a large one so that tags
+ * written or read in many small pieces cost few system calls. */
+bool CIccFileIO::SetBuffer()
+{
+  if (!m_fFile)
+    return false;
+
+  m_pFileBuf = (char*)malloc(icFileIOBufSize);
+  if (m_pFileBuf && setvbuf(m_fFile, m_pFileBuf, _IOFBF, icFileIOBufSize)) {
+    free(m_pFileBuf);
+    m_pFileBuf = NULL;
+  }
+
+  return true;
+}
+
+
 void CIccFileIO::Close()
 {
   if (m_fFile) {
     fclose(m_fFile);
     m_fFile = NULL;
   }
+  if (m_pFileBuf) {
+    free(m_pFileBuf);
+    m_pFileBuf = NULL;
+  }
 }
 
 
@@ -450,35 +524,78 @@ icInt32Number CIccFileIO::Write8(void *pBuf, icInt32Number nNum)
 }
 
 
-icInt32Number CIccFileIO::GetLength()
+icInt64Number CIccFileIO::GetLength()
 {
   if (!m_fFile)
     return 0;
 
   fflush(m_fFile);
-  icInt32Number current = ftell(m_fFile), end;
-  fseek (m_fFile, 0, SEEK_END);
-  end = ftell(m_fFile);
-  fseek (m_fFile, current, SEEK_SET);
+  icInt64Number current = icFTell64(m_fFile), end;
+  icFSeek64(m_fFile, 0, SEEK_END);
+  end = icFTell64(m_fFile);
+  icFSeek64(m_fFile, current, SEEK_SET);
   return end;
 }
 
 
-icInt32Number CIccFileIO::Seek(icInt32Number nOffset, icSeekVal pos)
+icInt64Number CIccFileIO::Seek(icInt64Number nOffset, icSeekVal pos)
 {
   if (!m_fFile)
     return -1;
 
-  return !fseek(m_fFile, nOffset, pos) ? ftell(m_fFile) : -1;
+  return !icFSeek64(m_fFile, nOffset, pos) ? (icInt64Number)icFTell64(m_fFile) : -1;
 }
 
 
-icInt32Number CIccFileIO::Tell()
+icInt64Number CIccFileIO::Tell()
 {
   if (!m_fFile)
     return -1;
 
-  return ftell(m_fFile);
+  return icFTell64(m_fFile);
+}
+
+
+/** Reads directly from the file descriptor at nPos.  Data written through
+ * the stream must have been flushed (GetLength() does this) first. */
+icInt32Number CIccFileIO::ReadAt(icInt64Number nPos, void *pBuf, icInt32Number nNum)
+{
+  if (!m_fFile || nPos<0 || nNum<0)
+    return -1;
+
+  icUInt8Number *pDst = (icUInt8Number*)pBuf;
+  icInt32Number nDone = 0;
+
+#ifdef WIN32
+  HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(m_fFile));
+  if (hFile==INVALID_HANDLE_VALUE)
+    return -1;
+
+  while (nDone<nNum) {
+    OVERLAPPED ov;
+    DWORD nRead = 0;
+    icInt64Number nAt = nPos + nDone;
+
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)(nAt & 0xffffffff);
+    ov.OffsetHigh = (DWORD)(nAt >> 32);
+
+    if (!ReadFile(hFile, pDst+nDone, (DWORD)(nNum-nDone), &nRead, &ov) || !nRead)
+      break;
+    nDone += (icInt32Number)nRead;
+  }
+#else
+  int fd = fileno(m_fFile);
+
+  while (nDone<nNum) {
+    ssize_t nRead = pread(fd, pDst+nDone, (size_t)(nNum-nDone), (off_t)(nPos+nDone));
+    if (nRead<=0)
+      break;
+    nDone += (icInt32Number)nRead;
+  }
+#endif
+
+  return nDone;
 }
 
 
@@ -494,6 +611,7 @@ CIccMemIO::CIccMemIO() : CIccIO()
   m_nPos = 0;
 
   m_bFreeData = false;
+  m_bGrow = false;
 }
 
 CIccMemIO::~CIccMemIO()
@@ -502,12 +620,19 @@ CIccMemIO::~CIccMemIO()
 }
 
 
-bool CIccMemIO::Alloc(icUInt32Number nSize, bool bWrite)
+bool CIccMemIO::Alloc(icUInt64Number nSize, bool bWrite, bool bGrow)
 {
   if (m_pData)
     Close();
 
-  icUInt8Number *pData = (icUInt8Number*)malloc(nSize);
+  if (nSize != (size_t)nSize)
+    return false;
+
+  //A growable buffer always has some room so that m_pData is never NULL
+  if (bGrow && nSize<256)
+    nSize = 256;
+
+  icUInt8Number *pData = (icUInt8Number*)malloc((size_t)nSize);
 
   if (!pData)
     return false;
@@ -518,12 +643,43 @@ bool CIccMemIO::Alloc(icUInt32Number nSize, bool bWrite)
   }
 
   m_bFreeData = true;
+  m_bGrow = bGrow && bWrite;
 
   return true;
 }
 
 
-bool CIccMemIO::Attach(icUInt8Number *pData, icUInt32Number nSize, bool bWrite)
+/** Makes room for at least nSize bytes.  The allocation grows in whole
+ * icMemIOGrowChunk chunks and at least doubles so that writing a profile
+ * piece by piece stays linear in its size. */
+bool CIccMemIO::Grow(icUInt64Number nSize)
+{
+  if (nSize<=m_nAvail)
+    return true;
+
+  if (!m_bGrow)
+    return false;
+
+  icUInt64Number nAvail = m_nAvail*2;
+  if (nAvail<nSize)
+    nAvail = nSize;
+  nAvail = (nAvail + icMemIOGrowChunk-1) & ~(icUInt64Number)(icMemIOGrowChunk-1);
+
+  if (nAvail != (size_t)nAvail)
+    return false;
+
+  icUInt8Number *pData = (icUInt8Number*)realloc(m_pData, (size_t)nAvail);
+  if (!pData)
+    return false;
+
+  m_pData = pData;
+  m_nAvail = nAvail;
+
+  return true;
+}
+
+
+bool CIccMemIO::Attach(icUInt8Number *pData, icUInt64Number nSize, bool bWrite)
 {
   if (!pData)
     return false;
@@ -533,6 +689,7 @@ bool CIccMemIO::Attach(icUInt8Number *pData, icUInt32Number nSize, bool bWrite)
 
   m_pData = pData;
   m_nPos = 0;
+  m_bGrow = false;
 
   if (bWrite) {
     m_nAvail = nSize;
@@ -555,6 +712,7 @@ void CIccMemIO::Close()
       m_bFreeData = false;
     }
     m_pData = NULL;
+    m_bGrow = false;
   }
 }
 
@@ -564,7 +722,10 @@ icInt32Number CIccMemIO::Read8(void *pBuf, icInt32Number nNum)
   if (!m_pData)
     return 0;
 
-  nNum = __min((icInt32Number)(m_nSize-m_nPos), nNum);
+  if (nNum<0)
+    return 0;
+  if ((icUInt64Number)nNum > m_nSize-m_nPos)
+    nNum = (icInt32Number)(m_nSize-m_nPos);
 
   memcpy(pBuf, m_pData+m_nPos, nNum);
   m_nPos += nNum;
@@ -578,7 +739,10 @@ icInt32Number CIccMemIO::Write8(void *pBuf, icInt32Number nNum)
   if (!m_pData)
     return 0;
 
-  nNum = __min((icInt32Number)(m_nAvail-m_nPos), nNum);
+  if (nNum<0)
+    return 0;
+  if ((icUInt64Number)nNum > m_nAvail-m_nPos && !Grow(m_nPos+nNum))
+    nNum = (icInt32Number)(m_nAvail-m_nPos);
 
   memcpy(m_pData + m_nPos, pBuf, nNum);
 
@@ -590,30 +754,30 @@ icInt32Number CIccMemIO::Write8(void *pBuf, icInt32Number nNum)
 }
 
 
-icInt32Number CIccMemIO::GetLength()
+icInt64Number CIccMemIO::GetLength()
 {
   if (!m_pData)
     return 0;
 
-  return m_nSize;
+  return (icInt64Number)m_nSize;
 }
 
 
-icInt32Number CIccMemIO::Seek(icInt32Number nOffset, icSeekVal pos)
+icInt64Number CIccMemIO::Seek(icInt64Number nOffset, icSeekVal pos)
 {
   if (!m_pData)
     return -1;
 
-  icInt32Number nPos;
+  icInt64Number nPos;
   switch(pos) {
   case icSeekSet:
     nPos = nOffset;
     break;
   case icSeekCur:
-    nPos = (icInt32Number)m_nPos + nOffset;
+    nPos = (icInt64Number)m_nPos + nOffset;
     break;
   case icSeekEnd:
-    nPos = (icInt32Number)m_nSize + nOffset;
+    nPos = (icInt64Number)m_nSize + nOffset;
     break;
   default:
     nPos = 0;
@@ -623,10 +787,13 @@ icInt32Number CIccMemIO::Seek(icInt32Number nOffset, icSeekVal pos)
   if (nPos < 0)
     return -1;
 
-  icUInt32Number uPos = (icUInt32Number)nPos;
+  icUInt64Number uPos = (icUInt64Number)nPos;
+
+  if (uPos > m_nAvail && m_bGrow)
+    Grow(uPos);
 
   if (uPos > m_nSize && m_nSize != m_nAvail && uPos <=m_nAvail) {
-    memset(m_pData+m_nSize, 0, (icInt32Number)(uPos - m_nSize));
+    memset(m_pData+m_nSize, 0, (size_t)(uPos - m_nSize));
     m_nSize = uPos;
   }
   if (uPos > m_nSize)
@@ -638,12 +805,167 @@ icInt32Number CIccMemIO::Seek(icInt32Number nOffset, icSeekVal pos)
 }
 
 
-icInt32Number CIccMemIO::Tell()
+icInt64Number CIccMemIO::Tell()
 {
   if (!m_pData)
     return -1;
 
-  return (icInt32Number)m_nPos;
+  return (icInt64Number)m_nPos;
+}
+
+
+icInt32Number CIccMemIO::ReadAt(icInt64Number nPos, void *pBuf, icInt32Number nNum)
+{
+  if (!m_pData || nPos<0 || nNum<0)
+    return -1;
+
+  if ((icUInt64Number)nPos>=m_nSize)
+    return 0;
+
+  if ((icUInt64Number)nNum > m_nSize-nPos)
+    nNum = (icInt32Number)(m_nSize-nPos);
+
+  memcpy(pBuf, m_pData+nPos, nNum);
+
+  return nNum;
+}
+
+
+const icUInt8Number *CIccMemIO::ReadDirect(icInt32Number nNum)
+{
+  if (!m_pData || nNum<0 || (icUInt64Number)nNum > m_nSize-m_nPos)
+    return NULL;
+
+  const icUInt8Number *pData = m_pData + m_nPos;
+  m_nPos += nNum;
+
+  return pData;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Class CIccMappedIO
+//////////////////////////////////////////////////////////////////////
+
+CIccMappedIO::CIccMappedIO() : CIccMemIO()
+{
+  m_pView = NULL;
+  m_nViewSize = 0;
+}
+
+CIccMappedIO::~CIccMappedIO()
+{
+  Close();
+}
+
+
+bool CIccMappedIO::AttachView(void *pView, size_t nSize)
+{
+  m_pView = pView;
+  m_nViewSize = nSize;
+
+  if (!Attach((icUInt8Number*)pView, (icUInt64Number)nSize)) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+
+#ifdef WIN32
+static void *icMapFile(HANDLE hFile, size_t &nSize)
+{
+  LARGE_INTEGER nFileSize;
+  void *pView = NULL;
+
+  if (hFile==INVALID_HANDLE_VALUE)
+    return NULL;
+
+  if (GetFileSizeEx(hFile, &nFileSize) && nFileSize.QuadPart>0 && (icUInt64Number)nFileSize.QuadPart==(size_t)nFileSize.QuadPart) {
+    HANDLE hMap = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (hMap) {
+      //The view keeps the mapping alive after the handles are closed
+      pView = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+      nSize = (size_t)nFileSize.QuadPart;
+      CloseHandle(hMap);
+    }
+  }
+  CloseHandle(hFile);
+
+  return pView;
+}
+
+bool CIccMappedIO::Open(const icChar *szFilename)
+{
+  Close();
+
+  size_t nSize = 0;
+  void *pView = icMapFile(CreateFileA(szFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), nSize);
+
+  if (!pView)
+    return false;
+
+  return AttachView(pView, nSize);
+}
+
+bool CIccMappedIO::Open(const icWChar *szFilename)
+{
+  Close();
+
+  size_t nSize = 0;
+  void *pView = icMapFile(CreateFileW(szFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), nSize);
+
+  if (!pView)
+    return false;
+
+  return AttachView(pView, nSize);
+}
+
+#else
+
+bool CIccMappedIO::Open(const icChar *szFilename)
+{
+  Close();
+
+  int fd = open(szFilename, O_RDONLY);
+  if (fd<0)
+    return false;
+
+  struct stat st;
+  void *pView = NULL;
+  size_t nSize = 0;
+
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size>0 && (icUInt64Number)st.st_size==(size_t)st.st_size) {
+    nSize = (size_t)st.st_size;
+    pView = mmap(NULL, nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pView==MAP_FAILED)
+      pView = NULL;
+  }
+  close(fd);
+
+  if (!pView)
+    return false;
+
+  return AttachView(pView, nSize);
+}
+#endif
+
+
+void CIccMappedIO::Close()
+{
+  CIccMemIO::Close();
+
+  if (m_pView) {
+#ifdef WIN32
+    UnmapViewOfFile(m_pView);
+#else
+    munmap(m_pView, m_nViewSize);
+#endif
+    m_pView = NULL;
+    m_nViewSize = 0;
+  }
 }
 
 ///////////////////////////////
@@ -678,8 +1000,11 @@ void CIccNullIO::Close()
 
 icInt32Number CIccNullIO::Read8(void *pBuf, icInt32Number nNum)
 {
-  icInt32Number nLeft = m_nSize - m_nPos;
-  icInt32Number nRead = (nNum <= (icInt32Number)nLeft) ? nNum : nLeft;
+  if (nNum<0)
+    return 0;
+
+  icUInt64Number nLeft = m_nSize > m_nPos ? m_nSize - m_nPos : 0;
+  icInt32Number nRead = ((icUInt64Number)nNum <= nLeft) ? nNum : (icInt32Number)nLeft;
 
   memset(pBuf, 0, nRead);
   m_nPos += nRead;
@@ -698,24 +1023,24 @@ icInt32Number CIccNullIO::Write8(void *pBuf, icInt32Number nNum)
 }
 
 
-icInt32Number CIccNullIO::GetLength()
+icInt64Number CIccNullIO::GetLength()
 {
-  return m_nSize;
+  return (icInt64Number)m_nSize;
 }
 
 
-icInt32Number CIccNullIO::Seek(icInt32Number nOffset, icSeekVal pos)
+icInt64Number CIccNullIO::Seek(icInt64Number nOffset, icSeekVal pos)
 {
-  icInt32Number nPos;
+  icInt64Number nPos;
   switch(pos) {
   case icSeekSet:
     nPos = nOffset;
     break;
   case icSeekCur:
-    nPos = (icInt32Number)m_nPos + nOffset;
+    nPos = (icInt64Number)m_nPos + nOffset;
     break;
   case icSeekEnd:
-    nPos = (icInt32Number)m_nSize + nOffset;
+    nPos = (icInt64Number)m_nSize + nOffset;
     break;
   default:
     nPos = 0;
@@ -725,7 +1050,7 @@ icInt32Number CIccNullIO::Seek(icInt32Number nOffset, icSeekVal pos)
   if (nPos < 0)
     return -1;
 
-  m_nPos = (icUInt32Number)nPos;
+  m_nPos = (icUInt64Number)nPos;
 
   if (m_nPos>m_nSize)
     m_nSize = m_nPos;
@@ -734,9 +1059,9 @@ icInt32Number CIccNullIO::Seek(icInt32Number nOffset, icSeekVal pos)
 }
 
 
-icInt32Number CIccNullIO::Tell()
+icInt64Number CIccNullIO::Tell()
 {
-  return (icInt32Number)m_nPos;
+  return (icInt64Number)m_nPos;
 }
 
 
@@ -97,6 +97,7 @@ class ICCPROFLIB_API CIccIO
 {
 public:
 
+  CIccIO() { m_bNativeCLUTStorage = false; }
   virtual ~CIccIO() {}
 
   virtual void Close() {}
@@ -127,16 +128,32 @@ public:
   icInt32Number ReadFloat32Float(void *pBufFloat, icInt32Number nNum=1);
   icInt32Number WriteFloat32Float(void *pBufFloat, icInt32Number nNum=1);
 
-  virtual icInt32Number GetLength() {return 0;}
+  ///Positions and lengths are 64 bit so that files and embedding containers larger than 2GB can be addressed
+  virtual icInt64Number GetLength() {return 0;}
 
-  virtual icInt32Number Seek(icInt32Number nOffset, icSeekVal pos) {return -1;}
-  virtual icInt32Number Tell() {return 0;}
+  virtual icInt64Number Seek(icInt64Number nOffset, icSeekVal pos) {return -1;}
+  virtual icInt64Number Tell() {return 0;}
+
+  ///Returns pointer to the next nNum bytes and advances past them if the data is held in memory, otherwise NULL
+  virtual const icUInt8Number *ReadDirect(icInt32Number nNum) { return NULL; }
+
+  ///Reads nNum bytes at nPos without using or moving the current position so that several threads can
+  ///read at once.  Returns the number of bytes read, or -1 if positional reads are not supported.
+  virtual icInt32Number ReadAt(icInt64Number nPos, void *pBuf, icInt32Number nNum) { return -1; }
 
   ///Write operation to make sure that filelength is evenly divisible by 4
   bool Align32(); 
 
   ///Operation to make sure read position is evenly divisible by 4
   bool Sync32(icUInt32Number nOffset=0); 
+
+  ///Selects whether CLUTs read through this object from 8-bit, 16-bit or float16 encodings keep
+  ///their grid values in 16-bit form rather than expanding them to icFloatNumber
+  void SetNativeCLUTStorage(bool bNative) { m_bNativeCLUTStorage = bNative; }
+  bool GetNativeCLUTStorage() const { return m_bNativeCLUTStorage; }
+
+protected:
+  bool m_bNativeCLUTStorage;
 };
 
 /**
@@ -161,15 +178,26 @@ public:
   virtual icInt32Number Read8(void *pBuf, icInt32Number nNum=1);
   virtual icInt32Number Write8(void *pBuf, icInt32Number nNum=1);
 
-  virtual icInt32Number GetLength();
+  virtual icInt64Number GetLength();
+
+  virtual icInt64Number Seek(icInt64Number nOffset, icSeekVal pos);
+  virtual icInt64Number Tell();
 
-  virtual icInt32Number Seek(icInt32Number nOffset, icSeekVal pos);
-  virtual icInt32Number Tell();
+  virtual icInt32Number ReadAt(icInt64Number nPos, void *pBuf, icInt32Number nNum);
+
+  ///Size of the stdio buffer used for opened files
+  static const size_t icFileIOBufSize = 0x40000;
 
 protected:
+  bool SetBuffer();
+
   FILE *m_fFile;
+  char *m_pFileBuf;
 };
 
+///Allocation granularity of a growable CIccMemIO (must be a power of two)
+#define icMemIOGrowChunk 0x10000
+
 /**
  **************************************************************************
  * Type: Class
@@ -183,28 +211,67 @@ public:
   CIccMemIO();
   virtual ~CIccMemIO();
 
-  bool Alloc(icUInt32Number nSize, bool bWrite = false);
+  ///With bGrow the buffer is reallocated as needed when writing past its end.  Write8()
+  ///then only returns a short count if the buffer cannot be grown.
+  bool Alloc(icUInt64Number nSize, bool bWrite = false, bool bGrow = false);
 
-  bool Attach(icUInt8Number *pData, icUInt32Number nSize, bool bWrite=false);
+  bool Attach(icUInt8Number *pData, icUInt64Number nSize, bool bWrite=false);
   virtual void Close();
 
   virtual icInt32Number Read8(void *pBuf, icInt32Number nNum=1);
   virtual icInt32Number Write8(void *pBuf, icInt32Number nNum=1);
 
-  virtual icInt32Number GetLength();
+  virtual icInt64Number GetLength();
+
+  virtual icInt64Number Seek(icInt64Number nOffset, icSeekVal pos);
+  virtual icInt64Number Tell();
 
-  virtual icInt32Number Seek(icInt32Number nOffset, icSeekVal pos);
-  virtual icInt32Number Tell();
+  virtual const icUInt8Number *ReadDirect(icInt32Number nNum);
+  virtual icInt32Number ReadAt(icInt64Number nPos, void *pBuf, icInt32Number nNum);
 
   icUInt8Number *GetData() { return m_pData; }
 
 protected:
+  bool Grow(icUInt64Number nSize);
+
   icUInt8Number *m_pData;
-  icUInt32Number m_nSize;
-  icUInt32Number m_nAvail;
-  icUInt32Number m_nPos;
+  icUInt64Number m_nSize;
+  icUInt64Number m_nAvail;
+  icUInt64Number m_nPos;
 
   bool m_bFreeData;
+  bool m_bGrow;
+};
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Handles read only IO of a memory mapped file.  Pages of the
+ *  file are only loaded when they are read, so a profile opened with
+ *  OpenIccProfile only costs memory for the tags that are actually used.
+ *  The file should not be changed while it is open.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccMappedIO : public CIccMemIO
+{
+public:
+  CIccMappedIO();
+  virtual ~CIccMappedIO();
+
+  bool Open(const icChar *szFilename);
+#ifdef WIN32
+  bool Open(const icWChar *szFilename);
+#endif
+  virtual void Close();
+
+  virtual icInt32Number Write8(void *pBuf, icInt32Number nNum=1) { return 0; }
+
+protected:
+  bool AttachView(void *pView, size_t nSize);
+
+  void *m_pView;
+  size_t m_nViewSize;
 };
 
 /**
@@ -228,14 +295,14 @@ public:
   virtual icInt32Number Read8(void *pBuf, icInt32Number nNum=1);   //Read zero's into buf
   virtual icInt32Number Write8(void *pBuf, icInt32Number nNum=1);
 
-  virtual icInt32Number GetLength();
+  virtual icInt64Number GetLength();
 
-  virtual icInt32Number Seek(icInt32Number nOffset, icSeekVal pos);
-  virtual icInt32Number Tell();
+  virtual icInt64Number Seek(icInt64Number nOffset, icSeekVal pos);
+  virtual icInt64Number Tell();
 
 protected:
-  icUInt32Number m_nSize;
-  icUInt32Number m_nPos;
+  icUInt64Number m_nSize;
+  icUInt64Number m_nPos;
 };
 
 
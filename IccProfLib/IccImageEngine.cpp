@@ -0,0 +1,562 @@
+/** @file
+    File:       IccImageEngine.cpp
+
+    Contains:   Implementation of a multithreaded image transform engine
+                built on CIccCmm
+
+    Version:    V1
+
+    Copyright:  (c) see ICC Software License
+*/
+
+
+/*
+ * The ICC Software License, Version 0.2
+ *
+ *
+ * Copyright (c) 2003-2016 The International Color Consortium. All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. In the absence of prior written permission, the names "ICC" and "The
+ *    International Color Consortium" must not be used to imply that the
+ *    ICC organization endorses or promotes products derived from this
+ *    software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE INTERNATIONAL COLOR CONSORTIUM OR
+ * ITS CONTRIBUTING MEMBERS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by many
+ * individuals on behalf of the The International Color Consortium. 
+ *
+ *
+ * Membership in the ICC is encouraged when this software is used for
+ * commercial purposes. 
+ *
+ *  
+ * For more information on The International Color Consortium, please
+ * see <http://www.color.org/>.
+ *  
+ * 
+ */
+
+////////////////////////////////////////////////////////////////////// 
+// HISTORY:
+//
+// -Initial implementation of tile parallel image engine
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "IccImageEngine.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USEREFICCMAXNAMESPACE
+namespace refIccMAX {
+#endif
+
+static icFloatNumber UnitClip(icFloatNumber v)
+{
+  if (v<0.0)
+    return 0.0;
+  if (v>1.0)
+    return 1.0;
+  return v;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageCodec::CIccImageCodec
+ * 
+ * Purpose: 
+ *  Constructor
+ *
+ * Args:
+ *  nSamples = number of interleaved samples per pixel,
+ *  nEncode = icEncode8Bit, icEncode16Bit or icEncodeFloat (32 bit floats)
+ **************************************************************************
+ */
+CIccImageCodec::CIccImageCodec(icUInt32Number nSamples, icFloatColorEncoding nEncode)
+{
+  m_nSamples = nSamples;
+  m_nEncode = nEncode;
+}
+
+
+bool CIccImageCodec::IsValid() const
+{
+  if (!m_nSamples)
+    return false;
+
+  return m_nEncode==icEncode8Bit || m_nEncode==icEncode16Bit || m_nEncode==icEncodeFloat;
+}
+
+
+icUInt32Number CIccImageCodec::GetBytesPerPixel() const
+{
+  switch(m_nEncode) {
+    case icEncode8Bit:
+      return m_nSamples;
+    case icEncode16Bit:
+      return m_nSamples * sizeof(icUInt16Number);
+    case icEncodeFloat:
+      return m_nSamples * sizeof(icFloat32Number);
+    default:
+      return 0;
+  }
+}
+
+
+void CIccImageCodec::Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const
+{
+  icUInt32Number i, n = nPixels * m_nSamples;
+
+  switch(m_nEncode) {
+    case icEncode8Bit:
+      for (i=0; i<n; i++)
+        pPixels[i] = (icFloatNumber)pData[i] / 255.0f;
+      break;
+
+    case icEncode16Bit:
+      {
+        const icUInt16Number *pData16 = (const icUInt16Number*)pData;
+        for (i=0; i<n; i++)
+          pPixels[i] = (icFloatNumber)pData16[i] / 65535.0f;
+      }
+      break;
+
+    case icEncodeFloat:
+      if (sizeof(icFloatNumber)==sizeof(icFloat32Number)) {
+        memcpy(pPixels, pData, n*sizeof(icFloatNumber));
+      }
+      else {
+        const icFloat32Number *pData32 = (const icFloat32Number*)pData;
+        for (i=0; i<n; i++)
+          pPixels[i] = (icFloatNumber)pData32[i];
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+void CIccImageCodec::Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const
+{
+  icUInt32Number i, n = nPixels * m_nSamples;
+
+  switch(m_nEncode) {
+    case icEncode8Bit:
+      for (i=0; i<n; i++)
+        pData[i] = (icUInt8Number)(UnitClip(pPixels[i]) * 255.0f + 0.5f);
+      break;
+
+    case icEncode16Bit:
+      {
+        icUInt16Number *pData16 = (icUInt16Number*)pData;
+        for (i=0; i<n; i++)
+          pData16[i] = (icUInt16Number)(UnitClip(pPixels[i]) * 65535.0f + 0.5f);
+      }
+      break;
+
+    case icEncodeFloat:
+      if (sizeof(icFloatNumber)==sizeof(icFloat32Number)) {
+        memcpy(pData, pPixels, n*sizeof(icFloatNumber));
+      }
+      else {
+        icFloat32Number *pData32 = (icFloat32Number*)pData;
+        for (i=0; i<n; i++)
+          pData32[i] = (icFloat32Number)pPixels[i];
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::CIccImageEngine
+ * 
+ * Purpose: 
+ *  Constructor
+ **************************************************************************
+ */
+CIccImageEngine::CIccImageEngine()
+{
+  m_pCmm = NULL;
+  m_nSrcSamples = 0;
+  m_nDstSamples = 0;
+  m_bQuit = false;
+
+  m_pDst = NULL;
+  m_pSrc = NULL;
+  m_nDstRowBytes = 0;
+  m_nSrcRowBytes = 0;
+  m_pDstCodec = NULL;
+  m_pSrcCodec = NULL;
+  m_nDstPixelBytes = 0;
+  m_nSrcPixelBytes = 0;
+  m_nWidth = 0;
+  m_nRowUnits = 0;
+
+  m_nUnits = 0;
+  m_nNextUnit = 0;
+  m_nDoneUnits = 0;
+  m_nStatus = icCmmStatOk;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::~CIccImageEngine
+ * 
+ * Purpose: 
+ *  Destructor
+ **************************************************************************
+ */
+CIccImageEngine::~CIccImageEngine()
+{
+  End();
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::Begin
+ * 
+ * Purpose: 
+ *  Creates the worker threads along with an apply object for each.
+ * 
+ * Args: 
+ *  pCmm = CMM to apply.  Begin() must already have been called on it,
+ *  nThreads = number of workers to use.  Zero uses one worker per
+ *   hardware thread.
+ * 
+ * Return: 
+ *  icCmmStatOk if the workers were started.
+ **************************************************************************
+ */
+icStatusCMM CIccImageEngine::Begin(CIccCmm *pCmm, icUInt32Number nThreads)
+{
+  End();
+
+  if (!pCmm || !pCmm->Valid())
+    return icCmmStatBad;
+
+  if (!nThreads) {
+    nThreads = std::thread::hardware_concurrency();
+    if (!nThreads)
+      nThreads = 1;
+  }
+
+  m_pCmm = pCmm;
+  m_nSrcSamples = pCmm->GetSourceSamples();
+  m_nDstSamples = pCmm->GetDestSamples();
+
+  if (!m_nSrcSamples || !m_nDstSamples) {
+    m_pCmm = NULL;
+    return icCmmStatBadSpaceLink;
+  }
+
+  icUInt32Number i;
+  for (i=0; i<nThreads; i++) {
+    icImageWorker worker;
+    icStatusCMM stat = icCmmStatOk;
+
+    worker.pApply = pCmm->GetNewApplyCmm(stat);
+    worker.pSrcPixels = (icFloatNumber*)malloc(icImageEngineChunkPixels * m_nSrcSamples * sizeof(icFloatNumber));
+    worker.pDstPixels = (icFloatNumber*)malloc(icImageEngineChunkPixels * m_nDstSamples * sizeof(icFloatNumber));
+
+    if (!worker.pApply || !worker.pSrcPixels || !worker.pDstPixels) {
+      if (worker.pApply)
+        delete worker.pApply;
+      if (worker.pSrcPixels)
+        free(worker.pSrcPixels);
+      if (worker.pDstPixels)
+        free(worker.pDstPixels);
+      End();
+      return stat!=icCmmStatOk ? stat : icCmmStatAllocErr;
+    }
+    m_Workers.push_back(worker);
+  }
+
+  m_bQuit = false;
+  for (i=0; i<nThreads; i++) {
+    m_Threads.push_back(std::thread(&CIccImageEngine::Run, this, i));
+  }
+
+  return icCmmStatOk;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::End
+ * 
+ * Purpose: 
+ *  Waits for outstanding work, stops the workers and releases their
+ *  apply objects.
+ **************************************************************************
+ */
+void CIccImageEngine::End()
+{
+  if (!m_Threads.empty()) {
+    Wait();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bQuit = true;
+    }
+    m_workCond.notify_all();
+
+    std::vector<std::thread>::iterator t;
+    for (t=m_Threads.begin(); t!=m_Threads.end(); t++)
+      t->join();
+    m_Threads.clear();
+  }
+
+  std::vector<icImageWorker>::iterator w;
+  for (w=m_Workers.begin(); w!=m_Workers.end(); w++) {
+    delete w->pApply;
+    free(w->pSrcPixels);
+    free(w->pDstPixels);
+  }
+  m_Workers.clear();
+
+  m_pCmm = NULL;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::Apply
+ * 
+ * Purpose: 
+ *  Applies the CMM to nPixels packed pixels in the internal floating point
+ *  encoding and waits for the result.
+ **************************************************************************
+ */
+icStatusCMM CIccImageEngine::Apply(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nPixels)
+{
+  return ApplyStrip((icUInt8Number*)pDst, 0, NULL, (const icUInt8Number*)pSrc, 0, NULL, nPixels, 1);
+}
+
+
+icStatusCMM CIccImageEngine::ApplyStrip(icUInt8Number *pDst, icUInt32Number nDstRowBytes, const IIccImageCodec *pDstCodec,
+                                        const icUInt8Number *pSrc, icUInt32Number nSrcRowBytes, const IIccImageCodec *pSrcCodec,
+                                        icUInt32Number nWidth, icUInt32Number nRows)
+{
+  icStatusCMM rv = StartStrip(pDst, nDstRowBytes, pDstCodec, pSrc, nSrcRowBytes, pSrcCodec, nWidth, nRows);
+
+  if (rv!=icCmmStatOk)
+    return rv;
+
+  return Wait();
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::StartStrip
+ * 
+ * Purpose: 
+ *  Queues a strip of rows for the workers and returns without waiting.
+ * 
+ * Args: 
+ *  pDst = first destination row,
+ *  nDstRowBytes = byte offset between destination rows,
+ *  pDstCodec = encoder for destination pixels (NULL for internal floats),
+ *  pSrc = first source row,
+ *  nSrcRowBytes = byte offset between source rows,
+ *  pSrcCodec = decoder for source pixels (NULL for internal floats),
+ *  nWidth = number of pixels in each row,
+ *  nRows = number of rows in the strip
+ * 
+ * Return: 
+ *  icCmmStatOk if the strip was queued.
+ **************************************************************************
+ */
+icStatusCMM CIccImageEngine::StartStrip(icUInt8Number *pDst, icUInt32Number nDstRowBytes, const IIccImageCodec *pDstCodec,
+                                        const icUInt8Number *pSrc, icUInt32Number nSrcRowBytes, const IIccImageCodec *pSrcCodec,
+                                        icUInt32Number nWidth, icUInt32Number nRows)
+{
+  if (m_Threads.empty())
+    return icCmmStatIncorrectApply;
+
+  icStatusCMM rv = Wait();
+  if (rv!=icCmmStatOk)
+    return rv;
+
+  if (!nWidth || !nRows)
+    return icCmmStatOk;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_pDst = pDst;
+  m_pSrc = pSrc;
+  m_pDstCodec = pDstCodec;
+  m_pSrcCodec = pSrcCodec;
+  m_nDstPixelBytes = pDstCodec ? pDstCodec->GetBytesPerPixel() : m_nDstSamples * sizeof(icFloatNumber);
+  m_nSrcPixelBytes = pSrcCodec ? pSrcCodec->GetBytesPerPixel() : m_nSrcSamples * sizeof(icFloatNumber);
+  m_nDstRowBytes = nRows>1 ? nDstRowBytes : 0;
+  m_nSrcRowBytes = nRows>1 ? nSrcRowBytes : 0;
+  m_nWidth = nWidth;
+  m_nRowUnits = (nWidth + icImageEngineChunkPixels - 1) / icImageEngineChunkPixels;
+
+  m_nUnits = m_nRowUnits * nRows;
+  m_nNextUnit = 0;
+  m_nDoneUnits = 0;
+  m_nStatus = icCmmStatOk;
+
+  lock.unlock();
+  m_workCond.notify_all();
+
+  return icCmmStatOk;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::Wait
+ * 
+ * Purpose: 
+ *  Blocks until the last queued strip has been transformed.
+ * 
+ * Return: 
+ *  icCmmStatOk or the first error reported by a worker for the strip.
+ **************************************************************************
+ */
+icStatusCMM CIccImageEngine::Wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (m_nDoneUnits<m_nUnits)
+    m_doneCond.wait(lock);
+
+  icStatusCMM rv = m_nStatus;
+  m_nStatus = icCmmStatOk;
+
+  return rv;
+}
+
+
+bool CIccImageEngine::IsBusy()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  return m_nDoneUnits<m_nUnits;
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::Run
+ * 
+ * Purpose: 
+ *  Worker thread loop.  Pulls units of the current strip until told to
+ *  quit.
+ **************************************************************************
+ */
+void CIccImageEngine::Run(icUInt32Number nWorker)
+{
+  icImageWorker &worker = m_Workers[nWorker];
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;) {
+    while (!m_bQuit && m_nNextUnit>=m_nUnits)
+      m_workCond.wait(lock);
+
+    if (m_bQuit)
+      break;
+
+    icUInt32Number nUnit = m_nNextUnit++;
+
+    lock.unlock();
+    icStatusCMM stat = ApplyUnit(worker, nUnit);
+    lock.lock();
+
+    if (stat!=icCmmStatOk && m_nStatus==icCmmStatOk)
+      m_nStatus = stat;
+
+    m_nDoneUnits++;
+    if (m_nDoneUnits==m_nUnits)
+      m_doneCond.notify_all();
+  }
+}
+
+
+/**
+ **************************************************************************
+ * Name: CIccImageEngine::ApplyUnit
+ * 
+ * Purpose: 
+ *  Decodes, transforms and encodes one unit of the current strip using
+ *  the worker's apply object and buffers.
+ **************************************************************************
+ */
+icStatusCMM CIccImageEngine::ApplyUnit(icImageWorker &worker, icUInt32Number nUnit)
+{
+  icUInt32Number nRow = nUnit / m_nRowUnits;
+  icUInt32Number nFirst = (nUnit % m_nRowUnits) * icImageEngineChunkPixels;
+  icUInt32Number nPixels = m_nWidth - nFirst;
+
+  if (nPixels>icImageEngineChunkPixels)
+    nPixels = icImageEngineChunkPixels;
+
+  const icUInt8Number *pSrc = m_pSrc + (size_t)nRow*m_nSrcRowBytes + (size_t)nFirst*m_nSrcPixelBytes;
+  icUInt8Number *pDst = m_pDst + (size_t)nRow*m_nDstRowBytes + (size_t)nFirst*m_nDstPixelBytes;
+
+  const icFloatNumber *pSrcPixels;
+  icFloatNumber *pDstPixels;
+
+  if (m_pSrcCodec) {
+    m_pSrcCodec->Decode(worker.pSrcPixels, pSrc, nPixels);
+    pSrcPixels = worker.pSrcPixels;
+  }
+  else {
+    pSrcPixels = (const icFloatNumber*)pSrc;
+  }
+
+  pDstPixels = m_pDstCodec ? worker.pDstPixels : (icFloatNumber*)pDst;
+
+  icStatusCMM rv = worker.pApply->Apply(pDstPixels, pSrcPixels, nPixels);
+  if (rv!=icCmmStatOk)
+    return rv;
+
+  if (m_pDstCodec)
+    m_pDstCodec->Encode(pDst, pDstPixels, nPixels);
+
+  return icCmmStatOk;
+}
+
+#ifdef USEREFICCMAXNAMESPACE
+} //namespace refIccMAX
+#endif
@@ -0,0 +1,236 @@
+/** @file
+    File:       IccImageEngine.h
+
+    Contains:   Header for implementation of a multithreaded image transform
+                engine built on CIccCmm
+
+    Version:    V1
+
+    Copyright:  (c) see ICC Software License
+*/
+
+
+/*
+ * The ICC Software License, Version 0.2
+ *
+ *
+ * Copyright (c) 2003-2016 The International Color Consortium. All rights 
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. In the absence of prior written permission, the names "ICC" and "The
+ *    International Color Consortium" must not be used to imply that the
+ *    ICC organization endorses or promotes products derived from this
+ *    software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE INTERNATIONAL COLOR CONSORTIUM OR
+ * ITS CONTRIBUTING MEMBERS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by many
+ * individuals on behalf of the The International Color Consortium. 
+ *
+ *
+ * Membership in the ICC is encouraged when this software is used for
+ * commercial purposes. 
+ *
+ *  
+ * For more information on The International Color Consortium, please
+ * see <http://www.color.org/>.
+ *  
+ * 
+ */
+
+////////////////////////////////////////////////////////////////////// 
+// HISTORY:
+//
+// -Initial implementation of tile parallel image engine
+//
+//////////////////////////////////////////////////////////////////////
+
+#if !defined(_ICCIMAGEENGINE_H)
+#define _ICCIMAGEENGINE_H
+
+#include "IccDefs.h"
+#include "IccCmm.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef USEREFICCMAXNAMESPACE
+namespace refIccMAX {
+#endif
+
+///Maximum number of pixels that a worker transforms in a single unit of work
+#define icImageEngineChunkPixels 4096
+
+
+/**
+ **************************************************************************
+ * Type: Interface Class
+ * 
+ * Purpose: Converts pixels between an application sample encoding and the
+ *  internal floating point encoding used by CIccCmm.  Workers call Decode()
+ *  and Encode() concurrently on disjoint pixel ranges so implementations
+ *  must not modify shared state.
+ **************************************************************************
+ */
+class ICCPROFLIB_API IIccImageCodec
+{
+public:
+  virtual ~IIccImageCodec() {}
+
+  ///Returns the number of bytes used by one encoded pixel
+  virtual icUInt32Number GetBytesPerPixel() const = 0;
+
+  virtual void Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const = 0;
+  virtual void Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const = 0;
+};
+
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Codec for interleaved unsigned 8 bit, 16 bit or 32 bit floating
+ *  point samples where each sample is scaled to the 0.0 to 1.0 range.  
+ *  Encoded values are clipped and rounded to the nearest integer.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccImageCodec : public IIccImageCodec
+{
+public:
+  CIccImageCodec(icUInt32Number nSamples, icFloatColorEncoding nEncode);
+  virtual ~CIccImageCodec() {}
+
+  bool IsValid() const;
+
+  virtual icUInt32Number GetBytesPerPixel() const;
+
+  virtual void Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const;
+  virtual void Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const;
+
+  icUInt32Number GetSamples() const { return m_nSamples; }
+  icFloatColorEncoding GetEncoding() const { return m_nEncode; }
+
+protected:
+  icUInt32Number m_nSamples;
+  icFloatColorEncoding m_nEncode;
+};
+
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Applies a CIccCmm to image buffers using a pool of worker
+ *  threads.  Each worker owns a CIccApplyCmm obtained from
+ *  CIccCmm::GetNewApplyCmm() along with its own decode and encode buffers.
+ *  A strip of rows is split into units of at most icImageEngineChunkPixels
+ *  pixels that workers pull until the strip is done.
+ *
+ *  StartStrip() returns as soon as the work has been queued so that the
+ *  caller can read the next strip and write the previous one while the
+ *  current strip is being transformed.  Wait() must be called before the
+ *  strip buffers are touched again or another strip is started.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccImageEngine
+{
+public:
+  CIccImageEngine();
+  virtual ~CIccImageEngine();
+
+  //The CIccCmm must have been begun and must outlive the engine (or the call to End())
+  icStatusCMM Begin(CIccCmm *pCmm, icUInt32Number nThreads=0);
+  void End();
+
+  icUInt32Number GetNumThreads() const { return (icUInt32Number)m_Threads.size(); }
+
+  ///Applies the CMM to packed pixels in the internal floating point encoding
+  icStatusCMM Apply(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nPixels);
+
+  ///Applies the CMM to a strip of encoded rows and waits for completion
+  icStatusCMM ApplyStrip(icUInt8Number *pDst, icUInt32Number nDstRowBytes, const IIccImageCodec *pDstCodec,
+                         const icUInt8Number *pSrc, icUInt32Number nSrcRowBytes, const IIccImageCodec *pSrcCodec,
+                         icUInt32Number nWidth, icUInt32Number nRows);
+
+  ///Queues a strip of encoded rows.  A NULL codec means that the rows hold internal floating point pixels.
+  icStatusCMM StartStrip(icUInt8Number *pDst, icUInt32Number nDstRowBytes, const IIccImageCodec *pDstCodec,
+                         const icUInt8Number *pSrc, icUInt32Number nSrcRowBytes, const IIccImageCodec *pSrcCodec,
+                         icUInt32Number nWidth, icUInt32Number nRows);
+
+  ///Waits for the last queued strip and returns the first error reported by a worker
+  icStatusCMM Wait();
+
+  bool IsBusy();
+
+protected:
+  typedef struct {
+    CIccApplyCmm *pApply;
+    icFloatNumber *pSrcPixels;
+    icFloatNumber *pDstPixels;
+  } icImageWorker;
+
+  void Run(icUInt32Number nWorker);
+  icStatusCMM ApplyUnit(icImageWorker &worker, icUInt32Number nUnit);
+
+  CIccCmm *m_pCmm;
+  icUInt32Number m_nSrcSamples;
+  icUInt32Number m_nDstSamples;
+
+  std::vector<icImageWorker> m_Workers;
+  std::vector<std::thread> m_Threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_workCond;
+  std::condition_variable m_doneCond;
+  bool m_bQuit;
+
+  //Current strip.  Only changed by StartStrip() while no units are outstanding.
+  icUInt8Number *m_pDst;
+  const icUInt8Number *m_pSrc;
+  icUInt32Number m_nDstRowBytes;
+  icUInt32Number m_nSrcRowBytes;
+  const IIccImageCodec *m_pDstCodec;
+  const IIccImageCodec *m_pSrcCodec;
+  icUInt32Number m_nDstPixelBytes;
+  icUInt32Number m_nSrcPixelBytes;
+  icUInt32Number m_nWidth;
+  icUInt32Number m_nRowUnits;
+
+  icUInt32Number m_nUnits;
+  icUInt32Number m_nNextUnit;
+  icUInt32Number m_nDoneUnits;
+  icStatusCMM m_nStatus;
+};
+
+
+#ifdef USEREFICCMAXNAMESPACE
+} //namespace refIccMAX
+#endif
+
+#endif // !defined(_ICCIMAGEENGINE_H)
@@ -166,6 +166,115 @@ void CIccMatrixMath::VectorMult(icFloatNumber *pDst, const icFloatNumber *pSrc)
 }
 
 
+//Matrix term with zero entries contributing nothing (as skipped by VectorMult)
+template <bool bSkipZero>
+static inline icFloatNumber icMtxTerm(icFloatNumber m, icFloatNumber v)
+{
+  if (bSkipZero)
+    return m!=0.0f ? m*v : 0.0f;
+  return m*v;
+}
+
+//Reduces blocks of vectors against a three row matrix
+template <bool bSkipZero>
+static void icMtxMult3N(const icFloatNumber *r0, const icFloatNumber *r1, const icFloatNumber *r2, int nCols,
+                        icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nVectors,
+                        icUInt32Number nDstStride, icUInt32Number nSrcStride)
+{
+  int i;
+
+  for (; nVectors>=4; nVectors-=4, pDst+=4*nDstStride, pSrc+=4*nSrcStride) {
+    const icFloatNumber *s0 = pSrc;
+    const icFloatNumber *s1 = s0 + nSrcStride;
+    const icFloatNumber *s2 = s1 + nSrcStride;
+    const icFloatNumber *s3 = s2 + nSrcStride;
+    icFloatNumber a00=0, a01=0, a02=0, a10=0, a11=0, a12=0;
+    icFloatNumber a20=0, a21=0, a22=0, a30=0, a31=0, a32=0;
+
+    for (i=0; i<nCols; i++) {
+      icFloatNumber m0 = r0[i], m1 = r1[i], m2 = r2[i];
+      icFloatNumber v0 = s0[i], v1 = s1[i], v2 = s2[i], v3 = s3[i];
+
+      a00 += icMtxTerm<bSkipZero>(m0, v0); a01 += icMtxTerm<bSkipZero>(m1, v0); a02 += icMtxTerm<bSkipZero>(m2, v0);
+      a10 += icMtxTerm<bSkipZero>(m0, v1); a11 += icMtxTerm<bSkipZero>(m1, v1); a12 += icMtxTerm<bSkipZero>(m2, v1);
+      a20 += icMtxTerm<bSkipZero>(m0, v2); a21 += icMtxTerm<bSkipZero>(m1, v2); a22 += icMtxTerm<bSkipZero>(m2, v2);
+      a30 += icMtxTerm<bSkipZero>(m0, v3); a31 += icMtxTerm<bSkipZero>(m1, v3); a32 += icMtxTerm<bSkipZero>(m2, v3);
+    }
+
+    icFloatNumber *d = pDst;
+    d[0] = a00; d[1] = a01; d[2] = a02; d += nDstStride;
+    d[0] = a10; d[1] = a11; d[2] = a12; d += nDstStride;
+    d[0] = a20; d[1] = a21; d[2] = a22; d += nDstStride;
+    d[0] = a30; d[1] = a31; d[2] = a32;
+  }
+
+  for (; nVectors; nVectors--, pDst+=nDstStride, pSrc+=nSrcStride) {
+    icFloatNumber a0=0, a1=0, a2=0;
+
+    for (i=0; i<nCols; i++) {
+      icFloatNumber v = pSrc[i];
+      a0 += icMtxTerm<bSkipZero>(r0[i], v); a1 += icMtxTerm<bSkipZero>(r1[i], v); a2 += icMtxTerm<bSkipZero>(r2[i], v);
+    }
+    pDst[0] = a0; pDst[1] = a1; pDst[2] = a2;
+  }
+}
+
+/**
+**************************************************************************
+* Name: CIccMatrixMath::VectorMultN
+* 
+* Purpose: 
+*  Multiplies a block of nVectors source vectors by the matrix.  Source
+*  vectors are treated as the rows of an nVectors x m_nCols matrix so the
+*  block is reduced as a single matrix product.  For three row matrices
+*  (spectral observers) four vectors are reduced at a time so that each
+*  matrix column is loaded once for all four and the twelve sums stay in
+*  registers.  The matrix itself is small enough to stay cache resident
+*  across the whole block.  Each sum is accumulated in the same order as
+*  VectorMult() and zero matrix entries contribute nothing (as they are
+*  skipped by VectorMult()) even when source values are infinite or NaN, so
+*  results are identical.  Zero entries are masked with selects rather than
+*  branches, and only when the matrix has any.
+* 
+* Args: 
+*  pDst = destination vectors (must not overlap pSrc)
+*  pSrc = source vectors
+*  nVectors = number of vectors
+*  nDstStride = number of samples between destination vectors
+*  nSrcStride = number of samples between source vectors
+**************************************************************************
+*/
+void CIccMatrixMath::VectorMultN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nVectors,
+                                 icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  int i, j;
+  int nCols = m_nCols;
+
+  if (m_nRows==3) {
+    //Zero entries only need masking when the matrix has some
+    int nEntries = 3*nCols;
+    for (i=0; i<nEntries && m_vals[i]!=0.0f; i++);
+
+    if (i<nEntries)
+      icMtxMult3N<true>(entry(0), entry(1), entry(2), nCols, pDst, pSrc, nVectors, nDstStride, nSrcStride);
+    else
+      icMtxMult3N<false>(entry(0), entry(1), entry(2), nCols, pDst, pSrc, nVectors, nDstStride, nSrcStride);
+    return;
+  }
+
+  for (; nVectors; nVectors--, pDst+=nDstStride, pSrc+=nSrcStride) {
+    const icFloatNumber *row = entry(0);
+    for (j=0; j<m_nRows; j++) {
+      icFloatNumber a = 0;
+      for (i=0; i<nCols; i++)
+        a += icMtxTerm<true>(row[i], pSrc[i]);
+      pDst[j] = a;
+      row = &row[nCols];
+    }
+  }
+}
+
+
 /**
 **************************************************************************
 * Name: CIccMatrixMath::dump
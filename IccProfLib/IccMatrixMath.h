@@ -98,6 +98,8 @@ public:
   virtual ~CIccMatrixMath();
 
   virtual void VectorMult(icFloatNumber *pDst, const icFloatNumber *pSrc) const;
+  virtual void VectorMultN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nVectors,
+                           icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
   virtual icUInt16Number GetCols() const { return m_nCols; }
   virtual icUInt16Number GetRows() const { return m_nRows; }
 
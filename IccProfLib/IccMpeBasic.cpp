@@ -495,6 +495,47 @@ icFloatNumber CIccFormulaCurveSegment::Apply(icFloatNumber v) const
   return v;
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccFormulaCurveSegment::IsAffine
+ * 
+ * Purpose: 
+ *  Determines whether the formula reduces to a linear mapping.  This is the
+ *  case for function types 0 and 3 when the gamma parameter is one.
+ * 
+ * Args: 
+ *  fScale = receives the slope of the mapping
+ *  fOffset = receives the offset of the mapping
+ * 
+ * Return: 
+ *  true if the segment evaluates as v*fScale + fOffset
+ ******************************************************************************/
+bool CIccFormulaCurveSegment::IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const
+{
+  if (!m_params)
+    return false;
+
+  switch (m_nFunctionType) {
+  case 0x0000:
+    //Y = (a * X + b) + c
+    if (m_nParameters<4 || m_params[0]!=1.0)
+      return false;
+    fScale = m_params[1];
+    fOffset = m_params[2] + m_params[3];
+    return true;
+
+  case 0x0003:
+    //Y = a * (b * X + c) + d
+    if (m_nParameters<5 || m_params[0]!=1.0)
+      return false;
+    fScale = m_params[1] * m_params[2];
+    fOffset = m_params[1] * m_params[3] + m_params[4];
+    return true;
+  }
+
+  return false;
+}
+
 /**
  ******************************************************************************
  * Name: CIccFormulaCurveSegment::Validate
@@ -1032,6 +1073,8 @@ CIccSingleCurveSegment::CIccSingleCurveSegment(const CIccSingleCurveSegment &cur
   m_startPoint = curve.m_startPoint;
   m_endPoint = curve.m_endPoint;
   m_nCount = curve.m_nCount;
+  m_storageType = curve.m_storageType;
+  m_segmentType = curve.m_segmentType;
 
   if (m_nCount) {
     m_pSamples = (icFloatNumber*)malloc(m_nCount * sizeof(icFloatNumber));
@@ -1046,6 +1089,8 @@ CIccSingleCurveSegment::CIccSingleCurveSegment(const CIccSingleCurveSegment &cur
 
   m_firstEntry = curve.m_firstEntry;
   m_lastEntry = curve.m_lastEntry;
+  m_range = curve.m_range;
+  m_last = curve.m_last;
 
   m_loIntercept = curve.m_loIntercept;
   m_loSlope = curve.m_loSlope;
@@ -1072,6 +1117,8 @@ CIccSingleCurveSegment &CIccSingleCurveSegment::operator=(const CIccSingleCurveS
   m_startPoint = curve.m_startPoint;
   m_endPoint = curve.m_endPoint;
   m_nCount = curve.m_nCount;
+  m_storageType = curve.m_storageType;
+  m_segmentType = curve.m_segmentType;
 
   if (m_nCount) {
     m_pSamples = (icFloatNumber*)malloc(m_nCount * sizeof(icFloatNumber));
@@ -1086,6 +1133,8 @@ CIccSingleCurveSegment &CIccSingleCurveSegment::operator=(const CIccSingleCurveS
 
   m_firstEntry = curve.m_firstEntry;
   m_lastEntry = curve.m_lastEntry;
+  m_range = curve.m_range;
+  m_last = curve.m_last;
 
   m_loIntercept = curve.m_loIntercept;
   m_loSlope = curve.m_loSlope;
@@ -1583,6 +1632,219 @@ CIccCurveSegment* CIccCurveSegment::Create(icCurveSegSignature sig, icFloatNumbe
 
 }
 
+//Smallest and largest number of intervals tried for a segment lookup table
+#define icCurveSegTableMinIntervals 256
+#define icCurveSegTableMaxIntervals 65536
+
+static inline icUInt32Number icCurveSegFloatBits(icFloatNumber v)
+{
+  union { float f; icUInt32Number n; } u;
+  u.f = (float)v;
+  return u.n;
+}
+
+static inline icFloatNumber icCurveSegBitsFloat(icUInt32Number n)
+{
+  union { float f; icUInt32Number n; } u;
+  u.n = n;
+  return (icFloatNumber)u.f;
+}
+
+/**
+ ******************************************************************************
+ * Name: icCurveSegTableApply
+ * 
+ * Purpose: 
+ *  Evaluates a segment using the evaluation data built by CIccSegmentedCurve::Begin().
+ *  Values at or outside the segment end points are evaluated directly so
+ *  segment boundaries give exactly the same results as the segment itself.
+ ******************************************************************************/
+static inline icFloatNumber icCurveSegTableApply(const icCurveSegTable *pTable, icFloatNumber v)
+{
+  if (!pTable->pValues || !(v > pTable->fStart && v < pTable->fEnd))
+    return pTable->pSeg->Apply(v);
+
+  icUInt32Number i;
+  icFloatNumber f;
+
+  if (pTable->bLog) {
+    icUInt32Number d = icCurveSegFloatBits(v) - pTable->nBase;
+
+    i = d >> pTable->nShift;
+    f = (icFloatNumber)(d & ((1u<<pTable->nShift)-1)) * pTable->fScale;
+  }
+  else {
+    f = (v - pTable->fStart) * pTable->fScale;
+    i = (icUInt32Number)f;
+    if (i>=pTable->nIntervals)
+      i = pTable->nIntervals-1;
+    f -= (icFloatNumber)i;
+  }
+
+  const icFloatNumber *p = pTable->pValues + i;
+
+  return p[0] + f*(p[1]-p[0]);
+}
+
+//Input value of table node k
+static icFloatNumber icCurveSegTableNode(const icCurveSegTable &table, icUInt32Number k)
+{
+  if (table.bLog)
+    return icCurveSegBitsFloat(table.nBase + (k<<table.nShift));
+
+  if (k>=table.nIntervals)
+    return table.fEnd;
+
+  return (icFloatNumber)(table.fStart + (icFloat64Number)k*((icFloat64Number)table.fEnd - table.fStart)/table.nIntervals);
+}
+
+static inline bool icCurveSegIsFinite(icFloatNumber v)
+{
+  return (v - v) == 0;
+}
+
+/**
+ ******************************************************************************
+ * Name: icFillCurveSegTable
+ * 
+ * Purpose: 
+ *  Samples a segment at the nodes of a table whose spacing has been set up
+ *  and measures the interpolation error at the quarter points of every interval
+ *  inside the segment.  Nodes that fall outside the segment (log spacing) or
+ *  where the segment does not give a finite value are clamped to the segment.
+ *  The error is a measured tolerance, not a bound: it is only checked at the
+ *  sample points, so a segment with detail finer than an interval can exceed
+ *  it in between.
+ * 
+ * Args: 
+ *  table = table with spacing set up and pValues==NULL
+ *  fTolerance = largest error allowed at the sample points
+ *  fErr = receives the largest error measured
+ * 
+ * Return: 
+ *  true if the table was filled and the measured error is within tolerance,
+ *  otherwise the table is left with pValues==NULL
+ ******************************************************************************/
+static bool icFillCurveSegTable(icCurveSegTable &table, icFloatNumber fTolerance, icFloatNumber &fErr)
+{
+  static const icFloatNumber fracs[3] = { 0.25f, 0.5f, 0.75f };
+  CIccCurveSegment *pSeg = table.pSeg;
+  icUInt32Number k, t;
+  icFloatNumber x, x0, x1, v, e;
+
+  icFloatNumber *pValues = (icFloatNumber*)malloc((table.nIntervals+1)*sizeof(icFloatNumber));
+  if (!pValues)
+    return false;
+
+  for (k=0; k<=table.nIntervals; k++) {
+    x = icCurveSegTableNode(table, k);
+    v = pSeg->Apply(x);
+
+    if (!icCurveSegIsFinite(v)) {
+      v = pSeg->Apply(x<table.fStart ? table.fStart : (x>table.fEnd ? table.fEnd : x));
+
+      if (!icCurveSegIsFinite(v)) {
+        free(pValues);
+        return false;
+      }
+    }
+    pValues[k] = v;
+  }
+
+  table.pValues = pValues;
+  fErr = 0;
+
+  x1 = icCurveSegTableNode(table, 0);
+  for (k=0; k<table.nIntervals; k++) {
+    x0 = x1;
+    x1 = icCurveSegTableNode(table, k+1);
+
+    for (t=0; t<3; t++) {
+      x = x0 + fracs[t]*(x1-x0);
+      if (!(x > table.fStart && x < table.fEnd))
+        continue;
+
+      e = (icFloatNumber)fabs(icCurveSegTableApply(&table, x) - pSeg->Apply(x));
+      if (!(e<=fTolerance)) {
+        free(pValues);
+        table.pValues = NULL;
+        return false;
+      }
+      if (e>fErr)
+        fErr = e;
+    }
+  }
+
+  return true;
+}
+
+/**
+ ******************************************************************************
+ * Name: icBuildCurveSegTable
+ * 
+ * Purpose: 
+ *  Replaces direct evaluation of a finite segment with the smallest lookup
+ *  table found that meets the error tolerance.  Table sizes double from
+ *  icCurveSegTableMinIntervals.  Nodes are placed uniformly between the
+ *  segment end points, or for segments that do not include negative values
+ *  at evenly spaced float bit patterns so that each octave of the input
+ *  (e.g. HDR luminance ranges) receives the same number of nodes.  The
+ *  segment is left to direct evaluation if neither spacing meets the
+ *  tolerance with icCurveSegTableMaxIntervals intervals.
+ * 
+ * Args: 
+ *  table = table with fStart, fEnd and pSeg set up
+ *  fTolerance = largest error allowed at the sample points
+ *  fErr = receives the largest error measured for the table built
+ * 
+ * Return: 
+ *  true if a table was built
+ ******************************************************************************/
+static bool icBuildCurveSegTable(icCurveSegTable &table, icFloatNumber fTolerance, icFloatNumber &fErr)
+{
+  if (!icCurveSegIsFinite(table.fStart) || !icCurveSegIsFinite(table.fEnd) || !(table.fStart<table.fEnd))
+    return false;
+
+  bool bLogSpacing = table.fStart>=0 && sizeof(icFloatNumber)==sizeof(icUInt32Number);
+  icUInt32Number nShift = 23 - 4;  //Log spacing starts at 16 nodes per octave
+  icUInt32Number nStartBits = icCurveSegFloatBits(table.fStart);
+  icUInt32Number nEndBits = icCurveSegFloatBits(table.fEnd);
+  icUInt32Number nIntervals;
+
+  for (nIntervals=icCurveSegTableMinIntervals; nIntervals<=icCurveSegTableMaxIntervals; nIntervals*=2) {
+    table.bLog = false;
+    table.nIntervals = nIntervals;
+    table.fScale = (icFloatNumber)(nIntervals / ((icFloat64Number)table.fEnd - table.fStart));
+    if (icFillCurveSegTable(table, fTolerance, fErr))
+      return true;
+
+    //Try the densest log spacing that fits in the same number of intervals
+    while (bLogSpacing && nShift) {
+      icUInt32Number nMask = (1u<<nShift)-1;
+      icUInt32Number nBase = nStartBits & ~nMask;
+      icUInt32Number nLogIntervals = ((nEndBits - nBase) + nMask) >> nShift;
+
+      if (nLogIntervals>nIntervals)
+        break;
+
+      table.bLog = true;
+      table.nIntervals = nLogIntervals ? nLogIntervals : 1;
+      table.nBase = nBase;
+      table.nShift = nShift;
+      table.fScale = (icFloatNumber)(1.0 / (icFloat64Number)(1u<<nShift));
+      nShift--;
+
+      if (icFillCurveSegTable(table, fTolerance, fErr))
+        return true;
+    }
+  }
+
+  table.bLog = false;
+  table.nIntervals = 0;
+
+  return false;
+}
+
 /**
  ******************************************************************************
  * Name: CIccSegmentedCurve::CIccSegmentedCurve
@@ -1599,6 +1861,11 @@ CIccSegmentedCurve::CIccSegmentedCurve()
   m_nReserved1 = 0;
   m_nReserved2 = 0;
 
+  m_fTableTolerance = 0;
+  m_fTableError = 0;
+  m_nTables = 0;
+  m_pTables = NULL;
+
 }
 
 
@@ -1623,6 +1890,11 @@ CIccSegmentedCurve::CIccSegmentedCurve(const CIccSegmentedCurve &curve)
   }
   m_nReserved1 = curve.m_nReserved1;
   m_nReserved2 = curve.m_nReserved2;
+
+  m_fTableTolerance = curve.m_fTableTolerance;
+  m_fTableError = 0;
+  m_nTables = 0;
+  m_pTables = NULL;
 }
 
 
@@ -1648,6 +1920,8 @@ CIccSegmentedCurve &CIccSegmentedCurve::operator=(const CIccSegmentedCurve &curv
   m_nReserved1 = curve.m_nReserved1;
   m_nReserved2 = curve.m_nReserved2;
 
+  m_fTableTolerance = curve.m_fTableTolerance;
+
   return (*this);
 }
 
@@ -1705,7 +1979,7 @@ bool CIccSegmentedCurve::Read(icUInt32Number size, CIccIO *pIO)
 {
   icCurveElemSignature sig;
 
-  icUInt32Number startPos = pIO->Tell();
+  icInt64Number startPos = pIO->Tell();
   
   icUInt32Number headerSize = sizeof(icCurveElemSignature) + 
     sizeof(icUInt32Number) + 
@@ -1738,7 +2012,7 @@ bool CIccSegmentedCurve::Read(icUInt32Number size, CIccIO *pIO)
 
   Reset();
 
-  icUInt32Number pos = pIO->Tell();
+  icInt64Number pos = pIO->Tell();
   icCurveSegSignature segSig;
   CIccCurveSegment *pSeg;
 
@@ -1776,7 +2050,7 @@ bool CIccSegmentedCurve::Read(icUInt32Number size, CIccIO *pIO)
         free(breakpoints);
         return false;
       }
-      if (pIO->Seek(pos, icSeekSet)!=(icInt32Number)pos)
+      if (pIO->Seek(pos, icSeekSet)!=(icInt64Number)pos)
         return false;;
 
       if (!i)
@@ -1872,6 +2146,8 @@ void CIccSegmentedCurve::Reset()
 {
   CIccCurveSegmentList::iterator i;
 
+  FreeTables();
+
   for (i=m_list->begin(); i!=m_list->end(); i++) {
     delete (*i);
   }
@@ -1879,6 +2155,50 @@ void CIccSegmentedCurve::Reset()
 }
 
 
+/**
+ ******************************************************************************
+ * Name: CIccSegmentedCurve::FreeTables
+ * 
+ * Purpose: 
+ *  Releases the segment evaluation data built by Begin()
+ ******************************************************************************/
+void CIccSegmentedCurve::FreeTables()
+{
+  if (m_pTables) {
+    icUInt32Number i;
+
+    for (i=0; i<m_nTables; i++) {
+      if (m_pTables[i].pValues)
+        free(m_pTables[i].pValues);
+    }
+    free(m_pTables);
+    m_pTables = NULL;
+  }
+  m_nTables = 0;
+  m_fTableError = 0;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccSegmentedCurve::GetTableBytes
+ * 
+ * Purpose: 
+ *  Returns the memory used by lookup tables built by Begin()
+ ******************************************************************************/
+icUInt32Number CIccSegmentedCurve::GetTableBytes() const
+{
+  icUInt32Number i, nBytes = 0;
+
+  for (i=0; i<m_nTables; i++) {
+    if (m_pTables[i].pValues)
+      nBytes += (m_pTables[i].nIntervals+1) * sizeof(icFloatNumber);
+  }
+
+  return nBytes;
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccSegmentedCurve::Insert
@@ -1932,6 +2252,27 @@ bool CIccSegmentedCurve::Begin()
     pLast = *i;
   }
 
+  FreeTables();
+
+  m_pTables = (icCurveSegTable*)calloc(m_list->size(), sizeof(icCurveSegTable));
+  if (!m_pTables)
+    return false;
+
+  for (i=m_list->begin(); i!=m_list->end(); i++) {
+    icCurveSegTable &table = m_pTables[m_nTables++];
+    icFloatNumber fScale, fOffset, fErr;
+
+    table.fStart = (*i)->StartPoint();
+    table.fEnd = (*i)->EndPoint();
+    table.pSeg = *i;
+
+    //Only formula segments benefit.  Sampled segments already interpolate linearly.
+    if (m_fTableTolerance>0 && (*i)->GetType()==icSigFormulaCurveSeg && !(*i)->IsAffine(fScale, fOffset)) {
+      if (icBuildCurveSegTable(table, m_fTableTolerance, fErr) && fErr>m_fTableError)
+        m_fTableError = fErr;
+    }
+  }
+
   return true;
 }
 
@@ -1948,6 +2289,17 @@ bool CIccSegmentedCurve::Begin()
  ******************************************************************************/
 icFloatNumber CIccSegmentedCurve::Apply(icFloatNumber v) const
 {
+  if (m_pTables) {
+    const icCurveSegTable *pTable = m_pTables;
+    icUInt32Number n;
+
+    for (n=m_nTables; n; n--, pTable++) {
+      if (v <= pTable->fEnd)
+        return icCurveSegTableApply(pTable, v);
+    }
+    return v;
+  }
+
  CIccCurveSegmentList::iterator i;
 
   for (i=m_list->begin(); i!=m_list->end(); i++) {
@@ -1957,6 +2309,96 @@ icFloatNumber CIccSegmentedCurve::Apply(icFloatNumber v) const
   return v;
 }
 
+
+/**
+ ******************************************************************************
+ * Name: CIccSegmentedCurve::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the curve to an array of values
+ * 
+ * Args: 
+ *  pDst = destination values
+ *  pSrc = source values (may be the same as pDst)
+ *  nCount = number of values to apply
+ *  nDstStride = number of samples between destination values
+ *  nSrcStride = number of samples between source values
+ ******************************************************************************/
+void CIccSegmentedCurve::ApplyN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nCount,
+                                icUInt32Number nDstStride/*=1*/, icUInt32Number nSrcStride/*=1*/) const
+{
+  if (!m_pTables) {
+    CIccCurveSetCurve::ApplyN(pDst, pSrc, nCount, nDstStride, nSrcStride);
+    return;
+  }
+
+  const icCurveSegTable *pTable;
+  icFloatNumber v;
+  icUInt32Number n;
+
+  //A single tabulated segment covering the source values is the common case
+  if (m_nTables==1 && m_pTables->pValues) {
+    pTable = m_pTables;
+    for (; nCount; nCount--, pDst+=nDstStride, pSrc+=nSrcStride) {
+      v = *pSrc;
+      *pDst = v <= pTable->fEnd ? icCurveSegTableApply(pTable, v) : v;
+    }
+    return;
+  }
+
+  for (; nCount; nCount--, pDst+=nDstStride, pSrc+=nSrcStride) {
+    v = *pSrc;
+    for (n=m_nTables, pTable=m_pTables; n; n--, pTable++) {
+      if (v <= pTable->fEnd) {
+        v = icCurveSegTableApply(pTable, v);
+        break;
+      }
+    }
+    *pDst = v;
+  }
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccSegmentedCurve::IsAffine
+ * 
+ * Purpose: 
+ *  Determines whether all segments of the curve share the same linear mapping
+ * 
+ * Args: 
+ *  fScale = receives the slope of the mapping
+ *  fOffset = receives the offset of the mapping
+ * 
+ * Return: 
+ *  true if the curve evaluates as v*fScale + fOffset for all input values
+ ******************************************************************************/
+bool CIccSegmentedCurve::IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const
+{
+  if (!m_list || m_list->empty())
+    return false;
+
+  CIccCurveSegmentList::const_iterator i;
+  icFloatNumber s, o;
+
+  for (i=m_list->begin(); i!=m_list->end(); i++) {
+    if (!(*i)->IsAffine(s, o))
+      return false;
+
+    if (i==m_list->begin()) {
+      fScale = s;
+      fOffset = o;
+    }
+    else if (s!=fScale || o!=fOffset)
+      return false;
+  }
+
+  //Values past the last segment are passed through by Apply()
+  if (m_list->back()->EndPoint()!=icMaxFloat32Number && (fScale!=1.0 || fOffset!=0.0))
+    return false;
+
+  return true;
+}
+
 /**
  ******************************************************************************
  * Name: CIccSegmentedCurve::Validate
@@ -2017,6 +2459,29 @@ CIccCurveSetCurve* CIccCurveSetCurve::Create(icCurveElemSignature sig)
   }
 }
 
+
+/**
+ ******************************************************************************
+ * Name: CIccCurveSetCurve::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the curve to an array of values by calling Apply() for each value
+ * 
+ * Args: 
+ *  pDst = destination values
+ *  pSrc = source values (may be the same as pDst)
+ *  nCount = number of values to apply
+ *  nDstStride = number of samples between destination values
+ *  nSrcStride = number of samples between source values
+ ******************************************************************************/
+void CIccCurveSetCurve::ApplyN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nCount,
+                               icUInt32Number nDstStride/*=1*/, icUInt32Number nSrcStride/*=1*/) const
+{
+  for (; nCount; nCount--, pDst+=nDstStride, pSrc+=nSrcStride) {
+    *pDst = Apply(*pSrc);
+  }
+}
+
 /**
  ******************************************************************************
  * Name: CIccMpeCurveSet::CIccMpeCurveSet
@@ -2030,6 +2495,7 @@ CIccCurveSetCurve* CIccCurveSetCurve::Create(icCurveElemSignature sig)
 CIccMpeCurveSet::CIccMpeCurveSet(int nSize/*=0*/)
 {
   m_nReserved = 0;
+  m_fTableTolerance = 0;
   if (nSize) {
     m_nInputChannels = m_nOutputChannels = nSize;
     m_curve = (icCurveSetCurvePtr*)calloc(nSize, sizeof(icCurveSetCurvePtr));
@@ -2057,6 +2523,7 @@ typedef std::map<icCurveSetCurvePtr, icCurveSetCurvePtr> icCurveMap;
 CIccMpeCurveSet::CIccMpeCurveSet(const CIccMpeCurveSet &curveSet)
 {
   m_nReserved = curveSet.m_nReserved;
+  m_fTableTolerance = curveSet.m_fTableTolerance;
 
   if (curveSet.m_nInputChannels) {
     int i;
@@ -2097,6 +2564,7 @@ CIccMpeCurveSet::CIccMpeCurveSet(const CIccMpeCurveSet &curveSet)
 CIccMpeCurveSet &CIccMpeCurveSet::operator=(const CIccMpeCurveSet &curveSet)
 {
   m_nReserved = m_nReserved;
+  m_fTableTolerance = curveSet.m_fTableTolerance;
 
   if (m_curve) {
     free(m_curve);
@@ -2280,7 +2748,7 @@ bool CIccMpeCurveSet::Read(icUInt32Number size, CIccIO *pIO)
 {
   icElemTypeSignature sig;
 
-  icUInt32Number startPos = pIO->Tell();
+  icInt64Number startPos = pIO->Tell();
   
   icUInt32Number headerSize = sizeof(icTagTypeSignature) + 
     sizeof(icUInt32Number) + 
@@ -2339,7 +2807,7 @@ bool CIccMpeCurveSet::Read(icUInt32Number size, CIccIO *pIO)
         }
 
         pos = startPos + m_position[i].offset;
-        if (pIO->Seek(pos, icSeekSet)!=(icInt32Number)pos) {
+        if (pIO->Seek(pos, icSeekSet)!=(icInt64Number)pos) {
           return false;
         }
         
@@ -2352,7 +2820,7 @@ bool CIccMpeCurveSet::Read(icUInt32Number size, CIccIO *pIO)
           return false;
         }
 
-        if (pIO->Seek(pos, icSeekSet)!=(icInt32Number)pos) {
+        if (pIO->Seek(pos, icSeekSet)!=(icInt64Number)pos) {
           return false;
         }
       
@@ -2388,7 +2856,7 @@ bool CIccMpeCurveSet::Write(CIccIO *pIO)
   if (!pIO)
     return false;
 
-  icUInt32Number elemStart = pIO->Tell();
+  icInt64Number elemStart = pIO->Tell();
 
   if (!pIO->Write32(&sig))
     return false;
@@ -2405,11 +2873,11 @@ bool CIccMpeCurveSet::Write(CIccIO *pIO)
   if (m_curve && m_nInputChannels) {
     int i;
     icCurvePtrMap map;
-    icUInt32Number start, end;
+    icInt64Number start, end;
     icUInt32Number zeros[2] = { 0, 0};
     icPositionNumber position;
 
-    icUInt32Number startTable = pIO->Tell();
+    icInt64Number startTable = pIO->Tell();
 
     //First write empty position table
     for (i=0; i<m_nInputChannels; i++) {
@@ -2466,7 +2934,20 @@ bool CIccMpeCurveSet::Begin(icElemInterp nInterp, CIccTagMultiProcessElement *pM
 
   int i;
   for (i=0; i<m_nInputChannels; i++) {
-    if (!m_curve[i] || !m_curve[i]->Begin())
+    if (!m_curve[i])
+      return false;
+
+    //A tolerance set on the curve set, or else on the tag, overrides the curve's own
+    if (m_curve[i]->GetType()==icSigSegmentedCurve) {
+      icFloatNumber fTolerance = m_fTableTolerance;
+      if (fTolerance<=0 && pMPE)
+        fTolerance = pMPE->GetTableTolerance();
+
+      if (fTolerance>0)
+        ((CIccSegmentedCurve*)m_curve[i])->SetTableTolerance(fTolerance);
+    }
+
+    if (!m_curve[i]->Begin())
       return false;
   }
 
@@ -2491,6 +2972,28 @@ void CIccMpeCurveSet::Apply(CIccApplyMpe *pApply, icFloatNumber *pDestPixel, con
   }
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccMpeCurveSet::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the curve set to a block of pixels one channel at a time so that
+ *  each curve processes all of the pixels in a single call.
+ * 
+ * Args: 
+ *  pApply = element apply data
+ *  pDestPixels = destination pixels
+ *  pSrcPixels = source pixels
+ *  nPixels = number of pixels
+ ******************************************************************************/
+void CIccMpeCurveSet::ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  int i;
+  for (i=0; i<m_nInputChannels; i++) {
+    m_curve[i]->ApplyN(pDestPixels+i, pSrcPixels+i, nPixels, m_nInputChannels, m_nInputChannels);
+  }
+}
+
 /**
  ******************************************************************************
  * Name: CIccMpeCurveSet::Validate
@@ -2695,7 +3198,7 @@ bool CIccMpeTintArray::Read(icUInt32Number size, CIccIO *pIO)
 
   icElemTypeSignature sig;
 
-  icUInt32Number startPos = pIO->Tell();
+  icInt64Number startPos = pIO->Tell();
   
   icUInt32Number headerSize = sizeof(icElemTypeSignature) + 
     sizeof(icUInt32Number) + 
@@ -2729,7 +3232,7 @@ bool CIccMpeTintArray::Read(icUInt32Number size, CIccIO *pIO)
   m_nInputChannels = nInputChannels;
   m_nOutputChannels = nOutputChannels;
 
-  icUInt32Number arrayPos = pIO->Tell();
+  icInt64Number arrayPos = pIO->Tell();
 
   icTagTypeSignature tagType;
   if (!pIO->Read32(&tagType))
@@ -3524,19 +4027,10 @@ bool CIccMpeCLUT::Read(icUInt32Number size, CIccIO *pIO)
 
   m_pCLUT->SetClipFunc(NoClip);
 
-  m_pCLUT->Init(gridPoints);
-
-  icFloatNumber *pData = m_pCLUT->GetData(0);
-
-  if (!pData)
+  if (!m_pCLUT->Init(gridPoints))
     return false;
 
-  icInt32Number nPoints = m_pCLUT->NumPoints()*m_nOutputChannels;
-
-  if (pIO->ReadFloat32Float(pData,nPoints)!= nPoints)
-    return false;
-  
-  return true;
+  return m_pCLUT->ReadTypedData(pIO, icValueTypeFloat32);
 }
 
 /**
@@ -3578,10 +4072,7 @@ bool CIccMpeCLUT::Write(CIccIO *pIO)
     if (pIO->Write8(gridPoints, 16)!=16)
       return false;
 
-    icFloatNumber *pData = m_pCLUT->GetData(0);
-    icInt32Number nPoints = m_pCLUT->NumPoints()*m_nOutputChannels;
-
-    if (pIO->WriteFloat32Float(pData, nPoints) != nPoints) 
+    if (!m_pCLUT->WriteTypedData(pIO, icValueTypeFloat32))
       return false;
   }
 
@@ -3634,6 +4125,62 @@ bool CIccMpeCLUT::Begin(icElemInterp nInterp, CIccTagMultiProcessElement *pMPE)
   return true;
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccApplyMpeCLUT::CIccApplyMpeCLUT
+ * 
+ * Purpose: Constructor (takes ownership of pApplyCLUT)
+ * 
+ * Args: 
+ *  pElem = CLUT element being applied,
+ *  pApplyCLUT = CLUT interpolation scratch storage (may be NULL)
+ ******************************************************************************/
+CIccApplyMpeCLUT::CIccApplyMpeCLUT(CIccMultiProcessElement *pElem, CIccApplyCLUT *pApplyCLUT) : CIccApplyMpe(pElem)
+{
+  m_pApplyCLUT = pApplyCLUT;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccApplyMpeCLUT::~CIccApplyMpeCLUT
+ * 
+ * Purpose: Destructor
+ ******************************************************************************/
+CIccApplyMpeCLUT::~CIccApplyMpeCLUT()
+{
+  if (m_pApplyCLUT)
+    delete m_pApplyCLUT;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccMpeCLUT::GetNewApply
+ * 
+ * Purpose: Creates apply time data holding the scratch storage used for
+ *  N-dimensional interpolation.
+ * 
+ * Args: 
+ *  pApplyTag = apply object of the containing MPE tag
+ * 
+ * Return: 
+ *  New CIccApplyMpeCLUT object or NULL on failure
+ ******************************************************************************/
+CIccApplyMpe *CIccMpeCLUT::GetNewApply(CIccApplyTagMpe *pApplyTag)
+{
+  CIccApplyCLUT *pApplyCLUT = NULL;
+
+  if (m_pCLUT && m_interpType==icNdInterp) {
+    pApplyCLUT = m_pCLUT->GetNewApply();
+    if (!pApplyCLUT)
+      return NULL;
+  }
+
+  return new CIccApplyMpeCLUT(this, pApplyCLUT);
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccMpeCLUT::Apply
@@ -3671,7 +4218,8 @@ void CIccMpeCLUT::Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixel, const icF
     pCLUT->Interp6d(dstPixel, srcPixel);
     break;
   case icNdInterp:
-    pCLUT->InterpND(dstPixel, srcPixel);
+    //Note: pApply should be a CIccApplyMpeCLUT type here
+    pCLUT->InterpND(dstPixel, srcPixel, pApply ? ((CIccApplyMpeCLUT*)pApply)->GetApplyCLUT() : NULL);
     break;
   }
 }
@@ -3842,40 +4390,10 @@ bool CIccMpeExtCLUT::Read(icUInt32Number size, CIccIO *pIO)
 
   m_pCLUT->SetClipFunc(NoClip);
 
-  m_pCLUT->Init(gridPoints);
-
-  icFloatNumber *pData = m_pCLUT->GetData(0);
-
-  if (!pData)
+  if (!m_pCLUT->Init(gridPoints))
     return false;
 
-  icInt32Number nPoints = m_pCLUT->NumPoints()*m_nOutputChannels;
-
-  switch(m_storageType) {
-    case icValueTypeUInt8:
-      if (pIO->ReadUInt8Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeUInt16:
-      if (pIO->ReadUInt16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat16:
-      if (pIO->ReadFloat16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat32:
-      if (pIO->ReadFloat32Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    default:
-      return false;
-  }
-  return true;
+  return m_pCLUT->ReadTypedData(pIO, m_storageType);
 }
 
 /**
@@ -3923,33 +4441,8 @@ bool CIccMpeExtCLUT::Write(CIccIO *pIO)
     if (pIO->Write8(gridPoints, 16)!=16)
       return false;
 
-    icFloatNumber *pData = m_pCLUT->GetData(0);
-    icInt32Number nPoints = m_pCLUT->NumPoints()*m_nOutputChannels;
-
-    switch(m_storageType) {
-    case icValueTypeUInt8:
-      if (pIO->WriteUInt8Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeUInt16:
-      if (pIO->WriteUInt16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat16:
-      if (pIO->WriteFloat16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat32:
-      if (pIO->WriteFloat32Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    default:
+    if (!m_pCLUT->WriteTypedData(pIO, m_storageType))
       return false;
-    }
   }
 
   return true;
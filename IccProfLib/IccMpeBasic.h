@@ -110,6 +110,9 @@ public:
   virtual bool Begin(CIccCurveSegment *pPrevSeg) = 0;
   virtual icFloatNumber Apply(icFloatNumber v) const =0;
 
+  ///Returns true if segment evaluates as v*fScale + fOffset
+  virtual bool IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const { return false; }
+
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const = 0;
 
   icFloatNumber StartPoint() { return m_startPoint; }
@@ -150,6 +153,7 @@ public:
 
   virtual bool Begin(CIccCurveSegment *pPrevSeg);
   virtual icFloatNumber Apply(icFloatNumber v) const;
+  virtual bool IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const;
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const;
 
 protected:
@@ -282,6 +286,12 @@ public:
 
   virtual bool Begin() = 0;
   virtual icFloatNumber Apply(icFloatNumber v) const = 0; 
+  virtual void ApplyN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nCount,
+                      icUInt32Number nDstStride=1, icUInt32Number nSrcStride=1) const;
+
+  ///Returns true if curve evaluates as v*fScale + fOffset over its entire domain
+  virtual bool IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const { return false; }
+
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const = 0;
 
 protected:
@@ -289,6 +299,29 @@ protected:
 
 typedef std::list<CIccCurveSegment*> CIccCurveSegmentList;
 
+/**
+****************************************************************************
+* Structure: icCurveSegTable
+* 
+* Purpose: Evaluation data built by CIccSegmentedCurve::Begin() for one segment.
+*  Values are linearly interpolated from nodes placed uniformly between the
+*  segment end points, or at evenly spaced float bit patterns (log-like
+*  spacing) when bLog is set.  pValues is NULL if the segment is evaluated
+*  directly.
+*****************************************************************************
+*/
+typedef struct {
+  icFloatNumber fStart;
+  icFloatNumber fEnd;
+  CIccCurveSegment *pSeg;
+  icFloatNumber *pValues;   //nIntervals+1 node values
+  icUInt32Number nIntervals;
+  bool bLog;
+  icFloatNumber fScale;     //uniform: intervals per input unit, log: 1/2^nShift
+  icUInt32Number nBase;     //log: bit pattern of first node
+  icUInt32Number nShift;    //log: bit pattern step between nodes is 2^nShift
+} icCurveSegTable;
+
 /**
 ****************************************************************************
 * Class: CIccSegmentedCurve
@@ -318,12 +351,31 @@ public:
 
   virtual bool Begin();
   virtual icFloatNumber Apply(icFloatNumber v) const;
+  virtual void ApplyN(icFloatNumber *pDst, const icFloatNumber *pSrc, icUInt32Number nCount,
+                      icUInt32Number nDstStride=1, icUInt32Number nSrcStride=1) const;
+  virtual bool IsAffine(icFloatNumber &fScale, icFloatNumber &fOffset) const;
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const;
 
+  ///Largest error measured at interval quarter points allowed when Begin() replaces formula segments with lookup tables (0 = exact evaluation)
+  void SetTableTolerance(icFloatNumber fMaxError) { m_fTableTolerance = fMaxError; }
+  icFloatNumber GetTableTolerance() const { return m_fTableTolerance; }
+
+  ///Largest interpolation error measured by Begin() at the table sample points (not a bound between them)
+  icFloatNumber GetTableError() const { return m_fTableError; }
+  icUInt32Number GetTableBytes() const;
+
 protected:
+  void FreeTables();
+
   CIccCurveSegmentList *m_list;
   icUInt32Number m_nReserved1;
   icUInt32Number m_nReserved2;
+
+  //Segment evaluation data built by Begin()
+  icFloatNumber m_fTableTolerance;
+  icFloatNumber m_fTableError;
+  icUInt32Number m_nTables;
+  icCurveSegTable *m_pTables;
 };
 
 typedef CIccCurveSetCurve* icCurveSetCurvePtr;
@@ -347,6 +399,7 @@ public:
   bool SetSize(int nNewSize);
 
   bool SetCurve(int nIndex, icCurveSetCurvePtr newCurve);
+  icCurveSetCurvePtr GetCurve(int nIndex) const { return (m_curve && nIndex>=0 && nIndex<m_nInputChannels) ? m_curve[nIndex] : NULL; }
 
   virtual icElemTypeSignature GetType() const { return icSigCurveSetElemType; }
   virtual const icChar *GetClassName() const { return "CIccMpeCurveSet"; }
@@ -358,13 +411,20 @@ public:
 
   virtual bool Begin(icElemInterp nInterp, CIccTagMultiProcessElement *pMPE);
   virtual void Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixel, const icFloatNumber *srcPixel) const;
+  virtual void ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const;
 
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const;
 
+  ///Measured error allowed when Begin() tabulates this element's segmented curves (0 = use the tag's tolerance or the curve's own)
+  void SetTableTolerance(icFloatNumber fMaxError) { m_fTableTolerance = fMaxError; }
+  icFloatNumber GetTableTolerance() const { return m_fTableTolerance; }
+
 protected:
   icCurveSetCurvePtr *m_curve;
 
   icPositionNumber *m_position;
+
+  icFloatNumber m_fTableTolerance;
 };
 
 
@@ -497,6 +557,7 @@ public:
   virtual bool Write(CIccIO *pIO);
 
   virtual bool Begin(icElemInterp nInterp, CIccTagMultiProcessElement *pMPE);
+  virtual CIccApplyMpe *GetNewApply(CIccApplyTagMpe *pApplyTag);
   virtual void Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixel, const icFloatNumber *srcPixel) const;
 
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const;
@@ -509,6 +570,28 @@ protected:
   icCLUTElemType m_interpType;
 };
 
+/****************************************************************************
+* Class: CIccApplyMpeCLUT
+* 
+* Purpose: Apply time data for CLUT based elements.  Holds the interpolation
+*  scratch storage so that a CLUT element can be applied from multiple threads.
+*****************************************************************************
+*/
+class CIccApplyMpeCLUT : public CIccApplyMpe
+{
+public:
+  CIccApplyMpeCLUT(CIccMultiProcessElement *pElem, CIccApplyCLUT *pApplyCLUT);
+  virtual ~CIccApplyMpeCLUT();
+
+  virtual icElemTypeSignature GetType() const { return icSigCLutElemType; }
+  virtual const icChar *GetClassName() const { return "CIccApplyMpeCLUT"; }
+
+  CIccApplyCLUT *GetApplyCLUT() { return m_pApplyCLUT; }
+
+protected:
+  CIccApplyCLUT *m_pApplyCLUT;
+};
+
 /****************************************************************************
 * Class: CIccMpeExtCLUT
 * 
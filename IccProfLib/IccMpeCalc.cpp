@@ -88,7 +88,7 @@
 #define OsPopArg(X) { \
   if (!os.pStack->size()) \
     return false; \
-  X = *(os.pStack->rbegin()); \
+  X = os.pStack->back(); \
   os.pStack->pop_back(); \
 }
 
@@ -105,13 +105,15 @@
 
 #define OsPushArg(X) { \
   icFloatNumber V = (X); \
-  os.pStack->push_back(V); \
+  if (!os.pStack->push_back(V)) \
+    return false; \
 }
 
 #define OsPushArgs(X, N) { \
   size_t ss = os.pStack->size(); \
   icUInt32Number nv=(N); \
-  os.pStack->resize(ss+nv); \
+  if (!os.pStack->resize(ss+nv)) \
+    return false; \
   icFloatNumber *sv = &(*os.pStack)[ss]; \
   memcpy(sv, (X), nv*sizeof(icFloatNumber)); \
 }
@@ -126,7 +128,8 @@
 
 #define OsExtendArgs(N) { \
   size_t ss = os.pStack->size(); \
-  os.pStack->resize(ss+(N)); \
+  if (!os.pStack->resize(ss+(N))) \
+    return false; \
 }
 
 
@@ -163,7 +166,8 @@ public:
       n=op->extra;
     }
     size_t ss = os.pStack->size();
-    os.pStack->resize(ss+n);
+    if (!os.pStack->resize(ss+n))
+      return false;
     icFloatNumber *s = &(*os.pStack)[ss];
     for (j=0; j<n; j++) {
       s[j] = op[j].data.num;
@@ -297,8 +301,8 @@ public:
 
     int ns = ss + (int)nDst - (int)nSrc;
 
-    if (ns != ss)
-      os.pStack->resize(ns);
+    if (ns != ss && !os.pStack->resize(ns))
+      return false;
 
     s = &(*os.pStack)[ns - nDst];
     memcpy(s, d, nDst*sizeof(icFloatNumber));
@@ -2624,6 +2628,59 @@ void CIccFuncTokenizer::SkipComment()
   }
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccCalcStack::reserve
+ * 
+ * Purpose: Makes sure that the stack can hold nSize values without
+ *  reallocation.
+ * 
+ * Args: 
+ *  nSize - number of values to reserve
+ * 
+ * Return: 
+ *  true if storage is available, false if allocation failed
+ ******************************************************************************/
+bool CIccCalcStack::reserve(size_t nSize)
+{
+  if (nSize<=m_nAlloc)
+    return true;
+
+  icFloatNumber *pData = (icFloatNumber*)realloc(m_pData, nSize*sizeof(icFloatNumber));
+  if (!pData)
+    return false;
+
+  m_pData = pData;
+  m_nAlloc = nSize;
+
+  return true;
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccCalcStack::resize
+ * 
+ * Purpose: Sets the number of values on the stack.  Values added by growing
+ *  the stack are zero like those of std::vector.
+ * 
+ * Args: 
+ *  nSize - new number of values
+ * 
+ * Return: 
+ *  true if successful, false if allocation failed
+ ******************************************************************************/
+bool CIccCalcStack::resize(size_t nSize)
+{
+  if (nSize>m_nAlloc && !reserve(nSize>m_nAlloc*2 ? nSize : m_nAlloc*2))
+    return false;
+
+  if (nSize>m_nSize)
+    memset(m_pData+m_nSize, 0, (nSize-m_nSize)*sizeof(icFloatNumber));
+  m_nSize = nSize;
+
+  return true;
+}
+
 /**
  ******************************************************************************
  * Name: CIccCalculatorFunc::CIccCalculatorFunc
@@ -2641,6 +2698,11 @@ CIccCalculatorFunc::CIccCalculatorFunc(CIccMpeCalculator *pCalc)
 
   m_nOps = 0;
   m_Op = NULL;
+
+  m_nMaxStack = 0;
+  m_nInstr = 0;
+  m_Instr = NULL;
+  m_Const = NULL;
 }
 
 /**
@@ -2667,6 +2729,12 @@ CIccCalculatorFunc::CIccCalculatorFunc(const CIccCalculatorFunc &func)
   }
   else
     m_Op = NULL;
+
+  //Programs refer to m_Op so they are regenerated by Begin()
+  m_nMaxStack = 0;
+  m_nInstr = 0;
+  m_Instr = NULL;
+  m_Const = NULL;
 }
 
 /**
@@ -2688,6 +2756,9 @@ CIccCalculatorFunc &CIccCalculatorFunc::operator=(const CIccCalculatorFunc &func
   if (m_Op)
     free(m_Op);
 
+  FreeProgram();
+  m_nMaxStack = 0;
+
   m_nOps = func.m_nOps;
 
   if (m_nOps) {
@@ -2715,6 +2786,8 @@ CIccCalculatorFunc::~CIccCalculatorFunc()
   if (m_Op) {
     free(m_Op);
   }
+
+  FreeProgram();
 }
 
 void CIccCalculatorFunc::InsertBlanks(std::string &sDescription, int nBlanks)
@@ -3368,6 +3441,14 @@ bool CIccCalculatorFunc::Begin(const CIccMpeCalculator *pChannelCalc, CIccTagMul
   if (DoesStackUnderflowOverflow(sReport)!=icFuncParseNoError)
     return false;
 
+  int nMaxStack = 0;
+  CheckUnderflowOverflow(m_Op, m_nOps, 0, false, sReport, &nMaxStack);
+  m_nMaxStack = (icUInt32Number)nMaxStack;
+
+  FreeProgram();
+  if (!pChannelCalc->UseInterpreter())
+    Compile();
+
   return true;
 }
 
@@ -3602,6 +3683,700 @@ bool CIccCalculatorFunc::ApplySequence(CIccApplyMpeCalculator *pApply, icUInt32N
   return true;
 }
 
+/**
+****************************************************************************
+* Structure: SIccCalcCompiler
+* 
+* Purpose: Working state used by CIccCalculatorFunc::Compile
+*****************************************************************************
+*/
+struct SIccCalcCompiler
+{
+  std::vector<SIccCalcInstr> instr;
+  CIccFloatVector consts;
+
+  //Constant values on top of the stack that have not been emitted yet
+  CIccCalcStack known;
+  CIccCalcStack fold;
+  CIccFloatVector scratch;
+
+  //Temp channels that are read by a tget operation
+  std::vector<bool> tempRead;
+};
+
+static bool icCalcOpCanFold(icSigCalcOp sig)
+{
+  switch(sig) {
+    case icSigPiOp:
+    case icSigPosInfinityOp:
+    case icSigNegInfinityOp:
+    case icSigNotaNumberOp:
+    case icSigCopyOp:
+    case icSigRotateLeftOp:
+    case icSigRotateRightOp:
+    case icSigPositionDupOp:
+    case icSigFlipOp:
+    case icSigPopOp:
+    case icSigTransposeOp:
+    case icSigSumOp:
+    case icSigProductOp:
+    case icSigMinimumOp:
+    case icSigMaximumOp:
+    case icSigAndOp:
+    case icSigOrOp:
+    case icSigNegOp:
+    case icSigAddOp:
+    case icSigSubtractOp:
+    case icSigMultiplyOp:
+    case icSigDivideOp:
+    case icSigModulusOp:
+    case icSigPowOp:
+    case icSigGammaOp:
+    case icSigScalarAddOp:
+    case icSigScalarSubtractOp:
+    case icSigScalarMultiplyOp:
+    case icSigScalarDivideOp:
+    case icSigSquareOp:
+    case icSigSquareRootOp:
+    case icSigCubeOp:
+    case icSigCubeRootOp:
+    case icSigSignOp:
+    case icSigAbsoluteValOp:
+    case icSigFloorOp:
+    case icSigCeilingOp:
+    case icSigTruncateOp:
+    case icSigRoundOp:
+    case icSigExpOp:
+    case icSigLogrithmOp:
+    case icSigNaturalLogOp:
+    case icSigSineOp:
+    case icSigCosineOp:
+    case icSigTangentOp:
+    case icSigArcSineOp:
+    case icSigArcCosineOp:
+    case icSigArcTangentOp:
+    case icSigArcTan2Op:
+    case icSigCartesianToPolarOp:
+    case icSigPolarToCartesianOp:
+    case icSigReanNumberOp:
+    case icSigLessThanOp:
+    case icSigLessThanEqualOp:
+    case icSigEqualOp:
+    case icSigNearOp:
+    case icSigGreaterThanEqualOp:
+    case icSigGreaterThanOp:
+    case icSigNotOp:
+    case icSigToLabOp:
+    case icSigFromLabOp:
+    case icSigVectorMinimumOp:
+    case icSigVectorMaximumOp:
+    case icSigVectorAndOp:
+    case icSigVectorOrOp:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+static icUInt32Number icCalcEmit(SIccCalcCompiler &comp, icCalcInstrCode code, icUInt32Number nPos=0, icUInt32Number nArg=0, SIccCalcOp *op=NULL)
+{
+  SIccCalcInstr instr;
+
+  instr.code = code;
+  instr.nPos = nPos;
+  instr.nArg = nArg;
+  instr.op = op;
+  instr.nResume = icCalcNoResume;
+  comp.instr.push_back(instr);
+
+  return (icUInt32Number)(comp.instr.size()-1);
+}
+
+static void icCalcFlushConst(SIccCalcCompiler &comp)
+{
+  icUInt32Number n = (icUInt32Number)comp.known.size();
+
+  if (n) {
+    icUInt32Number nPos = (icUInt32Number)comp.consts.size();
+    comp.consts.insert(comp.consts.end(), comp.known.data(), comp.known.data()+n);
+    icCalcEmit(comp, icCalcInstrData, nPos, n);
+    comp.known.clear();
+  }
+}
+
+static bool icCalcFoldOp(SIccCalcCompiler &comp, CIccMpeCalculator *pCalc, SIccCalcOp *op)
+{
+  size_t n = comp.known.size();
+
+  if (!icCalcOpCanFold(op->sig) || !op->def || op->ArgsUsed(pCalc)>n)
+    return false;
+
+  //Evaluate with the same operator used at apply time using only the known values
+  comp.fold.resize(n);
+  if (n)
+    memcpy(comp.fold.data(), comp.known.data(), n*sizeof(icFloatNumber));
+
+  SIccOpState os;
+  os.pApply = NULL;
+  os.pStack = &comp.fold;
+  os.pScratch = &comp.scratch;
+  os.temp = NULL;
+  os.pixel = NULL;
+  os.output = NULL;
+  os.idx = 0;
+  os.nOps = 1;
+
+  if (!op->def->Exec(op, os))
+    return false;
+
+  n = comp.fold.size();
+  comp.known.resize(n);
+  if (n)
+    memcpy(comp.known.data(), comp.fold.data(), n*sizeof(icFloatNumber));
+
+  return true;
+}
+
+static bool icCalcTempIsRead(SIccCalcCompiler &comp, icUInt32Number nStart, icUInt32Number nCount)
+{
+  icUInt32Number i;
+
+  for (i=nStart; i<nStart+nCount && i<comp.tempRead.size(); i++) {
+    if (comp.tempRead[i])
+      return true;
+  }
+  return false;
+}
+
+/**
+******************************************************************************
+* Name: CIccCalculatorFunc::CompileSequence
+* 
+* Purpose: Appends the program for an operation sequence.  Control flow is
+*  lowered to jumps, runs of constants are pushed by a single instruction,
+*  operations on known constants are evaluated and temp stores that are
+*  never read are removed.  Structure that ApplySequence would reject at
+*  apply time causes compilation to fail so that the interpreter is used.
+* 
+* Args: 
+*  comp - compiler state
+*  nOps - number of operations in sequence
+*  ops - sequence of operations
+* 
+* Return: 
+*  true if sequence was compiled, false if it must be interpreted.
+******************************************************************************/
+bool CIccCalculatorFunc::CompileSequence(SIccCalcCompiler &comp, icUInt32Number nOps, SIccCalcOp *ops)
+{
+  icUInt32Number i, j;
+  SIccCalcOp *op;
+
+  //Instruction ranges of the select cases in this sequence.  Like ApplySequence a
+  //failure within a case ends this sequence rather than the whole function.
+  std::vector<icUInt32Number> cases;
+
+  for (i=0; i<nOps; i++) {
+    op = &ops[i];
+
+    switch(op->sig) {
+      case icSigIfOp:
+        {
+          icUInt32Number nIfSize = op->data.size;
+          bool bHasElse = (i+1<nOps && ops[i+1].sig==icSigElseOp);
+          icUInt32Number nElseSize = bHasElse ? ops[i+1].data.size : 0;
+          icUInt32Number nIfPos = bHasElse ? i+2 : i+1;
+
+          if (bHasElse) {
+            if (i+2 + nIfSize >= nOps || i+2 + nIfSize + nElseSize > nOps)
+              return false;
+          }
+          else if (i + nIfSize >= nOps)
+            return false;
+
+          if (comp.known.size()) {
+            icFloatNumber a1 = comp.known.back();
+            comp.known.pop_back();
+
+            if (a1>=0.5) {
+              if (!CompileSequence(comp, nIfSize, &ops[nIfPos]))
+                return false;
+            }
+            else if (bHasElse) {
+              if (!CompileSequence(comp, nElseSize, &ops[nIfPos + nIfSize]))
+                return false;
+            }
+          }
+          else {
+            icUInt32Number nIf = icCalcEmit(comp, icCalcInstrIf);
+
+            if (!CompileSequence(comp, nIfSize, &ops[nIfPos]))
+              return false;
+            icCalcFlushConst(comp);
+
+            if (bHasElse && nElseSize) {
+              icUInt32Number nJump = icCalcEmit(comp, icCalcInstrJump);
+
+              comp.instr[nIf].nPos = (icUInt32Number)comp.instr.size();
+              if (!CompileSequence(comp, nElseSize, &ops[nIfPos + nIfSize]))
+                return false;
+              icCalcFlushConst(comp);
+
+              comp.instr[nJump].nPos = (icUInt32Number)comp.instr.size();
+            }
+            else {
+              comp.instr[nIf].nPos = (icUInt32Number)comp.instr.size();
+            }
+          }
+
+          i = nIfPos-1 + nIfSize + nElseSize;
+        }
+        break;
+
+      case icSigSelectOp:
+        {
+          icUInt32Number nCases = op->extra;
+          if (!nCases)
+            return false;
+
+          icUInt32Number nDefOff = i+1 + nCases;
+          if (nDefOff >= nOps)
+            return false;
+
+          bool bHasDefault = ops[nDefOff].sig==icSigDefaultOp;
+          icUInt32Number nLast = bHasDefault ? nDefOff : i + nCases;
+          icUInt32Number nEnd = i+1 + ops[nLast].extra + ops[nLast].data.size;
+
+          if (nEnd > nOps)
+            return false;
+
+          for (j=i+1; j<=nLast; j++) {
+            if (i+1 + ops[j].extra + ops[j].data.size > nOps)
+              return false;
+          }
+
+          if (comp.known.size()) {
+            icFloatNumber a1 = comp.known.back();
+            comp.known.pop_back();
+
+            icInt32Number nSel = (a1 >= 0.0) ? (icInt32Number)(a1+0.5f) : (icInt32Number)(a1-0.5f);
+
+            if (nSel<0 || (icUInt32Number)nSel>=nCases) {
+              if (bHasDefault) {
+                if (i+1 + ops[nDefOff].extra >= nOps)
+                  return false;
+                cases.push_back((icUInt32Number)comp.instr.size());
+                if (!CompileSequence(comp, ops[nDefOff].data.size, &ops[i+1 + ops[nDefOff].extra]))
+                  return false;
+                cases.push_back((icUInt32Number)comp.instr.size());
+              }
+            }
+            else {
+              icUInt32Number nOff = i+1 + nSel;
+              cases.push_back((icUInt32Number)comp.instr.size());
+              if (!CompileSequence(comp, ops[nOff].data.size, &ops[i+1 + ops[nOff].extra]))
+                return false;
+              cases.push_back((icUInt32Number)comp.instr.size());
+            }
+          }
+          else {
+            std::vector<icUInt32Number> jumps;
+            icUInt32Number nSelect = icCalcEmit(comp, icCalcInstrSelect, 0, nCases);
+
+            for (j=0; j<=nCases; j++)
+              icCalcEmit(comp, icCalcInstrCase);
+
+            cases.push_back((icUInt32Number)comp.instr.size());
+
+            for (j=0; j<nCases; j++) {
+              icUInt32Number nOff = i+1 + j;
+              comp.instr[nSelect+1+j].nPos = (icUInt32Number)comp.instr.size();
+              if (!CompileSequence(comp, ops[nOff].data.size, &ops[i+1 + ops[nOff].extra]))
+                return false;
+              icCalcFlushConst(comp);
+              jumps.push_back(icCalcEmit(comp, icCalcInstrJump));
+            }
+
+            comp.instr[nSelect+1+nCases].nPos = (icUInt32Number)comp.instr.size();
+            if (bHasDefault) {
+              if (i+1 + ops[nDefOff].extra >= nOps)
+                return false;
+              if (!CompileSequence(comp, ops[nDefOff].data.size, &ops[i+1 + ops[nDefOff].extra]))
+                return false;
+              icCalcFlushConst(comp);
+            }
+
+            for (j=0; j<(icUInt32Number)jumps.size(); j++)
+              comp.instr[jumps[j]].nPos = (icUInt32Number)comp.instr.size();
+
+            cases.push_back((icUInt32Number)comp.instr.size());
+          }
+
+          i = nEnd-1;
+        }
+        break;
+
+      case icSigDataOp:
+        comp.known.push_back(op->data.num);
+        break;
+
+      case icSigInputChanOp:
+        icCalcFlushConst(comp);
+        icCalcEmit(comp, icCalcInstrInput, op->data.select.v1, op->data.select.v2+1, op);
+        break;
+
+      case icSigOutputChanOp:
+        icCalcFlushConst(comp);
+        icCalcEmit(comp, icCalcInstrOutput, op->data.select.v1, op->data.select.v2+1, op);
+        break;
+
+      case icSigTempGetChanOp:
+        icCalcFlushConst(comp);
+        icCalcEmit(comp, icCalcInstrTempGet, op->data.select.v1, op->data.select.v2+1, op);
+        break;
+
+      case icSigTempPutChanOp:
+        if (icCalcTempIsRead(comp, op->data.select.v1, op->data.select.v2+1)) {
+          icCalcFlushConst(comp);
+          icCalcEmit(comp, icCalcInstrTempPut, op->data.select.v1, op->data.select.v2+1, op);
+        }
+        else if (comp.known.size() >= (size_t)op->data.select.v2+1) {
+          comp.known.resize(comp.known.size() - (op->data.select.v2+1));
+        }
+        else {
+          icCalcFlushConst(comp);
+          icCalcEmit(comp, icCalcInstrPop, 0, op->data.select.v2+1, op);
+        }
+        break;
+
+      case icSigTempSaveChanOp:
+        if (icCalcTempIsRead(comp, op->data.select.v1, op->data.select.v2+1)) {
+          icCalcFlushConst(comp);
+          icCalcEmit(comp, icCalcInstrTempSave, op->data.select.v1, op->data.select.v2+1, op);
+        }
+        break;
+
+      default:
+        if (icCalcFoldOp(comp, m_pCalc, op))
+          break;
+
+        icCalcFlushConst(comp);
+
+        switch(op->sig) {
+          case icSigPopOp:
+            icCalcEmit(comp, icCalcInstrPop, 0, op->data.select.v1+1, op);
+            break;
+          case icSigAddOp:
+            icCalcEmit(comp, icCalcInstrAdd, 0, op->data.select.v1+1, op);
+            break;
+          case icSigSubtractOp:
+            icCalcEmit(comp, icCalcInstrSubtract, 0, op->data.select.v1+1, op);
+            break;
+          case icSigMultiplyOp:
+            icCalcEmit(comp, icCalcInstrMultiply, 0, op->data.select.v1+1, op);
+            break;
+          case icSigDivideOp:
+            icCalcEmit(comp, icCalcInstrDivide, 0, op->data.select.v1+1, op);
+            break;
+          case icSigScalarAddOp:
+            icCalcEmit(comp, icCalcInstrScalarAdd, 0, op->data.select.v1+1, op);
+            break;
+          case icSigScalarSubtractOp:
+            icCalcEmit(comp, icCalcInstrScalarSubtract, 0, op->data.select.v1+1, op);
+            break;
+          case icSigScalarMultiplyOp:
+            icCalcEmit(comp, icCalcInstrScalarMultiply, 0, op->data.select.v1+1, op);
+            break;
+          case icSigScalarDivideOp:
+            icCalcEmit(comp, icCalcInstrScalarDivide, 0, op->data.select.v1+1, op);
+            break;
+          default:
+            if (!op->def)
+              return false;
+            icCalcEmit(comp, icCalcInstrExec, 0, 0, op);
+            break;
+        }
+        break;
+    }
+  }
+
+  //Failures in cases continue at the end of this sequence.  Cases of nested
+  //sequences already have their own resume position.
+  if (cases.size()) {
+    icCalcFlushConst(comp);
+
+    icUInt32Number nResume = (icUInt32Number)comp.instr.size();
+    for (i=0; i<(icUInt32Number)cases.size(); i+=2) {
+      for (j=cases[i]; j<cases[i+1]; j++) {
+        if (comp.instr[j].nResume==icCalcNoResume)
+          comp.instr[j].nResume = nResume;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+******************************************************************************
+* Name: CIccCalculatorFunc::Compile
+* 
+* Purpose: Generates the program used by Apply.  If the operation list
+*  cannot be compiled no program is generated and Apply interprets it.
+******************************************************************************/
+void CIccCalculatorFunc::Compile()
+{
+  SIccCalcCompiler comp;
+  icUInt32Number i, j;
+
+  for (i=0; i<m_nOps; i++) {
+    if (m_Op[i].sig==icSigTempGetChanOp) {
+      icUInt32Number nLast = m_Op[i].data.select.v1 + m_Op[i].data.select.v2;
+      if (comp.tempRead.size()<=nLast)
+        comp.tempRead.resize(nLast+1, false);
+      for (j=m_Op[i].data.select.v1; j<=nLast; j++)
+        comp.tempRead[j] = true;
+    }
+  }
+
+  if (!comp.known.reserve(m_nMaxStack+1))
+    return;
+
+  if (!CompileSequence(comp, m_nOps, m_Op))
+    return;
+  icCalcFlushConst(comp);
+
+  m_nInstr = (icUInt32Number)comp.instr.size();
+  m_Instr = (SIccCalcInstr*)malloc((m_nInstr ? m_nInstr : 1)*sizeof(SIccCalcInstr));
+  m_Const = (icFloatNumber*)malloc((comp.consts.size() ? comp.consts.size() : 1)*sizeof(icFloatNumber));
+
+  if (!m_Instr || !m_Const) {
+    FreeProgram();
+    return;
+  }
+
+  if (m_nInstr)
+    memcpy(m_Instr, &comp.instr[0], m_nInstr*sizeof(SIccCalcInstr));
+  if (comp.consts.size())
+    memcpy(m_Const, &comp.consts[0], comp.consts.size()*sizeof(icFloatNumber));
+}
+
+/**
+******************************************************************************
+* Name: CIccCalculatorFunc::FreeProgram
+* 
+* Purpose: Releases the program generated by Compile
+******************************************************************************/
+void CIccCalculatorFunc::FreeProgram()
+{
+  if (m_Instr) {
+    free(m_Instr);
+    m_Instr = NULL;
+  }
+  if (m_Const) {
+    free(m_Const);
+    m_Const = NULL;
+  }
+  m_nInstr = 0;
+}
+
+/**
+******************************************************************************
+* Name: CIccCalculatorFunc::ApplyProgram
+* 
+* Purpose: Runs the program generated by Compile.  Operators that have no
+*  instruction of their own are run through the same IIccOpDef objects used
+*  by ApplySequence so results are identical to the interpreter.  As in
+*  ApplySequence a failure within a select case continues after the
+*  sequence that holds the select.
+* 
+* Args: 
+*  pApply - apply object with input, output, temp and stack storage
+* 
+* Return: 
+*  true if successful, false if an operation outside of a select case failed.
+******************************************************************************/
+bool CIccCalculatorFunc::ApplyProgram(CIccApplyMpeCalculator *pApply) const
+{
+  SIccOpState os;
+  icUInt32Number pc = 0;
+
+  os.pApply = pApply;
+  os.pStack = pApply->GetStack();
+  os.pScratch = pApply->GetScratch();
+  os.temp = pApply->GetTemp();
+  os.pixel = pApply->GetInput();
+  os.output = pApply->GetOutput();
+  os.idx = 0;
+  os.nOps = 0;
+
+  os.pStack->clear();
+
+  while (!RunProgram(os, pc)) {
+    //pc is past the failed instruction
+    icUInt32Number nResume = m_Instr[pc-1].nResume;
+
+    if (nResume==icCalcNoResume)
+      return false;
+
+    pc = nResume;
+  }
+
+  return true;
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccCalculatorFunc::RunProgram
+ * 
+ * Purpose: Runs program instructions starting at pc until the end of the
+ *  program or until an instruction fails.
+ * 
+ * Args: 
+ *  os - operation state
+ *  pc - instruction to start with, set past the failed instruction on failure
+ * 
+ * Return: 
+ *  true if the end of the program was reached, false if an instruction failed
+ ******************************************************************************/
+bool CIccCalculatorFunc::RunProgram(SIccOpState &os, icUInt32Number &pc) const
+{
+  const SIccCalcInstr *ip;
+  icUInt32Number j, n;
+  size_t ss;
+  icFloatNumber *s, a1;
+
+  while (pc<m_nInstr) {
+    ip = &m_Instr[pc++];
+
+    switch(ip->code) {
+      case icCalcInstrExec:
+        if (!ip->op->def->Exec(ip->op, os))
+          return false;
+        break;
+
+      case icCalcInstrData:
+        OsPushArgs(&m_Const[ip->nPos], ip->nArg);
+        break;
+
+      case icCalcInstrInput:
+        OsPushArgs(&os.pixel[ip->nPos], ip->nArg);
+        break;
+
+      case icCalcInstrOutput:
+        OsPopArgs(&os.output[ip->nPos], ip->nArg);
+        break;
+
+      case icCalcInstrTempGet:
+        OsPushArgs(&os.temp[ip->nPos], ip->nArg);
+        break;
+
+      case icCalcInstrTempPut:
+        OsPopArgs(&os.temp[ip->nPos], ip->nArg);
+        break;
+
+      case icCalcInstrTempSave:
+        ss = os.pStack->size();
+        if (ip->nArg>ss)
+          return false;
+        memcpy(&os.temp[ip->nPos], &(*os.pStack)[ss-ip->nArg], ip->nArg*sizeof(icFloatNumber));
+        break;
+
+      case icCalcInstrPop:
+        OsShrinkArgs(ip->nArg);
+        break;
+
+      case icCalcInstrAdd:
+      case icCalcInstrSubtract:
+      case icCalcInstrMultiply:
+      case icCalcInstrDivide:
+        n = ip->nArg;
+        ss = os.pStack->size();
+        if (n*2>ss)
+          return false;
+        s = &(*os.pStack)[ss-n*2];
+        switch(ip->code) {
+          case icCalcInstrAdd:
+            for (j=0; j<n; j++)
+              s[j] += s[j+n];
+            break;
+          case icCalcInstrSubtract:
+            for (j=0; j<n; j++)
+              s[j] -= s[j+n];
+            break;
+          case icCalcInstrMultiply:
+            for (j=0; j<n; j++)
+              s[j] *= s[j+n];
+            break;
+          default:
+            for (j=0; j<n; j++)
+              s[j] /= s[j+n];
+            break;
+        }
+        os.pStack->resize(ss-n);
+        break;
+
+      case icCalcInstrScalarAdd:
+      case icCalcInstrScalarSubtract:
+      case icCalcInstrScalarMultiply:
+      case icCalcInstrScalarDivide:
+        n = ip->nArg;
+        ss = os.pStack->size();
+        if (n+1>ss)
+          return false;
+        s = &(*os.pStack)[ss-n-1];
+        a1 = s[n];
+        switch(ip->code) {
+          case icCalcInstrScalarAdd:
+            for (j=0; j<n; j++)
+              s[j] = s[j] + a1;
+            break;
+          case icCalcInstrScalarSubtract:
+            for (j=0; j<n; j++)
+              s[j] = s[j] - a1;
+            break;
+          case icCalcInstrScalarMultiply:
+            for (j=0; j<n; j++)
+              s[j] = s[j] * a1;
+            break;
+          default:
+            for (j=0; j<n; j++)
+              s[j] = s[j] / a1;
+            break;
+        }
+        os.pStack->resize(ss-1);
+        break;
+
+      case icCalcInstrIf:
+        OsPopArg(a1);
+        if (!(a1>=0.5))
+          pc = ip->nPos;
+        break;
+
+      case icCalcInstrJump:
+        pc = ip->nPos;
+        break;
+
+      case icCalcInstrSelect:
+        {
+          OsPopArg(a1);
+          icInt32Number nSel = (a1 >= 0.0) ? (icInt32Number)(a1+0.5f) : (icInt32Number)(a1-0.5f);
+
+          if (nSel<0 || (icUInt32Number)nSel>=ip->nArg)
+            nSel = ip->nArg;
+
+          pc = m_Instr[pc + nSel].nPos;
+        }
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
 /**
  ******************************************************************************
  * Name: CIccCalculatorFunc::Apply
@@ -3614,11 +4389,17 @@ bool CIccCalculatorFunc::ApplySequence(CIccApplyMpeCalculator *pApply, icUInt32N
  ******************************************************************************/
 bool CIccCalculatorFunc::Apply(CIccApplyMpeCalculator *pApply) const
 {
-  CIccFloatVector *pStack = pApply->GetStack();
+  bool rv;
 
-  pStack->clear();
+  if (m_Instr) {
+    rv = ApplyProgram(pApply);
+  }
+  else {
+    pApply->GetStack()->clear();
+    rv = ApplySequence(pApply, m_nOps, m_Op);
+  }
 
-  if (!ApplySequence(pApply, m_nOps, m_Op)) {
+  if (!rv) {
     icFloatNumber *pOut = pApply->GetOutput();
     icUInt32Number i;
     for (i=0; i<m_pCalc->NumOutputChannels(); i++)
@@ -3827,7 +4608,7 @@ bool CIccCalculatorFunc::SequenceNeedTempReset(SIccCalcOp *op, icUInt32Number nO
 * 
 * Return: 
 ******************************************************************************/
-int CIccCalculatorFunc::CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nOps, int nArgs, bool bCheckUnderflow, std::string &sReport) const
+int CIccCalculatorFunc::CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nOps, int nArgs, bool bCheckUnderflow, std::string &sReport, int *pMaxArgs/*=NULL*/) const
 {
   icUInt32Number i, p;
   int n, nIfArgs, nElseArgs, nSelArgs, nCaseArgs;
@@ -3869,17 +4650,20 @@ int CIccCalculatorFunc::CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nO
     if (nArgs>icMaxDataStackSize)
       return -2;
 
+    if (pMaxArgs && nArgs>*pMaxArgs)
+      *pMaxArgs = nArgs;
+
     if (op[i].sig == icSigIfOp) {
       int incI = 0;
       if (i+1<nOps && op[i+1].sig==icSigElseOp) {
         p = i+2; 
-        nIfArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i].data.size), nArgs, bCheckUnderflow, sReport);
+        nIfArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i].data.size), nArgs, bCheckUnderflow, sReport, pMaxArgs);
         if (nIfArgs<0)
           return -1;
         incI =op[i].data.size;
 
         p = i+2+op[i].data.size;
-        nElseArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i+1].data.size), nArgs, bCheckUnderflow, sReport);
+        nElseArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i+1].data.size), nArgs, bCheckUnderflow, sReport, pMaxArgs);
         if (nElseArgs<0)
           return -1;
         incI += op[i+1].data.size;
@@ -3890,7 +4674,7 @@ int CIccCalculatorFunc::CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nO
       }
       else {
         p = i+1; 
-        nIfArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i].data.size), nArgs, bCheckUnderflow, sReport);
+        nIfArgs = CheckUnderflowOverflow(&op[p], icIntMin(nOps-p, op[i].data.size), nArgs, bCheckUnderflow, sReport, pMaxArgs);
         if (nIfArgs<0)
           return -1;
         nArgs = bCheckUnderflow ? icIntMin(nArgs, nIfArgs) : icIntMax(nArgs, nIfArgs);
@@ -3924,7 +4708,7 @@ int CIccCalculatorFunc::CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nO
         if (pos>=nOps)
           return -1;
 
-        nCaseArgs = CheckUnderflowOverflow(&op[pos], icIntMin(nOps-pos, len), nArgs, bCheckUnderflow, sReport);
+        nCaseArgs = CheckUnderflowOverflow(&op[pos], icIntMin(nOps-pos, len), nArgs, bCheckUnderflow, sReport, pMaxArgs);
         if (nCaseArgs<0)
           return -1;
 
@@ -4085,6 +4869,7 @@ CIccMpeCalculator::CIccMpeCalculator(icUInt16Number nInputChannels /*=0*/,
   m_nOutputChannels = nOutputChannels;
   m_nTempChannels = 0;
   m_bNeedTempReset = true;
+  m_bUseInterpreter = false;
   m_nSubElem = 0;
   m_SubElem = NULL;
   m_calcFunc = NULL;
@@ -4108,18 +4893,25 @@ CIccMpeCalculator::CIccMpeCalculator(const CIccMpeCalculator &channelGen)
   m_nInputChannels = channelGen.m_nInputChannels;
   m_nOutputChannels = channelGen.m_nOutputChannels;
 
+  m_nTempChannels = channelGen.m_nTempChannels;
+  m_bNeedTempReset = channelGen.m_bNeedTempReset;
+  m_bUseInterpreter = channelGen.m_bUseInterpreter;
+
   m_pCmmEnvVarLookup = channelGen.m_pCmmEnvVarLookup;
 
   icCalculatorFuncPtr ptr = channelGen.m_calcFunc;
 
-  if (ptr)
+  if (ptr) {
     m_calcFunc = ptr->NewCopy();
+    m_calcFunc->m_pCalc = this;
+  }
   else
     m_calcFunc = NULL;
 
   if (channelGen.m_nSubElem) {
     icUInt32Number i;
 
+    m_nSubElem = channelGen.m_nSubElem;
     m_SubElem = (CIccMultiProcessElement**)calloc(m_nSubElem, sizeof(CIccMultiProcessElement*));
     if (m_SubElem) {
       for (i=0; i<m_nSubElem; i++) {
@@ -4158,18 +4950,25 @@ CIccMpeCalculator &CIccMpeCalculator::operator=(const CIccMpeCalculator &channel
   m_nInputChannels= channelGen.m_nInputChannels;
   m_nOutputChannels = channelGen.m_nOutputChannels;
 
+  m_nTempChannels = channelGen.m_nTempChannels;
+  m_bNeedTempReset = channelGen.m_bNeedTempReset;
+  m_bUseInterpreter = channelGen.m_bUseInterpreter;
+
   m_pCmmEnvVarLookup = channelGen.m_pCmmEnvVarLookup;
 
   icCalculatorFuncPtr ptr = channelGen.m_calcFunc;
 
-  if (ptr)
+  if (ptr) {
     m_calcFunc = ptr->NewCopy();
+    m_calcFunc->m_pCalc = this;
+  }
   else
     m_calcFunc = NULL;
 
   if (channelGen.m_nSubElem) {
     icUInt32Number i;
 
+    m_nSubElem = channelGen.m_nSubElem;
     m_SubElem = (CIccMultiProcessElement**)calloc(m_nSubElem, sizeof(CIccMultiProcessElement*));
     if (m_SubElem) {
       for (i=0; i<m_nSubElem; i++) {
@@ -4349,7 +5148,7 @@ bool CIccMpeCalculator::Read(icUInt32Number size, CIccIO *pIO)
 {
   icElemTypeSignature sig;
 
-  icUInt32Number startPos = pIO->Tell();
+  icInt64Number startPos = pIO->Tell();
   
   icUInt32Number headerSize = sizeof(icTagTypeSignature) + 
     sizeof(icUInt32Number) + 
@@ -4476,7 +5275,7 @@ bool CIccMpeCalculator::Write(CIccIO *pIO)
   if (!pIO)
     return false;
 
-  icUInt32Number elemStart = pIO->Tell();
+  icInt64Number elemStart = pIO->Tell();
 
   if (!pIO->Write32(&sig))
     return false;
@@ -4499,7 +5298,7 @@ bool CIccMpeCalculator::Write(CIccIO *pIO)
   if (!posvals) {
     return false;
   }
-  icUInt32Number nPositionStart = pIO->Tell();
+  icInt64Number nPositionStart = pIO->Tell();
 
   icUInt32Number n, np = nPos * (sizeof(icPositionNumber)/sizeof(icUInt32Number));
   if (pIO->Write32(posvals, np)!=np) {
@@ -4533,7 +5332,7 @@ bool CIccMpeCalculator::Write(CIccIO *pIO)
       pos++;
     }
   }
-  icUInt32Number endPos = pIO->Tell();
+  icInt64Number endPos = pIO->Tell();
 
   pIO->Seek(nPositionStart, icSeekSet);
 
@@ -4617,7 +5416,11 @@ CIccApplyMpe *CIccMpeCalculator::GetNewApply(CIccApplyTagMpe *pApplyTag)
   if (m_nTempChannels) {
     pApply->m_temp = (icFloatNumber*)malloc(m_nTempChannels*sizeof(icFloatNumber));
   }
-  pApply->m_stack = new CIccFloatVector;
+  pApply->m_stack = new CIccCalcStack;
+  if (m_calcFunc && !pApply->m_stack->reserve(m_calcFunc->GetMaxStack())) {
+    delete pApply;
+    return NULL;
+  }
   pApply->m_scratch = new CIccFloatVector;
   pApply->m_scratch->resize(50);
   pApply->m_pCmmEnvVarLookup = m_pCmmEnvVarLookup;
@@ -259,6 +259,46 @@ typedef std::list<CIccCalcOpListPtr> CIccCalcOpListPtrList;
 
 typedef std::vector<icFloatNumber> CIccFloatVector;
 
+/**
+****************************************************************************
+* Class: CIccCalcStack
+* 
+* Purpose: Flat data stack used by calculator functions.  The member names
+*  follow std::vector so that operator implementations can use either, but
+*  resize() and push_back() return false when storage cannot be allocated.
+*  Storage is reserved to the maximum stack depth of the function when the
+*  apply object is created so per operation pushes and pops only move the top.
+*****************************************************************************
+*/
+class ICCPROFLIB_API CIccCalcStack
+{
+public:
+  CIccCalcStack() { m_pData = NULL; m_nSize = 0; m_nAlloc = 0; }
+  ~CIccCalcStack() { if (m_pData) free(m_pData); }
+
+  bool reserve(size_t nSize);
+
+  size_t size() const { return m_nSize; }
+  void clear() { m_nSize = 0; }
+  bool resize(size_t nSize);
+
+  bool push_back(icFloatNumber v) { if (m_nSize>=m_nAlloc && !reserve(m_nAlloc ? m_nAlloc*2 : 16)) return false; m_pData[m_nSize++] = v; return true; }
+  void pop_back() { m_nSize--; }
+  icFloatNumber &back() { return m_pData[m_nSize-1]; }
+
+  icFloatNumber &operator[](size_t nIndex) { return m_pData[nIndex]; }
+  icFloatNumber *data() { return m_pData; }
+
+protected:
+  icFloatNumber *m_pData;
+  size_t m_nSize;
+  size_t m_nAlloc;
+
+private:
+  CIccCalcStack(const CIccCalcStack &stack);
+  CIccCalcStack &operator=(const CIccCalcStack &stack);
+};
+
 /**
 ****************************************************************************
 * Structure: SIccOpState
@@ -269,7 +309,7 @@ typedef std::vector<icFloatNumber> CIccFloatVector;
 struct SIccOpState
 {
   CIccApplyMpeCalculator *pApply;
-  CIccFloatVector *pStack;
+  CIccCalcStack *pStack;
   CIccFloatVector *pScratch;
   icFloatNumber *temp;
   const icFloatNumber *pixel;
@@ -302,6 +342,52 @@ public:
 };
 
 
+/**
+****************************************************************************
+* Structure: SIccCalcInstr
+* 
+* Purpose: Instruction of a calculator function program.  Programs are
+*  generated by CIccCalculatorFunc::Begin from the operation list with
+*  control flow lowered to jumps, so they can be run without recursion.
+*****************************************************************************
+*/
+typedef enum {
+  icCalcInstrExec = 0,      //Run op->def->Exec()
+  icCalcInstrData,          //Push nArg constants starting at constant nPos
+  icCalcInstrInput,         //Push nArg input channels starting at nPos
+  icCalcInstrOutput,        //Pop nArg output channels starting at nPos
+  icCalcInstrTempGet,       //Push nArg temp channels starting at nPos
+  icCalcInstrTempPut,       //Pop nArg temp channels starting at nPos
+  icCalcInstrTempSave,      //Copy top nArg values to temp channels starting at nPos
+  icCalcInstrPop,           //Pop nArg values
+  icCalcInstrAdd,           //Vector operations of nArg values
+  icCalcInstrSubtract,
+  icCalcInstrMultiply,
+  icCalcInstrDivide,
+  icCalcInstrScalarAdd,     //Scalar operations on nArg values
+  icCalcInstrScalarSubtract,
+  icCalcInstrScalarMultiply,
+  icCalcInstrScalarDivide,
+  icCalcInstrIf,            //Pop condition and jump to nPos if false
+  icCalcInstrJump,          //Jump to nPos
+  icCalcInstrSelect,        //Pop selector and jump using the nArg+1 case entries that follow
+  icCalcInstrCase,          //Jump table entry of a select with target nPos
+} icCalcInstrCode;
+
+//Instructions outside of any select case have no resume position and a failure ends the program
+#define icCalcNoResume ((icUInt32Number)-1)
+
+struct SIccCalcInstr
+{
+  icCalcInstrCode code;
+  icUInt32Number nPos;
+  icUInt32Number nArg;
+  SIccCalcOp *op;
+  icUInt32Number nResume;   //Where to continue if the instruction fails within a select case
+};
+
+struct SIccCalcCompiler;
+
 typedef enum {
   icFuncParseNoError=0,
   icFuncParseSyntaxError,
@@ -359,6 +445,7 @@ class CIccApplyMpeCalculator;
 */
 class ICCPROFLIB_API CIccCalculatorFunc
 {
+  friend class CIccMpeCalculator;
 public:
   CIccCalculatorFunc(CIccMpeCalculator *pCalc);
   CIccCalculatorFunc(const CIccCalculatorFunc &ICF);
@@ -383,7 +470,7 @@ public:
   icFuncParseStatus SetFunction(CIccCalcOpList &opList, std::string &sReport);
 
   icUInt32Number GetMaxTemp() const;
-  int CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nOps, int nArgs, bool bCheckUnderflow, std::string &sReport) const;
+  int CheckUnderflowOverflow(SIccCalcOp *op, icUInt32Number nOps, int nArgs, bool bCheckUnderflow, std::string &sReport, int *pMaxArgs=NULL) const;
   icFuncParseStatus DoesStackUnderflowOverflow(std::string &sReport) const;
   bool HasValidOperations(std::string &sReport) const;
   bool DoesOverflowInput(icUInt16Number nInputChannels) const;
@@ -391,6 +478,9 @@ public:
   bool NeedTempReset(icUInt8Number *tempUsage, icUInt32Number nMaxTemp);
   bool SetOpDefs();
 
+  icUInt32Number GetMaxStack() const { return m_nMaxStack; }
+  bool IsCompiled() const { return m_Instr!=NULL; }
+
 protected:
 
   bool InitSelectOps();
@@ -403,6 +493,12 @@ protected:
                         icUInt32Number nOps, SIccCalcOp *op, int nBlanks);
   bool ApplySequence(CIccApplyMpeCalculator *pApply, icUInt32Number nOps, SIccCalcOp *op) const;
 
+  void Compile();
+  bool CompileSequence(SIccCalcCompiler &comp, icUInt32Number nOps, SIccCalcOp *op);
+  void FreeProgram();
+  bool ApplyProgram(CIccApplyMpeCalculator *pApply) const;
+  bool RunProgram(SIccOpState &os, icUInt32Number &pc) const;
+
   const char *ParseFuncDef(const char *szFuncDef, CIccCalcOpList &m_list, std::string &sReport);
 
   CIccMpeCalculator *m_pCalc;
@@ -412,6 +508,11 @@ protected:
   icUInt32Number m_nOps;
   SIccCalcOp *m_Op;
 
+  //Program generated from m_Op by Begin() (NULL when interpreting m_Op)
+  icUInt32Number m_nMaxStack;
+  icUInt32Number m_nInstr;
+  SIccCalcInstr *m_Instr;
+  icFloatNumber *m_Const;
 };
 
 typedef CIccCalculatorFunc* icCalculatorFuncPtr;
@@ -474,12 +575,17 @@ public:
   virtual bool IsLateBinding() const;
   virtual bool IsLateBindingReflectance() const;
 
+  //Select the recursive operation interpreter instead of a compiled program the next time this calculator is begun
+  void SetUseInterpreter(bool bUseInterpreter) { m_bUseInterpreter = bUseInterpreter; }
+  bool UseInterpreter() const { return m_bUseInterpreter; }
+
 protected:
 
   bool SetElem(icUInt32Number idx, CIccMultiProcessElement *pElem, icUInt32Number &count, CIccMultiProcessElement ***pArray);
 
   icUInt32Number m_nTempChannels;
   bool m_bNeedTempReset;
+  bool m_bUseInterpreter;
 
   icUInt32Number m_nSubElem;
   CIccMultiProcessElement **m_SubElem;
@@ -510,7 +616,7 @@ public:
   icFloatNumber *GetOutput() { return m_output; }
   icFloatNumber *GetTemp() { return m_temp; }
 
-  CIccFloatVector *GetStack() { return m_stack; }
+  CIccCalcStack *GetStack() { return m_stack; }
 
   CIccFloatVector *GetScratch() { return m_scratch; }
 
@@ -521,7 +627,7 @@ public:
 protected:
   CIccApplyMpeCalculator(CIccMultiProcessElement *pElem);
 
-  CIccFloatVector *m_stack;
+  CIccCalcStack *m_stack;
   CIccFloatVector *m_scratch;
 
   //Use member storage for calls between Apply and ApplySequence
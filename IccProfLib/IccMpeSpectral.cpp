@@ -664,6 +664,39 @@ void CIccMpeEmissionMatrix::Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixel,
 }
 
 
+/**
+ ******************************************************************************
+ * Name: CIccMpeEmissionMatrix::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the element to a block of pixels.  The block is reduced to XYZ as
+ *  a single matrix product and the XYZ offset is added afterwards.
+ * 
+ * Args: 
+ *  pApply = element apply data
+ *  pDestPixels = destination pixels
+ *  pSrcPixels = source pixels
+ *  nPixels = number of pixels
+ ******************************************************************************/
+void CIccMpeEmissionMatrix::ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  icUInt32Number k;
+
+  if (m_pApplyMtx) {
+    m_pApplyMtx->VectorMultN(pDestPixels, pSrcPixels, nPixels, 3, m_nInputChannels);
+
+    for (k=0; k<nPixels; k++, pDestPixels+=3) {
+      pDestPixels[0] += m_xyzOffset[0];
+      pDestPixels[1] += m_xyzOffset[1];
+      pDestPixels[2] += m_xyzOffset[2];
+    }
+  }
+  else {
+    memset(pDestPixels, 0, nPixels*3*sizeof(icFloatNumber));
+  }
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccMpeInvEmissionMatrix::Begin
@@ -1048,39 +1081,11 @@ bool CIccMpeSpectralCLUT::Read(icUInt32Number size, CIccIO *pIO)
 
   m_pCLUT->SetClipFunc(NoClip);
 
-  m_pCLUT->Init(gridPoints);
-
-  icFloatNumber *pData = m_pCLUT->GetData(0);
-
-  if (!pData)
+  if (!m_pCLUT->Init(gridPoints))
     return false;
 
-  icInt32Number nPoints = m_pCLUT->NumPoints()*(int)m_Range.steps;
-
-  switch(m_nStorageType) {
-    case icValueTypeUInt8:
-      if (pIO->ReadUInt8Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeUInt16:
-      if (pIO->ReadUInt16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat16:
-      if (pIO->ReadFloat16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat32:
-      if (pIO->ReadFloat32Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    default:
-      return false;
-  }
+  if (!m_pCLUT->ReadTypedData(pIO, m_nStorageType))
+    return false;
 
   m_pWhite = (icFloatNumber *)malloc((int)m_Range.steps*sizeof(icFloatNumber));
   if (!m_pWhite)
@@ -1169,33 +1174,8 @@ bool CIccMpeSpectralCLUT::Write(CIccIO *pIO)
     if (pIO->Write8(gridPoints, 16)!=16)
       return false;
 
-    icFloatNumber *pData = m_pCLUT->GetData(0);
-    icInt32Number nPoints = m_pCLUT->NumPoints()*(int)m_Range.steps;
-
-    switch(m_nStorageType) {
-    case icValueTypeUInt8:
-      if (pIO->WriteUInt8Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeUInt16:
-      if (pIO->WriteUInt16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat16:
-      if (pIO->WriteFloat16Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    case icValueTypeFloat32:
-      if (pIO->WriteFloat32Float(pData,nPoints)!= nPoints)
-        return false;
-      break;
-
-    default:
+    if (!m_pCLUT->WriteTypedData(pIO, m_nStorageType))
       return false;
-    }
   }
 
   if (m_pWhite) {
@@ -1231,6 +1211,33 @@ bool CIccMpeSpectralCLUT::Write(CIccIO *pIO)
   return true;
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccMpeSpectralCLUT::GetNewApply
+ * 
+ * Purpose: Creates apply time data holding the scratch storage used for
+ *  N-dimensional interpolation.
+ * 
+ * Args: 
+ *  pApplyTag = apply object of the containing MPE tag
+ * 
+ * Return: 
+ *  New CIccApplyMpeCLUT object or NULL on failure
+ ******************************************************************************/
+CIccApplyMpe *CIccMpeSpectralCLUT::GetNewApply(CIccApplyTagMpe *pApplyTag)
+{
+  CIccApplyCLUT *pApplyCLUT = NULL;
+
+  if (m_pApplyCLUT && m_interpType==icNdInterp) {
+    pApplyCLUT = m_pApplyCLUT->GetNewApply();
+    if (!pApplyCLUT)
+      return NULL;
+  }
+
+  return new CIccApplyMpeCLUT(this, pApplyCLUT);
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccMpeEmissionCLUT::Apply
@@ -1268,7 +1275,45 @@ void CIccMpeSpectralCLUT::Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixel, c
     pCLUT->Interp6d(dstPixel, srcPixel);
     break;
   case icNdInterp:
-    pCLUT->InterpND(dstPixel, srcPixel);
+    //Note: pApply should be a CIccApplyMpeCLUT type here
+    pCLUT->InterpND(dstPixel, srcPixel, pApply ? ((CIccApplyMpeCLUT*)pApply)->GetApplyCLUT() : NULL);
+    break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccMpeSpectralCLUT::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the element to a block of pixels.  The observer is folded into the
+ *  apply CLUT by Begin() so 3D and 4D blocks are interpolated straight into
+ *  the destination with the batch CLUT kernels.  Other dimensions are applied
+ *  a pixel at a time.
+ * 
+ * Args: 
+ *  pApply = element apply data
+ *  pDestPixels = destination pixels
+ *  pSrcPixels = source pixels
+ *  nPixels = number of pixels
+ ******************************************************************************/
+void CIccMpeSpectralCLUT::ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  const CIccCLUT *pCLUT = m_pApplyCLUT;
+
+  switch(m_interpType) {
+  case ic3dInterpTetra:
+    pCLUT->Interp3dTetraN(pDestPixels, pSrcPixels, nPixels, m_nOutputChannels, m_nInputChannels);
+    break;
+  case ic3dInterp:
+    pCLUT->Interp3dN(pDestPixels, pSrcPixels, nPixels, m_nOutputChannels, m_nInputChannels);
+    break;
+  case ic4dInterp:
+    pCLUT->Interp4dN(pDestPixels, pSrcPixels, nPixels, m_nOutputChannels, m_nInputChannels);
+    break;
+  default:
+    CIccMultiProcessElement::ApplyN(pApply, pDestPixels, pSrcPixels, nPixels);
     break;
   }
 }
@@ -1343,6 +1388,58 @@ icValidateStatus CIccMpeSpectralCLUT::Validate(std::string sigPath, std::string
 }
 
 
+/**
+ ******************************************************************************
+ * Name: icSpectralCLUTMultN
+ * 
+ * Purpose: Reduces every spectral grid point of a CLUT with a matrix.  The
+ *  grid is read through GetValues() in blocks so compact CLUT storage is
+ *  reduced without being expanded to floats.
+ * 
+ * Args: 
+ *  pMtx = matrix with nSteps columns to apply,
+ *  pDst = destination for nPoints vectors of nDstStride values,
+ *  pCLUT = CLUT with nSteps outputs per grid point,
+ *  nDstStride = number of values per destination vector,
+ *  nSteps = number of spectral values per grid point
+ * 
+ * Return: 
+ *  true if all grid points were reduced
+ ******************************************************************************/
+static bool icSpectralCLUTMultN(const CIccMatrixMath *pMtx, icFloatNumber *pDst, const CIccCLUT *pCLUT,
+                                icUInt16Number nDstStride, icUInt16Number nSteps)
+{
+  icUInt32Number nPoints = pCLUT->NumPoints();
+  icUInt32Number nBlock = 4096 / nSteps;
+
+  if (!nBlock)
+    nBlock = 1;
+  if (nBlock>nPoints)
+    nBlock = nPoints;
+
+  icFloatNumber *pBuf = new icFloatNumber[nBlock * nSteps];
+
+  if (!pBuf)
+    return false;
+
+  icUInt32Number i, n;
+  for (i=0; i<nPoints; i+=n, pDst+=n*nDstStride) {
+    n = nPoints - i;
+    if (n>nBlock)
+      n = nBlock;
+
+    if (!pCLUT->GetValues(pBuf, i*nSteps, n*nSteps)) {
+      delete [] pBuf;
+      return false;
+    }
+    pMtx->VectorMultN(pDst, pBuf, n, nDstStride, nSteps);
+  }
+
+  delete [] pBuf;
+  return true;
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccMpeEmissionCLUT::Begin
@@ -1410,9 +1507,11 @@ bool CIccMpeEmissionCLUT::Begin(icElemInterp nInterp, CIccTagMultiProcessElement
   m_pApplyCLUT->SetClipFunc(NoClip);
   m_pApplyCLUT->Init(m_pCLUT->GridPointArray());
 
-  icFloatNumber *pSrc = m_pCLUT->GetData(0);
   icFloatNumber *pDst = m_pApplyCLUT->GetData(0);
 
+  if (!pDst)
+    return false;
+
   icFloatNumber xyzW[3];
   icUInt32Number i;
 
@@ -1421,17 +1520,17 @@ bool CIccMpeEmissionCLUT::Begin(icElemInterp nInterp, CIccTagMultiProcessElement
   bool bUseAbsolute = (m_flags & icRelativeSpectralData)!=0;
   bool bLab = (m_flags & icLabSpectralData) != 0;
 
-  for (i=0; i<m_pCLUT->NumPoints(); i++) {
-    observer.VectorMult(pDst, pSrc);
-    if (bLab) {
-      icXYZtoLab(pDst, pDst, xyzW);
-//      icLabToPcs(pDst);
-    }
-    else {
-//      icXyzToPcs(pDst);
-    }
-    pSrc += m_Range.steps;
-    pDst += m_nOutputChannels;
+  //Reduce all grid points as one matrix product
+  icUInt32Number nPoints = m_pCLUT->NumPoints();
+  if (!icSpectralCLUTMultN(&observer, pDst, m_pCLUT, m_nOutputChannels, m_Range.steps))
+    return false;
+
+  if (bLab) {
+    icXYZtoLabN(pDst, pDst, nPoints, m_nOutputChannels, xyzW);
+//    icLabToPcs(pDst);
+  }
+  else {
+//    icXyzToPcs(pDst);
   }
 
   m_pApplyCLUT->Begin();
@@ -1532,9 +1631,11 @@ bool CIccMpeReflectanceCLUT::Begin(icElemInterp nInterp, CIccTagMultiProcessElem
   m_pApplyCLUT->SetClipFunc(NoClip);
   m_pApplyCLUT->Init(m_pCLUT->GridPointArray());
 
-  icFloatNumber *pSrc = m_pCLUT->GetData(0);
   icFloatNumber *pDst = m_pApplyCLUT->GetData(0);
 
+  if (!pDst)
+    return false;
+
   icFloatNumber xyzW[3];
 
   pApplyMtx->VectorMult(xyzW, m_pWhite);
@@ -1549,24 +1650,26 @@ bool CIccMpeReflectanceCLUT::Begin(icElemInterp nInterp, CIccTagMultiProcessElem
     xyzscale[2] = xyzi[2] / xyzW[2];
   }
 
-  for (i=0; i<(int)m_pCLUT->NumPoints(); i++) {
-    pApplyMtx->VectorMult(pDst, pSrc);
+  //Reduce all grid points as one matrix product
+  icUInt32Number nPoints = m_pCLUT->NumPoints();
+  if (!icSpectralCLUTMultN(pApplyMtx, pDst, m_pCLUT, m_nOutputChannels, m_Range.steps))
+    return false;
 
-    if (!bUseAbsolute) {
-      pDst[0] *= xyzscale[0];
-      pDst[1] *= xyzscale[1];
-      pDst[2] *= xyzscale[2];
+  if (!bUseAbsolute) {
+    icFloatNumber *pXYZ = pDst;
+    for (i=0; i<(int)nPoints; i++, pXYZ+=m_nOutputChannels) {
+      pXYZ[0] *= xyzscale[0];
+      pXYZ[1] *= xyzscale[1];
+      pXYZ[2] *= xyzscale[2];
     }
+  }
 
-    if (bLab) {
-      icXYZtoLab(pDst, pDst, xyzi);
-      //      icLabToPcs(pDst);
-    }
-    else {
-      //      icXyzToPcs(pDst);
-    }
-    pSrc += m_Range.steps;
-    pDst += m_nOutputChannels;
+  if (bLab) {
+    icXYZtoLabN(pDst, pDst, nPoints, m_nOutputChannels, xyzi);
+    //      icLabToPcs(pDst);
+  }
+  else {
+    //      icXyzToPcs(pDst);
   }
 
   if (pApplyMtx!=&observer)
@@ -1904,6 +2007,49 @@ void CIccMpeSpectralObserver::Apply(CIccApplyMpe *pApply, icFloatNumber *dstPixe
   }
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccMpeSpectralObserver::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the observer to a block of pixels.  Each run of icMpeBatchPixels
+ *  pixels is reduced to XYZ as a single matrix product and then scaled and
+ *  converted to Lab while the results are still in cache.
+ * 
+ * Args: 
+ *  pApply = element apply data
+ *  pDestPixels = destination pixels
+ *  pSrcPixels = source pixels
+ *  nPixels = number of pixels
+ ******************************************************************************/
+void CIccMpeSpectralObserver::ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  if (!m_pApplyMtx)
+    return;
+
+  bool bUseAbsolute = (m_flags & icRelativeSpectralData)!=0;
+  bool bLab = (m_flags & icLabSpectralData) != 0;
+  icUInt32Number n, k;
+
+  for (; nPixels; nPixels-=n, pDestPixels+=n*3, pSrcPixels+=n*m_nInputChannels) {
+    n = nPixels<icMpeBatchPixels ? nPixels : icMpeBatchPixels;
+
+    m_pApplyMtx->VectorMultN(pDestPixels, pSrcPixels, n, 3, m_nInputChannels);
+
+    if (!bUseAbsolute) {
+      icFloatNumber *xyz = pDestPixels;
+      for (k=0; k<n; k++, xyz+=3) {
+        xyz[0] *= m_xyzscale[0];
+        xyz[1] *= m_xyzscale[1];
+        xyz[2] *= m_xyzscale[2];
+      }
+    }
+
+    if (bLab)
+      icXYZtoLabN(pDestPixels, pDestPixels, n, 3, m_xyzw);
+  }
+}
+
 /**
  ******************************************************************************
  * Name: CIccMpeSpectralObserver::Validate
@@ -1998,8 +2144,8 @@ bool CIccMpeEmissionObserver::Begin(icElemInterp nInterp, CIccTagMultiProcessEle
   m_pApplyMtx->VectorMult(m_xyzw, m_pWhite);
 
   m_xyzscale[0] = 1.0;
-  m_xyzscale[0] = 1.0;
-  m_xyzscale[0] = 1.0;
+  m_xyzscale[1] = 1.0;
+  m_xyzscale[2] = 1.0;
 
   return true;
 }
@@ -173,6 +173,16 @@ namespace refIccMAX {
 // Uncomment below if you wish to utilize Eigen library to support matrix solving
 //#define ICC_USE_EIGEN_SOLVER
 
+// CLUT interpolation uses SSE2 or NEON when the compiler targets them.
+// Define ICC_NO_SIMD to build only the scalar code.
+#if !defined(ICC_NO_SIMD)
+  #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define ICC_USE_SSE2
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define ICC_USE_NEON
+  #endif
+#endif
+
 #ifdef USEREFICCMAXNAMESPACE
 }
 #endif
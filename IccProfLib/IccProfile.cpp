@@ -80,12 +80,137 @@
 #include "IccUtil.h"
 #include "IccMatrixMath.h"
 #include "IccMD5.h"
+#include "IccTagFactory.h"
+#include "IccMpeFactory.h"
+#include "IccStructFactory.h"
+#include "IccArrayFactory.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 #ifdef USEREFICCMAXNAMESPACE
 namespace refIccMAX {
 #endif
 
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: 
+ *  Open addressing hash table from tag signature to the first tag
+ *  directory entry with that signature.  The entries stay in the
+ *  CIccProfile's TagEntryList which keeps the directory order.
+ **************************************************************************
+ */
+class CIccTagIndex
+{
+public:
+  CIccTagIndex() { m_nEntries = 0; m_nUsed = 0; m_pLast = NULL; }
+
+  void Clear();
+  void Build(TagEntryList *pTags);
+  void Add(IccTagEntry *pEntry);
+  IccTagEntry *Find(icSignature sig) const;
+  bool IsCurrent(const TagEntryList *pTags) const;
+
+protected:
+  size_t Slot(icSignature sig) const { return (size_t)(((icUInt32Number)sig * 0x9E3779B1U) >> 16) & (m_Table.size()-1); }
+  void Insert(IccTagEntry *pEntry);
+
+  std::vector<IccTagEntry*> m_Table;
+  size_t m_nUsed;
+
+  ///Number of directory entries accounted for, including duplicates
+  size_t m_nEntries;
+  ///Last directory entry accounted for
+  IccTagEntry *m_pLast;
+};
+
+void CIccTagIndex::Clear()
+{
+  m_Table.clear();
+  m_nEntries = 0;
+  m_nUsed = 0;
+  m_pLast = NULL;
+}
+
+void CIccTagIndex::Build(TagEntryList *pTags)
+{
+  TagEntryList::iterator i;
+
+  Clear();
+  for (i=pTags->begin(); i!=pTags->end(); i++)
+    Add(&(*i));
+}
+
+void CIccTagIndex::Insert(IccTagEntry *pEntry)
+{
+  size_t n = Slot(pEntry->TagInfo.sig);
+
+  while (m_Table[n]) {
+    //The first entry with a signature wins as in a directory search
+    if (m_Table[n]->TagInfo.sig==pEntry->TagInfo.sig)
+      return;
+    n = (n+1) & (m_Table.size()-1);
+  }
+  m_Table[n] = pEntry;
+  m_nUsed++;
+}
+
+void CIccTagIndex::Add(IccTagEntry *pEntry)
+{
+  m_nEntries++;
+  m_pLast = pEntry;
+
+  //Keep the table at most half full
+  if ((m_nUsed+1)*2 > m_Table.size()) {
+    std::vector<IccTagEntry*> old;
+    size_t n, nSize = m_Table.size() ? m_Table.size()*2 : 32;
+
+    old.swap(m_Table);
+    m_Table.assign(nSize, (IccTagEntry*)NULL);
+    m_nUsed = 0;
+
+    for (n=0; n<old.size(); n++) {
+      if (old[n])
+        Insert(old[n]);
+    }
+  }
+
+  Insert(pEntry);
+}
+
+IccTagEntry *CIccTagIndex::Find(icSignature sig) const
+{
+  if (m_Table.empty())
+    return NULL;
+
+  size_t n = Slot(sig);
+
+  while (m_Table[n]) {
+    if (m_Table[n]->TagInfo.sig==(icTagSignature)sig)
+      return m_Table[n];
+    n = (n+1) & (m_Table.size()-1);
+  }
+
+  return NULL;
+}
+
+//The directory list is public so entries can be added or removed without
+//going through CIccProfile.  Such changes are detected by the entry count
+//and the address of the last entry.
+bool CIccTagIndex::IsCurrent(const TagEntryList *pTags) const
+{
+  if (m_nEntries!=pTags->size())
+    return false;
+
+  return pTags->empty() ? !m_pLast : m_pLast==&pTags->back();
+}
+
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -104,6 +229,7 @@ CIccProfile::CIccProfile()
   memset(&m_Header, 0, sizeof(m_Header));
   m_Tags = new(TagEntryList);
   m_TagVals = new(TagPtrList);
+  m_TagIndex = new(CIccTagIndex);
 }
 
 /**
@@ -126,6 +252,7 @@ CIccProfile::CIccProfile(const CIccProfile &Profile)
   memset(&m_Header, 0, sizeof(m_Header));
   m_Tags = new(TagEntryList);
   m_TagVals = new(TagPtrList);
+  m_TagIndex = new(CIccTagIndex);
   memcpy(&m_Header, &Profile.m_Header, sizeof(m_Header));
 
   if (!Profile.m_TagVals->empty()) {
@@ -158,6 +285,7 @@ CIccProfile::CIccProfile(const CIccProfile &Profile)
 
       memcpy(&entry.TagInfo, &i->TagInfo, sizeof(icTag));
       m_Tags->push_back(entry);
+      m_TagIndex->Add(&m_Tags->back());
     }
   }
 
@@ -217,6 +345,7 @@ CIccProfile &CIccProfile::operator=(const CIccProfile &Profile)
 
       memcpy(&entry.TagInfo, &i->TagInfo, sizeof(icTag));
       m_Tags->push_back(entry);
+      m_TagIndex->Add(&m_Tags->back());
     }
   }
 
@@ -239,6 +368,7 @@ CIccProfile::~CIccProfile()
 
   delete m_Tags;
   delete m_TagVals;
+  delete m_TagIndex;
 }
 
 /**
@@ -262,6 +392,7 @@ void CIccProfile::Cleanup()
       delete i->ptr;
   }
   m_Tags->clear();
+  m_TagIndex->Clear();
   m_TagVals->clear();
   memset(&m_Header, 0, sizeof(m_Header));
 }
@@ -281,6 +412,16 @@ void CIccProfile::Cleanup()
  */
 IccTagEntry* CIccProfile::GetTag(icSignature sig) const
 {
+  //Only a hit in an index that accounts for every directory entry is trusted.
+  //A miss falls back to the directory search since entry signatures can
+  //also be changed in place through m_Tags.
+  if (m_TagIndex->IsCurrent(m_Tags)) {
+    IccTagEntry *pEntry = m_TagIndex->Find(sig);
+
+    if (pEntry && pEntry->TagInfo.sig==(icTagSignature)sig)
+      return pEntry;
+  }
+
   TagEntryList::const_iterator i;
 
   for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
@@ -439,9 +580,10 @@ CIccMemIO* CIccProfile::GetTagIO(icSignature sig)
       delete pIO;
       return NULL;
     }
+    pIO->SetNativeCLUTStorage(m_pAttachIO->GetNativeCLUTStorage());
 
     m_pAttachIO->Seek(pEntry->TagInfo.offset, icSeekSet);
-    m_pAttachIO->Read8(pIO->GetData(), pIO->GetLength());
+    m_pAttachIO->Read8(pIO->GetData(), (icInt32Number)pIO->GetLength());
     return pIO;
   }
 
@@ -483,6 +625,7 @@ bool CIccProfile::AttachTag(icSignature sig, CIccTag *pTag)
   Entry.pTag = pTag;
 
   m_Tags->push_back(Entry);
+  m_TagIndex->Add(&m_Tags->back());
 
   TagPtrList::iterator i;
 
@@ -526,6 +669,7 @@ bool CIccProfile::DeleteTag(icSignature sig)
   if (i!=m_Tags->end()) {
     CIccTag *pTag = i->pTag;
     m_Tags->erase(i);
+    m_TagIndex->Build(m_Tags);
 
     if (!GetTag(pTag)) {
       DetachTag(pTag);
@@ -596,6 +740,201 @@ bool CIccProfile::Detach()
   return false;
 }
 
+/**
+ * A tag that a worker thread of CIccProfile::LoadTags() decodes on its own
+ */
+struct CIccTagLoadJob
+{
+  IccTagEntry *pEntry;
+  CIccTag *pTag;
+};
+
+typedef std::vector<CIccTagLoadJob> CIccTagLoadJobList;
+
+/**
+ * Shared state of the threads decoding tags in CIccProfile::LoadTags()
+ */
+struct CIccTagLoadQueue
+{
+  CIccIO *pIO;
+  CIccTagLoadJobList *pJobs;
+  size_t nNext;
+  std::mutex mutex;
+};
+
+static bool icTagLoadJobLarger(const CIccTagLoadJob &a, const CIccTagLoadJob &b)
+{
+  return a.pEntry->TagInfo.size > b.pEntry->TagInfo.size;
+}
+
+/**
+ ******************************************************************************
+ * Name: icLoadTagAt
+ * 
+ * Purpose: Decodes the tag at the offset of a tag directory entry.  The tag
+ *  data is read with a positional read into a private buffer so that any
+ *  number of tags can be decoded at once from the same IO object.
+ * 
+ * Return: 
+ *  The tag object or NULL if the tag could not be decoded this way.
+ *******************************************************************************
+ */
+static CIccTag *icLoadTagAt(CIccIO *pIO, const icTag &TagInfo)
+{
+  icUInt8Number *pData = (icUInt8Number*)malloc(TagInfo.size);
+
+  if (!pData)
+    return NULL;
+
+  CIccTag *pTag = NULL;
+
+  if (pIO->ReadAt(TagInfo.offset, pData, (icInt32Number)TagInfo.size)==(icInt32Number)TagInfo.size) {
+    CIccMemIO TagIO;
+    icTagTypeSignature sigType;
+
+    TagIO.SetNativeCLUTStorage(pIO->GetNativeCLUTStorage());
+
+    if (TagIO.Attach(pData, TagInfo.size) && TagIO.Read32(&sigType)) {
+      pTag = CIccTag::Create(sigType);
+
+      if (pTag && (TagIO.Seek(0, icSeekSet)<0 || !pTag->Read(TagInfo.size, &TagIO))) {
+        delete pTag;
+        pTag = NULL;
+      }
+    }
+  }
+
+  free(pData);
+
+  return pTag;
+}
+
+static void icTagLoadWorker(CIccTagLoadQueue *pQueue)
+{
+  while (true) {
+    CIccTagLoadJob *pJob;
+    {
+      std::lock_guard<std::mutex> lock(pQueue->mutex);
+
+      if (pQueue->nNext>=pQueue->pJobs->size())
+        break;
+
+      pJob = &(*pQueue->pJobs)[pQueue->nNext++];
+    }
+
+    pJob->pTag = icLoadTagAt(pQueue->pIO, pJob->pEntry->TagInfo);
+  }
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccProfile::LoadTags
+ * 
+ * Purpose: Loads all tags in the tag directory.  With more than one thread
+ *  each tag offset is decoded once by a worker using positional reads, and
+ *  the decoded tags are then associated with the directory in directory
+ *  order.  Tags that could not be decoded by a worker are loaded
+ *  sequentially through pIO so failures are handled as in LoadTag().
+ * 
+ * Args: 
+ *  pIO - pointer to IO object to read tag object data from
+ *  nThreads - number of worker threads, 0 uses one per hardware thread
+ * 
+ * Return: 
+ *  true - all tags loaded, false - failure
+ *******************************************************************************
+ */
+bool CIccProfile::LoadTags(CIccIO *pIO, int nThreads)
+{
+  TagEntryList::iterator i, j;
+
+  if (nThreads<=0) {
+    nThreads = (int)std::thread::hardware_concurrency();
+    if (nThreads<=0)
+      nThreads = 1;
+  }
+
+  icUInt8Number probe;
+  if (nThreads>1 && pIO->ReadAt(0, &probe, 0)==0) {
+    CIccTagLoadJobList jobs;
+    icInt64Number nLength = pIO->GetLength();
+
+    //Tags that share an offset are only decoded once
+    for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
+      if (i->pTag || i->TagInfo.offset<sizeof(m_Header) || !i->TagInfo.size ||
+          i->TagInfo.size>0x7fffffff || (icInt64Number)i->TagInfo.offset + i->TagInfo.size > nLength)
+        continue;
+
+      for (j=m_Tags->begin(); j!=i; j++) {
+        if (j->TagInfo.offset==i->TagInfo.offset)
+          break;
+      }
+
+      if (i==j) {
+        CIccTagLoadJob job;
+        job.pEntry = &(*i);
+        job.pTag = NULL;
+        jobs.push_back(job);
+      }
+    }
+
+    //Start the largest tags first so they do not finish last
+    std::stable_sort(jobs.begin(), jobs.end(), icTagLoadJobLarger);
+
+    if ((size_t)nThreads>jobs.size())
+      nThreads = (int)jobs.size();
+
+    if (nThreads>1) {
+      //Make sure lazily initialized factories are built before the workers
+      //can use them
+      std::string name;
+      CIccTagCreator::GetTagTypeSigName(icSigUnknownType);
+      CIccMpeCreator::GetElementSigName(name, icSigUnknownElemType);
+      CIccStructCreator::GetStructSigName(name, icSigUnknownStruct);
+      CIccArrayCreator::GetArraySigName(name, icSigUnknownArray);
+
+      CIccTagLoadQueue queue;
+      std::vector<std::thread> threads;
+      size_t n;
+
+      queue.pIO = pIO;
+      queue.pJobs = &jobs;
+      queue.nNext = 0;
+
+      for (n=0; n<(size_t)nThreads; n++)
+        threads.push_back(std::thread(icTagLoadWorker, &queue));
+
+      for (n=0; n<threads.size(); n++)
+        threads[n].join();
+    }
+    else {
+      for (size_t n=0; n<jobs.size(); n++)
+        jobs[n].pTag = icLoadTagAt(pIO, jobs[n].pEntry->TagInfo);
+    }
+
+    //Associate decoded tags in directory order as LoadTag() would
+    std::map<IccTagEntry*, CIccTag*> loaded;
+    for (size_t n=0; n<jobs.size(); n++) {
+      if (jobs[n].pTag)
+        loaded[jobs[n].pEntry] = jobs[n].pTag;
+    }
+
+    for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
+      std::map<IccTagEntry*, CIccTag*>::iterator t = loaded.find(&(*i));
+
+      if (t!=loaded.end() && !i->pTag)
+        SetLoadedTag(&(*i), t->second);
+    }
+  }
+
+  for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
+    if (!LoadTag((IccTagEntry*)&(i->TagInfo), pIO))
+      return false;
+  }
+
+  return true;
+}
+
 /**
 ******************************************************************************
 * Name: CIccProfile::ReadTags
@@ -609,7 +948,7 @@ bool CIccProfile::Detach()
 *  false - No IO object attached or tags cannot be read.
 *******************************************************************************
 */
-bool CIccProfile::ReadTags(CIccProfile* pProfile)
+bool CIccProfile::ReadTags(CIccProfile* pProfile, int nThreads/*=1*/)
 {
 	CIccIO *pIO = m_pAttachIO;
 	
@@ -621,19 +960,13 @@ bool CIccProfile::ReadTags(CIccProfile* pProfile)
 		return false;
 	}
 
-	TagEntryList::iterator i;
-	icUInt32Number pos = pIO->Tell();
+	icInt64Number pos = pIO->Tell();
 
-	for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
-		if (!LoadTag((IccTagEntry*)&(i->TagInfo), pIO)) {
-			pIO->Seek(pos, icSeekSet);
-			return false;
-		}
-	}
+	bool rv = LoadTags(pIO, nThreads);
 
 	pIO->Seek(pos, icSeekSet);
 
-	return true;
+	return rv;
 }
 
 /**
@@ -645,6 +978,8 @@ bool CIccProfile::ReadTags(CIccProfile* pProfile)
  * 
  * Args: 
  *  pIO - pointer to IO object to read ICC profile from
+ *  nThreads - number of threads used to decode tags, 0 uses one per
+ *   hardware thread.  More than one thread requires pIO to support ReadAt().
  * 
  * Return: 
  *  true - the IO object (file) is an ICC profile, and the CIccProfile object
@@ -652,7 +987,7 @@ bool CIccProfile::ReadTags(CIccProfile* pProfile)
  *  false - the IO object (file) is not an ICC profile.
  *******************************************************************************
  */
-bool CIccProfile::Read(CIccIO *pIO)
+bool CIccProfile::Read(CIccIO *pIO, int nThreads/*=1*/)
 {
   if (m_Tags->size())
     Cleanup();
@@ -662,13 +997,9 @@ bool CIccProfile::Read(CIccIO *pIO)
     return false;
   }
 
-  TagEntryList::iterator i;
-
-  for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
-    if (!LoadTag((IccTagEntry*)&(i->TagInfo), pIO)) {
-      Cleanup();
-      return false;
-    }
+  if (!LoadTags(pIO, nThreads)) {
+    Cleanup();
+    return false;
   }
 
   return true;
@@ -746,12 +1077,39 @@ icValidateStatus CIccProfile::ReadValidate(CIccIO *pIO, std::string &sReport)
 }
 
 
+/**
+ ******************************************************************************
+ * Name: icWriteBlock
+ * 
+ * Purpose: Writes a block of memory that may be larger than a single Write8
+ *  call can take.
+ *******************************************************************************
+ */
+static bool icWriteBlock(CIccIO *pIO, icUInt8Number *pData, icUInt64Number nSize)
+{
+  while (nSize) {
+    icInt32Number n = nSize>0x40000000 ? 0x40000000 : (icInt32Number)nSize;
+
+    if (pIO->Write8(pData, n)!=n)
+      return false;
+
+    pData += n;
+    nSize -= n;
+  }
+
+  return true;
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccProfile::Write
  * 
  * Purpose: Write the data associated with the CIccProfile object to an IO
- *  IO object.
+ *  IO object.  The tags are serialized once into a growable memory buffer so
+ *  that the header and tag directory can be completed before anything is
+ *  written, and the profile ID is calculated from memory as the profile is
+ *  output rather than by reading the output back.
  * 
  * Args: 
  *  pIO - pointer to IO object to write data to
@@ -762,44 +1120,6 @@ icValidateStatus CIccProfile::ReadValidate(CIccIO *pIO, std::string &sReport)
  */
 bool CIccProfile::Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId)
 {
-  //Write Header
-  pIO->Seek(0, icSeekSet);
-
-  pIO->Write32(&m_Header.size);
-  pIO->Write32(&m_Header.cmmId);
-  pIO->Write32(&m_Header.version);
-  pIO->Write32(&m_Header.deviceClass);
-  pIO->Write32(&m_Header.colorSpace);
-  pIO->Write32(&m_Header.pcs);
-  pIO->Write16(&m_Header.date.year);
-  pIO->Write16(&m_Header.date.month);
-  pIO->Write16(&m_Header.date.day);
-  pIO->Write16(&m_Header.date.hours);
-  pIO->Write16(&m_Header.date.minutes);
-  pIO->Write16(&m_Header.date.seconds);
-  pIO->Write32(&m_Header.magic);
-  pIO->Write32(&m_Header.platform);
-  pIO->Write32(&m_Header.flags);
-  pIO->Write32(&m_Header.manufacturer);
-  pIO->Write32(&m_Header.model);
-  pIO->Write64(&m_Header.attributes);
-  pIO->Write32(&m_Header.renderingIntent);
-  pIO->Write32(&m_Header.illuminant.X);
-  pIO->Write32(&m_Header.illuminant.Y);
-  pIO->Write32(&m_Header.illuminant.Z);
-  pIO->Write32(&m_Header.creator);
-  pIO->Write8(&m_Header.profileID, sizeof(m_Header.profileID));
-  pIO->Write32(&m_Header.spectralPCS);
-  pIO->Write16(&m_Header.spectralRange.start);
-  pIO->Write16(&m_Header.spectralRange.end);
-  pIO->Write16(&m_Header.spectralRange.steps);
-  pIO->Write16(&m_Header.biSpectralRange.start);
-  pIO->Write16(&m_Header.biSpectralRange.end);
-  pIO->Write16(&m_Header.biSpectralRange.steps);
-  pIO->Write32(&m_Header.mcs);
-  pIO->Write32(&m_Header.deviceSubClass);
-  pIO->Write8(&m_Header.reserved[0], sizeof(m_Header.reserved));
-
   TagEntryList::iterator i, j;
   icUInt32Number count;
 
@@ -808,21 +1128,12 @@ bool CIccProfile::Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId)
       count++;
   }
 
-  pIO->Write32(&count);
+  //Tags start after the header and tag directory
+  icUInt64Number nTagBase = sizeof(m_Header) + 4 + (icUInt64Number)count*sizeof(icTag);
 
-  icUInt32Number dirpos = pIO->GetLength();
-
-  //Write Unintialized TagDir
-  for (i=m_Tags->begin(); i!= m_Tags->end(); i++) {
-    if (i->pTag) {
-      i->TagInfo.offset = 0;
-      i->TagInfo.size = 0;
-
-      pIO->Write32(&i->TagInfo.sig);
-      pIO->Write32(&i->TagInfo.offset);
-      pIO->Write32(&i->TagInfo.size);
-    }
-  }
+  CIccMemIO tagIO;
+  if (!tagIO.Alloc(0x10000, true, true))
+    return false;
 
   //Write Tags
   for (i=m_Tags->begin(); i!= m_Tags->end(); i++) {
@@ -833,11 +1144,16 @@ bool CIccProfile::Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId)
       }
 
       if (i==j) {
-        i->TagInfo.offset = pIO->GetLength();
-        i->pTag->Write(pIO);
-        i->TagInfo.size = pIO->GetLength() - i->TagInfo.offset;
+        icUInt64Number nTagStart = nTagBase + tagIO.GetLength();
+
+        i->pTag->Write(&tagIO);
+        if (nTagBase + tagIO.GetLength() > 0xffffffff)
+          return false;
+
+        i->TagInfo.offset = (icUInt32Number)nTagStart;
+        i->TagInfo.size = (icUInt32Number)(nTagBase + tagIO.GetLength() - nTagStart);
 
-        pIO->Align32();
+        tagIO.Align32();
       }
       else {
         i->TagInfo.offset = j->TagInfo.offset;
@@ -846,22 +1162,67 @@ bool CIccProfile::Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId)
     }
   }
 
-  pIO->Seek(dirpos, icSeekSet);
+  if (nTagBase + tagIO.GetLength() > 0xffffffff)
+    return false;
+
+  m_Header.size = (icUInt32Number)(nTagBase + tagIO.GetLength());
+
+  //The header and tag directory are assembled in memory and written with one call each
+  icUInt8Number header[128];
+  CIccMemIO hdrIO;
+
+  hdrIO.Attach(header, sizeof(header), true);
+
+  hdrIO.Write32(&m_Header.size);
+  hdrIO.Write32(&m_Header.cmmId);
+  hdrIO.Write32(&m_Header.version);
+  hdrIO.Write32(&m_Header.deviceClass);
+  hdrIO.Write32(&m_Header.colorSpace);
+  hdrIO.Write32(&m_Header.pcs);
+  hdrIO.Write16(&m_Header.date.year);
+  hdrIO.Write16(&m_Header.date.month);
+  hdrIO.Write16(&m_Header.date.day);
+  hdrIO.Write16(&m_Header.date.hours);
+  hdrIO.Write16(&m_Header.date.minutes);
+  hdrIO.Write16(&m_Header.date.seconds);
+  hdrIO.Write32(&m_Header.magic);
+  hdrIO.Write32(&m_Header.platform);
+  hdrIO.Write32(&m_Header.flags);
+  hdrIO.Write32(&m_Header.manufacturer);
+  hdrIO.Write32(&m_Header.model);
+  hdrIO.Write64(&m_Header.attributes);
+  hdrIO.Write32(&m_Header.renderingIntent);
+  hdrIO.Write32(&m_Header.illuminant.X);
+  hdrIO.Write32(&m_Header.illuminant.Y);
+  hdrIO.Write32(&m_Header.illuminant.Z);
+  hdrIO.Write32(&m_Header.creator);
+  hdrIO.Write8(&m_Header.profileID, sizeof(m_Header.profileID));
+  hdrIO.Write32(&m_Header.spectralPCS);
+  hdrIO.Write16(&m_Header.spectralRange.start);
+  hdrIO.Write16(&m_Header.spectralRange.end);
+  hdrIO.Write16(&m_Header.spectralRange.steps);
+  hdrIO.Write16(&m_Header.biSpectralRange.start);
+  hdrIO.Write16(&m_Header.biSpectralRange.end);
+  hdrIO.Write16(&m_Header.biSpectralRange.steps);
+  hdrIO.Write32(&m_Header.mcs);
+  hdrIO.Write32(&m_Header.deviceSubClass);
+  hdrIO.Write8(&m_Header.reserved[0], sizeof(m_Header.reserved));
 
   //Write TagDir with offsets and sizes
+  CIccMemIO dirIO;
+  if (!dirIO.Alloc(4 + count*sizeof(icTag), true))
+    return false;
+
+  dirIO.Write32(&count);
+
   for (i=m_Tags->begin(); i!= m_Tags->end(); i++) {
     if (i->pTag) {
-      pIO->Write32(&i->TagInfo.sig);
-      pIO->Write32(&i->TagInfo.offset);
-      pIO->Write32(&i->TagInfo.size);
+      dirIO.Write32(&i->TagInfo.sig);
+      dirIO.Write32(&i->TagInfo.offset);
+      dirIO.Write32(&i->TagInfo.size);
     }
   }
 
-  //Update header with size
-  m_Header.size = pIO->GetLength();
-  pIO->Seek(0, icSeekSet);
-  pIO->Write32(&m_Header.size);
-
   bool bWriteId;
 
   switch (nWriteId) {
@@ -879,13 +1240,33 @@ bool CIccProfile::Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId)
     bWriteId = false;
   }
 
-  //Write the profile ID if version 4 profile
+  //Calculate the profile ID if version 4 profile.  The flags, rendering
+  //intent and profile ID are zeroed for the calculation and the ID is
+  //then patched into the header.
   if(bWriteId) {
-    CalcProfileID(pIO, &m_Header.profileID);
-    pIO->Seek(84, icSeekSet);
-    pIO->Write8(&m_Header.profileID, sizeof(m_Header.profileID));
+    icUInt8Number idHeader[128];
+    MD5_CTX context;
+
+    memcpy(idHeader, header, sizeof(idHeader));
+    memset(idHeader+44, 0, 4);  //Profile flags
+    memset(idHeader+64, 0, 4);  //Rendering Intent
+    memset(idHeader+84, 0, 16); //Profile Id
+
+    icMD5Init(&context);
+    icMD5Update(&context, idHeader, sizeof(idHeader));
+    icMD5Update(&context, dirIO.GetData(), (unsigned int)dirIO.GetLength());
+    icMD5Update(&context, tagIO.GetData(), (unsigned int)tagIO.GetLength());
+    icMD5Final(&m_Header.profileID.ID8[0], &context);
+
+    memcpy(header+84, &m_Header.profileID, sizeof(m_Header.profileID));
   }
 
+  if (pIO->Seek(0, icSeekSet)<0 ||
+      !icWriteBlock(pIO, header, sizeof(header)) ||
+      !icWriteBlock(pIO, dirIO.GetData(), dirIO.GetLength()) ||
+      !icWriteBlock(pIO, tagIO.GetData(), tagIO.GetLength()))
+    return false;
+
   return true;
 }
 
@@ -1016,6 +1397,7 @@ bool CIccProfile::ReadBasic(CIccIO *pIO)
       return false;
     }
     m_Tags->push_back(TagEntry);
+    m_TagIndex->Add(&m_Tags->back());
   }
 
 
@@ -1056,7 +1438,7 @@ bool CIccProfile::LoadTag(IccTagEntry *pTagEntry, CIccIO *pIO)
   icTagTypeSignature sigType;
 
   //First we need to get the tag type to create the right kind of tag
-  if (pIO->Seek(pTagEntry->TagInfo.offset, icSeekSet)!=(icInt32Number)pTagEntry->TagInfo.offset)
+  if (pIO->Seek(pTagEntry->TagInfo.offset, icSeekSet)!=(icInt64Number)pTagEntry->TagInfo.offset)
     return false;
 
   if (!pIO->Read32(&sigType))
@@ -1070,7 +1452,7 @@ bool CIccProfile::LoadTag(IccTagEntry *pTagEntry, CIccIO *pIO)
   //Now seek back to where the tag starts so the created tag object can read
   //in its data.
   //First we need to get the tag type to create the right kind of tag
-  if (pIO->Seek(pTagEntry->TagInfo.offset, icSeekSet)!=(icInt32Number)pTagEntry->TagInfo.offset) {
+  if (pIO->Seek(pTagEntry->TagInfo.offset, icSeekSet)!=(icInt64Number)pTagEntry->TagInfo.offset) {
     delete pTag;
     return false;
   }
@@ -1080,6 +1462,26 @@ bool CIccProfile::LoadTag(IccTagEntry *pTagEntry, CIccIO *pIO)
     return false;
   }
 
+  SetLoadedTag(pTagEntry, pTag);
+
+  return true;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccProfile::SetLoadedTag
+ * 
+ * Purpose: Associates a tag object that was just read with its tag directory
+ *  entry and with all other entries that share its offset.
+ * 
+ * Args: 
+ *  pTagEntry - pointer to tag directory entry the tag was read for,
+ *  pTag - tag object read from the offset of pTagEntry
+ *******************************************************************************
+ */
+void CIccProfile::SetLoadedTag(IccTagEntry *pTagEntry, CIccTag *pTag)
+{
   switch(pTagEntry->TagInfo.sig) {
   case icSigAToB0Tag:
   case icSigAToB1Tag:
@@ -1132,8 +1534,6 @@ bool CIccProfile::LoadTag(IccTagEntry *pTagEntry, CIccIO *pIO)
         i->pTag != pTag)
       i->pTag = pTag; 
   }
-  
-  return true;
 }
 
 
@@ -1180,6 +1580,8 @@ bool CIccProfile::DetachTag(CIccTag *pTag)
     else
       j++;
   }
+  m_TagIndex->Build(m_Tags);
+
   return true;
 }
 
@@ -2524,18 +2926,18 @@ icValidateStatus CIccProfile::CheckRequiredTags(std::string &sReport) const
  */
 bool CIccProfile::CheckFileSize(CIccIO *pIO) const
 {
-  icUInt32Number FileSize;
-  icUInt32Number curPos = pIO->Tell();
+  icInt64Number FileSize;
+  icInt64Number curPos = pIO->Tell();
 
-  if (!pIO->Seek(0, icSeekEnd))
+  if (pIO->Seek(0, icSeekEnd)<0)
     return false;
 
   FileSize = pIO->Tell();
 
-  if (!FileSize)
+  if (FileSize<=0)
     return false;
 
-  if (!pIO->Seek(curPos, icSeekSet))
+  if (pIO->Seek(curPos, icSeekSet)<0)
     return false;
 
   if (FileSize != m_Header.size)
@@ -2927,7 +3329,7 @@ getmediaXYZ:
     if (samples && pNumTag->GetNumValues()>=samples) {
       pWhite=new icFloatNumber[samples];
       if (pWhite) {
-        pNumTag->GetValues(pWhite);
+        pNumTag->GetValues(pWhite, 0, samples);
       }
       else {
         goto getmediaXYZ;
@@ -2971,6 +3373,56 @@ getmediaXYZ:
 //  Function Definitions
 //////////////////////////////////////////////////////////////////////
 
+/**
+*****************************************************************************
+* Name: icOpenProfileIO
+* 
+* Purpose: Opens a profile file for reading.  The file is memory mapped
+*  when possible so that only the parts that are read are loaded.
+* 
+* Args: 
+*  szFilename - zero terminated string with filename of ICC profile to open
+* 
+* Return: 
+*  Pointer to IO object, or NULL on failure
+******************************************************************************
+*/
+static CIccIO *icOpenProfileIO(const icChar *szFilename)
+{
+  CIccMappedIO *pMappedIO = new CIccMappedIO;
+
+  if (pMappedIO->Open(szFilename))
+    return pMappedIO;
+  delete pMappedIO;
+
+  CIccFileIO *pFileIO = new CIccFileIO;
+
+  if (pFileIO->Open(szFilename, "rb"))
+    return pFileIO;
+  delete pFileIO;
+
+  return NULL;
+}
+
+#ifdef WIN32
+static CIccIO *icOpenProfileIO(const icWChar *szFilename)
+{
+  CIccMappedIO *pMappedIO = new CIccMappedIO;
+
+  if (pMappedIO->Open(szFilename))
+    return pMappedIO;
+  delete pMappedIO;
+
+  CIccFileIO *pFileIO = new CIccFileIO;
+
+  if (pFileIO->Open(szFilename, L"rb"))
+    return pFileIO;
+  delete pFileIO;
+
+  return NULL;
+}
+#endif
+
 /**
  *****************************************************************************
  * Name: ReadIccProfile
@@ -2979,19 +3431,21 @@ getmediaXYZ:
  * 
  * Args: 
  *  szFilename - zero terminated string with filename of ICC profile to read 
+ *  bNativeCLUTStorage - keep 8-bit, 16-bit and float16 CLUT data in 16-bit form
+ *   (see CIccIO::SetNativeCLUTStorage())
  * 
  * Return: 
  *  Pointer to icc profile object, or NULL on failure
  ******************************************************************************
  */
-CIccProfile* ReadIccProfile(const icChar *szFilename)
+CIccProfile* ReadIccProfile(const icChar *szFilename, bool bNativeCLUTStorage/*=false*/)
 {
-  CIccFileIO *pFileIO = new CIccFileIO;
+  CIccIO *pFileIO = icOpenProfileIO(szFilename);
 
-  if (!pFileIO->Open(szFilename, "rb")) {
-    delete pFileIO;
+  if (!pFileIO)
     return NULL;
-  }
+
+  pFileIO->SetNativeCLUTStorage(bNativeCLUTStorage);
 
   CIccProfile *pIcc = new CIccProfile;
 
@@ -3015,19 +3469,20 @@ CIccProfile* ReadIccProfile(const icChar *szFilename)
 * 
 * Args: 
 *  szFilename - zero terminated string with filename of ICC profile to read 
+*  bNativeCLUTStorage - keep 8-bit, 16-bit and float16 CLUT data in 16-bit form
 * 
 * Return: 
 *  Pointer to icc profile object, or NULL on failure
 ******************************************************************************
 */
-CIccProfile* ReadIccProfile(const icWChar *szFilename)
+CIccProfile* ReadIccProfile(const icWChar *szFilename, bool bNativeCLUTStorage/*=false*/)
 {
-  CIccFileIO *pFileIO = new CIccFileIO;
+  CIccIO *pFileIO = icOpenProfileIO(szFilename);
 
-  if (!pFileIO->Open(szFilename, L"rb")) {
-    delete pFileIO;
+  if (!pFileIO)
     return NULL;
-  }
+
+  pFileIO->SetNativeCLUTStorage(bNativeCLUTStorage);
 
   CIccProfile *pIcc = new CIccProfile;
 
@@ -3089,19 +3544,21 @@ CIccProfile* ReadIccProfile(const icUInt8Number *pMem, icUInt32Number nSize)
  * 
  * Args: 
  *  szFilename - zero terminated string with filename of ICC profile to read 
+ *  bNativeCLUTStorage - keep 8-bit, 16-bit and float16 CLUT data in 16-bit form
+ *   when tags are loaded (see CIccIO::SetNativeCLUTStorage())
  * 
  * Return: 
  *  Pointer to icc profile object, or NULL on failure
  *******************************************************************************
  */
-CIccProfile* OpenIccProfile(const icChar *szFilename)
+CIccProfile* OpenIccProfile(const icChar *szFilename, bool bNativeCLUTStorage/*=false*/)
 {
-  CIccFileIO *pFileIO = new CIccFileIO;
+  CIccIO *pFileIO = icOpenProfileIO(szFilename);
 
-  if (!pFileIO->Open(szFilename, "rb")) {
-    delete pFileIO;
+  if (!pFileIO)
     return NULL;
-  }
+
+  pFileIO->SetNativeCLUTStorage(bNativeCLUTStorage);
 
   CIccProfile *pIcc = new CIccProfile;
 
@@ -3125,19 +3582,21 @@ CIccProfile* OpenIccProfile(const icChar *szFilename)
 * 
 * Args: 
 *  szFilename - zero terminated string with filename of ICC profile to read 
+*  bNativeCLUTStorage - keep 8-bit, 16-bit and float16 CLUT data in 16-bit form
+*   when tags are loaded
 * 
 * Return: 
 *  Pointer to icc profile object, or NULL on failure
 *******************************************************************************
 */
-CIccProfile* OpenIccProfile(const icWChar *szFilename)
+CIccProfile* OpenIccProfile(const icWChar *szFilename, bool bNativeCLUTStorage/*=false*/)
 {
-  CIccFileIO *pFileIO = new CIccFileIO;
+  CIccIO *pFileIO = icOpenProfileIO(szFilename);
 
-  if (!pFileIO->Open(szFilename, L"rb")) {
-    delete pFileIO;
+  if (!pFileIO)
     return NULL;
-  }
+
+  pFileIO->SetNativeCLUTStorage(bNativeCLUTStorage);
 
   CIccProfile *pIcc = new CIccProfile;
 
@@ -3400,9 +3859,10 @@ bool SaveIccProfile(const icWChar *szFilename, CIccProfile *pIcc, icProfileIDSav
  */
 void CalcProfileID(CIccIO *pIO, icProfileID *pProfileID)
 {
-  icUInt32Number len, num, nBlock, pos;
+  icInt64Number len, pos;
+  icInt32Number num, nBlock;
   MD5_CTX context;
-  icUInt8Number buffer[1024];
+  icUInt8Number buffer[16384];
 
   //remember where we are
   pos = pIO->Tell();
@@ -3411,11 +3871,13 @@ void CalcProfileID(CIccIO *pIO, icProfileID *pProfileID)
   len = pIO->GetLength();
   pIO->Seek(0, icSeekSet);
 
-  //read file updating checksum as we go
+  //read file updating checksum as we go, only one block is ever held
   icMD5Init(&context);
   nBlock = 0;
-  while(len) {
-    num = pIO->Read8(&buffer[0],1024);
+  while(len>0) {
+    num = pIO->Read8(&buffer[0], len<(icInt64Number)sizeof(buffer) ? (icInt32Number)len : (icInt32Number)sizeof(buffer));
+    if (num<=0)
+      break;
     if (!nBlock) {  // Zero out 3 header contents in Profile ID calculation
       memset(buffer+44, 0, 4); //Profile flags
       memset(buffer+64, 0, 4);  //Rendering Intent
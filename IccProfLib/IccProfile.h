@@ -85,6 +85,7 @@ namespace refIccMAX {
 class ICCPROFLIB_API CIccTag;
 class ICCPROFLIB_API CIccIO;
 class ICCPROFLIB_API CIccMemIO;
+class CIccTagIndex;
 
 /**
  **************************************************************************
@@ -164,11 +165,11 @@ public:
   bool AttachTag(icSignature sig, CIccTag *pTag);
   bool DeleteTag(icSignature sig);
   CIccMemIO* GetTagIO(icSignature sig); //caller should delete returned result
-	bool ReadTags(CIccProfile* pProfile); // will read in all the tags using the IO of the passed profile
+	bool ReadTags(CIccProfile* pProfile, int nThreads=1); // will read in all the tags using the IO of the passed profile
 
   bool Attach(CIccIO *pIO);
   bool Detach();
-  bool Read(CIccIO *pIO);
+  bool Read(CIccIO *pIO, int nThreads=1);
   icValidateStatus ReadValidate(CIccIO *pIO, std::string &sReport);
   bool Write(CIccIO *pIO, icProfileIDSaveMethod nWriteId=icVersionBasedID);
 
@@ -210,6 +211,8 @@ protected:
   IccTagEntry* GetTag(CIccTag *pTag) const;
   bool ReadBasic(CIccIO *pIO);
   bool LoadTag(IccTagEntry *pTagEntry, CIccIO *pIO);
+  bool LoadTags(CIccIO *pIO, int nThreads);
+  void SetLoadedTag(IccTagEntry *pTagEntry, CIccTag *pTag);
   bool DetachTag(CIccTag *pTag);
 
   // Profile Validation functions
@@ -225,11 +228,14 @@ protected:
   CIccIO *m_pAttachIO;
 
   TagPtrList *m_TagVals;
+
+  ///Hash index of m_Tags by tag signature
+  CIccTagIndex *m_TagIndex;
 };
 
-CIccProfile ICCPROFLIB_API *ReadIccProfile(const icChar *szFilename);
+CIccProfile ICCPROFLIB_API *ReadIccProfile(const icChar *szFilename, bool bNativeCLUTStorage=false);
 CIccProfile ICCPROFLIB_API *ReadIccProfile(const icUInt8Number *pMem, icUInt32Number nSize);
-CIccProfile ICCPROFLIB_API *OpenIccProfile(const icChar *szFilename);
+CIccProfile ICCPROFLIB_API *OpenIccProfile(const icChar *szFilename, bool bNativeCLUTStorage=false);
 CIccProfile ICCPROFLIB_API *OpenIccProfile(const icUInt8Number *pMem, icUInt32Number nSize);  //pMem must be available for entire life of returned CIccProfile Object
 
 CIccProfile ICCPROFLIB_API *ValidateIccProfile(CIccIO *pIO, std::string &sReport, icValidateStatus &nStatus);
@@ -241,8 +247,8 @@ void ICCPROFLIB_API CalcProfileID(CIccIO *pIO, icProfileID *profileID);
 bool ICCPROFLIB_API CalcProfileID(const icChar *szFilename, icProfileID *profileID);
 
 #ifdef WIN32
-CIccProfile ICCPROFLIB_API *ReadIccProfile(const icWChar *szFilename);
-CIccProfile ICCPROFLIB_API *OpenIccProfile(const icWChar *szFilename);
+CIccProfile ICCPROFLIB_API *ReadIccProfile(const icWChar *szFilename, bool bNativeCLUTStorage=false);
+CIccProfile ICCPROFLIB_API *OpenIccProfile(const icWChar *szFilename, bool bNativeCLUTStorage=false);
 CIccProfile ICCPROFLIB_API *ValidateIccProfile(const icWChar *szFilename, std::string &sReport, icValidateStatus &nStatus);
 bool ICCPROFLIB_API SaveIccProfile(const icWChar *szFilename, CIccProfile *pIcc, icProfileIDSaveMethod nWriteId=icVersionBasedID);
 bool ICCPROFLIB_API CalcProfileID(const icWChar *szFilename, icProfileID *profileID);
@@ -76,6 +76,7 @@
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include "IccTag.h"
 #include "IccUtil.h"
 #include "IccProfile.h"
@@ -1918,7 +1919,7 @@ CIccTagTextDescription::~CIccTagTextDescription()
 bool CIccTagTextDescription::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number nEnd;
+  icInt64Number nEnd;
 
   nEnd = pIO->Tell() + size;
 
@@ -1968,14 +1969,14 @@ bool CIccTagTextDescription::Read(icUInt32Number size, CIccIO *pIO)
 
   ReleaseUnicode();
 
-  if (pIO->Tell()+3 > (icInt32Number)nEnd)
+  if (pIO->Tell()+3 > (icInt64Number)nEnd)
     return false;
 
   if (!pIO->Read16(&m_nScriptCode) ||
       !pIO->Read8(&m_nScriptSize))
      return false;
   
-  if (pIO->Tell() + m_nScriptSize> (icInt32Number)nEnd ||
+  if (pIO->Tell() + m_nScriptSize> (icInt64Number)nEnd ||
       m_nScriptSize > sizeof(m_szScriptText))
     return false;
 
@@ -2532,6 +2533,10 @@ CIccTagNamedColor2::CIccTagNamedColor2(int nSize/*=1*/, int nDeviceCoords/*=0*/)
   m_NamedColor = (SIccNamedColorEntry*)calloc(nSize, m_nColorEntrySize);
 
   m_NamedLab = NULL;
+  m_pNameIndex = NULL;
+  m_pRootIndex = NULL;
+  m_pLabIndex = NULL;
+  m_pDeviceIndex = NULL;
 }
 
 
@@ -2562,6 +2567,10 @@ CIccTagNamedColor2::CIccTagNamedColor2(const CIccTagNamedColor2 &ITNC)
   memcpy(m_NamedColor, ITNC.m_NamedColor, m_nColorEntrySize*m_nSize);
 
   m_NamedLab = NULL;
+  m_pNameIndex = NULL;
+  m_pRootIndex = NULL;
+  m_pLabIndex = NULL;
+  m_pDeviceIndex = NULL;
 }
 
 
@@ -2596,7 +2605,7 @@ CIccTagNamedColor2 &CIccTagNamedColor2::operator=(const CIccTagNamedColor2 &Name
   m_NamedColor = (SIccNamedColorEntry*)calloc(m_nSize, m_nColorEntrySize);
   memcpy(m_NamedColor, NamedColor2Tag.m_NamedColor, m_nColorEntrySize*m_nSize);
 
-  m_NamedLab = NULL;
+  ResetPCSCache();
 
   return *this;
 }
@@ -2615,8 +2624,7 @@ CIccTagNamedColor2::~CIccTagNamedColor2()
   if (m_NamedColor)
     free(m_NamedColor);
 
-  if (m_NamedLab)
-    delete [] m_NamedLab;
+  ResetPCSCache();
 }
 
 /**
@@ -2922,6 +2930,26 @@ void CIccTagNamedColor2::SetColorSpaces(icColorSpaceSignature csPCS, icColorSpac
    m_csDevice = csDevice;
 }
 
+/**
+ ****************************************************************************
+ * Name: icNamedColorKey
+ * 
+ * Purpose: Builds the key used to index a root color name.  Keys for
+ *  case insensitive lookups are converted to lower case.
+ *****************************************************************************
+ */
+static std::string icNamedColorKey(const icChar *szRoot, icUInt32Number nLen, bool bNoCase)
+{
+  std::string sKey(szRoot, nLen);
+
+  if (bNoCase) {
+    for (std::string::iterator c=sKey.begin(); c!=sKey.end(); c++)
+      *c = (icChar)tolower((icUInt8Number)*c);
+  }
+
+  return sKey;
+}
+
 /**
  ****************************************************************************
  * Name: CIccTagNamedColor2::FindRootColor
@@ -2937,8 +2965,14 @@ void CIccTagNamedColor2::SetColorSpaces(icColorSpaceSignature csPCS, icColorSpac
  */
 icInt32Number CIccTagNamedColor2::FindRootColor(const icChar *szRootColor) const
 {
+  if (m_pRootIndex) {
+    icNamedColorIndexMap::const_iterator i = m_pRootIndex->find(icNamedColorKey(szRootColor, (icUInt32Number)strlen(szRootColor), true));
+
+    return i!=m_pRootIndex->end() ? i->second : -1;
+  }
+
   for (icUInt32Number i=0; i<m_nSize; i++) {
-    if (stricmp(m_NamedColor[i].rootName,szRootColor) == 0)
+    if (stricmp(GetEntry(i)->rootName,szRootColor) == 0)
       return i;
   }
 
@@ -2960,13 +2994,31 @@ void CIccTagNamedColor2::ResetPCSCache()
     delete [] m_NamedLab;
     m_NamedLab = NULL;
   }
+  if (m_pNameIndex) {
+    delete m_pNameIndex;
+    m_pNameIndex = NULL;
+  }
+  if (m_pRootIndex) {
+    delete m_pRootIndex;
+    m_pRootIndex = NULL;
+  }
+  if (m_pLabIndex) {
+    delete m_pLabIndex;
+    m_pLabIndex = NULL;
+  }
+  if (m_pDeviceIndex) {
+    delete m_pDeviceIndex;
+    m_pDeviceIndex = NULL;
+  }
 }
 
 /**
 ****************************************************************************
 * Name: CIccTagNamedColor2::InitFindPCSColor
 * 
-* Purpose: Initialization needed for using FindPCSColor
+* Purpose: Initialization needed for using FindPCSColor.  The name, Lab and
+*  device indexes used by the Find functions are also built here so that
+*  lookups after CMM Begin() don't need to scan the whole tag.
 * 
 * Return: 
 *  true if successfull, false if failure
@@ -2974,28 +3026,71 @@ void CIccTagNamedColor2::ResetPCSCache()
 */
 bool CIccTagNamedColor2::InitFindCachedPCSColor()
 {
-  icFloatNumber *pXYZ, *pLab;
+  icFloatNumber XYZ[3], *pLab;
+  icUInt32Number i, j;
 
   if (!m_NamedLab) {
+    ResetPCSCache();
+
     m_NamedLab = new SIccNamedLabEntry[m_nSize];
     if (!m_NamedLab)
       return false;
 
     if (m_csPCS != icSigLabData) {
-      for (icUInt32Number i=0; i<m_nSize; i++) {
+      for (i=0; i<m_nSize; i++) {
         pLab = m_NamedLab[i].lab;
-        pXYZ = m_NamedColor[i].pcsCoords;
-        icXyzFromPcs(pXYZ);
-        icXYZtoLab(pLab, pXYZ);
+        memcpy(XYZ, GetEntry(i)->pcsCoords, sizeof(XYZ));
+        icXyzFromPcs(XYZ);
+        icXYZtoLab(pLab, XYZ);
       }
     }
     else {
-      for (icUInt32Number i=0; i<m_nSize; i++) {
+      for (i=0; i<m_nSize; i++) {
         pLab = m_NamedLab[i].lab;
-        Lab2ToLab4(pLab, m_NamedColor[i].pcsCoords);
+        Lab2ToLab4(pLab, GetEntry(i)->pcsCoords);
         icLabFromPcs(pLab);
       }
     }
+
+    m_pLabIndex = new CIccNearestIndex;
+    if (!m_pLabIndex || !m_pLabIndex->Build(m_NamedLab[0].lab, m_nSize, 3)) {
+      ResetPCSCache();
+      return false;
+    }
+
+    if (m_nDeviceCoords) {
+      icFloatNumber *pDevice = new icFloatNumber[m_nSize*m_nDeviceCoords];
+      if (!pDevice) {
+        ResetPCSCache();
+        return false;
+      }
+      for (i=0; i<m_nSize; i++) {
+        for (j=0; j<m_nDeviceCoords; j++)
+          pDevice[i*m_nDeviceCoords+j] = GetEntry(i)->deviceCoords[j];
+      }
+
+      m_pDeviceIndex = new CIccNearestIndex;
+      bool bOk = m_pDeviceIndex && m_pDeviceIndex->Build(pDevice, m_nSize, m_nDeviceCoords);
+      delete [] pDevice;
+
+      if (!bOk) {
+        ResetPCSCache();
+        return false;
+      }
+    }
+
+    //Only the first entry with a given name is found by the linear search
+    m_pNameIndex = new icNamedColorIndexMap;
+    m_pRootIndex = new icNamedColorIndexMap;
+    for (i=0; i<m_nSize; i++) {
+      const icChar *szRoot = GetEntry(i)->rootName;
+      icUInt32Number nLen = 0;
+      while (nLen<sizeof(GetEntry(i)->rootName) && szRoot[nLen])
+        nLen++;
+
+      m_pNameIndex->insert(std::make_pair(icNamedColorKey(szRoot, nLen, false), (icInt32Number)i));
+      m_pRootIndex->insert(std::make_pair(icNamedColorKey(szRoot, nLen, true), (icInt32Number)i));
+    }
   }
 
   return true;
@@ -3018,13 +3113,13 @@ bool CIccTagNamedColor2::InitFindCachedPCSColor()
 icInt32Number CIccTagNamedColor2::FindCachedPCSColor(icFloatNumber *pPCS, icFloatNumber dMinDE/*=1000.0*/) const
 {
   icFloatNumber dCalcDE, dLeastDE=0.0;
-  icFloatNumber pLabIn[3];
-  icFloatNumber *pXYZ, *pLab;
+  icFloatNumber pLabIn[3], XYZ[3];
+  icFloatNumber *pLab;
   icInt32Number leastDEindex = -1;
   if (m_csPCS != icSigLabData) {
-    pXYZ = pPCS;
-    icXyzFromPcs(pXYZ);
-    icXYZtoLab(pLabIn,pXYZ);
+    memcpy(XYZ, pPCS, sizeof(XYZ));
+    icXyzFromPcs(XYZ);
+    icXYZtoLab(pLabIn,XYZ);
   }
   else {
     Lab2ToLab4(pLabIn, pPCS);
@@ -3034,6 +3129,16 @@ icInt32Number CIccTagNamedColor2::FindCachedPCSColor(icFloatNumber *pPCS, icFloa
   if (!m_NamedLab)
     return -1;
 
+  //The first entry is returned when no entry is within dMinDE
+  if (m_pLabIndex) {
+    leastDEindex = m_pLabIndex->FindNearest(pLabIn);
+
+    if (leastDEindex>0 && !(icDeltaE(pLabIn, m_NamedLab[leastDEindex].lab)<dMinDE))
+      leastDEindex = 0;
+
+    return leastDEindex;
+  }
+
   for (icUInt32Number i=0; i<m_nSize; i++) {
     pLab = m_NamedLab[i].lab;
 
@@ -3092,29 +3197,40 @@ icInt32Number CIccTagNamedColor2::FindPCSColor(icFloatNumber *pPCS, icFloatNumbe
  */
 icInt32Number CIccTagNamedColor2::FindColor(const icChar *szColor) const
 {
-  std::string sColorName;
-  icInt32Number i, j;
+  icInt32Number i, nPrefix, nSufix, nLen;
 
-  j = (icInt32Number)strlen(m_szPrefix);
-  if (j != 0) {  
-    if (strncmp(szColor, m_szPrefix, j))
+  nPrefix = (icInt32Number)strlen(m_szPrefix);
+  if (nPrefix != 0) {  
+    if (strncmp(szColor, m_szPrefix, nPrefix))
       return -1;
   }
 
-  j = (icInt32Number)strlen(m_szSufix);
-  i = (icInt32Number)strlen(szColor);
-  if (j != 0) {
-    if (strncmp(szColor+(i-j), m_szSufix, j))
+  nSufix = (icInt32Number)strlen(m_szSufix);
+  nLen = (icInt32Number)strlen(szColor);
+  if (nLen < nPrefix + nSufix)
+    return -1;
+
+  if (nSufix != 0) {
+    if (strncmp(szColor+(nLen-nSufix), m_szSufix, nSufix))
       return -1;    
   }
 
+  //Only the root part of szColor remains to be matched
+  const icChar *szRoot = szColor + nPrefix;
+  nLen -= nPrefix + nSufix;
+  if (nLen > (icInt32Number)sizeof(m_NamedColor->rootName))
+    return -1;
+
+  if (m_pNameIndex) {
+    icNamedColorIndexMap::const_iterator c = m_pNameIndex->find(icNamedColorKey(szRoot, nLen, false));
+
+    return c!=m_pNameIndex->end() ? c->second : -1;
+  }
 
   for ( i=0; i<(icInt32Number)m_nSize; i++) {
-    sColorName = m_szPrefix;
-    sColorName += m_NamedColor[i].rootName;
-    sColorName += m_szSufix;
+    const icChar *szName = GetEntry(i)->rootName;
 
-    if (strcmp(sColorName.c_str(),szColor) == 0)
+    if (!strncmp(szName, szRoot, nLen) && (nLen==sizeof(GetEntry(i)->rootName) || !szName[nLen]))
       return i;
   }
 
@@ -3138,6 +3254,9 @@ icInt32Number CIccTagNamedColor2::FindDeviceColor(icFloatNumber *pDevColor) cons
 {
   if (!m_nDeviceCoords)
     return -1;
+
+  if (m_pDeviceIndex)
+    return m_pDeviceIndex->FindNearest(pDevColor);
   
   icFloatNumber dCalcDiff=0.0, dLeastDiff=0.0;
   icFloatNumber *pDevOut;
@@ -3145,7 +3264,7 @@ icInt32Number CIccTagNamedColor2::FindDeviceColor(icFloatNumber *pDevColor) cons
 
 
   for (icUInt32Number i=0; i<m_nSize; i++) {
-    pDevOut = m_NamedColor[i].deviceCoords;
+    pDevOut = GetEntry(i)->deviceCoords;
 
     for (icUInt32Number j=0; j<m_nDeviceCoords; j++) {
       dCalcDiff += (pDevColor[j]-pDevOut[j])*(pDevColor[j]-pDevOut[j]);
@@ -4930,12 +5049,12 @@ bool CIccTagFixedNum<T, Tsig>::GetValues(icFloatNumber *DstVector, icUInt32Numbe
 
   switch (Tsig) {
     case icSigS15Fixed16ArrayType:
-      for (i=0; i<m_nSize; i++) {
+      for (i=0; i<nVectorSize; i++) {
         DstVector[i] = (icFloatNumber)icFtoD(m_Num[i+nStart]);
       }
       break;
     case icSigU16Fixed16ArrayType:
-      for (i=0; i<m_nSize; i++) {
+      for (i=0; i<nVectorSize; i++) {
         DstVector[i] = (icFloatNumber)icUFtoD(m_Num[i+nStart]);
       }
       break;
@@ -5476,12 +5595,12 @@ bool CIccTagNum<T, Tsig>::GetValues(icFloatNumber *DstVector, icUInt32Number nSt
   
   switch (Tsig) {
     case icSigUInt8ArrayType:
-      for (i=0; i<m_nSize; i++) {
+      for (i=0; i<nVectorSize; i++) {
         DstVector[i] = icU8toF((icUInt8Number)(m_Num[i+nStart]));
       }
       break;
     case icSigUInt16ArrayType:
-      for (i=0; i<m_nSize; i++) {
+      for (i=0; i<nVectorSize; i++) {
         DstVector[i] = icU16toF((icUInt16Number)(m_Num[i+nStart]));
       }
       break;
@@ -6025,12 +6144,12 @@ bool  CIccTagFloatNum<T, Tsig>::SetSize(icUInt32Number nSize, bool bZeroNew/*=tr
 template <class T, icTagTypeSignature Tsig>
 bool CIccTagFloatNum<T, Tsig>::GetValues(icFloatNumber *DstVector, icUInt32Number nStart, icUInt32Number nVectorSize) const
 {
-  if (nVectorSize >m_nSize)
+  if (nVectorSize+nStart >m_nSize)
     return false;
 
   icUInt32Number i;
 
-  for (i=0; i<m_nSize; i++) {
+  for (i=0; i<nVectorSize; i++) {
     DstVector[i] = (icFloatNumber)m_Num[i+nStart];
   }
   return true;
@@ -6813,7 +6932,7 @@ bool CIccTagMultiLocalizedUnicode::Read(icUInt32Number size, CIccIO *pIO)
     return false;
   }
 
-  icUInt32Number nTagPos = pIO->Tell();
+  icInt64Number nTagPos = pIO->Tell();
   
   if (!pIO->Read32(&sig) ||
       !pIO->Read32(&m_nReserved) ||
@@ -8674,7 +8793,7 @@ void CIccProfileDescText::Describe(std::string &sDescription)
 bool CIccProfileDescText::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number nPos;
+  icInt64Number nPos;
 
   //Check for description tag type signature
   nPos = pIO->Tell();
@@ -8887,7 +9006,8 @@ CIccTagProfileSeqDesc::~CIccTagProfileSeqDesc()
 bool CIccTagProfileSeqDesc::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number nCount, nEnd;
+  icUInt32Number nCount;
+  icInt64Number nEnd;
 
   nEnd = pIO->Tell() + size;
 
@@ -9627,7 +9747,7 @@ bool CIccTagResponseCurveSet16::Write(CIccIO *pIO)
     return false;
   }
 
-  icUInt32Number startPos = pIO->GetLength();
+  icInt64Number startPos = pIO->GetLength();
 
   if (!pIO->Write32(&sig) ||
       !pIO->Write32(&m_nReserved))
@@ -9638,7 +9758,7 @@ bool CIccTagResponseCurveSet16::Write(CIccIO *pIO)
       !pIO->Write16(&nCountMeasmntTypes))
     return false;
 
-  icUInt32Number offsetPos = pIO->GetLength();
+  icInt64Number offsetPos = pIO->GetLength();
   icUInt32Number* nOffset = new icUInt32Number[nCountMeasmntTypes];
 
 
@@ -9657,7 +9777,7 @@ bool CIccTagResponseCurveSet16::Write(CIccIO *pIO)
       return false;
   }
 
-  icUInt32Number curPOs = pIO->GetLength();
+  icInt64Number curPOs = pIO->GetLength();
 
   pIO->Seek(offsetPos,icSeekSet);
 
@@ -10193,6 +10313,7 @@ CIccTagSpectralViewingConditions::CIccTagSpectralViewingConditions(const CIccTag
   m_observerRange.start = SVCT.m_observerRange.start;
   m_observerRange.end = SVCT.m_observerRange.end;
   m_observerRange.steps = SVCT.m_observerRange.steps;
+  m_reserved2 = SVCT.m_reserved2;
 
   if (SVCT.m_observer && SVCT.m_observerRange.steps) {
     m_observer = new icFloat32Number[SVCT.m_observerRange.steps*3];
@@ -10207,9 +10328,10 @@ CIccTagSpectralViewingConditions::CIccTagSpectralViewingConditions(const CIccTag
   m_stdIlluminant = SVCT.m_stdIlluminant;
   m_colorTemperature = SVCT.m_colorTemperature;
 
-  m_illuminantRange.start = 0;
-  m_illuminantRange.end = 0;
-  m_illuminantRange.steps = 0;
+  m_illuminantRange.start = SVCT.m_illuminantRange.start;
+  m_illuminantRange.end = SVCT.m_illuminantRange.end;
+  m_illuminantRange.steps = SVCT.m_illuminantRange.steps;
+  m_reserved3 = SVCT.m_reserved3;
 
   if (SVCT.m_illuminant && SVCT.m_illuminantRange.steps) {
     m_illuminant = new icFloat32Number[SVCT.m_illuminantRange.steps];
@@ -10221,13 +10343,8 @@ CIccTagSpectralViewingConditions::CIccTagSpectralViewingConditions(const CIccTag
     m_illuminant = NULL;
   }
 
-  m_illuminantXYZ.X = 0;
-  m_illuminantXYZ.Y = 0;
-  m_illuminantXYZ.Z = 0;
-
-  m_surroundXYZ.X = 0;
-  m_surroundXYZ.Y = 0;
-  m_surroundXYZ.Z = 0;
+  m_illuminantXYZ = SVCT.m_illuminantXYZ;
+  m_surroundXYZ = SVCT.m_surroundXYZ;
 }
 
 
@@ -10243,10 +10360,19 @@ CIccTagSpectralViewingConditions::CIccTagSpectralViewingConditions(const CIccTag
  */
 CIccTagSpectralViewingConditions &CIccTagSpectralViewingConditions::operator=(const CIccTagSpectralViewingConditions &SVCT)
 {
+  if (&SVCT == this)
+    return *this;
+
+  if (m_observer)
+    delete [] m_observer;
+  if (m_illuminant)
+    delete [] m_illuminant;
+
   m_stdObserver = SVCT.m_stdObserver;
   m_observerRange.start = SVCT.m_observerRange.start;
   m_observerRange.end = SVCT.m_observerRange.end;
   m_observerRange.steps = SVCT.m_observerRange.steps;
+  m_reserved2 = SVCT.m_reserved2;
 
   if (SVCT.m_observer && SVCT.m_observerRange.steps) {
     m_observer = new icFloat32Number[SVCT.m_observerRange.steps*3];
@@ -10261,9 +10387,10 @@ CIccTagSpectralViewingConditions &CIccTagSpectralViewingConditions::operator=(co
   m_stdIlluminant = SVCT.m_stdIlluminant;
   m_colorTemperature = SVCT.m_colorTemperature;
 
-  m_illuminantRange.start = 0;
-  m_illuminantRange.end = 0;
-  m_illuminantRange.steps = 0;
+  m_illuminantRange.start = SVCT.m_illuminantRange.start;
+  m_illuminantRange.end = SVCT.m_illuminantRange.end;
+  m_illuminantRange.steps = SVCT.m_illuminantRange.steps;
+  m_reserved3 = SVCT.m_reserved3;
 
   if (SVCT.m_illuminant && SVCT.m_illuminantRange.steps) {
     m_illuminant = new icFloat32Number[SVCT.m_illuminantRange.steps];
@@ -10275,13 +10402,8 @@ CIccTagSpectralViewingConditions &CIccTagSpectralViewingConditions::operator=(co
     m_illuminant = NULL;
   }
 
-  m_illuminantXYZ.X = 0;
-  m_illuminantXYZ.Y = 0;
-  m_illuminantXYZ.Z = 0;
-
-  m_surroundXYZ.X = 0;
-  m_surroundXYZ.Y = 0;
-  m_surroundXYZ.Z = 0;
+  m_illuminantXYZ = SVCT.m_illuminantXYZ;
+  m_surroundXYZ = SVCT.m_surroundXYZ;
 
   return *this;
 }
@@ -74,6 +74,7 @@
 
 #include <list>
 #include <string>
+#include <unordered_map>
 #include "IccDefs.h"
 
 #ifdef USEREFICCMAXNAMESPACE
@@ -535,6 +536,10 @@ typedef struct {
   icFloatNumber lab[3];
 } SIccNamedLabEntry;
 
+typedef std::unordered_map<std::string, icInt32Number> icNamedColorIndexMap;
+
+class CIccNearestIndex;
+
 /**
 ****************************************************************************
 * Class: CIccTagNamedColor2
@@ -577,6 +582,8 @@ public:
   icInt32Number FindDeviceColor(icFloatNumber *pDevColor) const;
   icInt32Number FindPCSColor(icFloatNumber *pPCS, icFloatNumber dMinDE=1000.0);
 
+  //InitFindCachedPCSColor also builds the name and device indexes used by
+  //FindColor(), FindRootColor() and FindDeviceColor()
   bool InitFindCachedPCSColor();
   //FindPCSColor returns the zero based index of the color or -1 to indicate that the color was not found.
   //InitFindPCSColor must be called before FindPCSColor
@@ -613,6 +620,12 @@ protected:
   SIccNamedLabEntry *m_NamedLab; ///For quick response of repeated FindPCSColor
   icUInt32Number m_nColorEntrySize;
 
+  ///Lookup indexes built by InitFindCachedPCSColor()
+  icNamedColorIndexMap *m_pNameIndex;
+  icNamedColorIndexMap *m_pRootIndex;
+  CIccNearestIndex *m_pLabIndex;
+  CIccNearestIndex *m_pDeviceIndex;
+
   icUInt32Number m_nVendorFlags;
   icUInt32Number m_nDeviceCoords;
   icUInt32Number m_nSize;
@@ -753,7 +766,7 @@ public:
   CIccTagSparseMatrixArray(int nNumMatrices=1, int nChannelsPerMatrix=4);
   CIccTagSparseMatrixArray(const CIccTagSparseMatrixArray &ITSMA);
   CIccTagSparseMatrixArray &operator=(const CIccTagSparseMatrixArray &ITSMA);
-  virtual CIccTag* NewCopy() { return new CIccTagSparseMatrixArray(*this); }
+  virtual CIccTag* NewCopy() const { return new CIccTagSparseMatrixArray(*this); }
   virtual ~CIccTagSparseMatrixArray();
 
   virtual bool IsArrayType() { return m_nSize > 1; }
@@ -422,7 +422,7 @@ bool CIccTagStruct::Write(CIccIO *pIO)
 
   pIO->Write32(&count);
 
-  icUInt32Number dirpos = pIO->Tell();
+  icInt64Number dirpos = pIO->Tell();
 
   //Write Unintialized TagDir
   for (i=m_ElemEntries->begin(); i!= m_ElemEntries->end(); i++) {
@@ -458,7 +458,7 @@ bool CIccTagStruct::Write(CIccIO *pIO)
       }
     }
   }
-  icUInt32Number epos = pIO->Tell();
+  icInt64Number epos = pIO->Tell();
 
   pIO->Seek(dirpos, icSeekSet);
 
@@ -997,7 +997,8 @@ CIccTagArray::CIccTagArray(icArraySignature sigArrayType/* =icSigUndefinedArray
 CIccTagArray::CIccTagArray(const CIccTagArray &tagAry)
 {
   if (tagAry.m_nSize) {
-    m_TagVals = new IccTagPtr[tagAry.m_nSize];
+    m_TagVals = (IccTagPtr*)calloc(tagAry.m_nSize, sizeof(IccTagPtr));
+    m_nSize = tagAry.m_nSize;
 
     icUInt32Number i;
     for (i=0; i<m_nSize; i++) {
@@ -1006,7 +1007,10 @@ CIccTagArray::CIccTagArray(const CIccTagArray &tagAry)
       else
         m_TagVals[i].ptr = NULL;
     }
-    m_nSize = tagAry.m_nSize;
+  }
+  else {
+    m_TagVals = NULL;
+    m_nSize = 0;
   }
   m_sigArrayType = tagAry.m_sigArrayType;
 
@@ -1034,7 +1038,8 @@ CIccTagArray &CIccTagArray::operator=(const CIccTagArray &tagAry)
   Cleanup();
 
   if (tagAry.m_nSize) {
-    m_TagVals = new IccTagPtr[tagAry.m_nSize];
+    m_TagVals = (IccTagPtr*)calloc(tagAry.m_nSize, sizeof(IccTagPtr));
+    m_nSize = tagAry.m_nSize;
 
     icUInt32Number i;
     for (i=0; i<m_nSize; i++) {
@@ -1043,7 +1048,10 @@ CIccTagArray &CIccTagArray::operator=(const CIccTagArray &tagAry)
       else
         m_TagVals[i].ptr = NULL;
     }
-    m_nSize = tagAry.m_nSize;
+  }
+  else {
+    m_TagVals = NULL;
+    m_nSize = 0;
   }
   m_sigArrayType = tagAry.m_sigArrayType;
 
@@ -1170,7 +1178,7 @@ bool CIccTagArray::Read(icUInt32Number size, CIccIO *pIO)
 
   Cleanup();
 
-  icUInt32Number nTagStart = pIO->Tell();
+  icInt64Number nTagStart = pIO->Tell();
 
   if (!pIO->Read32(&sig))
     return false;
@@ -1269,7 +1277,7 @@ bool CIccTagArray::Write(CIccIO *pIO)
   if (!pIO)
     return false;
 
-  icUInt32Number nTagStart = pIO->Tell();
+  icInt64Number nTagStart = pIO->Tell();
 
   if (!pIO->Write32(&sig))
     return false;
@@ -1286,7 +1294,7 @@ bool CIccTagArray::Write(CIccIO *pIO)
   if (m_nSize) {
     icUInt32Number i, j;
 
-    icUInt32Number pos = pIO->Tell();
+    icInt64Number pos = pIO->Tell();
 
     //Write Unintialized TagPosition block
     icUInt32Number zero = 0;
@@ -1325,7 +1333,7 @@ bool CIccTagArray::Write(CIccIO *pIO)
         tagPos[i].size = 0;
       }
     }
-    icUInt32Number endPos = pIO->Tell();
+    icInt64Number endPos = pIO->Tell();
 
     //Update TagPosition block
     pIO->Seek(pos, icSeekSet);
@@ -1453,7 +1461,10 @@ void CIccTagArray::Cleanup()
     }
   }
 
-  delete [] m_TagVals;
+  if (m_TagVals)
+    free(m_TagVals);
+  m_TagVals = NULL;
+  m_nSize = 0;
 
   if (m_pArray)
     delete m_pArray;
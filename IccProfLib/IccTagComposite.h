@@ -198,7 +198,7 @@ protected:
   
   icStructSignature m_sigStructType;
 
-  icUInt32Number m_tagStart;
+  icInt64Number m_tagStart;
   icUInt32Number m_tagSize;
   
   TagEntryList *m_ElemEntries;
@@ -812,7 +812,8 @@ bool CIccTagDict::Write(CIccIO *pIO)
   if (!pos)
     return false;
 
-  icUInt32Number n, dirpos = pIO->Tell();
+  icUInt32Number n;
+  icInt64Number dirpos = pIO->Tell();
 
   //Write Unintialized Dict rec offset array
   for (i=m_Dict->begin(); i!= m_Dict->end(); i++) {
@@ -861,7 +862,7 @@ bool CIccTagDict::Write(CIccIO *pIO)
       n++;
     }
   }
-  icUInt32Number endpos = pIO->Tell();
+  icInt64Number endpos = pIO->Tell();
 
   pIO->Seek(dirpos, icSeekSet);
 
@@ -219,7 +219,7 @@ protected:
   icUInt32Number MaxPosRecSize();
 
   icUInt32Number m_tagSize;
-  icUInt32Number m_tagStart;
+  icInt64Number m_tagStart;
 };
 
 
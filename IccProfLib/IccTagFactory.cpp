@@ -450,7 +450,7 @@ const icChar* CIccSpecTagFactory::GetTagSigName(icTagSignature tagSig)
 
 icTagSignature CIccSpecTagFactory::GetTagNameSig(const icChar *szName)
 {
-  if (g_TagSigToNameMap.empty()) {
+  if (g_TagNameToSigMap.empty()) {
     for (int i = 0; g_icTagNameTable[i].sig; i++)
       g_TagNameToSigMap[g_icTagNameTable[i].szName] = g_icTagNameTable[i].sig;
   }
@@ -82,6 +82,13 @@
 #include "IccUtil.h"
 #include "IccProfile.h"
 #include "IccMpeBasic.h"
+#include <vector>
+
+#if defined(ICC_USE_SSE2)
+  #include <emmintrin.h>
+#elif defined(ICC_USE_NEON)
+  #include <arm_neon.h>
+#endif
 
 #ifdef USEREFICCMAXNAMESPACE
 namespace refIccMAX {
@@ -132,6 +139,176 @@ icFloatNumber CIccCurve::Find(icFloatNumber v,
 }
 
 
+/**
+****************************************************************************
+* Name: icInvertSamples
+* 
+* Purpose: Fills an inverse curve table from samples of a monotonically
+*  non-decreasing curve.  Values on flat runs map to the start of the run.
+*  Either linear interpolation or monotone cubic (Fritsch-Carlson) Hermite
+*  interpolation of the inverse is used between samples.
+* 
+* Args:
+*  pLut = table of nSize entries to fill,
+*  X = increasing sample positions,
+*  Y = non-decreasing sample values,
+*  n = number of samples (at least 2),
+*  bCubic = use monotone cubic interpolation
+*****************************************************************************
+*/
+static void icInvertSamples(icFloatNumber *pLut, icUInt32Number nSize, const icFloat64Number *X,
+                            const icFloat64Number *Y, icUInt32Number n, bool bCubic)
+{
+  std::vector<icFloat64Number> delta, m;
+  icUInt32Number i, k;
+
+  if (bCubic) {
+    //Slopes of the inverse (dx/dy) are zero on flat runs which are never interpolated
+    delta.resize(n-1);
+    for (k=0; k<n-1; k++)
+      delta[k] = Y[k+1]>Y[k] ? (X[k+1]-X[k]) / (Y[k+1]-Y[k]) : 0.0;
+
+    m.resize(n);
+    for (k=0; k<n; k++) {
+      icFloat64Number d0 = k>0 ? delta[k-1] : 0.0;
+      icFloat64Number d1 = k<n-1 ? delta[k] : 0.0;
+
+      if (d0>0 && d1>0)
+        m[k] = (d0 + d1) / 2.0;
+      else
+        m[k] = d0>0 ? d0 : d1;
+    }
+
+    //Limit slopes to keep the interpolation monotonic
+    for (k=0; k<n-1; k++) {
+      if (delta[k]<=0)
+        continue;
+
+      icFloat64Number a = m[k] / delta[k];
+      icFloat64Number b = m[k+1] / delta[k];
+      icFloat64Number d = a*a + b*b;
+
+      if (d > 9.0) {
+        icFloat64Number tau = 3.0 / sqrt(d);
+        m[k] = tau * a * delta[k];
+        m[k+1] = tau * b * delta[k];
+      }
+    }
+  }
+
+  for (i=0, k=0; i<nSize; i++) {
+    icFloat64Number y = (icFloatNumber)i / (icFloatNumber)(nSize-1);
+
+    if (y<=Y[0]) {
+      pLut[i] = (icFloatNumber)X[0];
+      continue;
+    }
+    if (y>Y[n-1]) {
+      pLut[i] = (icFloatNumber)X[n-1];
+      continue;
+    }
+
+    //Y[k] < y <= Y[k+1] so the interval is never flat
+    while (y>Y[k+1])
+      k++;
+
+    icFloat64Number h = Y[k+1] - Y[k];
+    icFloat64Number t = (y - Y[k]) / h;
+    icFloat64Number x;
+
+    if (bCubic) {
+      icFloat64Number t2 = t*t, t3 = t2*t;
+
+      x = (2.0*t3 - 3.0*t2 + 1.0)*X[k] + (t3 - 2.0*t2 + t)*h*m[k] +
+          (3.0*t2 - 2.0*t3)*X[k+1] + (t3 - t2)*h*m[k+1];
+    }
+    else {
+      x = X[k] + (X[k+1] - X[k])*t;
+    }
+
+    pLut[i] = (icFloatNumber)x;
+  }
+}
+
+
+/**
+****************************************************************************
+* Name: CIccCurve::NewInverse
+* 
+* Purpose: Creates a table based inverse of the curve over the unit range.
+*  Curves with a closed form inverse evaluate it for each entry.  Other
+*  increasing curves are sampled and inverted using monotone cubic
+*  interpolation.  Curves that do not increase fall back to Find().
+* 
+* Args:
+*  nSize = number of entries in the inverse table (2 to 65536)
+* 
+* Return:
+*  New inverse curve (owned by caller) or NULL if nSize is out of range
+*****************************************************************************
+*/
+CIccTagCurve *CIccCurve::NewInverse(icUInt32Number nSize/*=icDefaultInvCurveSize*/)
+{
+  if (nSize<2 || nSize>65536)
+    return NULL;
+
+  Begin();
+
+  CIccTagCurve *pInv = new CIccTagCurve(nSize);
+  icFloatNumber *Lut = pInv->GetData(0);
+  icFloatNumber v0 = Apply(0), v1 = Apply(1.0);
+  icFloatNumber x;
+  icUInt32Number i;
+
+  if (IsInvertible()) {
+    for (i=0; i<nSize; i++) {
+      x = (icFloatNumber)i / (icFloatNumber)(nSize-1);
+
+      if (x<=v0)
+        Lut[i] = 0;
+      else if (x>=v1)
+        Lut[i] = 1.0;
+      else {
+        icFloatNumber p = ApplyInverse(x);
+        Lut[i] = p<0 ? 0 : (p>1.0 ? (icFloatNumber)1.0 : p);
+      }
+    }
+  }
+  else if (!(v1>v0)) {
+    for (i=0; i<nSize; i++) {
+      x = (icFloatNumber)i / (icFloatNumber)(nSize-1);
+
+      Lut[i] = Find(x);
+    }
+  }
+  else {
+    icUInt32Number k, nSamples = 4*(nSize-1)+1;
+    std::vector<icFloat64Number> px(nSamples), py(nSamples);
+
+    for (k=0; k<nSamples; k++) {
+      px[k] = (icFloat64Number)k / (nSamples-1);
+      py[k] = Apply((icFloatNumber)px[k]);
+      if (k && py[k]<py[k-1])
+        py[k] = py[k-1];
+    }
+
+    icInvertSamples(Lut, nSize, &px[0], &py[0], nSamples, true);
+
+    //Match Find() behavior at the ends of the range
+    for (i=0; i<nSize; i++) {
+      x = (icFloatNumber)i / (icFloatNumber)(nSize-1);
+
+      if (x<=v0)
+        Lut[i] = 0;
+      else if (x>=v1)
+        Lut[i] = 1.0;
+    }
+  }
+
+  return pInv;
+}
+
+
 /**
 ****************************************************************************
 * Name: CIccTagCurve::CIccTagCurve
@@ -591,6 +768,88 @@ icFloatNumber CIccTagCurve::Apply(icFloatNumber v) const
 }
 
 
+/**
+****************************************************************************
+* Name: CIccTagCurve::ApplyInverse
+* 
+* Purpose: Closed form inverse for identity and gamma curves
+* 
+* Args:
+*  v = value to invert
+* 
+* Return:
+*  position on curve that results in v
+*****************************************************************************
+*/
+icFloatNumber CIccTagCurve::ApplyInverse(icFloatNumber v) const
+{
+  if(v<0.0) v = 0.0;
+  else if(v>1.0) v = 1.0;
+
+  if (m_nSize==1) {
+    icFloatNumber dGamma = (icFloatNumber)(m_Curve[0] * 65535.0 / 256.0);
+    if (dGamma>0 && v>0)
+      return (icFloatNumber)pow(v, 1.0/dGamma);
+  }
+
+  return v;
+}
+
+
+/**
+****************************************************************************
+* Name: CIccTagCurve::NewInverse
+* 
+* Purpose: Creates a table based inverse of the curve.  Sampled curves are
+*  linear between entries so the inverse is exactly linear between the
+*  entries of the curve.
+* 
+* Args:
+*  nSize = number of entries in the inverse table (2 to 65536)
+* 
+* Return:
+*  New inverse curve (owned by caller) or NULL if nSize is out of range
+*****************************************************************************
+*/
+CIccTagCurve *CIccTagCurve::NewInverse(icUInt32Number nSize/*=icDefaultInvCurveSize*/)
+{
+  Begin();
+
+  icFloatNumber v0 = Apply(0), v1 = Apply(1.0);
+
+  if (m_nSize<2 || !(v1>v0))
+    return CIccCurve::NewInverse(nSize);
+
+  if (nSize<2 || nSize>65536)
+    return NULL;
+
+  CIccTagCurve *pInv = new CIccTagCurve(nSize);
+  icFloatNumber *Lut = pInv->GetData(0);
+  std::vector<icFloat64Number> px(m_nSize), py(m_nSize);
+  icUInt32Number k;
+
+  for (k=0; k<m_nSize; k++) {
+    px[k] = (icFloat64Number)k / (m_nSize-1);
+    py[k] = Apply((icFloatNumber)px[k]);
+    if (k && py[k]<py[k-1])
+      py[k] = py[k-1];
+  }
+
+  icInvertSamples(Lut, nSize, &px[0], &py[0], m_nSize, false);
+
+  for (k=0; k<nSize; k++) {
+    icFloatNumber x = (icFloatNumber)k / (icFloatNumber)(nSize-1);
+
+    if (x<=v0)
+      Lut[k] = 0;
+    else if (x>=v1)
+      Lut[k] = 1.0;
+  }
+
+  return pInv;
+}
+
+
 /**
 ******************************************************************************
 * Name: CIccTagCurve::Validate
@@ -660,6 +919,7 @@ CIccTagParametricCurve::CIccTagParametricCurve()
 CIccTagParametricCurve::CIccTagParametricCurve(const CIccTagParametricCurve &ITPC)
 {
   m_nFunctionType = ITPC.m_nFunctionType;
+  m_nReserved2 = ITPC.m_nReserved2;
   m_nNumParam = ITPC.m_nNumParam;
 
   m_dParam = new icFloatNumber[m_nNumParam];
@@ -683,6 +943,7 @@ CIccTagParametricCurve &CIccTagParametricCurve::operator=(const CIccTagParametri
     return *this;
 
   m_nFunctionType = ParamCurveTag.m_nFunctionType;
+  m_nReserved2 = ParamCurveTag.m_nReserved2;
   m_nNumParam = ParamCurveTag.m_nNumParam;
 
   if (m_dParam)
@@ -1068,6 +1329,107 @@ icFloatNumber CIccTagParametricCurve::Apply(icFloatNumber X) const
 }
 
 
+/**
+******************************************************************************
+* Name: CIccTagParametricCurve::IsInvertible
+* 
+* Purpose: Determines whether ApplyInverse() can be used.  This requires a
+*  positive gamma and slope so that the function is increasing.
+* 
+* Return: 
+*  true if the curve has a closed form inverse
+******************************************************************************
+*/
+bool CIccTagParametricCurve::IsInvertible() const
+{
+  if (!m_dParam || !m_nNumParam || m_dParam[0]<=0)
+    return false;
+
+  switch(m_nFunctionType) {
+    case 0x0000:
+      return true;
+
+    case 0x0001:
+    case 0x0002:
+      return m_nNumParam>=(m_nFunctionType==0x0001 ? 3 : 4) && m_dParam[1]>0;
+
+    case 0x0003:
+    case 0x0004:
+      return m_nNumParam>=(m_nFunctionType==0x0003 ? 5 : 7) && m_dParam[1]>0 && m_dParam[3]>=0;
+
+    default:
+      return false;
+  }
+}
+
+
+/**
+******************************************************************************
+* Name: CIccTagParametricCurve::ApplyInverse
+* 
+* Purpose: Closed form inverse of Apply().  Only valid if IsInvertible()
+*  returns true.  Values in gaps between the two pieces of function types 3
+*  and 4 map to the break point.
+* 
+* Args: 
+*  Y = value to invert
+* 
+* Return: 
+*  X value where Apply(X) results in Y
+******************************************************************************
+*/
+icFloatNumber CIccTagParametricCurve::ApplyInverse(icFloatNumber Y) const
+{
+  double g = m_dParam[0];
+  double a, b, c, d, e, f, y, yd;
+
+  switch(m_nFunctionType) {
+    case 0x0000:
+      if (Y<=0)
+        return 0;
+      return (icFloatNumber)pow(Y, 1.0/g);
+
+    case 0x0001:
+    case 0x0002:
+      a=m_dParam[1];
+      b=m_dParam[2];
+      y = Y;
+      if (m_nFunctionType==0x0002)
+        y -= m_dParam[3];
+
+      if (y<=0)
+        return (icFloatNumber)(-b/a);
+      return (icFloatNumber)((pow(y, 1.0/g) - b) / a);
+
+    case 0x0003:
+    case 0x0004:
+      a=m_dParam[1];
+      b=m_dParam[2];
+      c=m_dParam[3];
+      d=m_dParam[4];
+      e = m_nFunctionType==0x0004 ? m_dParam[5] : 0.0;
+      f = m_nFunctionType==0x0004 ? m_dParam[6] : 0.0;
+
+      yd = a*d + b;
+      yd = (yd>0 ? pow(yd, g) : 0.0) + e;
+
+      if (Y >= yd) {
+        y = Y - e;
+        double x = y>0 ? (pow(y, 1.0/g) - b) / a : -b/a;
+        return (icFloatNumber)(x>d ? x : d);
+      }
+      else if (c>0) {
+        double x = (Y - f) / c;
+        return (icFloatNumber)(x<d ? x : d);
+      }
+      return (icFloatNumber)d;
+
+    default:
+      return Y;
+  }
+}
+
+
 /**
 ******************************************************************************
 * Name: CIccTagParametricCurve::Validate
@@ -1607,6 +1969,198 @@ static icFloatNumber ClutUnitClip(icFloatNumber v)
   return v;
 }
 
+//Converts half float bits to a float.  Normal and subnormal values are rebiased
+//with a single multiply, infinities and NaNs are left to icF16toF().
+static inline icFloatNumber icCLUTHalfToFloat(icUInt16Number v)
+{
+  if ((v & 0x7C00)==0x7C00)
+    return icF16toF((icFloat16Number)v);
+
+  union {
+    icUInt32Number n;
+    icFloat32Number f;
+  } bits;
+
+  bits.n = ((icUInt32Number)(v & 0x7FFF)) << 13;
+  bits.f *= 5.192296858534828e+33f; // 2^112
+  bits.n |= ((icUInt32Number)(v & 0x8000)) << 16;
+
+  return (icFloatNumber)bits.f;
+}
+
+//Grid value access used by the CIccCLUT interpolation kernels.  Value() converts
+//a stored grid value, Result() is applied to each interpolated output.  Float32 is
+//non-zero when the grid holds 32 bit floats that a vector kernel can load directly.
+struct icCLUTFloatData
+{
+  typedef icFloatNumber Type;
+  enum { Float32 = (sizeof(icFloatNumber)==sizeof(icFloat32Number)) };
+  static inline icFloatNumber Value(icFloatNumber v) { return v; }
+  static inline icFloatNumber Result(icFloatNumber v) { return v; }
+};
+
+struct icCLUTUInt16Data
+{
+  typedef icUInt16Number Type;
+  enum { Float32 = 0 };
+  static inline icFloatNumber Value(icUInt16Number v) { return (icFloatNumber)v; }
+  //interpolation is linear so the values are normalized once per output
+  static inline icFloatNumber Result(icFloatNumber v) { return v * (icFloatNumber)(1.0/65535.0); }
+};
+
+struct icCLUTFloat16Data
+{
+  typedef icUInt16Number Type;
+  enum { Float32 = 0 };
+  static inline icFloatNumber Value(icUInt16Number v) { return icCLUTHalfToFloat(v); }
+  static inline icFloatNumber Result(icFloatNumber v) { return v; }
+};
+
+//Output loops of the CIccCLUT interpolation kernels.  Tetra() applies a tetrahedron
+//given as three corner differences, Sum() weights N corners.  All outputs of a grid
+//point are contiguous so a vector version can interpolate several outputs at once.
+template <class D, bool bFloat32 = (D::Float32 != 0)>
+struct icCLUTKernel
+{
+  typedef typename D::Type T;
+
+  static inline void Tetra(icFloatNumber *destPixel, const T *p, icUInt32Number nOutput, const T *pEnd,
+                           icUInt32Number t1, icUInt32Number t0, icUInt32Number u1, icUInt32Number u0,
+                           icUInt32Number v1, icUInt32Number v0, icFloatNumber t, icFloatNumber u, icFloatNumber v)
+  {
+    for (icUInt32Number i=0; i<nOutput; i++, p++) {
+      destPixel[i] = D::Result(D::Value(p[0]) + t*(D::Value(p[t1])-D::Value(p[t0])) +
+                                                u*(D::Value(p[u1])-D::Value(p[u0])) +
+                                                v*(D::Value(p[v1])-D::Value(p[v0])));
+    }
+  }
+
+  template <int N>
+  static inline void Sum(icFloatNumber *destPixel, const T *p, icUInt32Number nOutput, const T *pEnd,
+                         const icUInt32Number *pOffset, const icFloatNumber *dF)
+  {
+    for (icUInt32Number i=0; i<nOutput; i++, p++) {
+      icFloatNumber pv = D::Value(p[pOffset[0]])*dF[0];
+      for (int j=1; j<N; j++)
+        pv += D::Value(p[pOffset[j]])*dF[j];
+
+      destPixel[i] = D::Result(pv);
+    }
+  }
+};
+
+#if defined(ICC_USE_SSE2) || defined(ICC_USE_NEON)
+
+#if defined(ICC_USE_SSE2)
+typedef __m128 icCLUTVec;
+static inline icCLUTVec icVecLoad(const icFloat32Number *p) { return _mm_loadu_ps(p); }
+static inline icCLUTVec icVecSet(icFloat32Number v) { return _mm_set1_ps(v); }
+static inline icCLUTVec icVecAdd(icCLUTVec a, icCLUTVec b) { return _mm_add_ps(a, b); }
+static inline icCLUTVec icVecSub(icCLUTVec a, icCLUTVec b) { return _mm_sub_ps(a, b); }
+static inline icCLUTVec icVecMul(icCLUTVec a, icCLUTVec b) { return _mm_mul_ps(a, b); }
+static inline void icVecStore(icFloat32Number *p, icCLUTVec a) { _mm_storeu_ps(p, a); }
+#else
+typedef float32x4_t icCLUTVec;
+static inline icCLUTVec icVecLoad(const icFloat32Number *p) { return vld1q_f32(p); }
+static inline icCLUTVec icVecSet(icFloat32Number v) { return vdupq_n_f32(v); }
+static inline icCLUTVec icVecAdd(icCLUTVec a, icCLUTVec b) { return vaddq_f32(a, b); }
+static inline icCLUTVec icVecSub(icCLUTVec a, icCLUTVec b) { return vsubq_f32(a, b); }
+static inline icCLUTVec icVecMul(icCLUTVec a, icCLUTVec b) { return vmulq_f32(a, b); }
+static inline void icVecStore(icFloat32Number *p, icCLUTVec a) { vst1q_f32(p, a); }
+#endif
+
+//32 bit float grids interpolate four outputs at a time.  The operation order is the
+//same as the scalar loop, so results match it unless the compiler contracts the scalar
+//code into fused multiply-adds (e.g. -ffp-contract=fast with FMA enabled).  A remainder
+//of three outputs (the common RGB/XYZ/Lab case) also uses a vector when the fourth lane
+//can be read without going past the end of the grid, and only three lanes are stored.
+//When icFloatNumber is double the scalar template is used.
+template <>
+struct icCLUTKernel<icCLUTFloatData, true>
+{
+  static inline void Tetra(icFloat32Number *destPixel, const icFloat32Number *p, icUInt32Number nOutput, const icFloat32Number *pEnd,
+                           icUInt32Number t1, icUInt32Number t0, icUInt32Number u1, icUInt32Number u0,
+                           icUInt32Number v1, icUInt32Number v0, icFloat32Number t, icFloat32Number u, icFloat32Number v)
+  {
+    icCLUTVec vt = icVecSet(t), vu = icVecSet(u), vv = icVecSet(v);
+    icUInt32Number nLast = icMax(icMax(icMax(t1, t0), icMax(u1, u0)), icMax(v1, v0));
+    icUInt32Number i = 0;
+
+    for (;;) {
+      icUInt32Number nLeft = nOutput - i;
+
+      if (nLeft<3 || (nLeft==3 && p + nLast + 4 > pEnd))
+        break;
+
+      icCLUTVec r = icVecAdd(icVecAdd(icVecAdd(icVecLoad(p),
+                                               icVecMul(vt, icVecSub(icVecLoad(p+t1), icVecLoad(p+t0)))),
+                                      icVecMul(vu, icVecSub(icVecLoad(p+u1), icVecLoad(p+u0)))),
+                             icVecMul(vv, icVecSub(icVecLoad(p+v1), icVecLoad(p+v0))));
+
+      if (nLeft>=4) {
+        icVecStore(destPixel+i, r);
+        i += 4;
+        p += 4;
+      }
+      else {
+        icFloat32Number tmp[4];
+        icVecStore(tmp, r);
+        destPixel[i] = tmp[0];
+        destPixel[i+1] = tmp[1];
+        destPixel[i+2] = tmp[2];
+        return;
+      }
+    }
+
+    for (; i<nOutput; i++, p++) {
+      destPixel[i] = p[0] + t*(p[t1]-p[t0]) + u*(p[u1]-p[u0]) + v*(p[v1]-p[v0]);
+    }
+  }
+
+  template <int N>
+  static inline void Sum(icFloat32Number *destPixel, const icFloat32Number *p, icUInt32Number nOutput, const icFloat32Number *pEnd,
+                         const icUInt32Number *pOffset, const icFloat32Number *dF)
+  {
+    icUInt32Number i = 0;
+    int j;
+
+    for (;;) {
+      icUInt32Number nLeft = nOutput - i;
+
+      if (nLeft<3 || (nLeft==3 && p + pOffset[N-1] + 4 > pEnd))
+        break;
+
+      icCLUTVec r = icVecMul(icVecLoad(p+pOffset[0]), icVecSet(dF[0]));
+      for (j=1; j<N; j++)
+        r = icVecAdd(r, icVecMul(icVecLoad(p+pOffset[j]), icVecSet(dF[j])));
+
+      if (nLeft>=4) {
+        icVecStore(destPixel+i, r);
+        i += 4;
+        p += 4;
+      }
+      else {
+        icFloat32Number tmp[4];
+        icVecStore(tmp, r);
+        destPixel[i] = tmp[0];
+        destPixel[i+1] = tmp[1];
+        destPixel[i+2] = tmp[2];
+        return;
+      }
+    }
+
+    for (; i<nOutput; i++, p++) {
+      icFloat32Number pv = p[pOffset[0]]*dF[0];
+      for (j=1; j<N; j++)
+        pv += p[pOffset[j]]*dF[j];
+
+      destPixel[i] = pv;
+    }
+  }
+};
+
+#endif
+
 /**
  ****************************************************************************
  * Name: CIccCLUT::CIccCLUT
@@ -1625,11 +2179,11 @@ CIccCLUT::CIccCLUT(icUInt8Number nInputChannels, icUInt16Number nOutputChannels,
   m_nOutput = nOutputChannels;
   m_nPrecision = nPrecision;
   m_pData = NULL;
+  m_nStorage = icCLUTStorageFloat;
+  m_pCompact = NULL;
+  m_fStorageError = 0;
   m_nOffset = NULL;
-  m_g = NULL;
-  m_ig = NULL;
-  m_s = NULL;
-  m_df = NULL;
+  m_pApply = NULL;
   memset(&m_nReserved2, 0 , sizeof(m_nReserved2));
 
   UnitClip = ClutUnitClip;
@@ -1650,10 +2204,7 @@ CIccCLUT::CIccCLUT(const CIccCLUT &ICLUT)
 {
   m_pData = NULL;
   m_nOffset = NULL;
-  m_g = NULL;
-  m_ig = NULL;
-  m_s = NULL;
-  m_df = NULL;
+  m_pApply = NULL;
   m_nInput = ICLUT.m_nInput;
   m_nOutput = ICLUT.m_nOutput;
   m_nPrecision = ICLUT.m_nPrecision;
@@ -1667,9 +2218,19 @@ CIccCLUT::CIccCLUT(const CIccCLUT &ICLUT)
   memcpy(m_GridAdr, ICLUT.m_GridAdr, sizeof(m_GridAdr));
   memcpy(&m_nReserved2, &ICLUT.m_nReserved2, sizeof(m_nReserved2));
 
+  m_nStorage = ICLUT.m_nStorage;
+  m_pCompact = NULL;
+  m_fStorageError = ICLUT.m_fStorageError;
+
   int num = NumPoints()*m_nOutput;
-  m_pData = new icFloatNumber[num];
-  memcpy(m_pData, ICLUT.m_pData, num*sizeof(icFloatNumber));
+  if (ICLUT.m_pCompact) {
+    m_pCompact = new icUInt16Number[num];
+    memcpy(m_pCompact, ICLUT.m_pCompact, num*sizeof(icUInt16Number));
+  }
+  else if (ICLUT.m_pData) {
+    m_pData = new icFloatNumber[num];
+    memcpy(m_pData, ICLUT.m_pData, num*sizeof(icFloatNumber));
+  }
 
   UnitClip = ICLUT.UnitClip;
 }
@@ -1704,11 +2265,18 @@ CIccCLUT &CIccCLUT::operator=(const CIccCLUT &CLUTTag)
   memcpy(m_nReserved2, &CLUTTag.m_nReserved2, sizeof(m_nReserved2));
 
   int num;
-  if (m_pData)
-    delete [] m_pData;
+  FreeData();
   num = NumPoints()*m_nOutput;
-  m_pData = new icFloatNumber[num];
-  memcpy(m_pData, CLUTTag.m_pData, num*sizeof(icFloatNumber));
+  if (CLUTTag.m_pCompact) {
+    m_pCompact = new icUInt16Number[num];
+    memcpy(m_pCompact, CLUTTag.m_pCompact, num*sizeof(icUInt16Number));
+  }
+  else if (CLUTTag.m_pData) {
+    m_pData = new icFloatNumber[num];
+    memcpy(m_pData, CLUTTag.m_pData, num*sizeof(icFloatNumber));
+  }
+  m_nStorage = CLUTTag.m_nStorage;
+  m_fStorageError = CLUTTag.m_fStorageError;
 
   UnitClip = CLUTTag.UnitClip;
 
@@ -1727,23 +2295,13 @@ CIccCLUT &CIccCLUT::operator=(const CIccCLUT &CLUTTag)
  */
 CIccCLUT::~CIccCLUT()
 {
-  if (m_pData)
-    delete [] m_pData;
+  FreeData();
 
   if (m_nOffset)
     delete [] m_nOffset;
 
-  if (m_g)
-    delete [] m_g;
-
-  if (m_ig)
-    delete [] m_ig;
-
-  if (m_s)
-    delete [] m_s;
-
-  if (m_df)
-    delete [] m_df;
+  if (m_pApply)
+    delete m_pApply;
 }
 
 /**
@@ -1767,7 +2325,10 @@ bool CIccCLUT::Init(icUInt8Number nGridPoints)
  ****************************************************************************
  * Name: CIccCLUT::Init
  * 
- * Purpose: Initializes and sets the size of the CLUT
+ * Purpose: Initializes and sets the size of the CLUT.  Storage for the grid
+ *  values is allocated when it is first needed (by GetData(), Begin() or
+ *  ReadTypedData()) so that reading compact data never allocates a float
+ *  grid as well.
  * 
  * Args:
  *  pGridPoints = number of grid points in the CLUT
@@ -1782,9 +2343,7 @@ bool CIccCLUT::Init(const icUInt8Number *pGridPoints)
       memset(m_GridPoints+m_nInput, 0, 16-m_nInput);
   }
 
-  if (m_pData) {
-    delete [] m_pData;
-  }
+  FreeData();
 
   int i=m_nInput-1;
 
@@ -1797,12 +2356,7 @@ bool CIccCLUT::Init(const icUInt8Number *pGridPoints)
 
   icUInt32Number nSize = NumPoints() * m_nOutput;
 
-  if (!nSize)
-    return false;
-
-  m_pData = new icFloatNumber[nSize];
-
-  return (m_pData != NULL);
+  return nSize!=0;
 }
 
 
@@ -1829,18 +2383,12 @@ bool CIccCLUT::ReadData(icUInt32Number size, CIccIO *pIO, icUInt8Number nPrecisi
   if (nNum * nPrecision > size)
     return false;
 
-  if (nPrecision==1) {
-    if (pIO->ReadUInt8Float(m_pData, nNum)!=(icInt32Number)nNum)
-      return false;
-  }
-  else if (nPrecision==2) {
-    if (pIO->ReadUInt16Float(m_pData, nNum)!=(icInt32Number)nNum)
-      return false;
-  }
-  else
-    return false;
+  if (nPrecision==1)
+    return ReadTypedData(pIO, icValueTypeUInt8);
+  else if (nPrecision==2)
+    return ReadTypedData(pIO, icValueTypeUInt16);
 
-  return true;
+  return false;
 }
 
 
@@ -1861,23 +2409,422 @@ bool CIccCLUT::ReadData(icUInt32Number size, CIccIO *pIO, icUInt8Number nPrecisi
  */
 bool CIccCLUT::WriteData(CIccIO *pIO, icUInt8Number nPrecision)
 {
-  icUInt32Number nNum=NumPoints() * m_nOutput;
+  if (nPrecision==1)
+    return WriteTypedData(pIO, icValueTypeUInt8);
+  else if (nPrecision==2)
+    return WriteTypedData(pIO, icValueTypeUInt16);
 
-  if (nPrecision==1) {
-    if (pIO->WriteUInt8Float(m_pData, nNum)!=(icInt32Number)nNum)
-      return false;
-  }
-  else if (nPrecision==2) {
-    if (pIO->WriteUInt16Float(m_pData, nNum)!=(icInt32Number)nNum)
-      return false;
+  return false;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::ReadTypedData
+ * 
+ * Purpose: Reads the CLUT data points encoded with an icValueEncodingType.
+ *  When native storage is selected for pIO (see CIccIO::SetNativeCLUTStorage())
+ *  8-bit, 16-bit and float16 encodings are kept in compact 16-bit storage
+ *  and no float grid is allocated.
+ * 
+ * Args:
+ *  pIO = IO object to read data from,
+ *  nValueType = icValueTypeUInt8, icValueTypeUInt16, icValueTypeFloat16 or
+ *   icValueTypeFloat32
+ *
+ * Return:
+ *  true = data read succesfully,
+ *  false = read data failed
+ *****************************************************************************
+ */
+bool CIccCLUT::ReadTypedData(CIccIO *pIO, icUInt16Number nValueType)
+{
+  icInt32Number i, nNum = NumPoints() * m_nOutput;
+
+  if (!nNum)
+    return false;
+
+  if (pIO->GetNativeCLUTStorage() && nValueType!=icValueTypeFloat32) {
+    icUInt16Number *pCompact;
+    icCLUTStorage nStorage = icCLUTStorageUInt16;
+
+    switch(nValueType) {
+      case icValueTypeUInt8:
+        {
+          pCompact = new icUInt16Number[nNum];
+          icUInt8Number *pBytes = (icUInt8Number*)pCompact;
+
+          if (pIO->Read8(pBytes, nNum)!=nNum) {
+            delete [] pCompact;
+            return false;
+          }
+          //Expand in place from the end so no byte is overwritten before it is used
+          for (i=nNum-1; i>=0; i--)
+            pCompact[i] = (icUInt16Number)(pBytes[i] * 257);
+        }
+        break;
+
+      case icValueTypeFloat16:
+        nStorage = icCLUTStorageFloat16;
+        //Fall through
+
+      case icValueTypeUInt16:
+        pCompact = new icUInt16Number[nNum];
+        if (pIO->Read16(pCompact, nNum)!=nNum) {
+          delete [] pCompact;
+          return false;
+        }
+        break;
+
+      default:
+        return false;
+    }
+
+    FreeData();
+    m_pCompact = pCompact;
+    m_nStorage = nStorage;
+
+    return true;
   }
-  else
+
+  if (m_pCompact)
+    FreeData();
+  if (!m_pData && !AllocData())
+    return false;
+
+  icFloatNumber *pData = m_pData;
+
+  switch(nValueType) {
+    case icValueTypeUInt8:
+      return pIO->ReadUInt8Float(pData, nNum)==nNum;
+
+    case icValueTypeUInt16:
+      return pIO->ReadUInt16Float(pData, nNum)==nNum;
+
+    case icValueTypeFloat16:
+      return pIO->ReadFloat16Float(pData, nNum)==nNum;
+
+    case icValueTypeFloat32:
+      return pIO->ReadFloat32Float(pData, nNum)==nNum;
+  }
+
+  return false;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::WriteTypedData
+ * 
+ * Purpose: Writes the CLUT data points with an icValueEncodingType.  Compact
+ *  storage is written directly when it matches the encoding and is otherwise
+ *  converted in blocks without expanding the CLUT.
+ * 
+ * Args:
+ *  pIO = IO object to write data to,
+ *  nValueType = icValueTypeUInt8, icValueTypeUInt16, icValueTypeFloat16 or
+ *   icValueTypeFloat32
+ *
+ * Return:
+ *  true = data written succesfully,
+ *  false = write operation failed
+ *****************************************************************************
+ */
+bool CIccCLUT::WriteTypedData(CIccIO *pIO, icUInt16Number nValueType)
+{
+  icInt32Number i, n, nNum = NumPoints() * m_nOutput;
+
+  if (!m_pData && !m_pCompact && !AllocData())
+    return false;
+
+  if (m_pCompact && ((nValueType==icValueTypeUInt16 && m_nStorage==icCLUTStorageUInt16) ||
+                     (nValueType==icValueTypeFloat16 && m_nStorage==icCLUTStorageFloat16)))
+    return pIO->Write16(m_pCompact, nNum)==nNum;
+
+  icFloatNumber buf[1024];
+
+  for (i=0; i<nNum; i+=n) {
+    icFloatNumber *pData;
+
+    n = nNum - i;
+    if (m_pCompact) {
+      if (n>1024)
+        n = 1024;
+      GetValues(buf, i, n);
+      pData = buf;
+    }
+    else
+      pData = &m_pData[i];
+
+    switch(nValueType) {
+      case icValueTypeUInt8:
+        if (pIO->WriteUInt8Float(pData, n)!=n)
+          return false;
+        break;
+
+      case icValueTypeUInt16:
+        if (pIO->WriteUInt16Float(pData, n)!=n)
+          return false;
+        break;
+
+      case icValueTypeFloat16:
+        if (pIO->WriteFloat16Float(pData, n)!=n)
+          return false;
+        break;
+
+      case icValueTypeFloat32:
+        if (pIO->WriteFloat32Float(pData, n)!=n)
+          return false;
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::GetValues
+ * 
+ * Purpose: Copies grid values as icFloatNumber without changing the storage
+ * 
+ * Args:
+ *  pDst = where the values are stored,
+ *  nStart = index of the first value,
+ *  nNum = number of values to copy
+ *
+ * Return:
+ *  true = values copied, false = range is outside of the CLUT
+ *****************************************************************************
+ */
+bool CIccCLUT::GetValues(icFloatNumber *pDst, icUInt32Number nStart, icUInt32Number nNum) const
+{
+  icUInt32Number i, nTotal = NumPoints() * m_nOutput;
+
+  if (nStart>nTotal || nNum>nTotal-nStart || (!m_pData && !m_pCompact))
     return false;
 
+  switch(m_nStorage) {
+    case icCLUTStorageUInt16:
+      for (i=0; i<nNum; i++)
+        pDst[i] = icCLUTUInt16Data::Result(icCLUTUInt16Data::Value(m_pCompact[nStart+i]));
+      break;
+
+    case icCLUTStorageFloat16:
+      for (i=0; i<nNum; i++)
+        pDst[i] = icCLUTHalfToFloat(m_pCompact[nStart+i]);
+      break;
+
+    default:
+      memcpy(pDst, &m_pData[nStart], nNum*sizeof(icFloatNumber));
+      break;
+  }
+
   return true;
 }
 
 
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::StoredValue
+ * 
+ * Purpose: Returns a single grid value as icFloatNumber
+ *****************************************************************************
+ */
+icFloatNumber CIccCLUT::StoredValue(icUInt32Number nIndex) const
+{
+  switch(m_nStorage) {
+    case icCLUTStorageUInt16:
+      return icCLUTUInt16Data::Result(icCLUTUInt16Data::Value(m_pCompact[nIndex]));
+
+    case icCLUTStorageFloat16:
+      return icCLUTHalfToFloat(m_pCompact[nIndex]);
+
+    default:
+      return m_pData ? m_pData[nIndex] : 0;
+  }
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::AllocData
+ * 
+ * Purpose: Allocates zeroed icFloatNumber storage for the grid values of a
+ *  CLUT that has no values yet
+ *****************************************************************************
+ */
+bool CIccCLUT::AllocData()
+{
+  icUInt32Number nNum = NumPoints() * m_nOutput;
+
+  if (m_pData || m_pCompact || !nNum)
+    return false;
+
+  m_pData = new icFloatNumber[nNum]();
+  m_nStorage = icCLUTStorageFloat;
+
+  return m_pData!=NULL;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::FreeData
+ * 
+ * Purpose: Releases the grid values and resets the storage to icFloatNumber
+ *****************************************************************************
+ */
+void CIccCLUT::FreeData()
+{
+  if (m_pData) {
+    delete [] m_pData;
+    m_pData = NULL;
+  }
+  if (m_pCompact) {
+    delete [] m_pCompact;
+    m_pCompact = NULL;
+  }
+  m_nStorage = icCLUTStorageFloat;
+  m_fStorageError = 0;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::SetStorage
+ * 
+ * Purpose: Converts the grid values to another storage format.  The
+ *  interpolation functions read every format directly, so this may be used
+ *  to trade accuracy for memory and cache footprint after the CLUT is
+ *  populated.  GetStorageError() reports the largest change in any value.
+ * 
+ * Args:
+ *  nStorage = new storage format
+ *
+ * Return:
+ *  true = converted, false = the values cannot be represented (UInt16 needs
+ *   values in the range 0..1, Float16 needs values within the half range)
+ *****************************************************************************
+ */
+bool CIccCLUT::SetStorage(icCLUTStorage nStorage)
+{
+  if (nStorage==m_nStorage)
+    return true;
+
+  if (!m_pData && !m_pCompact)
+    return false;
+
+  icUInt32Number i, nNum = NumPoints() * m_nOutput;
+  icFloatNumber fError = 0;
+
+  if (nStorage==icCLUTStorageFloat) {
+    icFloatNumber *pData = new icFloatNumber[nNum];
+    GetValues(pData, 0, nNum);
+
+    delete [] m_pCompact;
+    m_pCompact = NULL;
+    m_pData = pData;
+    m_nStorage = nStorage;
+
+    return true;
+  }
+
+  icUInt16Number *pCompact = new icUInt16Number[nNum];
+
+  for (i=0; i<nNum; i++) {
+    icFloatNumber v = StoredValue(i), c;
+
+    if (nStorage==icCLUTStorageUInt16) {
+      if (!(v>=0.0 && v<=1.0)) {
+        delete [] pCompact;
+        return false;
+      }
+      pCompact[i] = (icUInt16Number)(v * 65535.0 + 0.5);
+      c = icCLUTUInt16Data::Result(icCLUTUInt16Data::Value(pCompact[i]));
+    }
+    else {
+      pCompact[i] = (icUInt16Number)icFtoF16((icFloat32Number)v);
+      //values outside of the half range would become infinite
+      if ((pCompact[i] & 0x7C00)==0x7C00) {
+        delete [] pCompact;
+        return false;
+      }
+      c = icCLUTHalfToFloat(pCompact[i]);
+    }
+
+    if (fabs(c - v) > fError)
+      fError = (icFloatNumber)fabs(c - v);
+  }
+
+  icFloatNumber fPrevError = m_fStorageError;
+
+  FreeData();
+  m_pCompact = pCompact;
+  m_nStorage = nStorage;
+  m_fStorageError = fPrevError + fError;
+
+  return true;
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::GetStorageBytes
+ * 
+ * Purpose: Returns the number of bytes used to hold the grid values
+ *****************************************************************************
+ */
+icUInt32Number CIccCLUT::GetStorageBytes() const
+{
+  icUInt32Number nNum = NumPoints() * m_nOutput;
+
+  if (m_nStorage==icCLUTStorageFloat)
+    return nNum * sizeof(icFloatNumber);
+
+  return nNum * sizeof(icUInt16Number);
+}
+
+
+/**
+ ****************************************************************************
+ * Name: CIccCLUT::DescribeStorage
+ * 
+ * Purpose: Adds a line describing the grid storage format, its memory use
+ *  and the largest difference from the values the CLUT was populated with.
+ * 
+ * Args:
+ *  sDescription = string to concatenate the report to
+ *****************************************************************************
+ */
+void CIccCLUT::DescribeStorage(std::string &sDescription) const
+{
+  icChar buf[256];
+  const icChar *szStorage;
+
+  switch(m_nStorage) {
+    case icCLUTStorageUInt16:
+      szStorage = "UInt16";
+      break;
+    case icCLUTStorageFloat16:
+      szStorage = "Float16";
+      break;
+    default:
+      szStorage = "Float";
+      break;
+  }
+
+  sprintf(buf, "CLUT storage: %s, %u bytes (%u bytes as float), max error %g\r\n", szStorage,
+          GetStorageBytes(), (icUInt32Number)(NumPoints() * m_nOutput * sizeof(icFloatNumber)),
+          (double)m_fStorageError);
+  sDescription += buf;
+}
+
+
 /**
  ****************************************************************************
  * Name: CIccCLUT::Read
@@ -1956,7 +2903,6 @@ void CIccCLUT::Iterate(std::string &sDescription, icUInt8Number nIndex, icUInt32
   }
   else {
     icChar *ptr = m_pOutText;
-    icFloatNumber *pData = &m_pData[nPos];
     int i;
 
     for (i=0; i<m_nInput; i++) {
@@ -1968,7 +2914,7 @@ void CIccCLUT::Iterate(std::string &sDescription, icUInt8Number nIndex, icUInt32
     ptr += 2;
 
     for (i=0; i<m_nOutput; i++) {
-      icColorValue(m_pVal, pData[i], m_csOutput, i, bUseLegacy);
+      icColorValue(m_pVal, StoredValue(nPos+i), m_csOutput, i, bUseLegacy);
 
       ptr += sprintf(ptr, " %s", m_pVal);
     }
@@ -1993,6 +2939,12 @@ void CIccCLUT::Iterate(std::string &sDescription, icUInt8Number nIndex, icUInt32
  */
 void CIccCLUT::Iterate(IIccCLUTExec* pExec)
 {
+  //PixelOp() may change the grid values
+  if (m_pCompact)
+    SetStorage(icCLUTStorageFloat);
+  else if (!m_pData && !AllocData())
+    return;
+
   memset(&m_fGridAdr[0], 0, sizeof(m_fGridAdr));
   if (m_nInput==3) {
     int i,j,k;
@@ -2085,6 +3037,9 @@ void CIccCLUT::DumpLut(std::string  &sDescription, const icChar *szName,
   icChar szOutText[200000], szColor[40];
   int i, len;
 
+  if (m_nStorage!=icCLUTStorageFloat)
+    DescribeStorage(sDescription);
+
   sprintf(szOutText, "BEGIN_LUT %s %d %d\r\n", szName, m_nInput, m_nOutput);
   sDescription += szOutText;
 
@@ -2142,6 +3097,11 @@ void CIccCLUT::DumpLut(std::string  &sDescription, const icChar *szName,
 void CIccCLUT::Begin()
 {
   int i;
+
+  //Interpolation needs grid values even if the CLUT was never populated
+  if (!m_pData && !m_pCompact)
+    AllocData();
+
   for (i=0; i<m_nInput; i++) {
     m_MaxGridPoint[i] = m_GridPoints[i] - 1;
   }
@@ -2292,10 +3252,9 @@ void CIccCLUT::Begin()
   }
   else {
     //initialize ND interpolation variables
-    m_g = new icFloatNumber[m_nInput];
-    m_ig = new icUInt32Number[m_nInput];
-    m_s = new icFloatNumber[m_nInput];
-    m_df = new icFloatNumber[m_nNodes];
+    if (m_pApply)
+      delete m_pApply;
+    m_pApply = GetNewApply();
     
     m_nOffset[0] = 0;
     int count, nFlag;
@@ -2335,7 +3294,8 @@ void CIccCLUT::Begin()
 *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
 *******************************************************************************
 */
-void CIccCLUT::Interp1d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp1dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number mx = m_MaxGridPoint[0];
 
@@ -2353,7 +3313,7 @@ void CIccCLUT::Interp1d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber nu = (icFloatNumber)(1.0 - u);
 
   int i;
-  icFloatNumber *p = &m_pData[ix*n001];
+  const typename D::Type *p = &pData[ix*n001];
 
   //Normalize grid units
   icFloatNumber dF0, dF1, pv;
@@ -2362,9 +3322,25 @@ void CIccCLUT::Interp1d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   dF1 =  u;
 
   for (i=0; i<m_nOutput; i++, p++) {
-    pv = p[n000]*dF0 + p[n001]*dF1;
+    pv = D::Value(p[n000])*dF0 + D::Value(p[n001])*dF1;
+
+    destPixel[i] = D::Result(pv);
+  }
+}
 
-    destPixel[i] = pv;
+
+void CIccCLUT::Interp1d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp1dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp1dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp1dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
   }
 }
 
@@ -2379,7 +3355,8 @@ void CIccCLUT::Interp1d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
 *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
 *******************************************************************************
 */
-void CIccCLUT::Interp2d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp2dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number mx = m_MaxGridPoint[0];
   icUInt8Number my = m_MaxGridPoint[1];
@@ -2406,7 +3383,7 @@ void CIccCLUT::Interp2d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber nu = (icFloatNumber)(1.0 - u);
 
   int i;
-  icFloatNumber *p = &m_pData[ix*n001 + iy*n010];
+  const typename D::Type *p = &pData[ix*n001 + iy*n010];
 
   //Normalize grid units
   icFloatNumber dF0, dF1, dF2, dF3, pv;
@@ -2417,9 +3394,25 @@ void CIccCLUT::Interp2d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   dF3 =  t*  u;
 
   for (i=0; i<m_nOutput; i++, p++) {
-    pv = p[n000]*dF0 + p[n001]*dF1 + p[n010]*dF2 + p[n011]*dF3;
+    pv = D::Value(p[n000])*dF0 + D::Value(p[n001])*dF1 + D::Value(p[n010])*dF2 + D::Value(p[n011])*dF3;
+
+    destPixel[i] = D::Result(pv);
+  }
+}
+
 
-    destPixel[i] = pv;
+void CIccCLUT::Interp2d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp2dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp2dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp2dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
   }
 }
 
@@ -2434,7 +3427,8 @@ void CIccCLUT::Interp2d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
  *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
  *******************************************************************************
  */
-void CIccCLUT::Interp3dTetra(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp3dTetraT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number mx = m_MaxGridPoint[0];
   icUInt8Number my = m_MaxGridPoint[1];
@@ -2465,47 +3459,52 @@ void CIccCLUT::Interp3dTetra(icFloatNumber *destPixel, const icFloatNumber *srcP
     t = 1.0;
   }
 
-  int i;
-  icFloatNumber *p = &m_pData[ix*n001 + iy*n010 + iz*n100];
+  const typename D::Type *p = &pData[ix*n001 + iy*n010 + iz*n100];
 
-  //Normalize grid units
+  //Select the tetrahedron once and express it as three corner differences
+  icUInt32Number t1, t0, u1, u0, v1, v0;
 
-  for (i=0; i<m_nOutput; i++, p++) {
-    if (t<u) {
-      if (t>v) {
-        destPixel[i] = (p[n000] + t*(p[n110]-p[n010]) +
-                                      u*(p[n010]-p[n000]) +
-                                      v*(p[n111]-p[n110]));
-      }
-      else if (u<v) {
-        destPixel[i] = (p[n000] + t*(p[n111]-p[n011]) + 
-                                      u*(p[n011]-p[n001]) +
-                                      v*(p[n001]-p[n000]));
-      }
-      else {
-        destPixel[i] = (p[n000] + t*(p[n111]-p[n011]) +
-                                      u*(p[n010]-p[n000]) +
-                                      v*(p[n011]-p[n010]));
-      }
+  if (t<u) {
+    if (t>v) {
+      t1 = n110; t0 = n010; u1 = n010; u0 = n000; v1 = n111; v0 = n110;
     }
-    else { 
-      if (t<v) {
-        destPixel[i] = (p[n000] + t*(p[n101]-p[n001]) + 
-                                      u*(p[n111]-p[n101]) + 
-                                      v*(p[n001]-p[n000]));
-      }
-      else if (u<v) {
-        destPixel[i] = (p[n000] + t*(p[n100]-p[n000]) + 
-                                      u*(p[n111]-p[n101]) + 
-                                      v*(p[n101]-p[n100]));
-      }
-      else {
-        destPixel[i] = (p[n000] + t*(p[n100]-p[n000]) + 
-                                      u*(p[n110]-p[n100]) + 
-                                      v*(p[n111]-p[n110]));
-      }
+    else if (u<v) {
+      t1 = n111; t0 = n011; u1 = n011; u0 = n001; v1 = n001; v0 = n000;
+    }
+    else {
+      t1 = n111; t0 = n011; u1 = n010; u0 = n000; v1 = n011; v0 = n010;
     }
   }
+  else { 
+    if (t<v) {
+      t1 = n101; t0 = n001; u1 = n111; u0 = n101; v1 = n001; v0 = n000;
+    }
+    else if (u<v) {
+      t1 = n100; t0 = n000; u1 = n111; u0 = n101; v1 = n101; v0 = n100;
+    }
+    else {
+      t1 = n100; t0 = n000; u1 = n110; u0 = n100; v1 = n111; v0 = n110;
+    }
+  }
+
+  //Interpolate all output channels with the same corners
+  icCLUTKernel<D>::Tetra(destPixel, p, m_nOutput, pData + m_nNumPoints*m_nOutput, t1, t0, u1, u0, v1, v0, t, u, v);
+}
+
+
+void CIccCLUT::Interp3dTetra(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp3dTetraT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp3dTetraT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp3dTetraT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
+  }
 }
 
 
@@ -2520,7 +3519,8 @@ void CIccCLUT::Interp3dTetra(icFloatNumber *destPixel, const icFloatNumber *srcP
  *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
  *******************************************************************************
  */
-void CIccCLUT::Interp3d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp3dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number mx = m_MaxGridPoint[0];
   icUInt8Number my = m_MaxGridPoint[1];
@@ -2555,26 +3555,36 @@ void CIccCLUT::Interp3d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber nt = (icFloatNumber)(1.0 - t);
   icFloatNumber nu = (icFloatNumber)(1.0 - u);
 
-  int i;
-  icFloatNumber *p = &m_pData[ix*n001 + iy*n010 + iz*n100];
+  const typename D::Type *p = &pData[ix*n001 + iy*n010 + iz*n100];
 
   //Normalize grid units
-  icFloatNumber dF0, dF1, dF2, dF3, dF4, dF5, dF6, dF7, pv;
-
-  dF0 = ns* nt* nu;
-  dF1 = ns* nt*  u;
-  dF2 = ns*  t* nu;
-  dF3 = ns*  t*  u;
-  dF4 =  s* nt* nu;
-  dF5 =  s* nt*  u;
-  dF6 =  s*  t* nu;
-  dF7 =  s*  t*  u;
+  icFloatNumber dF[8];
+
+  dF[0] = ns* nt* nu;
+  dF[1] = ns* nt*  u;
+  dF[2] = ns*  t* nu;
+  dF[3] = ns*  t*  u;
+  dF[4] =  s* nt* nu;
+  dF[5] =  s* nt*  u;
+  dF[6] =  s*  t* nu;
+  dF[7] =  s*  t*  u;
+
+  icCLUTKernel<D>::template Sum<8>(destPixel, p, m_nOutput, pData + m_nNumPoints*m_nOutput, m_nOffset, dF);
+}
 
-  for (i=0; i<m_nOutput; i++, p++) {
-    pv = p[n000]*dF0 + p[n001]*dF1 + p[n010]*dF2 + p[n011]*dF3 +
-         p[n100]*dF4 + p[n101]*dF5 + p[n110]*dF6 + p[n111]*dF7;
 
-    destPixel[i] = pv;
+void CIccCLUT::Interp3d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp3dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp3dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp3dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
   }
 }
 
@@ -2590,7 +3600,8 @@ void CIccCLUT::Interp3d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
  *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
  *******************************************************************************
  */
-void CIccCLUT::Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp4dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number mw = m_MaxGridPoint[0];
   icUInt8Number mx = m_MaxGridPoint[1];
@@ -2634,11 +3645,10 @@ void CIccCLUT::Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber nu = (icFloatNumber)(1.0 - u);
   icFloatNumber nv = (icFloatNumber)(1.0 - v);
 
-  int i, j;
-  icFloatNumber *p = &m_pData[iw*n001 + ix*n010 + iy*n100 + iz*n1000];
+  const typename D::Type *p = &pData[iw*n001 + ix*n010 + iy*n100 + iz*n1000];
 
   //Normalize grid units
-  icFloatNumber dF[16], pv;
+  icFloatNumber dF[16];
 
   dF[ 0] = ns* nt* nu* nv;
   dF[ 1] = ns* nt* nu*  v;
@@ -2657,11 +3667,130 @@ void CIccCLUT::Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   dF[14] =  s*  t*  u* nv;
   dF[15] =  s*  t*  u*  v;
 
-  for (i=0; i<m_nOutput; i++, p++) {
-    for (pv=0, j=0; j<16; j++)
-      pv += p[m_nOffset[j]] * dF[j];
+  icCLUTKernel<D>::template Sum<16>(destPixel, p, m_nOutput, pData + m_nNumPoints*m_nOutput, m_nOffset, dF);
+}
+
+
+void CIccCLUT::Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp4dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp4dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp4dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccCLUT::Interp3dTetraN
+ * 
+ * Purpose: Tetrahedral interpolation of a buffer of pixels
+ *
+ * Args:
+ *  destPixels = where results are stored (may be the same as srcPixels),
+ *  srcPixels = pixel values to be found in the CLUT,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels
+ *******************************************************************************
+ */
+void CIccCLUT::Interp3dTetraN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                              icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icUInt32Number k;
+
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dTetraT<icCLUTUInt16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dTetraT<icCLUTFloat16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    default:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dTetraT<icCLUTFloatData>(destPixels, srcPixels, m_pData);
+      break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccCLUT::Interp3dN
+ * 
+ * Purpose: Three dimensional interpolation of a buffer of pixels
+ *
+ * Args:
+ *  destPixels = where results are stored (may be the same as srcPixels),
+ *  srcPixels = pixel values to be found in the CLUT,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels
+ *******************************************************************************
+ */
+void CIccCLUT::Interp3dN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                         icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icUInt32Number k;
 
-    destPixel[i] = pv;
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dT<icCLUTUInt16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dT<icCLUTFloat16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    default:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp3dT<icCLUTFloatData>(destPixels, srcPixels, m_pData);
+      break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccCLUT::Interp4dN
+ * 
+ * Purpose: Four dimensional interpolation of a buffer of pixels
+ *
+ * Args:
+ *  destPixels = where results are stored (may be the same as srcPixels),
+ *  srcPixels = pixel values to be found in the CLUT,
+ *  nPixels = number of pixels,
+ *  nDstStride = number of samples between destination pixels,
+ *  nSrcStride = number of samples between source pixels
+ *******************************************************************************
+ */
+void CIccCLUT::Interp4dN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                         icUInt32Number nDstStride, icUInt32Number nSrcStride) const
+{
+  icUInt32Number k;
+
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp4dT<icCLUTUInt16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp4dT<icCLUTFloat16Data>(destPixels, srcPixels, m_pCompact);
+      break;
+    default:
+      for (k=0; k<nPixels; k++, destPixels+=nDstStride, srcPixels+=nSrcStride)
+        Interp4dT<icCLUTFloatData>(destPixels, srcPixels, m_pData);
+      break;
   }
 }
 
@@ -2676,7 +3805,8 @@ void CIccCLUT::Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
  *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
  *******************************************************************************
  */
-void CIccCLUT::Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp5dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number m0 = m_MaxGridPoint[0];
   icUInt8Number m1 = m_MaxGridPoint[1];
@@ -2730,7 +3860,7 @@ void CIccCLUT::Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber ns4 = (icFloatNumber)(1.0 - s4);
 
   int i, j;
-  icFloatNumber *p = &m_pData[ig0*n001 + ig1*n010 + ig2*n100 + ig3*n1000 + ig4*n10000];
+  const typename D::Type *p = &pData[ig0*n001 + ig1*n010 + ig2*n100 + ig3*n1000 + ig4*n10000];
 
   //Normalize grid units
   icFloatNumber dF[32], pv;
@@ -2770,9 +3900,25 @@ void CIccCLUT::Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
 
   for (i=0; i<m_nOutput; i++, p++) {
     for (pv=0.0, j=0; j<32; j++)
-      pv += p[m_nOffset[j]] * dF[j];
+      pv += D::Value(p[m_nOffset[j]]) * dF[j];
 
-    destPixel[i] = pv;
+    destPixel[i] = D::Result(pv);
+  }
+}
+
+
+void CIccCLUT::Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp5dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp5dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp5dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
   }
 }
 
@@ -2788,7 +3934,8 @@ void CIccCLUT::Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
  *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
  *******************************************************************************
  */
-void CIccCLUT::Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::Interp6dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
 {
   icUInt8Number m0 = m_MaxGridPoint[0];
   icUInt8Number m1 = m_MaxGridPoint[1];
@@ -2851,7 +3998,7 @@ void CIccCLUT::Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
   icFloatNumber ns5 = (icFloatNumber)(1.0 - s5);
 
   int i, j;
-  icFloatNumber *p = &m_pData[ig0*n001 + ig1*n010 + ig2*n100 + ig3*n1000 + ig4*n10000 + ig5*n100000];
+  const typename D::Type *p = &pData[ig0*n001 + ig1*n010 + ig2*n100 + ig3*n1000 + ig4*n10000 + ig5*n100000];
 
   //Normalize grid units
   icFloatNumber dF[64], pv;
@@ -2923,13 +4070,105 @@ void CIccCLUT::Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
 
   for (i=0; i<m_nOutput; i++, p++) {
     for (pv=0, j=0; j<64; j++)
-      pv += p[m_nOffset[j]] * dF[j];
+      pv += D::Value(p[m_nOffset[j]]) * dF[j];
 
-    destPixel[i] = pv;
+    destPixel[i] = D::Result(pv);
   }
 }
 
 
+void CIccCLUT::Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      Interp6dT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      Interp6dT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      Interp6dT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccApplyCLUT::CIccApplyCLUT
+ * 
+ * Purpose: Constructor
+ *******************************************************************************
+ */
+CIccApplyCLUT::CIccApplyCLUT()
+{
+  m_df = NULL;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccApplyCLUT::~CIccApplyCLUT
+ * 
+ * Purpose: Destructor
+ *******************************************************************************
+ */
+CIccApplyCLUT::~CIccApplyCLUT()
+{
+  if (m_df)
+    delete [] m_df;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccApplyCLUT::Init
+ * 
+ * Purpose: Allocates the node weight storage used by CIccCLUT::InterpND()
+ *
+ * Args:
+ *  nInputs = number of CLUT input channels,
+ *  nNodes = number of nodes in each CLUT grid cell
+ *******************************************************************************
+ */
+bool CIccApplyCLUT::Init(icUInt8Number nInputs, icUInt32Number nNodes)
+{
+  if (m_df)
+    delete [] m_df;
+
+  m_df = new icFloatNumber[nNodes];
+
+  return m_df!=NULL;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccCLUT::GetNewApply
+ * 
+ * Purpose: Creates scratch storage that allows InterpND() to be called
+ *  concurrently from multiple threads.  Begin() must have been called.
+ *
+ * Return:
+ *  New CIccApplyCLUT object owned by the caller, or NULL on failure.
+ *******************************************************************************
+ */
+CIccApplyCLUT *CIccCLUT::GetNewApply() const
+{
+  CIccApplyCLUT *pApply = new CIccApplyCLUT();
+
+  if (!pApply)
+    return NULL;
+
+  if (!pApply->Init(m_nInput, m_nNodes)) {
+    delete pApply;
+    return NULL;
+  }
+
+  return pApply;
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccCLUT::InterpND
@@ -2937,40 +4176,51 @@ void CIccCLUT::Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
  * Purpose: Generic N-dimensional interpolation function
  *
  * Args:
- *  Pixel = Pixel value to be found in the CLUT. Also used to store the result.
+ *  destPixel = where the result is stored,
+ *  srcPixel = Pixel value to be found in the CLUT,
+ *  pApply = scratch storage from GetNewApply() (NULL uses the CLUT's own storage)
  *******************************************************************************
  */
-void CIccCLUT::InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+template <class D>
+void CIccCLUT::InterpNDT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, CIccApplyCLUT *pApply, const typename D::Type *pData) const
 {
   icUInt32Number i,j, index = 0;
 
+  if (!pApply)
+    pApply = m_pApply;
+
+  icFloatNumber *g = pApply->m_g;
+  icFloatNumber *s = pApply->m_s;
+  icFloatNumber *df = pApply->m_df;
+  icUInt32Number *ig = pApply->m_ig;
+
   for (i=0; i<m_nInput; i++) {
-    m_g[i] = UnitClip(srcPixel[i]) * m_MaxGridPoint[i];
-    m_ig[i] = (icUInt32Number)m_g[i];
-    m_s[m_nInput-1-i] = m_g[i] - m_ig[i];
-    if (m_ig[i]==m_MaxGridPoint[i]) {
-      m_ig[i]--;
-      m_s[m_nInput-1-i] = 1.0;      
+    g[i] = UnitClip(srcPixel[i]) * m_MaxGridPoint[i];
+    ig[i] = (icUInt32Number)g[i];
+    s[m_nInput-1-i] = g[i] - ig[i];
+    if (ig[i]==m_MaxGridPoint[i]) {
+      ig[i]--;
+      s[m_nInput-1-i] = 1.0;      
     }
-    index += m_ig[i]*m_DimSize[i];
+    index += ig[i]*m_DimSize[i];
   }
 
-  icFloatNumber *p = &m_pData[index];
+  const typename D::Type *p = &pData[index];
   icFloatNumber temp[2];
   icFloatNumber pv;
   int nFlag = 0;
 
   for (i=0; i<m_nNodes; i++) {
-    m_df[i] = 1.0;
+    df[i] = 1.0;
   }
 
 
   for (i=0; i<m_nInput; i++) {
-    temp[0] = (icFloatNumber)(1.0 - m_s[i]);
-    temp[1] = (icFloatNumber)(m_s[i]);
+    temp[0] = (icFloatNumber)(1.0 - s[i]);
+    temp[1] = (icFloatNumber)(s[i]);
     index = m_nPower[i];
     for (j=0; j<m_nNodes; j++) {
-      m_df[j] *= temp[nFlag];
+      df[j] *= temp[nFlag];
       if ((j+1)%index == 0)
         nFlag = !nFlag;
     }
@@ -2979,14 +4229,106 @@ void CIccCLUT::InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel)
 
   for (i=0; i<m_nOutput; i++, p++) {
     for (pv=0, j=0; j<m_nNodes; j++)
-      pv += p[m_nOffset[j]] * m_df[j];
+      pv += D::Value(p[m_nOffset[j]]) * df[j];
 
-    destPixel[i] = pv;
+    destPixel[i] = D::Result(pv);
   }
 
 }
 
 
+void CIccCLUT::InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel, CIccApplyCLUT *pApply) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      InterpNDT<icCLUTUInt16Data>(destPixel, srcPixel, pApply, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      InterpNDT<icCLUTFloat16Data>(destPixel, srcPixel, pApply, m_pCompact);
+      break;
+    default:
+      InterpNDT<icCLUTFloatData>(destPixel, srcPixel, pApply, m_pData);
+      break;
+  }
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccCLUT::InterpNDSimplex
+ * 
+ * Purpose: Generic N-dimensional simplex interpolation function.  The grid
+ *  cell is split into simplices by ordering the fractional positions, so
+ *  only N+1 nodes are used per output channel (for three dimensions this is
+ *  tetrahedral interpolation).  No scratch storage is needed, so this can
+ *  be called concurrently from multiple threads.
+ *
+ * Args:
+ *  destPixel = where the result is stored,
+ *  srcPixel = Pixel value to be found in the CLUT
+ *******************************************************************************
+ */
+template <class D>
+void CIccCLUT::InterpNDSimplexT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const
+{
+  icFloatNumber f[16], w[17], g, pv;
+  icUInt32Number ig, order[16], off[17], index = 0;
+  int i, j, n = m_nInput;
+
+  for (i=0; i<n; i++) {
+    g = UnitClip(srcPixel[i]) * m_MaxGridPoint[i];
+    ig = (icUInt32Number)g;
+    f[i] = g - ig;
+    if (ig==m_MaxGridPoint[i]) {
+      ig--;
+      f[i] = 1.0;
+    }
+    index += ig*m_DimSize[i];
+
+    //insertion sort of channels by decreasing fractional position
+    for (j=i; j>0 && f[order[j-1]]<f[i]; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  //Walk from the base node toward the far corner one dimension at a time
+  w[0] = (icFloatNumber)(1.0 - f[order[0]]);
+  off[0] = 0;
+  for (i=1; i<n; i++) {
+    w[i] = f[order[i-1]] - f[order[i]];
+    off[i] = off[i-1] + m_DimSize[order[i-1]];
+  }
+  w[n] = f[order[n-1]];
+  off[n] = off[n-1] + m_DimSize[order[n-1]];
+
+  const typename D::Type *p = &pData[index];
+
+  for (i=0; i<m_nOutput; i++, p++) {
+    for (pv=0, j=0; j<=n; j++)
+      pv += D::Value(p[off[j]]) * w[j];
+
+    destPixel[i] = D::Result(pv);
+  }
+}
+
+
+void CIccCLUT::InterpNDSimplex(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const
+{
+  switch (m_nStorage) {
+    case icCLUTStorageUInt16:
+      InterpNDSimplexT<icCLUTUInt16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    case icCLUTStorageFloat16:
+      InterpNDSimplexT<icCLUTFloat16Data>(destPixel, srcPixel, m_pCompact);
+      break;
+    default:
+      InterpNDSimplexT<icCLUTFloatData>(destPixel, srcPixel, m_pData);
+      break;
+  }
+}
+
+
+
 /**
 ******************************************************************************
 * Name: CIccCLUT::Validate
@@ -3790,7 +5132,8 @@ CIccTagLutAtoB::~CIccTagLutAtoB()
 bool CIccTagLutAtoB::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number Offset[5], nStart, nEnd, nPos;
+  icUInt32Number Offset[5];
+  icInt64Number nStart, nEnd, nPos;
   icUInt8Number nCurves, i;
 
   if (size<8*sizeof(icUInt32Number) || !pIO) {
@@ -3955,7 +5298,8 @@ bool CIccTagLutAtoB::Read(icUInt32Number size, CIccIO *pIO)
 bool CIccTagLutAtoB::Write(CIccIO *pIO)
 {
   icTagTypeSignature sig = GetType();
-  icUInt32Number Offset[5], nStart, nEnd, nOffsetPos;
+  icUInt32Number Offset[5];
+  icInt64Number nStart, nEnd, nOffsetPos;
   icUInt8Number nCurves, i;
 
   nStart = pIO->Tell();
@@ -4410,7 +5754,7 @@ CIccTagLut8::~CIccTagLut8()
 bool CIccTagLut8::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number nStart, nEnd;
+  icInt64Number nStart, nEnd;
   icUInt8Number i, nGrid;
   LPIccCurve *pCurves;
   CIccTagCurve *pCurve;
@@ -4852,7 +6196,7 @@ CIccTagLut16::~CIccTagLut16()
 bool CIccTagLut16::Read(icUInt32Number size, CIccIO *pIO)
 {
   icTagTypeSignature sig;
-  icUInt32Number nStart, nEnd;
+  icInt64Number nStart, nEnd;
   icUInt8Number i, nGrid;
   icUInt16Number nInputEntries, nOutputEntries;
   LPIccCurve *pCurves;
@@ -5459,7 +6803,7 @@ bool CIccTagGamutBoundaryDesc::Write(CIccIO *pIO)
 		return false;
 	}
 	
-	icUInt32Number startPos = pIO->GetLength();
+	icInt64Number startPos = pIO->GetLength();
 	
 	if (!pIO->Write32(&sig) ||
 		!pIO->Write32(&m_nReserved))
@@ -80,6 +80,18 @@ namespace refIccMAX {
 
 #include "IccTagBasic.h"
 
+///Default number of entries in inverse curve tables built by CIccCurve::NewInverse()
+#define icDefaultInvCurveSize 2048
+
+class CIccTagCurve;
+
+/** Storage formats for CIccCLUT grid data **/
+typedef enum {
+  icCLUTStorageFloat = 0,   //one icFloatNumber per grid value (default)
+  icCLUTStorageUInt16,      //unsigned 16-bit values normalized to 0..65535
+  icCLUTStorageFloat16,     //IEEE half precision values
+} icCLUTStorage;
+
 /**
 ****************************************************************************
 * Class: CIccCurve
@@ -103,6 +115,12 @@ public:
   icFloatNumber Find(icFloatNumber v) { return Find(v, 0, Apply(0), 1.0, Apply(1.0)); }
   virtual bool IsIdentity() {return false;}
 
+  ///Returns true if ApplyInverse() provides a closed form inverse of Apply()
+  virtual bool IsInvertible() const { return false; }
+  virtual icFloatNumber ApplyInverse(icFloatNumber v) const { return v; }
+
+  virtual CIccTagCurve *NewInverse(icUInt32Number nSize=icDefaultInvCurveSize);
+
 protected:
   icFloatNumber Find(icFloatNumber v,
     icFloatNumber p0, icFloatNumber v0,
@@ -154,6 +172,10 @@ public:
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccProfile* pProfile=NULL) const;
   virtual bool IsIdentity();
 
+  virtual bool IsInvertible() const { return m_nSize<=1; }
+  virtual icFloatNumber ApplyInverse(icFloatNumber v) const;
+  virtual CIccTagCurve *NewInverse(icUInt32Number nSize=icDefaultInvCurveSize);
+
 protected:
   icFloatNumber *m_Curve;
   icUInt32Number m_nSize;
@@ -199,6 +221,9 @@ public:
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccProfile* pProfile=NULL) const;
   virtual bool IsIdentity();
 
+  virtual bool IsInvertible() const;
+  virtual icFloatNumber ApplyInverse(icFloatNumber v) const;
+
   icUInt16Number      m_nReserved2;
 protected:
   icUInt16Number      m_nFunctionType;
@@ -291,6 +316,31 @@ public:
 
 typedef icFloatNumber (*icCLUTCLIPFUNC)(icFloatNumber v);
 
+class CIccCLUT;
+
+/**
+****************************************************************************
+* Class: CIccApplyCLUT
+* 
+* Purpose: Apply time scratch storage used by CIccCLUT::InterpND().  Each
+*  thread applying a shared CIccCLUT should use its own CIccApplyCLUT.
+*****************************************************************************
+*/
+class ICCPROFLIB_API CIccApplyCLUT
+{
+  friend class CIccCLUT;
+public:
+  CIccApplyCLUT();
+  virtual ~CIccApplyCLUT();
+
+  bool Init(icUInt8Number nInputs, icUInt32Number nNodes);
+
+protected:
+  icFloatNumber m_g[16], m_s[16];
+  icUInt32Number m_ig[16];
+  icFloatNumber *m_df;
+};
+
 /**
 ****************************************************************************
 * Class: CIccCLUT
@@ -312,6 +362,9 @@ public:
   bool ReadData(icUInt32Number size, CIccIO *pIO, icUInt8Number nPrecision);
   bool WriteData(CIccIO *pIO, icUInt8Number nPrecision);
 
+  bool ReadTypedData(CIccIO *pIO, icUInt16Number nValueType);
+  bool WriteTypedData(CIccIO *pIO, icUInt16Number nValueType);
+
   bool Read(icUInt32Number size, CIccIO *pIO);
   bool Write(CIccIO *pIO);
 
@@ -319,8 +372,12 @@ public:
                icColorSpaceSignature csInput, icColorSpaceSignature csOutput,
                bool bUseLegacy=false);
 
-  icFloatNumber& operator[](int index) { return m_pData[index]; }
-  icFloatNumber* GetData(int index) { return &m_pData[index]; }
+  //operator[] returns a grid value converted to icFloatNumber for any storage.
+  //GetData() gives direct access to icFloatNumber grid values.  Float storage is allocated if the CLUT has no values yet.
+  //GetData() returns NULL for compact storage (read it with GetValues() or call SetStorage(icCLUTStorageFloat) first).
+  icFloatNumber operator[](int index) const { return StoredValue(index); }
+  icFloatNumber* GetData(int index) { if (!m_pData && !m_pCompact) AllocData(); return m_pData ? &m_pData[index] : NULL; }
+  bool GetValues(icFloatNumber *pDst, icUInt32Number nStart, icUInt32Number nNum) const;
   icUInt32Number NumPoints() const { return m_nNumPoints; }
   icUInt8Number GridPoints() const { return m_GridPoints[0]; }
   icUInt8Number GridPoint(int index) const { return m_GridPoints[index]; }
@@ -344,8 +401,22 @@ public:
   void Interp4d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const;
   void Interp5d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const;
   void Interp6d(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const;
-  void InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const;
-
+  void InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const { InterpND(destPixel, srcPixel, m_pApply); }
+  void InterpND(icFloatNumber *destPixel, const icFloatNumber *srcPixel, CIccApplyCLUT *pApply) const;
+  void InterpNDSimplex(icFloatNumber *destPixel, const icFloatNumber *srcPixel) const;
+
+  ///Returns new scratch storage for InterpND().  Must be called after Begin().  Caller owns the returned object.
+  CIccApplyCLUT *GetNewApply() const;
+
+  //Batch versions of the interpolation functions.  Strides give the number of samples between pixels.
+  void Interp3dTetraN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                      icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
+  void Interp3dN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                 icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
+  void Interp4dN(icFloatNumber *destPixels, const icFloatNumber *srcPixels, icUInt32Number nPixels,
+                 icUInt32Number nDstStride, icUInt32Number nSrcStride) const;
+
+  ///Calls pExec->PixelOp() for each grid point.  PixelOp() may change values so compact storage is converted to float.
   void Iterate(IIccCLUTExec* pExec);
   icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccProfile* pProfile=NULL)  const;
 
@@ -353,7 +424,27 @@ public:
 
   icUInt8Number GetPrecision() { return m_nPrecision; }
 
+  bool SetStorage(icCLUTStorage nStorage);
+  icCLUTStorage GetStorage() const { return m_nStorage; }
+  icFloatNumber GetStorageError() const { return m_fStorageError; }
+  icUInt32Number GetStorageBytes() const;
+  void DescribeStorage(std::string &sDescription) const;
+
 protected:
+  icFloatNumber StoredValue(icUInt32Number nIndex) const;
+  bool AllocData();
+  void FreeData();
+
+  template <class D> void Interp1dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp2dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp3dTetraT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp3dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp4dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp5dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void Interp6dT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+  template <class D> void InterpNDT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, CIccApplyCLUT *pApply, const typename D::Type *pData) const;
+  template <class D> void InterpNDSimplexT(icFloatNumber *destPixel, const icFloatNumber *srcPixel, const typename D::Type *pData) const;
+
   void Iterate(std::string &sDescription, icUInt8Number nIndex, icUInt32Number nPos, bool bUseLegacy=false);
   void SubIterate(IIccCLUTExec* pExec, icUInt8Number nIndex, icUInt32Number nPos);
 
@@ -371,6 +462,11 @@ protected:
   icUInt32Number m_DimSize[16];
   icFloatNumber *m_pData;
 
+  //Compact grid storage (m_pData is NULL when used)
+  icCLUTStorage m_nStorage;
+  icUInt16Number *m_pCompact;
+  icFloatNumber m_fStorageError;
+
   //Iteration temporary variables
   icUInt8Number m_GridAdr[16];
   icFloatNumber m_fGridAdr[16];
@@ -383,9 +479,8 @@ protected:
 
   //ND Interpolation
   icUInt32Number *m_nOffset;
-  // Temporary ND Interp Variables
-  icFloatNumber *m_g, *m_s, *m_df;
-  icUInt32Number* m_ig;
+  // Scratch storage used by InterpND() when no CIccApplyCLUT is provided (not thread safe)
+  CIccApplyCLUT *m_pApply;
   icUInt32Number m_nNodes, m_nPower[16];
 };
 
@@ -504,7 +599,7 @@ public:
   CIccTagLutBtoA();
   CIccTagLutBtoA(const CIccTagLutBtoA &ITLB2A);
   CIccTagLutBtoA &operator=(const CIccTagLutBtoA &ITLB2A);
-  virtual CIccTag* NewCopy() { return new CIccTagLutBtoA(*this); }
+  virtual CIccTag* NewCopy() const { return new CIccTagLutBtoA(*this); }
 
   virtual icTagTypeSignature GetType() const { return icSigLutBtoAType; }
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccProfile* pProfile=NULL);
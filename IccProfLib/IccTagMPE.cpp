@@ -79,7 +79,9 @@
 #include "IccTagMPE.h"
 #include "IccIO.h"
 #include "IccMpeFactory.h"
+#include "IccMpeBasic.h"
 #include <map>
+#include <vector>
 #include "IccUtil.h"
 
 #ifdef USEREFICCMAXNAMESPACE
@@ -147,6 +149,31 @@ CIccApplyMpe* CIccMultiProcessElement::GetNewApply( CIccApplyTagMpe *pApplyTag )
   return new CIccApplyMpe(this);
 }
 
+/**
+ ******************************************************************************
+ * Name: CIccMultiProcessElement::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the element to a block of contiguous pixels.  The base implementation
+ *  calls Apply() for each pixel.  Elements with a native batch path override this.
+ * 
+ * Args: 
+ *  pApply = element apply data from GetNewApply()
+ *  pDestPixels = destination pixels (NumOutputChannels() samples each)
+ *  pSrcPixels = source pixels (NumInputChannels() samples each)
+ *  nPixels = number of pixels to apply
+******************************************************************************/
+void CIccMultiProcessElement::ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  icUInt16Number nSrcStride = NumInputChannels();
+  icUInt16Number nDstStride = NumOutputChannels();
+  icUInt32Number k;
+
+  for (k=0; k<nPixels; k++, pDestPixels+=nDstStride, pSrcPixels+=nSrcStride) {
+    Apply(pApply, pDestPixels, pSrcPixels);
+  }
+}
+
 
 /**
  ******************************************************************************
@@ -618,6 +645,9 @@ CIccApplyTagMpe::CIccApplyTagMpe(CIccTagMultiProcessElement *pTag)
 {
   m_pTag = pTag;
   m_list = NULL;
+  m_pPlan = NULL;
+  m_pSpanBuf1 = NULL;
+  m_pSpanBuf2 = NULL;
 }
 
 
@@ -642,6 +672,61 @@ CIccApplyTagMpe::~CIccApplyTagMpe()
 
     delete m_list;
   }
+
+  if (m_pSpanBuf1)
+    free(m_pSpanBuf1);
+  if (m_pSpanBuf2)
+    free(m_pSpanBuf2);
+
+  //Plan elements are released after the apply objects that refer to them
+  if (m_pPlan)
+    m_pPlan->Release();
+}
+
+
+/**
+******************************************************************************
+* Name: CIccApplyTagMpe::SetPlan
+* 
+* Purpose: 
+*  Keeps a reference to the execution plan that owns the appended elements
+*  so that they stay valid if the tag rebuilds or releases its plan.
+* 
+* Args: 
+*  pPlan = plan to reference
+******************************************************************************/
+void CIccApplyTagMpe::SetPlan(CIccMpePlan *pPlan)
+{
+  if (pPlan)
+    pPlan->AddRef();
+  if (m_pPlan)
+    m_pPlan->Release();
+  m_pPlan = pPlan;
+}
+
+
+/**
+******************************************************************************
+* Name: CIccApplyTagMpe::BeginSpans
+* 
+* Purpose: 
+*  Allocates the buffers that hold blocks of icMpeBatchPixels pixels between
+*  elements during ApplyN()
+* 
+* Args: 
+*  nMaxChannels = largest number of channels output by an element
+* 
+* Return: 
+*  true if successful
+******************************************************************************/
+bool CIccApplyTagMpe::BeginSpans(icUInt16Number nMaxChannels)
+{
+  size_t nSize = (size_t)icMpeBatchPixels * (nMaxChannels ? nMaxChannels : 1);
+
+  m_pSpanBuf1 = (icFloatNumber*)calloc(nSize, sizeof(icFloatNumber));
+  m_pSpanBuf2 = (icFloatNumber*)calloc(nSize, sizeof(icFloatNumber));
+
+  return m_pSpanBuf1!=NULL && m_pSpanBuf2!=NULL;
 }
 
 
@@ -696,6 +781,11 @@ CIccTagMultiProcessElement::CIccTagMultiProcessElement(icUInt16Number nInputChan
 
   m_nInputChannels = nInputChannels;
   m_nOutputChannels = nOutputChannels;
+  m_nBufChannels = 0;
+
+  m_bOptimize = true;
+  m_pPlan = NULL;
+  m_fTableTolerance = 0;
 
   m_pAppliedPCC = NULL;
   m_pProfilePCC = NULL;
@@ -716,6 +806,14 @@ CIccTagMultiProcessElement::CIccTagMultiProcessElement(icUInt16Number nInputChan
 CIccTagMultiProcessElement::CIccTagMultiProcessElement(const CIccTagMultiProcessElement &lut)
 {
   m_nReserved = lut.m_nReserved;
+  m_list = NULL;
+  m_nProcElements = 0;
+  m_position = NULL;
+  m_nBufChannels = 0;
+
+  m_bOptimize = lut.m_bOptimize;
+  m_pPlan = NULL;
+  m_fTableTolerance = lut.m_fTableTolerance;
 
   if (lut.m_list) {
     m_list = new CIccMultiProcessElementList();
@@ -760,6 +858,8 @@ CIccTagMultiProcessElement &CIccTagMultiProcessElement::operator=(const CIccTagM
   Clean();
 
   m_nReserved = lut.m_nReserved;
+  m_bOptimize = lut.m_bOptimize;
+  m_fTableTolerance = lut.m_fTableTolerance;
 
   if (lut.m_list) {
     m_list = new CIccMultiProcessElementList();
@@ -820,6 +920,8 @@ typedef std::map<icUInt32Number, CIccMultiProcessElement*> CIccLutOffsetMap;
  ******************************************************************************/
 void CIccTagMultiProcessElement::Clean()
 {
+  ResetPlan();
+
   if (m_list) {
     CIccLutPtrMap map;
     CIccMultiProcessElementList::iterator i;
@@ -911,6 +1013,8 @@ void CIccTagMultiProcessElement::Describe(std::string &sDescription)
  ******************************************************************************/
 void CIccTagMultiProcessElement::Attach(CIccMultiProcessElement *pElement)
 {
+  ResetPlan();
+
   if (!m_list) {
     m_list = new CIccMultiProcessElementList();
   }
@@ -953,7 +1057,7 @@ bool CIccTagMultiProcessElement::Read(icUInt32Number size, CIccIO *pIO)
 
   Clean();
 
-  icUInt32Number tagStart = pIO->Tell();
+  icInt64Number tagStart = pIO->Tell();
 
   if (!pIO->Read32(&sig))
     return false;
@@ -1007,7 +1111,7 @@ bool CIccTagMultiProcessElement::Read(icUInt32Number size, CIccIO *pIO)
     if (!element) {
       icUInt32Number pos = tagStart + m_position[i].offset;
 
-      if (pIO->Seek(pos, icSeekSet)!=(icInt32Number)pos) {
+      if (pIO->Seek(pos, icSeekSet)!=(icInt64Number)pos) {
         return false;
       }
 
@@ -1015,7 +1119,7 @@ bool CIccTagMultiProcessElement::Read(icUInt32Number size, CIccIO *pIO)
         return false;
       }
       
-      if (pIO->Seek(pos, icSeekSet)!=(icInt32Number)pos) {
+      if (pIO->Seek(pos, icSeekSet)!=(icInt64Number)pos) {
         return false;
       }
 
@@ -1056,7 +1160,7 @@ bool CIccTagMultiProcessElement::Write(CIccIO *pIO)
   if (!pIO)
     return false;
 
-  icUInt32Number tagStart = pIO->Tell();
+  icInt64Number tagStart = pIO->Tell();
 
   if (!pIO->Write32(&sig))
     return false;
@@ -1081,7 +1185,7 @@ bool CIccTagMultiProcessElement::Write(CIccIO *pIO)
     return false;
 
   if (m_nProcElements) {
-    icUInt32Number offsetPos = pIO->Tell();
+    icInt64Number offsetPos = pIO->Tell();
 
     if (m_position) {
       delete [] m_position;
@@ -1101,7 +1205,7 @@ bool CIccTagMultiProcessElement::Write(CIccIO *pIO)
 
     CIccLutPtrMap map;
     CIccMultiProcessElementList::iterator i;
-    icUInt32Number start, end;
+    icInt64Number start, end;
     icPositionNumber position;
 
     //Write out each process element
@@ -1125,7 +1229,7 @@ bool CIccTagMultiProcessElement::Write(CIccIO *pIO)
       m_position[j] = map[i->ptr];
     }
 
-    icUInt32Number endPos = pIO->Tell();
+    icInt64Number endPos = pIO->Tell();
 
     if (pIO->Seek(offsetPos, icSeekSet)<0)
       return false;
@@ -1256,6 +1360,8 @@ bool CIccTagMultiProcessElement::Begin(icElemInterp nInterp /*=icElemInterpLinea
                                        IIccProfileConnectionConditions *pAppliedPCC /*= NULL*/,
                                        IIccCmmEnvVarLookup *pCmmEnvVarLookup /*= NULL*/)
 {
+  ResetPlan();
+
   if (!m_list || !m_list->size()) {
     if (m_nInputChannels != m_nOutputChannels)
       return false;
@@ -1295,6 +1401,10 @@ bool CIccTagMultiProcessElement::Begin(icElemInterp nInterp /*=icElemInterpLinea
   if (last && last->NumOutputChannels() != m_nOutputChannels)
     return false;
 
+  //Elements are applied directly if an execution plan cannot be built
+  if (m_bOptimize && !BuildPlan(nInterp))
+    ResetPlan();
+
   m_pAppliedPCC = NULL;
   m_pProfilePCC = NULL;
 
@@ -1302,6 +1412,444 @@ bool CIccTagMultiProcessElement::Begin(icElemInterp nInterp /*=icElemInterpLinea
 }
 
 
+/**
+ ******************************************************************************
+ * Name: icMpePlanStep
+ * 
+ * Purpose: 
+ *  Working representation of an element while building an execution plan.
+ *  Matrices and curve sets made up of linear curves are also represented as
+ *  an affine mapping (dst = mtx * src + offset) so they can be combined.
+ ******************************************************************************/
+struct icMpePlanStep
+{
+  CIccMultiProcessElement *pElem;  //Element to apply (NULL if affine mapping was changed)
+  std::string sSrc;                //Description of source elements for plan log
+
+  bool bAffine;
+  bool bHasMatrix;
+  icUInt16Number nIn, nOut;
+  std::vector<icFloat64Number> mtx;
+  std::vector<icFloat64Number> offset;
+};
+
+static bool icGetMpeAffine(icMpePlanStep &step)
+{
+  CIccMultiProcessElement *pElem = step.pElem;
+  icUInt16Number i, j;
+
+  step.nIn = pElem->NumInputChannels();
+  step.nOut = pElem->NumOutputChannels();
+
+  if (pElem->GetType()==icSigMatrixElemType) {
+    CIccMpeMatrix *pMatrix = (CIccMpeMatrix*)pElem;
+    icFloatNumber *pMtx = pMatrix->GetMatrix();
+    icFloatNumber *pConst = pMatrix->GetConstants();
+
+    if (!pConst)
+      return false;
+
+    step.mtx.assign((size_t)step.nIn*step.nOut, 0.0);
+    step.offset.assign(step.nOut, 0.0);
+    for (j=0; j<step.nOut; j++) {
+      if (pMtx) {
+        for (i=0; i<step.nIn; i++)
+          step.mtx[j*step.nIn+i] = pMtx[j*step.nIn+i];
+      }
+      step.offset[j] = pConst[j];
+    }
+    step.bHasMatrix = true;
+    return true;
+  }
+  else if (pElem->GetType()==icSigCurveSetElemType) {
+    CIccMpeCurveSet *pCurves = (CIccMpeCurveSet*)pElem;
+    icFloatNumber fScale, fOffset;
+
+    step.mtx.assign((size_t)step.nIn*step.nOut, 0.0);
+    step.offset.assign(step.nOut, 0.0);
+    for (j=0; j<step.nOut; j++) {
+      CIccCurveSetCurve *pCurve = pCurves->GetCurve(j);
+
+      if (!pCurve || !pCurve->IsAffine(fScale, fOffset))
+        return false;
+
+      step.mtx[j*step.nIn+j] = fScale;
+      step.offset[j] = fOffset;
+    }
+    step.bHasMatrix = false;
+    return true;
+  }
+
+  return false;
+}
+
+static void icComposeMpeAffine(icMpePlanStep &first, const icMpePlanStep &second)
+{
+  std::vector<icFloat64Number> mtx((size_t)first.nIn*second.nOut, 0.0);
+  std::vector<icFloat64Number> offset(second.offset);
+  icUInt16Number i, j, k;
+
+  for (j=0; j<second.nOut; j++) {
+    for (k=0; k<second.nIn; k++) {
+      icFloat64Number b = second.mtx[j*second.nIn+k];
+
+      if (b!=0.0) {
+        for (i=0; i<first.nIn; i++)
+          mtx[j*first.nIn+i] += b * first.mtx[k*first.nIn+i];
+        offset[j] += b * first.offset[k];
+      }
+    }
+  }
+
+  first.mtx.swap(mtx);
+  first.offset.swap(offset);
+  first.nOut = second.nOut;
+  first.bHasMatrix = first.bHasMatrix || second.bHasMatrix;
+  first.sSrc += " + " + second.sSrc;
+  first.pElem = NULL;
+}
+
+static bool icIsIdentityMpeAffine(const icMpePlanStep &step)
+{
+  if (step.nIn!=step.nOut)
+    return false;
+
+  icUInt16Number i, j;
+  for (j=0; j<step.nOut; j++) {
+    if (step.offset[j]!=0.0)
+      return false;
+    for (i=0; i<step.nIn; i++) {
+      if (step.mtx[j*step.nIn+i] != (i==j ? 1.0 : 0.0))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+//Determines if each channel is either passed through or reversed (1-v) so that grid points map onto grid points
+static bool icGetMpeAxisFlips(const icMpePlanStep &step, std::vector<bool> &flip)
+{
+  if (step.nIn!=step.nOut)
+    return false;
+
+  icUInt16Number i, j;
+  flip.assign(step.nOut, false);
+  for (j=0; j<step.nOut; j++) {
+    for (i=0; i<step.nIn; i++) {
+      if (i!=j && step.mtx[j*step.nIn+i]!=0.0)
+        return false;
+    }
+    icFloat64Number d = step.mtx[j*step.nIn+j];
+    if (d==1.0 && step.offset[j]==0.0)
+      flip[j] = false;
+    else if (d==-1.0 && step.offset[j]==1.0)
+      flip[j] = true;
+    else
+      return false;
+  }
+
+  return true;
+}
+
+//Creates a new CLUT element with reversed input axes and/or an affine mapping applied to its grid values
+static CIccMpeCLUT *icFoldMpeCLUT(CIccMpeCLUT *pElem, const std::vector<bool> *pFlip, const icMpePlanStep *pOutput)
+{
+  CIccCLUT *pSrcCLUT = pElem->GetCLUT();
+  icUInt8Number nIn = pSrcCLUT->GetInputDim();
+  icUInt16Number nSrcOut = pSrcCLUT->GetOutputChannels();
+  icUInt16Number nDstOut = pOutput ? pOutput->nOut : nSrcOut;
+
+  CIccCLUT *pCLUT = new CIccCLUT(nIn, nDstOut);
+  if (!pCLUT->Init(pSrcCLUT->GridPointArray())) {
+    delete pCLUT;
+    return NULL;
+  }
+
+  icUInt32Number nPoints = pSrcCLUT->NumPoints();
+  icUInt32Number idx[16] = { 0 };
+  icFloatNumber *pDst = pCLUT->GetData(0);
+  icUInt32Number n;
+  int d;
+  icUInt16Number i, j;
+
+  //Source values are read through GetValues() so compact source storage is left as it is
+  std::vector<icFloatNumber> src(nSrcOut);
+  const icFloatNumber *pSrc = &src[0];
+
+  for (n=0; n<nPoints; n++) {
+    icUInt32Number nSrcOffset = 0;
+    for (d=0; d<nIn; d++) {
+      icUInt32Number g = idx[d];
+      if (pFlip && (*pFlip)[d])
+        g = pSrcCLUT->GridPoint(d) - 1 - g;
+      nSrcOffset += g * pSrcCLUT->GetDimSize((icUInt8Number)d);
+    }
+    if (!pSrcCLUT->GetValues(&src[0], nSrcOffset, nSrcOut)) {
+      delete pCLUT;
+      return NULL;
+    }
+
+    if (pOutput) {
+      for (j=0; j<nDstOut; j++) {
+        icFloat64Number v = pOutput->offset[j];
+        for (i=0; i<nSrcOut; i++)
+          v += pOutput->mtx[j*nSrcOut+i] * pSrc[i];
+        pDst[j] = (icFloatNumber)v;
+      }
+    }
+    else {
+      memcpy(pDst, pSrc, nSrcOut*sizeof(icFloatNumber));
+    }
+    pDst += nDstOut;
+
+    //Last input dimension varies fastest
+    for (d=nIn-1; d>=0; d--) {
+      if (++idx[d] < pSrcCLUT->GridPoint(d))
+        break;
+      idx[d] = 0;
+    }
+  }
+
+  CIccMpeCLUT *pNewElem = new CIccMpeCLUT();
+  pNewElem->SetCLUT(pCLUT);
+
+  return pNewElem;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccTagMultiProcessElement::BuildPlan
+ * 
+ * Purpose: 
+ *  Builds the list of elements used by GetNewApply().  Adjacent matrices and
+ *  linear curve sets are combined, identity mappings are removed, curve sets
+ *  that only reverse channels are folded into following CLUTs, and matrices
+ *  and linear curve sets following a CLUT are folded into its grid values
+ *  (interpolation weights sum to one so this gives the same result).  The
+ *  elements in m_list are left untouched.
+ * 
+ * Args: 
+ *  nInterp = interpolation used for CLUT elements
+ * 
+ * Return: 
+ *  true if successful
+ ******************************************************************************/
+bool CIccTagMultiProcessElement::BuildPlan(icElemInterp nInterp)
+{
+  std::vector<icMpePlanStep> steps;
+  CIccMultiProcessElementList::iterator e;
+  icChar buf[80];
+  int n;
+  size_t i;
+  bool bChanged = false;
+
+  m_sPlanLog.clear();
+
+  m_pPlan = new CIccMpePlan();
+
+  for (n=0, e=GetFirstElem(); e!=GetLastElem(); GetNextElemIterator(e), n++) {
+    icMpePlanStep step;
+
+    step.pElem = e->ptr;
+    sprintf(buf, "#%d %s", n, e->ptr->GetClassName());
+    step.sSrc = buf;
+    step.bAffine = !e->ptr->IsAcs() && icGetMpeAffine(step);
+
+    steps.push_back(step);
+  }
+
+  //Combine adjacent affine mappings (curve sets are only turned into matrices next to a matrix)
+  for (i=0; i+1<steps.size();) {
+    icMpePlanStep &cur = steps[i];
+    icMpePlanStep &next = steps[i+1];
+
+    if (cur.bAffine && next.bAffine) {
+      icMpePlanStep combined = cur;
+      icComposeMpeAffine(combined, next);
+
+      if (combined.bHasMatrix || icIsIdentityMpeAffine(combined)) {
+        m_sPlanLog += "Combined " + combined.sSrc + "\r\n";
+        steps[i] = combined;
+        steps.erase(steps.begin()+i+1);
+        bChanged = true;
+        continue;
+      }
+    }
+    i++;
+  }
+
+  //Remove identity mappings
+  for (i=0; i<steps.size();) {
+    if (steps[i].bAffine && icIsIdentityMpeAffine(steps[i])) {
+      m_sPlanLog += "Removed identity " + steps[i].sSrc + "\r\n";
+      steps.erase(steps.begin()+i);
+      bChanged = true;
+      continue;
+    }
+    i++;
+  }
+
+  //Fold channel reversals into following CLUTs and affine mappings into preceding CLUTs
+  for (i=0; i<steps.size(); i++) {
+    CIccMultiProcessElement *pElem = steps[i].pElem;
+
+    if (!pElem || pElem->GetType()!=icSigCLutElemType || !((CIccMpeCLUT*)pElem)->GetCLUT())
+      continue;
+
+    std::vector<bool> flip;
+    icMpePlanStep *pPrev = NULL, *pNext = NULL;
+
+    //Tetrahedral interpolation is not symmetric so reversed axes would not give the same result
+    if (i>0 && steps[i-1].bAffine && icGetMpeAxisFlips(steps[i-1], flip) &&
+        !(pElem->NumInputChannels()==3 && nInterp==icElemInterpTetra))
+      pPrev = &steps[i-1];
+
+    if (i+1<steps.size() && steps[i+1].bAffine && steps[i+1].nOut<=pElem->NumOutputChannels())
+      pNext = &steps[i+1];
+
+    if (!pPrev && !pNext)
+      continue;
+
+    CIccMpeCLUT *pCLUT = icFoldMpeCLUT((CIccMpeCLUT*)pElem, pPrev ? &flip : NULL, pNext);
+    if (!pCLUT)
+      return false;
+
+    CIccMultiProcessElementPtr ptr;
+    ptr.ptr = pCLUT;
+    m_pPlan->m_elems.push_back(ptr);
+
+    if (!pCLUT->Begin(nInterp, this))
+      return false;
+
+    std::string sSrc = steps[i].sSrc;
+    if (pPrev)
+      sSrc = pPrev->sSrc + " + " + sSrc;
+    if (pNext)
+      sSrc += " + " + pNext->sSrc;
+    m_sPlanLog += "Folded into CLUT " + sSrc + "\r\n";
+
+    steps[i].pElem = pCLUT;
+    steps[i].sSrc = sSrc;
+    if (pNext)
+      steps.erase(steps.begin()+i+1);
+    if (pPrev) {
+      steps.erase(steps.begin()+i-1);
+      i--;
+    }
+    bChanged = true;
+  }
+
+  if (!bChanged) {
+    m_pPlan->Release();
+    m_pPlan = NULL;
+    m_sPlanLog = "No elements combined\r\n";
+    return true;
+  }
+
+  for (i=0; i<steps.size(); i++) {
+    CIccMultiProcessElementPtr ptr;
+
+    if (steps[i].pElem) {
+      ptr.ptr = steps[i].pElem;
+    }
+    else {
+      icMpePlanStep &step = steps[i];
+      CIccMpeMatrix *pMatrix = new CIccMpeMatrix();
+
+      ptr.ptr = pMatrix;
+      m_pPlan->m_elems.push_back(ptr);
+
+      if (!pMatrix->SetSize(step.nIn, step.nOut))
+        return false;
+
+      icFloatNumber *pMtx = pMatrix->GetMatrix();
+      icFloatNumber *pConst = pMatrix->GetConstants();
+      size_t k;
+      for (k=0; k<step.mtx.size(); k++)
+        pMtx[k] = (icFloatNumber)step.mtx[k];
+      for (k=0; k<step.offset.size(); k++)
+        pConst[k] = (icFloatNumber)step.offset[k];
+
+      if (!pMatrix->Begin(nInterp, this))
+        return false;
+    }
+    m_pPlan->m_list.push_back(ptr);
+  }
+
+  return true;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccMpePlan::~CIccMpePlan
+ * 
+ * Purpose: 
+ *  Deletes the elements created for the plan.  Called by Release() once the
+ *  tag and all apply objects made from the plan no longer refer to it.
+ ******************************************************************************/
+CIccMpePlan::~CIccMpePlan()
+{
+  CIccMultiProcessElementList::iterator i;
+
+  for (i=m_elems.begin(); i!=m_elems.end(); i++)
+    delete i->ptr;
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccTagMultiProcessElement::ResetPlan
+ * 
+ * Purpose: 
+ *  Releases the tag's reference to the execution plan.  Plan elements are
+ *  deleted once apply objects made from the plan have also been deleted.
+ ******************************************************************************/
+void CIccTagMultiProcessElement::ResetPlan()
+{
+  if (m_pPlan) {
+    m_pPlan->Release();
+    m_pPlan = NULL;
+  }
+
+  m_sPlanLog.clear();
+}
+
+
+/**
+ ******************************************************************************
+ * Name: CIccTagMultiProcessElement::DescribePlan
+ * 
+ * Purpose: 
+ *  Describes how elements were combined by Begin() and the resulting list of
+ *  elements that is applied.  Intended for debugging.
+ * 
+ * Args: 
+ *  sDescription = string to append description to
+ ******************************************************************************/
+void CIccTagMultiProcessElement::DescribePlan(std::string &sDescription)
+{
+  icChar buf[128];
+  int n;
+
+  sDescription += "BEGIN_MPE_PLAN\r\n";
+  sDescription += m_sPlanLog;
+
+  CIccMultiProcessElementList *pList = m_pPlan ? &m_pPlan->m_list : m_list;
+  if (pList) {
+    CIccMultiProcessElementList::iterator i;
+
+    for (n=0, i=pList->begin(); i!=pList->end(); i++, n++) {
+      sprintf(buf, "%d: %s %d->%d\r\n", n, i->ptr->GetClassName(), i->ptr->NumInputChannels(), i->ptr->NumOutputChannels());
+      sDescription += buf;
+    }
+  }
+  sDescription += "END_MPE_PLAN\r\n";
+}
+
+
 
 
 /**
@@ -1359,11 +1907,26 @@ CIccApplyTagMpe *CIccTagMultiProcessElement::GetNewApply()
 
   CIccDblPixelBuffer *pApplyBuf = pApply->GetBuf();
   pApplyBuf->UpdateChannels(m_nBufChannels);
-  if (!pApplyBuf->Begin()) {
+  if (!pApplyBuf->Begin() || !pApply->BeginSpans(m_nBufChannels)) {
     delete pApply;
     return NULL;
   }
 
+  if (m_pPlan) {
+    CIccMultiProcessElementList::iterator i;
+
+    pApply->SetPlan(m_pPlan);
+
+    for (i=m_pPlan->m_list.begin(); i!=m_pPlan->m_list.end(); i++) {
+      if (!pApply->AppendElem(i->ptr)) {
+        delete pApply;
+        return NULL;
+      }
+    }
+
+    return pApply;
+  }
+
   if (!m_list || !m_list->size())
     return pApply;
 
@@ -1436,6 +1999,71 @@ void CIccTagMultiProcessElement::Apply(CIccApplyTagMpe *pApply, icFloatNumber *p
 }
 
 
+/**
+ ******************************************************************************
+ * Name: CIccTagMultiProcessElement::ApplyN
+ * 
+ * Purpose: 
+ *  Applies the elements to a buffer of contiguous pixels.  Pixels are passed
+ *  through the elements in blocks of icMpeBatchPixels so that each element
+ *  can process a whole block with its ApplyN() before the next one runs.
+ * 
+ * Args: 
+ *  pApply = apply data from GetNewApply()
+ *  pDestPixels = destination pixels (NumOutputChannels() samples each)
+ *  pSrcPixels = source pixels (NumInputChannels() samples each).  May equal
+ *   pDestPixels only if the number of input and output channels is the same.
+ *  nPixels = number of pixels to apply
+ ******************************************************************************/
+void CIccTagMultiProcessElement::ApplyN(CIccApplyTagMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const
+{
+  if (!pApply || !pApply->GetList() || !pApply->GetList()->size()) {
+    if (pDestPixels!=pSrcPixels)
+      memmove(pDestPixels, pSrcPixels, (size_t)nPixels*m_nInputChannels*sizeof(icFloatNumber));
+    return;
+  }
+
+  CIccApplyMpeIter first = pApply->begin();
+  CIccApplyMpeIter last = pApply->end();
+  CIccApplyMpeIter i;
+  icUInt32Number n;
+
+  last--;
+
+  //Elements rely on pDestPixels != pSrcPixels
+  if (first==last && pSrcPixels!=pDestPixels) {
+    first->ptr->ApplyN(pDestPixels, pSrcPixels, nPixels);
+    return;
+  }
+
+  while (nPixels) {
+    n = nPixels<icMpeBatchPixels ? nPixels : icMpeBatchPixels;
+
+    if (first==last) {
+      first->ptr->ApplyN(pApply->GetSpanDstBuf(), pSrcPixels, n);
+      memcpy(pDestPixels, pApply->GetSpanDstBuf(), (size_t)n*m_nOutputChannels*sizeof(icFloatNumber));
+    }
+    else {
+      first->ptr->ApplyN(pApply->GetSpanDstBuf(), pSrcPixels, n);
+      pApply->SwitchSpans();
+
+      for (i=first, i++; i!=last; i++) {
+        if (!i->ptr->GetElem()->IsAcs()) {
+          i->ptr->ApplyN(pApply->GetSpanDstBuf(), pApply->GetSpanSrcBuf(), n);
+          pApply->SwitchSpans();
+        }
+      }
+
+      last->ptr->ApplyN(pDestPixels, pApply->GetSpanSrcBuf(), n);
+    }
+
+    pSrcPixels += n*m_nInputChannels;
+    pDestPixels += n*m_nOutputChannels;
+    nPixels -= n;
+  }
+}
+
+
 /**
  ******************************************************************************
  * Name: CIccTagMultiProcessElement::Validate
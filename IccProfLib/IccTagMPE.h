@@ -81,6 +81,7 @@ Copyright:  (c) see ICC Software License
 #include "icProfileHeader.h"
 #include <memory>
 #include <list>
+#include <atomic>
 
 
 //CIccFloatTag support
@@ -120,6 +121,9 @@ typedef CIccMultiProcessElementList::iterator CIccMultiProcessElementIter;
 
 #define icSigMpeLevel0 ((icSignature)0x6D706530)  /* 'mpe0' */
 
+//Number of pixels passed between elements at a time by CIccTagMultiProcessElement::ApplyN()
+#define icMpeBatchPixels 64
+
 class CIccApplyMpePtr
 {
 public:
@@ -170,6 +174,7 @@ public:
 
   virtual CIccApplyMpe* GetNewApply(CIccApplyTagMpe *pApplyTag);
   virtual void Apply(CIccApplyMpe *pApply, icFloatNumber *pDestPixel, const icFloatNumber *pSrcPixel) const = 0;
+  virtual void ApplyN(CIccApplyMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const;
 
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccTagMultiProcessElement* pMPE=NULL) const = 0;
 
@@ -211,6 +216,7 @@ public:
   CIccMultiProcessElement *GetElem() const { return m_pElem; }
 
   void Apply(icFloatNumber *pDestPixel, const icFloatNumber *pSrcPixel) { m_pElem->Apply(this, pDestPixel, pSrcPixel); }
+  void ApplyN(icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) { m_pElem->ApplyN(this, pDestPixels, pSrcPixels, nPixels); }
 
 protected:
   CIccApplyTagMpe *m_pApplyTag;
@@ -310,6 +316,34 @@ protected:
 };
 
 
+/**
+****************************************************************************
+* Class: CIccMpePlan
+* 
+* Purpose: Execution plan built by CIccTagMultiProcessElement::Begin().  The
+*  plan is reference counted so that apply objects made from it keep its
+*  elements alive after the tag rebuilds or releases its plan.
+*****************************************************************************
+*/
+class CIccMpePlan
+{
+public:
+  CIccMpePlan() : m_nRefCount(1) {}
+
+  void AddRef() { m_nRefCount++; }
+  void Release() { if (!--m_nRefCount) delete this; }
+
+  //Elements applied in order
+  CIccMultiProcessElementList m_list;
+  //Elements created for the plan and owned by it
+  CIccMultiProcessElementList m_elems;
+
+protected:
+  ~CIccMpePlan();
+
+  std::atomic<int> m_nRefCount;
+};
+
 /**
 ****************************************************************************
 * Class: CIccTagMultiProcessElement
@@ -330,17 +364,32 @@ public:
   CIccDblPixelBuffer *GetBuf() { return &m_applyBuf; }
   CIccApplyMpeList *GetList() { return m_list; }
 
+  bool BeginSpans(icUInt16Number nMaxChannels);
+  icFloatNumber *GetSpanSrcBuf() { return m_pSpanBuf1; }
+  icFloatNumber *GetSpanDstBuf() { return m_pSpanBuf2; }
+  void SwitchSpans() { icFloatNumber *tmp=m_pSpanBuf2; m_pSpanBuf2=m_pSpanBuf1; m_pSpanBuf1=tmp; }
+
   CIccApplyMpeIter begin() { return m_list->begin(); }
   CIccApplyMpeIter end() { return m_list->end(); }
 
+  ///Keeps a reference to the execution plan whose elements were appended
+  void SetPlan(CIccMpePlan *pPlan);
+
 protected:
   CIccTagMultiProcessElement *m_pTag;
 
+  //Execution plan that owns appended elements (NULL if elements are owned by the tag)
+  CIccMpePlan *m_pPlan;
+
   //List of processing elements
   CIccApplyMpeList *m_list;
 
   //Pixel data for Apply 
   CIccDblPixelBuffer m_applyBuf;
+
+  //Blocks of icMpeBatchPixels pixels for ApplyN
+  icFloatNumber *m_pSpanBuf1;
+  icFloatNumber *m_pSpanBuf2;
 };
 
 
@@ -385,9 +434,20 @@ public:
   virtual CIccApplyTagMpe *GetNewApply();
 
   virtual void Apply(CIccApplyTagMpe *pApply, icFloatNumber *pDestPixel, const icFloatNumber *pSrcPixel) const;
+  virtual void ApplyN(CIccApplyTagMpe *pApply, icFloatNumber *pDestPixels, const icFloatNumber *pSrcPixels, icUInt32Number nPixels) const;
 
   virtual icValidateStatus Validate(std::string sigPath, std::string &sReport, const CIccProfile* pProfile=NULL) const;
 
+  ///Enables/disables combining of elements into an execution plan by Begin()
+  void SetOptimize(bool bOptimize) { m_bOptimize = bOptimize; }
+  bool GetOptimize() const { return m_bOptimize; }
+
+  ///Measured error allowed when Begin() tabulates segmented curves of curve set elements (0 = leave as set on the elements)
+  void SetTableTolerance(icFloatNumber fMaxError) { m_fTableTolerance = fMaxError; }
+  icFloatNumber GetTableTolerance() const { return m_fTableTolerance; }
+
+  void DescribePlan(std::string &sDescription);
+
   icUInt16Number NumInputChannels() const { return m_nInputChannels; }
   icUInt16Number NumOutputChannels() const { return m_nOutputChannels; }
 
@@ -410,6 +470,9 @@ protected:
   virtual CIccMultiProcessElementList::iterator GetFirstElem();
   virtual CIccMultiProcessElementList::iterator GetLastElem();
 
+  void ResetPlan();
+  bool BuildPlan(icElemInterp nInterp);
+
   icUInt16Number m_nInputChannels;
   icUInt16Number m_nOutputChannels;
 
@@ -423,6 +486,13 @@ protected:
   //Number of Buffer Channels needed
   icUInt16Number m_nBufChannels;
 
+  //Execution plan built by Begin() (NULL if elements in m_list are applied directly)
+  bool m_bOptimize;
+  CIccMpePlan *m_pPlan;
+  std::string m_sPlanLog;
+
+  icFloatNumber m_fTableTolerance;
+
   IIccProfileConnectionConditions *m_pProfilePCC;
   IIccProfileConnectionConditions *m_pAppliedPCC;
 
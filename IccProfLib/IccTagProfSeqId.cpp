@@ -474,7 +474,7 @@ bool CIccTagProfileSequenceId::Read(icUInt32Number size, CIccIO *pIO)
   m_list->clear();
 
   icUInt32Number sig;
-  icUInt32Number tagStart = pIO->Tell();
+  icInt64Number tagStart = pIO->Tell();
 
   if (!pIO->Read32(&sig))
     return false;
@@ -546,7 +546,7 @@ bool CIccTagProfileSequenceId::Write(CIccIO *pIO)
   if (!pIO)
     return false;
 
-  icUInt32Number tagStart = pIO->Tell();
+  icInt64Number tagStart = pIO->Tell();
 
   if (!pIO->Write32(&sig))
     return false;
@@ -562,7 +562,7 @@ bool CIccTagProfileSequenceId::Write(CIccIO *pIO)
   if (!pos)
     return false;
 
-  icUInt32Number dirpos = pIO->Tell();
+  icInt64Number dirpos = pIO->Tell();
 
   //Write Unintialized TagDir
   for (i=0; i<count; i++) {
@@ -585,7 +585,7 @@ bool CIccTagProfileSequenceId::Write(CIccIO *pIO)
     pIO->Align32();
   }
 
-  icUInt32Number endpos = pIO->Tell();
+  icInt64Number endpos = pIO->Tell();
 
   pIO->Seek(dirpos, icSeekSet);
 
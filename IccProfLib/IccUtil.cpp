@@ -77,8 +77,10 @@
 #include <memory.h>
 #include <ctype.h>
 #include <math.h>
+#include <float.h>
 #include <string.h>
 #include <time.h>
+#include <algorithm>
 
 #define PI 3.1415926535897932384626433832795
 
@@ -448,7 +450,7 @@ icFloatNumber icRmsDif(const icFloatNumber *v1, const icFloatNumber *v2, icUInt3
 {
   icFloatNumber sum=0;
   icUInt32Number i;
-  for (i=0; i>nSample; i++) {
+  for (i=0; i<nSample; i++) {
     sum += icSq(v1[i] - v2[i]);
   }
   if (nSample)
@@ -861,6 +863,338 @@ void icXyzToPcs(icFloatNumber *XYZ)
 }
 
 
+/**
+ **************************************************************************
+ * Name: icCbrtPos
+ * 
+ * Purpose: 
+ *  Cube root of a positive finite value.  An estimate from the float bit
+ *  pattern (within a few percent) is refined by two Halley iterations,
+ *  which triples the number of correct bits each time, giving a result
+ *  accurate to float precision without a library call.
+ **************************************************************************
+ */
+static inline icFloatNumber icCbrtPos(icFloatNumber v)
+{
+  union { float f; icUInt32Number n; } u;
+
+  u.f = (float)v;
+  u.n = u.n/3 + 0x2a514067;
+
+  icFloat64Number x = v, y = u.f, y3;
+
+  y3 = y*y*y;
+  y *= (y3 + x + x) / (y3 + y3 + x);
+  y3 = y*y*y;
+  y *= (y3 + x + x) / (y3 + y3 + x);
+
+  return (icFloatNumber)y;
+}
+
+/**
+ **************************************************************************
+ * Name: icCubethFast
+ * 
+ * Purpose: 
+ *  Same as icCubeth() but uses icCbrtPos() and selects the result without
+ *  branching so that it can be used in vectorized loops.
+ **************************************************************************
+ */
+icFloatNumber icCubethFast(icFloatNumber v)
+{
+  icFloatNumber c = icCbrtPos(v);
+  icFloatNumber l = (icFloatNumber)(7.787037037037037037037037037037*v + 16.0/116.0);
+
+  c = v <= FLT_MAX ? c : v;
+  return v > 0.008856 ? c : l;
+}
+
+static inline icFloatNumber icUnitClipValue(icFloatNumber v)
+{
+  v = v < 0 ? 0 : v;
+  return v > 1.0f ? 1.0f : v;
+}
+
+/**
+ **************************************************************************
+ * Name: icXYZtoLabN
+ * 
+ * Purpose: 
+ *  Buffer version of icXYZtoLab()
+ * 
+ * Args: 
+ *  Lab = destination Lab pixels (may be the same as XYZ)
+ *  XYZ = source XYZ pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ *  WhiteXYZ = white point (D50 if NULL)
+ **************************************************************************
+ */
+void icXYZtoLabN(icFloatNumber *Lab, const icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride/*=3*/,
+                 const icFloatNumber *WhiteXYZ/*=NULL*/)
+{
+  if (!WhiteXYZ)
+    WhiteXYZ = icD50XYZ;
+
+  icFloatNumber sx = (icFloatNumber)(1.0 / WhiteXYZ[0]);
+  icFloatNumber sy = (icFloatNumber)(1.0 / WhiteXYZ[1]);
+  icFloatNumber sz = (icFloatNumber)(1.0 / WhiteXYZ[2]);
+  icFloatNumber Xn, Yn, Zn;
+
+  for (; nPixels; nPixels--, Lab+=nStride, XYZ+=nStride) {
+    Xn = icCubethFast(XYZ[0] * sx);
+    Yn = icCubethFast(XYZ[1] * sy);
+    Zn = icCubethFast(XYZ[2] * sz);
+
+    Lab[0] = (icFloatNumber)(116.0 * Yn - 16.0);
+    Lab[1] = (icFloatNumber)(500.0 * (Xn - Yn));
+    Lab[2] = (icFloatNumber)(200.0 * (Yn - Zn));
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icLabtoXYZN
+ * 
+ * Purpose: 
+ *  Buffer version of icLabtoXYZ()
+ * 
+ * Args: 
+ *  XYZ = destination XYZ pixels (may be the same as Lab)
+ *  Lab = source Lab pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ *  WhiteXYZ = white point (D50 if NULL)
+ **************************************************************************
+ */
+void icLabtoXYZN(icFloatNumber *XYZ, const icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride/*=3*/,
+                 const icFloatNumber *WhiteXYZ/*=NULL*/)
+{
+  if (!WhiteXYZ)
+    WhiteXYZ = icD50XYZ;
+
+  icFloatNumber Wx = WhiteXYZ[0], Wy = WhiteXYZ[1], Wz = WhiteXYZ[2];
+  icFloatNumber fy, a, b;
+
+  for (; nPixels; nPixels--, XYZ+=nStride, Lab+=nStride) {
+    fy = (icFloatNumber)((Lab[0] + 16.0) / 116.0);
+    a = (icFloatNumber)(Lab[1]/500.0 + fy);
+    b = (icFloatNumber)(fy - Lab[2]/200.0);
+
+    XYZ[0] = icICubeth(a) * Wx;
+    XYZ[1] = icICubeth(fy) * Wy;
+    XYZ[2] = icICubeth(b) * Wz;
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icLabFromPcsN, icLabToPcsN, icXyzFromPcsN, icXyzToPcsN
+ * 
+ * Purpose: 
+ *  Buffer versions of icLabFromPcs(), icLabToPcs(), icXyzFromPcs() and
+ *  icXyzToPcs()
+ **************************************************************************
+ */
+void icLabFromPcsN(icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride/*=3*/)
+{
+  for (; nPixels; nPixels--, Lab+=nStride) {
+    Lab[0] *= 100.0;
+    Lab[1] = (icFloatNumber)(Lab[1]*255.0 - 128.0);
+    Lab[2] = (icFloatNumber)(Lab[2]*255.0 - 128.0);
+  }
+}
+
+void icLabToPcsN(icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride/*=3*/)
+{
+  for (; nPixels; nPixels--, Lab+=nStride) {
+    Lab[0] /= 100.0;
+    Lab[1] = (icFloatNumber)((Lab[1] + 128.0) / 255.0);
+    Lab[2] = (icFloatNumber)((Lab[2] + 128.0) / 255.0);
+  }
+}
+
+void icXyzFromPcsN(icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride/*=3*/)
+{
+  for (; nPixels; nPixels--, XYZ+=nStride) {
+    XYZ[0] = (icFloatNumber)(XYZ[0] * 65535.0 / 32768.0);
+    XYZ[1] = (icFloatNumber)(XYZ[1] * 65535.0 / 32768.0);
+    XYZ[2] = (icFloatNumber)(XYZ[2] * 65535.0 / 32768.0);
+  }
+}
+
+void icXyzToPcsN(icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride/*=3*/)
+{
+  for (; nPixels; nPixels--, XYZ+=nStride) {
+    XYZ[0] = (icFloatNumber)(XYZ[0] * 32768.0 / 65535.0);
+    XYZ[1] = (icFloatNumber)(XYZ[1] * 32768.0 / 65535.0);
+    XYZ[2] = (icFloatNumber)(XYZ[2] * 32768.0 / 65535.0);
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icPcsXyzToPcsLabN
+ * 
+ * Purpose: 
+ *  Converts PCS encoded XYZ to PCS encoded Lab (D50 white point).  The PCS
+ *  decoding is folded into the white point normalization so each pixel
+ *  needs a single pass.  Gives the same results as CIccPCS::XyzToLab()
+ *  within float rounding.
+ * 
+ * Args: 
+ *  Dst = destination pixels (may be the same as Src)
+ *  Src = source pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ *  bClip = clip source and destination values to 0.0 to 1.0
+ **************************************************************************
+ */
+void icPcsXyzToPcsLabN(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride/*=3*/,
+                       bool bClip/*=false*/)
+{
+  icFloatNumber sx = (icFloatNumber)(65535.0 / 32768.0 / icD50XYZ[0]);
+  icFloatNumber sy = (icFloatNumber)(65535.0 / 32768.0 / icD50XYZ[1]);
+  icFloatNumber sz = (icFloatNumber)(65535.0 / 32768.0 / icD50XYZ[2]);
+  icFloatNumber X, Y, Z, Xn, Yn, Zn;
+
+  for (; nPixels; nPixels--, Dst+=nStride, Src+=nStride) {
+    X = Src[0];
+    Y = Src[1];
+    Z = Src[2];
+
+    if (bClip) {
+      X = icUnitClipValue(X);
+      Y = icUnitClipValue(Y);
+      Z = icUnitClipValue(Z);
+    }
+
+    Xn = icCubethFast(X * sx);
+    Yn = icCubethFast(Y * sy);
+    Zn = icCubethFast(Z * sz);
+
+    X = (icFloatNumber)((116.0 * Yn - 16.0) / 100.0);
+    Y = (icFloatNumber)((500.0 * (Xn - Yn) + 128.0) / 255.0);
+    Z = (icFloatNumber)((200.0 * (Yn - Zn) + 128.0) / 255.0);
+
+    if (bClip) {
+      X = icUnitClipValue(X);
+      Y = icUnitClipValue(Y);
+      Z = icUnitClipValue(Z);
+    }
+
+    Dst[0] = X;
+    Dst[1] = Y;
+    Dst[2] = Z;
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icPcsLabToPcsXyzN
+ * 
+ * Purpose: 
+ *  Converts PCS encoded Lab to PCS encoded XYZ (D50 white point).  Gives
+ *  the same results as CIccPCS::LabToXyz() within float rounding.
+ * 
+ * Args: 
+ *  Dst = destination pixels (may be the same as Src)
+ *  Src = source pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ *  bClip = clip destination values to 0.0 to 1.0
+ **************************************************************************
+ */
+void icPcsLabToPcsXyzN(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride/*=3*/,
+                       bool bClip/*=false*/)
+{
+  icFloatNumber sx = (icFloatNumber)(icD50XYZ[0] * 32768.0 / 65535.0);
+  icFloatNumber sy = (icFloatNumber)(icD50XYZ[1] * 32768.0 / 65535.0);
+  icFloatNumber sz = (icFloatNumber)(icD50XYZ[2] * 32768.0 / 65535.0);
+  icFloatNumber fy, fx, fz, X, Y, Z;
+
+  for (; nPixels; nPixels--, Dst+=nStride, Src+=nStride) {
+    fy = (icFloatNumber)((Src[0]*100.0 + 16.0) / 116.0);
+    fx = (icFloatNumber)((Src[1]*255.0 - 128.0)/500.0 + fy);
+    fz = (icFloatNumber)(fy - (Src[2]*255.0 - 128.0)/200.0);
+
+    X = icICubeth(fx) * sx;
+    Y = icICubeth(fy) * sy;
+    Z = icICubeth(fz) * sz;
+
+    if (bClip) {
+      X = icUnitClipValue(X);
+      Y = icUnitClipValue(Y);
+      Z = icUnitClipValue(Z);
+    }
+
+    Dst[0] = X;
+    Dst[1] = Y;
+    Dst[2] = Z;
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icPcsLab2ToLab4N
+ * 
+ * Purpose: 
+ *  Converts version 2 PCS Lab encoding to version 4 PCS Lab encoding
+ * 
+ * Args: 
+ *  Dst = destination pixels (may be the same as Src)
+ *  Src = source pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ *  bClip = clip destination values to 0.0 to 1.0
+ **************************************************************************
+ */
+void icPcsLab2ToLab4N(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride/*=3*/,
+                      bool bClip/*=false*/)
+{
+  icFloatNumber L, a, b;
+
+  for (; nPixels; nPixels--, Dst+=nStride, Src+=nStride) {
+    L = (icFloatNumber)(Src[0] * 65535.0f / 65280.0f);
+    a = (icFloatNumber)(Src[1] * 65535.0f / 65280.0f);
+    b = (icFloatNumber)(Src[2] * 65535.0f / 65280.0f);
+
+    if (bClip) {
+      L = icUnitClipValue(L);
+      a = icUnitClipValue(a);
+      b = icUnitClipValue(b);
+    }
+
+    Dst[0] = L;
+    Dst[1] = a;
+    Dst[2] = b;
+  }
+}
+
+/**
+ **************************************************************************
+ * Name: icPcsLab4ToLab2N
+ * 
+ * Purpose: 
+ *  Converts version 4 PCS Lab encoding to version 2 PCS Lab encoding
+ * 
+ * Args: 
+ *  Dst = destination pixels (may be the same as Src)
+ *  Src = source pixels
+ *  nPixels = number of pixels
+ *  nStride = number of samples between pixels
+ **************************************************************************
+ */
+void icPcsLab4ToLab2N(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride/*=3*/)
+{
+  for (; nPixels; nPixels--, Dst+=nStride, Src+=nStride) {
+    Dst[0] = (icFloatNumber)(Src[0] * 65280.0f / 65535.0f);
+    Dst[1] = (icFloatNumber)(Src[1] * 65280.0f / 65535.0f);
+    Dst[2] = (icFloatNumber)(Src[2] * 65280.0f / 65535.0f);
+  }
+}
+
+
 #define DUMPBYTESPERLINE 16
 
 void icMemDump(std::string &sDump, void *pBuf, icUInt32Number nNum)
@@ -2370,6 +2704,278 @@ CIccPixelBuf::~CIccPixelBuf()
     delete [] m_pixel;
 }
 
+
+//Dimensions above this are searched by blocked scan instead of a k-d tree
+#define icNearestTreeMaxDim 8
+#define icNearestBlockSize 256
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::CIccNearestIndex
+ * 
+ * Purpose: Constructor
+ ******************************************************************************
+ */
+CIccNearestIndex::CIccNearestIndex()
+{
+  m_nPoints = 0;
+  m_nDim = 0;
+  m_pPoints = NULL;
+  m_pIndex = NULL;
+  m_pAxis = NULL;
+}
+
+CIccNearestIndex::~CIccNearestIndex()
+{
+  Reset();
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::Reset
+ * 
+ * Purpose: Release the points held by the index
+ ******************************************************************************
+ */
+void CIccNearestIndex::Reset()
+{
+  if (m_pPoints)
+    delete [] m_pPoints;
+  if (m_pIndex)
+    delete [] m_pIndex;
+  if (m_pAxis)
+    delete [] m_pAxis;
+
+  m_pPoints = NULL;
+  m_pIndex = NULL;
+  m_pAxis = NULL;
+  m_nPoints = 0;
+  m_nDim = 0;
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::Build
+ * 
+ * Purpose: Copies a set of points into the index
+ * 
+ * Args:
+ *  pPoints - nPoints points of nDim values each stored one after another
+ *  nPoints - number of points
+ *  nDim - number of values per point
+ *
+ * Return:
+ *  true if successful, false if memory could not be allocated
+ ******************************************************************************
+ */
+bool CIccNearestIndex::Build(const icFloatNumber *pPoints, icUInt32Number nPoints, icUInt32Number nDim)
+{
+  Reset();
+
+  if (!nPoints || !nDim)
+    return true;
+
+  icUInt32Number i, j;
+
+  m_pPoints = new icFloatNumber[nPoints*nDim];
+  if (!m_pPoints)
+    return false;
+
+  m_nPoints = nPoints;
+  m_nDim = nDim;
+
+  if (nDim > icNearestTreeMaxDim) {
+    for (i=0; i<nPoints; i++) {
+      for (j=0; j<nDim; j++)
+        m_pPoints[j*nPoints + i] = pPoints[i*nDim + j];
+    }
+    return true;
+  }
+
+  m_pIndex = new icUInt32Number[nPoints];
+  m_pAxis = new icUInt8Number[nPoints];
+  if (!m_pIndex || !m_pAxis) {
+    Reset();
+    return false;
+  }
+
+  for (i=0; i<nPoints; i++)
+    m_pIndex[i] = i;
+
+  BuildTree(0, nPoints, pPoints);
+
+  for (i=0; i<nPoints; i++)
+    memcpy(&m_pPoints[i*nDim], &pPoints[m_pIndex[i]*nDim], nDim*sizeof(icFloatNumber));
+
+  return true;
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::BuildTree
+ * 
+ * Purpose: Orders m_pIndex[nStart..nEnd) so that the middle entry splits
+ *  the range on the axis with the largest spread
+ ******************************************************************************
+ */
+void CIccNearestIndex::BuildTree(icUInt32Number nStart, icUInt32Number nEnd, const icFloatNumber *pPoints)
+{
+  while (nEnd > nStart) {
+    icUInt32Number i, j, nMid = nStart + (nEnd - nStart)/2;
+    icUInt8Number nAxis = 0;
+    icFloatNumber dSpread = -1.0;
+
+    for (j=0; j<m_nDim; j++) {
+      icFloatNumber lo = pPoints[m_pIndex[nStart]*m_nDim + j], hi = lo;
+      for (i=nStart+1; i<nEnd; i++) {
+        icFloatNumber v = pPoints[m_pIndex[i]*m_nDim + j];
+        if (v<lo)
+          lo = v;
+        else if (v>hi)
+          hi = v;
+      }
+      if (hi - lo > dSpread) {
+        dSpread = hi - lo;
+        nAxis = (icUInt8Number)j;
+      }
+    }
+
+    const icFloatNumber *pAxisVals = pPoints + nAxis;
+    icUInt32Number nDim = m_nDim;
+    std::nth_element(m_pIndex + nStart, m_pIndex + nMid, m_pIndex + nEnd,
+                     [pAxisVals, nDim](icUInt32Number a, icUInt32Number b) {
+                       return pAxisVals[a*nDim] < pAxisVals[b*nDim];
+                     });
+    m_pAxis[nMid] = nAxis;
+
+    BuildTree(nStart, nMid, pPoints);
+    nStart = nMid + 1;
+  }
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::SearchTree
+ * 
+ * Purpose: Recursive nearest neighbor search of the k-d tree in
+ *  [nStart..nEnd)
+ ******************************************************************************
+ */
+void CIccNearestIndex::SearchTree(icUInt32Number nStart, icUInt32Number nEnd, const icFloatNumber *pPoint,
+                                  icFloatNumber &dBest, icInt32Number &nBest) const
+{
+  while (nEnd > nStart) {
+    icUInt32Number j, nMid = nStart + (nEnd - nStart)/2;
+    const icFloatNumber *pMid = &m_pPoints[nMid*m_nDim];
+    icFloatNumber d, dist = 0;
+
+    for (j=0; j<m_nDim; j++) {
+      d = pPoint[j] - pMid[j];
+      dist += d*d;
+    }
+
+    icInt32Number nIndex = (icInt32Number)m_pIndex[nMid];
+    if (nBest<0 || dist<dBest || (dist==dBest && nIndex<nBest)) {
+      dBest = dist;
+      nBest = nIndex;
+    }
+
+    d = pPoint[m_pAxis[nMid]] - pMid[m_pAxis[nMid]];
+
+    //Search the near side first and then the far side if it can still hold
+    //a point as close (with a little slack for rounding of the distances)
+    if (d<0) {
+      SearchTree(nStart, nMid, pPoint, dBest, nBest);
+      if (d*d > dBest*(icFloatNumber)1.0001)
+        return;
+      nStart = nMid + 1;
+    }
+    else {
+      SearchTree(nMid+1, nEnd, pPoint, dBest, nBest);
+      if (d*d > dBest*(icFloatNumber)1.0001)
+        return;
+      nEnd = nMid;
+    }
+  }
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::SearchBlocks
+ * 
+ * Purpose: Nearest neighbor search by scanning blocks of dimension major
+ *  points.  The inner loops are written so that compilers can vectorize
+ *  them across points.
+ ******************************************************************************
+ */
+icInt32Number CIccNearestIndex::SearchBlocks(const icFloatNumber *pPoint, icFloatNumber &dBest) const
+{
+  icFloatNumber dist[icNearestBlockSize];
+  icInt32Number nBest = -1;
+  icUInt32Number i, j, n, nBlock;
+
+  for (i=0; i<m_nPoints; i+=icNearestBlockSize) {
+    nBlock = m_nPoints - i;
+    if (nBlock > icNearestBlockSize)
+      nBlock = icNearestBlockSize;
+
+    for (n=0; n<nBlock; n++)
+      dist[n] = 0;
+
+    for (j=0; j<m_nDim; j++) {
+      const icFloatNumber *pCol = &m_pPoints[j*m_nPoints + i];
+      icFloatNumber v = pPoint[j];
+      for (n=0; n<nBlock; n++) {
+        icFloatNumber d = v - pCol[n];
+        dist[n] += d*d;
+      }
+    }
+
+    for (n=0; n<nBlock; n++) {
+      if (nBest<0 || dist[n]<dBest) {
+        dBest = dist[n];
+        nBest = (icInt32Number)(i+n);
+      }
+    }
+  }
+
+  return nBest;
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccNearestIndex::FindNearest
+ * 
+ * Purpose: Finds the point closest to pPoint
+ * 
+ * Args:
+ *  pPoint - point to search for (GetDim() values)
+ *  pDistSq - optional location for the squared distance to the point found
+ *
+ * Return:
+ *  The index of the closest point as passed to Build(), or -1 if the index
+ *  is empty
+ ******************************************************************************
+ */
+icInt32Number CIccNearestIndex::FindNearest(const icFloatNumber *pPoint, icFloatNumber *pDistSq/*=NULL*/) const
+{
+  icFloatNumber dBest = 0;
+  icInt32Number nBest = -1;
+
+  if (!m_nPoints)
+    return -1;
+
+  if (m_pIndex)
+    SearchTree(0, m_nPoints, pPoint, dBest, nBest);
+  else
+    nBest = SearchBlocks(pPoint, dBest);
+
+  if (pDistSq)
+    *pDistSq = dBest;
+
+  return nBest;
+}
+
 #ifdef USEREFICCMAXNAMESPACE
 } //namespace refIccMAX
 #endif
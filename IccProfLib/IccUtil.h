@@ -75,6 +75,7 @@
 #include "IccProfLibConf.h"
 #include <string>
 #include <limits>
+#include <string.h>
 
 #ifdef USEREFICCMAXNAMESPACE
 namespace refIccMAX {
@@ -171,6 +172,29 @@ ICCPROFLIB_API void icLabToPcs(icFloatNumber *Lab);
 ICCPROFLIB_API void icXyzFromPcs(icFloatNumber *XYZ);
 ICCPROFLIB_API void icXyzToPcs(icFloatNumber *XYZ);
 
+/** Buffer versions of the conversions above.  Each pixel holds three values
+ and pixels are nStride samples apart.  Dst may be the same as Src.  The loops
+ avoid library calls and branches so that they can be vectorized.*/
+ICCPROFLIB_API icFloatNumber icCubethFast(icFloatNumber v);
+ICCPROFLIB_API void icXYZtoLabN(icFloatNumber *Lab, const icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride=3,
+                                const icFloatNumber *WhiteXYZ=NULL);
+ICCPROFLIB_API void icLabtoXYZN(icFloatNumber *XYZ, const icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride=3,
+                                const icFloatNumber *WhiteXYZ=NULL);
+ICCPROFLIB_API void icLabFromPcsN(icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride=3);
+ICCPROFLIB_API void icLabToPcsN(icFloatNumber *Lab, icUInt32Number nPixels, icUInt32Number nStride=3);
+ICCPROFLIB_API void icXyzFromPcsN(icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride=3);
+ICCPROFLIB_API void icXyzToPcsN(icFloatNumber *XYZ, icUInt32Number nPixels, icUInt32Number nStride=3);
+
+///PCS encoded conversions (XYZ and Lab both encoded as 0.0 to 1.0) with optional clipping to the encoding range
+ICCPROFLIB_API void icPcsXyzToPcsLabN(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride=3,
+                                      bool bClip=false);
+ICCPROFLIB_API void icPcsLabToPcsXyzN(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride=3,
+                                      bool bClip=false);
+///Version 2 (legacy 16-bit) <-> version 4 PCS Lab encoding
+ICCPROFLIB_API void icPcsLab2ToLab4N(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride=3,
+                                     bool bClip=false);
+ICCPROFLIB_API void icPcsLab4ToLab2N(icFloatNumber *Dst, const icFloatNumber *Src, icUInt32Number nPixels, icUInt32Number nStride=3);
+
 
 ICCPROFLIB_API void icMemDump(std::string &sDump, void *pBuf, icUInt32Number nNum);
 ICCPROFLIB_API void icMatrixDump(std::string &sDump, icS15Fixed16Number *pMatrix);
@@ -196,6 +220,21 @@ ICCPROFLIB_API extern const char *icValidateWarningMsg;
 ICCPROFLIB_API extern const char *icValidateNonCompliantMsg;
 ICCPROFLIB_API extern const char *icValidateCriticalErrorMsg;
 
+inline icUInt16Number icSwabVal16(icUInt16Number v)
+{
+  return (icUInt16Number)((v>>8) | (v<<8));
+}
+
+inline icUInt32Number icSwabVal32(icUInt32Number v)
+{
+  return (v>>24) | ((v>>8) & 0xff00) | ((v<<8) & 0xff0000) | (v<<24);
+}
+
+inline icUInt64Number icSwabVal64(icUInt64Number v)
+{
+  return ((icUInt64Number)icSwabVal32((icUInt32Number)v)<<32) | icSwabVal32((icUInt32Number)(v>>32));
+}
+
 #ifdef ICC_BYTE_ORDER_LITTLE_ENDIAN
 inline void icSwab16Ptr(void *pVoid)
 {
@@ -205,15 +244,17 @@ inline void icSwab16Ptr(void *pVoid)
   tmp = ptr[0]; ptr[0] = ptr[1]; ptr[1] = tmp;
 }
 
+//The array functions are written as simple word loops so that compilers
+//can turn them into vector byte shuffles.
 inline void icSwab16Array(void *pVoid, int num)
 {
   icUInt8Number *ptr = (icUInt8Number*)pVoid;
-  icUInt8Number tmp;
+  icUInt16Number v;
 
-  while (num>0) {
-    tmp = ptr[0]; ptr[0] = ptr[1]; ptr[1] = tmp;
-    ptr += 2;
-    num--;
+  for (; num>0; num--, ptr+=2) {
+    memcpy(&v, ptr, 2);
+    v = icSwabVal16(v);
+    memcpy(ptr, &v, 2);
   }
 }
 
@@ -229,15 +270,13 @@ inline void icSwab32Ptr(void *pVoid)
 inline void icSwab32Array(void *pVoid, int num)
 {
   icUInt8Number *ptr = (icUInt8Number*)pVoid;
-  icUInt8Number tmp;
+  icUInt32Number v;
 
-  while (num>0) {
-    tmp = ptr[0]; ptr[0] = ptr[3]; ptr[3] = tmp;
-    tmp = ptr[1]; ptr[1] = ptr[2]; ptr[2] = tmp;
-    ptr += 4;
-    num--;
+  for (; num>0; num--, ptr+=4) {
+    memcpy(&v, ptr, 4);
+    v = icSwabVal32(v);
+    memcpy(ptr, &v, 4);
   }
-
 }
 
 inline void icSwab64Ptr(void *pVoid)
@@ -254,17 +293,55 @@ inline void icSwab64Ptr(void *pVoid)
 inline void icSwab64Array(void *pVoid, int num)
 {
   icUInt8Number *ptr = (icUInt8Number*)pVoid;
-  icUInt8Number tmp;
+  icUInt64Number v;
+
+  for (; num>0; num--, ptr+=8) {
+    memcpy(&v, ptr, 8);
+    v = icSwabVal64(v);
+    memcpy(ptr, &v, 8);
+  }
+}
+
+///Copies num 16 bit values from pSrc to pDst swapping to/from big endian
+inline void icSwab16Copy(void *pDst, const void *pSrc, int num)
+{
+  icUInt8Number *dst = (icUInt8Number*)pDst;
+  const icUInt8Number *src = (const icUInt8Number*)pSrc;
+  icUInt16Number v;
+
+  for (; num>0; num--, src+=2, dst+=2) {
+    memcpy(&v, src, 2);
+    v = icSwabVal16(v);
+    memcpy(dst, &v, 2);
+  }
+}
 
-  while (num>0) {
-    tmp = ptr[0]; ptr[0] = ptr[7]; ptr[7] = tmp;
-    tmp = ptr[1]; ptr[1] = ptr[6]; ptr[6] = tmp;
-    tmp = ptr[2]; ptr[2] = ptr[5]; ptr[5] = tmp;
-    tmp = ptr[3]; ptr[3] = ptr[4]; ptr[4] = tmp;
-    ptr += 8;
-    num--;
+///Copies num 32 bit values from pSrc to pDst swapping to/from big endian
+inline void icSwab32Copy(void *pDst, const void *pSrc, int num)
+{
+  icUInt8Number *dst = (icUInt8Number*)pDst;
+  const icUInt8Number *src = (const icUInt8Number*)pSrc;
+  icUInt32Number v;
+
+  for (; num>0; num--, src+=4, dst+=4) {
+    memcpy(&v, src, 4);
+    v = icSwabVal32(v);
+    memcpy(dst, &v, 4);
   }
+}
 
+///Copies num 64 bit values from pSrc to pDst swapping to/from big endian
+inline void icSwab64Copy(void *pDst, const void *pSrc, int num)
+{
+  icUInt8Number *dst = (icUInt8Number*)pDst;
+  const icUInt8Number *src = (const icUInt8Number*)pSrc;
+  icUInt64Number v;
+
+  for (; num>0; num--, src+=8, dst+=8) {
+    memcpy(&v, src, 8);
+    v = icSwabVal64(v);
+    memcpy(dst, &v, 8);
+  }
 }
 #else //!ICC_BYTE_ORDER_LITTLE_ENDIAN
 #define icSwab16Ptr(flt)
@@ -273,6 +350,9 @@ inline void icSwab64Array(void *pVoid, int num)
 #define icSwab32Array(flt, n)
 #define icSwab64Ptr(flt)
 #define icSwab64Array(flt, n)
+#define icSwab16Copy(dst, src, n) memcpy(dst, src, (n)*2)
+#define icSwab32Copy(dst, src, n) memcpy(dst, src, (n)*4)
+#define icSwab64Copy(dst, src, n) memcpy(dst, src, (n)*8)
 #endif
 
 #define icSwab16(flt) icSwab16Ptr(&flt)
@@ -373,6 +453,48 @@ protected:
   icFloatNumber *m_pixel;
 };
 
+/**
+ **************************************************************************
+ * Type: Class
+ *
+ * Purpose:
+ *  This is a utility class for nearest neighbor searches over a fixed set
+ *  of points (such as the Lab, device or spectral values of named colors).
+ *  Points with few dimensions are organized into a balanced k-d tree.
+ *  Points with more dimensions are stored dimension major and searched
+ *  with a blocked distance loop that compilers can vectorize.
+ *  Ties are resolved in favor of the point with the lowest index so that
+ *  results match a linear search.
+ **************************************************************************
+ */
+class ICCPROFLIB_API CIccNearestIndex
+{
+public:
+  CIccNearestIndex();
+  ~CIccNearestIndex();
+
+  bool Build(const icFloatNumber *pPoints, icUInt32Number nPoints, icUInt32Number nDim);
+  void Reset();
+
+  icInt32Number FindNearest(const icFloatNumber *pPoint, icFloatNumber *pDistSq=NULL) const;
+
+  icUInt32Number GetNumPoints() const { return m_nPoints; }
+  icUInt32Number GetDim() const { return m_nDim; }
+
+protected:
+  void BuildTree(icUInt32Number nStart, icUInt32Number nEnd, const icFloatNumber *pPoints);
+  void SearchTree(icUInt32Number nStart, icUInt32Number nEnd, const icFloatNumber *pPoint,
+                  icFloatNumber &dBest, icInt32Number &nBest) const;
+  icInt32Number SearchBlocks(const icFloatNumber *pPoint, icFloatNumber &dBest) const;
+
+  icUInt32Number m_nPoints;
+  icUInt32Number m_nDim;
+
+  icFloatNumber *m_pPoints;
+  icUInt32Number *m_pIndex;
+  icUInt8Number *m_pAxis;
+};
+
 
 
 /**
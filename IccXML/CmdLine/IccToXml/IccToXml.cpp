@@ -5,6 +5,7 @@
 #include "IccTagXmlFactory.h"
 #include "IccMpeXmlFactory.h"
 #include "IccProfileXml.h"
+#include "IccUtilXml.h"
 #include "IccIO.h"
 #include "IccProfLibVer.h"
 #include "IccLibXMLVer.h"
@@ -32,27 +33,20 @@ int main(int argc, char* argv[])
     return -1;
   }
 
-  std::string xml;
-  xml.reserve(40000000);
-
-  if (!profile.ToXml(xml)) {
-    printf("Unable to convert '%s' to xml\n", argv[1]);
-    return -1;
-  }
-
   if (!dstIO.Open(argv[2], "wb")) {
     printf("unable to open '%s'\n", argv[2]);
     return -1;
   }
 
-  if (dstIO.Write8((char*)xml.c_str(), (icInt32Number)xml.size())==(icInt32Number)xml.size()) {
-    printf("XML successfully created\n");
-  }
-  else {
-    printf("Unable to write '%s'\n", argv[2]);
+  CIccXmlIOSink sink(&dstIO);
+
+  if (!profile.ToXml(&sink) || !sink.Flush()) {
+    printf("Unable to convert '%s' to xml\n", argv[1]);
     return -1;
   }
 
+  printf("XML successfully created\n");
+
   dstIO.Close();
 
   return 0;
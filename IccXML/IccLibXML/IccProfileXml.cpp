@@ -65,14 +65,201 @@
 #include "IccTagXml.h"
 #include "IccUtilXml.h"
 #include "IccArrayBasic.h"
+#include "IccMpeFactory.h"
+#include "IccStructFactory.h"
+#include "IccArrayFactory.h"
 #include <set>
 #include <cstring> /* C strings strcpy, memcpy ... */
 #include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 typedef  std::map<icUInt32Number, icTagSignature> IccOffsetTagSigMap;
 
+struct CIccTagXmlJob
+{
+  CIccTagXml *pTagXml;   //NULL if xml is already complete
+  icTagSignature sig;
+  std::string xml;
+  std::string xmlEnd;
+  bool bDone;
+  bool bOk;
+};
+
+typedef std::vector<CIccTagXmlJob> CIccTagXmlJobList;
+
+/**
+ * Shared state of the threads converting tags in icTagsToXml(). Workers
+ * only start tags that are within nWindow of the next tag to be written
+ * so that the XML held in memory stays bounded.
+ */
+struct CIccTagXmlQueue
+{
+  CIccTagXmlJobList *pJobs;
+  size_t nNext;
+  size_t nWritten;
+  size_t nWindow;
+  bool bAbort;
+  std::mutex mutex;
+  std::condition_variable cvWork;
+  std::condition_variable cvDone;
+};
+
+static void icTagToXml(CIccTagXmlJob &job)
+{
+  job.bOk = job.pTagXml->ToXml(job.xml, "      ");
+  if (job.bOk)
+    job.xml += job.xmlEnd;
+  std::string().swap(job.xmlEnd);
+}
+
+static void icTagXmlWorker(CIccTagXmlQueue *pQueue)
+{
+  std::unique_lock<std::mutex> lock(pQueue->mutex);
+
+  while (true) {
+    while (!pQueue->bAbort && pQueue->nNext<pQueue->pJobs->size() &&
+           pQueue->nNext>=pQueue->nWritten+pQueue->nWindow)
+      pQueue->cvWork.wait(lock);
+
+    if (pQueue->bAbort || pQueue->nNext>=pQueue->pJobs->size())
+      break;
+
+    CIccTagXmlJob &job = (*pQueue->pJobs)[pQueue->nNext++];
+    if (job.bDone)
+      continue;
+
+    lock.unlock();
+    icTagToXml(job);
+    lock.lock();
+
+    job.bDone = true;
+    pQueue->cvDone.notify_all();
+  }
+}
+
+/**
+ ******************************************************************************
+ * Name: icTagsToXml
+ *
+ * Purpose: Converts the tag bodies in jobs to XML using nThreads threads and
+ *  writes the completed XML of each job to pSink in order.
+ ******************************************************************************
+ */
+static bool icTagsToXml(IIccXmlSink *pSink, CIccTagXmlJobList &jobs, int nThreads)
+{
+  char buf[40];
+  size_t i;
+
+  if (nThreads<=0) {
+    nThreads = (int)std::thread::hardware_concurrency();
+    if (nThreads<=0)
+      nThreads = 1;
+  }
+  if ((size_t)nThreads>jobs.size())
+    nThreads = (int)jobs.size();
+
+  if (nThreads<=1) {
+    for (i=0; i<jobs.size(); i++) {
+      CIccTagXmlJob &job = jobs[i];
+
+      if (!job.bDone)
+        icTagToXml(job);
+
+      if (!job.bOk) {
+        printf("Unable to output tag with type %s\n", icGetSigStr(buf, job.sig));
+        return false;
+      }
+      if (!pSink->Write(job.xml))
+        return false;
+      std::string().swap(job.xml);
+    }
+    return true;
+  }
+
+  //Make sure lazily initialized factory tables are built before the
+  //workers can use them
+  std::string name;
+  CIccMpeCreator::GetElementSigName(name, icSigUnknownElemType);
+  CIccStructCreator::GetStructSigName(name, icSigUnknownStruct);
+  CIccArrayCreator::GetArraySigName(name, icSigUnknownArray);
+
+  CIccTagXmlQueue queue;
+  std::vector<std::thread> threads;
+  bool rv = true;
+
+  queue.pJobs = &jobs;
+  queue.nNext = 0;
+  queue.nWritten = 0;
+  queue.nWindow = (size_t)nThreads*2;
+  queue.bAbort = false;
+
+  for (i=0; i<(size_t)nThreads; i++)
+    threads.push_back(std::thread(icTagXmlWorker, &queue));
+
+  for (i=0; i<jobs.size(); i++) {
+    CIccTagXmlJob &job = jobs[i];
+    {
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      while (!job.bDone)
+        queue.cvDone.wait(lock);
+    }
+
+    if (!job.bOk) {
+      printf("Unable to output tag with type %s\n", icGetSigStr(buf, job.sig));
+      rv = false;
+    }
+    else if (!pSink->Write(job.xml)) {
+      rv = false;
+    }
+    std::string().swap(job.xml);
+
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (!rv) {
+      queue.bAbort = true;
+      queue.cvWork.notify_all();
+      break;
+    }
+    queue.nWritten = i+1;
+    queue.cvWork.notify_all();
+  }
+
+  for (i=0; i<threads.size(); i++)
+    threads[i].join();
+
+  return rv;
+}
+
 bool CIccProfileXml::ToXml(std::string &xml)
-{ 
+{
+  CIccXmlStringSink sink(xml);
+
+  xml.clear();
+
+  return ToXml(&sink, 1);
+}
+
+/**
+*****************************************************************************
+* Name: CIccProfileXml::ToXml
+*
+* Purpose: Writes the profile as XML to a sink. The XML for each tag is
+*  generated by a pool of worker threads and written to the sink in tag
+*  order as soon as it and all tags before it are complete.
+*
+* Args:
+*  pSink - destination for the XML text
+*  nThreads - number of worker threads, 0 uses one per hardware thread
+*
+* Return:
+*  true if the whole profile was converted and written
+*****************************************************************************
+*/
+bool CIccProfileXml::ToXml(IIccXmlSink *pSink, int nThreads)
+{
+  std::string xml;
   CIccInfo info;
   char line[256];
   char buf[256];
@@ -198,6 +385,7 @@ bool CIccProfileXml::ToXml(std::string &xml)
   std::set<icTagSignature> sigSet;
   CIccInfo Fmt;
   IccOffsetTagSigMap offsetTags;
+  CIccTagXmlJobList jobs;
 
   for (i=m_Tags->begin(); i!=m_Tags->end(); i++) {
     if (sigSet.find(i->TagInfo.sig)==sigSet.end()) {
@@ -208,6 +396,13 @@ bool CIccProfileXml::ToXml(std::string &xml)
         if (pTagXml) {
           IccOffsetTagSigMap::iterator prevTag = offsetTags.find(i->TagInfo.offset);
           const icChar *tagName = Fmt.GetTagSigName(i->TagInfo.sig);
+          CIccTagXmlJob job;
+
+          job.pTagXml = NULL;
+          job.sig = i->TagInfo.sig;
+          job.bDone = false;
+          job.bOk = false;
+
           if (prevTag == offsetTags.end()) {
             const icChar* tagSig = icGetTagSigTypeName(pTag->GetType());
 
@@ -218,38 +413,19 @@ bool CIccProfileXml::ToXml(std::string &xml)
               sprintf(line, "    <PrivateTag TagSignature=\"%s\"> ", icFixXml(fix, icGetSigStr(buf, i->TagInfo.sig)));
               tagName = "PrivateTag";
             }
-            xml += line;
+            job.xml = line;
             // PrivateType - a type that does not belong to the list in the icc specs - custom for vendor.
             if (!strcmp("PrivateType", tagSig))
               sprintf(line, "<PrivateType type=\"%s\">\n", icFixXml(fix, icGetSigStr(buf, pTag->GetType())));
             else
               sprintf(line, "<%s>\n", tagSig); //parent node is the tag type
 
-            xml += line;
-            j = i;
-#if 0
-            // print out the tag signature (there is at least one)
-            sprintf(line, "      <TagSignature>%s</TagSignature>\n", icFixXml(fix, icGetSigStr(buf, i->TagInfo.sig)));
-            xml += line;
-
-            sigSet.insert(i->TagInfo.sig);
-
-            // print out the rest of the tag signatures
-            for (j++; j != m_Tags->end(); j++) {
-              if (j->pTag == i->pTag || j->TagInfo.offset == i->TagInfo.offset) {
-                sprintf(line, "      <TagSignature>%s</TagSignature>\n", icFixXml(fix, icGetSigStr(buf, j->TagInfo.sig)));
-                xml += line;
-                sigSet.insert(j->TagInfo.sig);
-              }
-            }
-#endif
-            //convert the rest of the tag to xml
-            if (!pTagXml->ToXml(xml, "      ")) {
-              printf("Unable to output tag with type %s\n", icGetSigStr(buf, i->TagInfo.sig));
-              return false;
-            }
+            job.xml += line;
+
+            //the rest of the tag is converted to xml by icTagsToXml()
+            job.pTagXml = pTagXml;
             sprintf(line, "    </%s> </%s>\n\n", tagSig, tagName);
-            xml += line;
+            job.xmlEnd = line;
             offsetTags[i->TagInfo.offset] = i->TagInfo.sig;
           }
           else {
@@ -265,14 +441,17 @@ bool CIccProfileXml::ToXml(std::string &xml)
             else
               sprintf(line, "    <PrivateTag TagSignature=\"%s\" SameAs=\"%s\"", icFixXml(fix2, icGetSigStr(buf, i->TagInfo.sig)), icFixXml(fix, prevTagName));
             
-            xml += line;
+            job.xml = line;
             if (prevTagName == nameBuf) {
               sprintf(line, " SameAsSignature=\"%s\"", icFixXml(fix2, icGetSigStr(buf, prevTag->second)));
-              xml += line;
+              job.xml += line;
             }
 
-            xml += "/>\n\n";
+            job.xml += "/>\n\n";
+            job.bDone = true;
+            job.bOk = true;
           }
+          jobs.push_back(job);
         }
         else {
           printf("Non XML tag in list with tag %s!\n", icGetSigStr(buf, i->TagInfo.sig));
@@ -285,10 +464,17 @@ bool CIccProfileXml::ToXml(std::string &xml)
       }
     }
   }
-  xml += "  </Tags>\n";
+
+  if (!pSink->Write(xml))
+    return false;
+
+  if (!icTagsToXml(pSink, jobs, nThreads))
+    return false;
+
+  xml = "  </Tags>\n";
   xml += "</IccProfile>\n";
 
-  return true;
+  return pSink->Write(xml);
 }
 
 
@@ -733,9 +919,17 @@ bool CIccProfileXml::LoadXml(const char *szFilename, const char *szRelaxNGDir, s
 {  
   xmlDoc *doc = NULL;
   xmlNode *root_element = NULL;
+  CIccXmlDocReader reader;
 
   /*parse the file and get the DOM */
-  doc = xmlReadFile(szFilename, NULL, 0);
+  if (szRelaxNGDir && szRelaxNGDir[0]) {
+    //RelaxNG validation needs the array text in the DOM
+    doc = xmlReadFile(szFilename, NULL, 0);
+  }
+  else {
+    //Large numeric arrays are parsed while streaming the file
+    doc = reader.ReadFile(szFilename);
+  }
 
   if (doc == NULL) 
     return NULL;
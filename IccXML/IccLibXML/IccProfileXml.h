@@ -70,6 +70,7 @@ Copyright:  (c) see ICC Software License
 #include <libxml/tree.h>
 #include <libxml/relaxng.h>
 
+class IIccXmlSink;
 
 class CIccProfileXml :
   public CIccProfile
@@ -78,6 +79,7 @@ public:
   virtual ~CIccProfileXml() {}
 
   bool ToXml(std::string &xmlString);
+  bool ToXml(IIccXmlSink *pSink, int nThreads=0);
 
   bool ParseXml(xmlNode *pNode, std::string &parseStr);
   bool LoadXml(const char *szFilename, const char *szRelaxNGDir, std::string *parseStr=NULL);
@@ -1986,7 +1986,7 @@ bool CIccTagXmlSpectralViewingConditions::ParseXml(xmlNode *pNode, std::string &
 
     if (pChild->children && pChild->children->content) {
       CIccFloatArray vals;
-      vals.ParseTextArray((icChar*)pChild->children->content);
+      vals.ParseTextArray(pChild);
       if (vals.GetSize()!=m_observerRange.steps*3)
         return false;
       m_observer = (icFloatNumber*)malloc(m_observerRange.steps*3*sizeof(icFloatNumber));
@@ -2028,7 +2028,7 @@ bool CIccTagXmlSpectralViewingConditions::ParseXml(xmlNode *pNode, std::string &
 
     if (pChild->children && pChild->children->content) {
       CIccFloatArray vals;
-      vals.ParseTextArray((icChar*)pChild->children->content);
+      vals.ParseTextArray(pChild);
       if (vals.GetSize()!=m_illuminantRange.steps)
         return false;
       m_illuminant = (icFloatNumber*)malloc(m_illuminantRange.steps * sizeof(icFloatNumber));
@@ -2431,8 +2431,8 @@ bool CIccTagXmlCurve::ToXml(std::string &xml, icConvertType nType, std::string b
         xml += "\n";
         xml += blanks + " ";
       }
-      sprintf(buf, " %13.8f", m_Curve[i]);
-      xml += buf;
+      buf[0] = ' ';
+      xml.append(buf, icXmlFloatToStr(buf+1, (icFloat32Number)m_Curve[i]) + 1);
     }
     xml += "\n";
     xml += blanks + "</Curve>\n";
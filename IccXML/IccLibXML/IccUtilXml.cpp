@@ -65,6 +65,8 @@
 #include "IccUtilXml.h"
 #include "IccConvertUTF.h"
 #include "IccTagFactory.h"
+#include "libxml/SAX2.h"
+#include "libxml/parserInternals.h"
 
 #ifdef WIN32
 #include <windows.h>
@@ -73,6 +75,8 @@
 #endif
 #endif
 #include <cstring> /* C strings strcpy, memcpy ... */
+#include <cfloat>
+#include <math.h>
 
 
 
@@ -452,9 +456,10 @@ public:
         break;
       case icConvertFloat:
       default:
+        //Shortest text that reads back as the same float
         for (i=0; i<m_nSamples; i++) {
-          sprintf(buf, " %13.8f", pData[i]);
-          *m_xml += buf;
+          buf[0] = ' ';
+          m_xml->append(buf, icXmlFloatToStr(buf+1, (icFloat32Number)pData[i]) + 1);
         }
         break;
     }
@@ -635,18 +640,22 @@ icUInt32Number icXmlGetHexDataSize(const char *szText)
 
 icUInt32Number icXmlDumpHexData(std::string &xml, std::string blanks, void *pBuf, icUInt32Number nBufSize)
 {
+  static const char hexDigits[] = "0123456789abcdef";
   icUInt8Number *m_ptr = (icUInt8Number *)pBuf;
-  char buf[15];
+  char buf[2];
   icUInt32Number i;
 
+  xml.reserve(xml.size() + (size_t)nBufSize*2 + (size_t)(nBufSize/32 + 1)*(blanks.size() + 1));
+
   for (i=0; i<nBufSize; i++, m_ptr++) {
     if (!(i%32)) {
       if (i)
         xml += "\n";
       xml += blanks;
     }
-    sprintf(buf, "%02x", *m_ptr);
-    xml += buf; 
+    buf[0] = hexDigits[*m_ptr >> 4];
+    buf[1] = hexDigits[*m_ptr & 0xf];
+    xml.append(buf, 2);
   }
   if (i) {
     xml += "\n";
@@ -700,6 +709,588 @@ icUInt32Number icXmlNodeCount(xmlNode *pNode, const char *szNodeName)
   return rv;
 }
 
+static const icFloat64Number icPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ ******************************************************************************
+ * Name: icXmlStrToDouble
+ * 
+ * Purpose: Converts a numeric token to a double. Tokens with at most 19
+ *  significant digits whose mantissa and power of ten are both exactly
+ *  representable are converted with a single correctly rounded multiply or
+ *  divide. Anything else goes through atof so results always match atof.
+ * 
+ * Args: 
+ *  szNum - start of token (need not be null terminated)
+ *  nLen - number of characters in token
+ *
+ * Return: 
+ *  converted value
+ ******************************************************************************
+ */
+icFloat64Number icXmlStrToDouble(const char *szNum, size_t nLen)
+{
+  const char *ptr = szNum, *end = szNum + nLen;
+  bool bNeg = false;
+
+  if (ptr<end && (*ptr=='-' || *ptr=='+')) {
+    bNeg = (*ptr=='-');
+    ptr++;
+  }
+
+  icUInt64Number mantissa = 0;
+  int nDigits = 0, nSigDigits = 0, nExp = 0;
+
+  for (; ptr<end && *ptr>='0' && *ptr<='9'; ptr++, nDigits++) {
+    if (mantissa || *ptr!='0') {
+      if (nSigDigits<19)
+        mantissa = mantissa*10 + (*ptr - '0');
+      else
+        nExp++;
+      nSigDigits++;
+    }
+  }
+  if (ptr<end && *ptr=='.') {
+    for (ptr++; ptr<end && *ptr>='0' && *ptr<='9'; ptr++, nDigits++) {
+      if (mantissa || *ptr!='0') {
+        if (nSigDigits<19) {
+          mantissa = mantissa*10 + (*ptr - '0');
+          nExp--;
+        }
+        nSigDigits++;
+      }
+      else
+        nExp--;
+    }
+  }
+
+  if (nDigits && ptr<end && *ptr=='e') {
+    const char *exp = ptr+1;
+    bool bExpNeg = false;
+    int e = 0, n = 0;
+
+    if (exp<end && (*exp=='-' || *exp=='+')) {
+      bExpNeg = (*exp=='-');
+      exp++;
+    }
+    for (; exp<end && *exp>='0' && *exp<='9' && n<6; exp++, n++)
+      e = e*10 + (*exp - '0');
+
+    if (n)
+      nExp += bExpNeg ? -e : e;
+    ptr = n ? exp : end+1;
+  }
+
+  if (nDigits && ptr==end && nSigDigits<=19) {
+    if (!mantissa)
+      return bNeg ? -0.0 : 0.0;
+
+    if (mantissa <= ((icUInt64Number)1<<53) && nExp>=-22 && nExp<=22) {
+      icFloat64Number rv = (icFloat64Number)mantissa;
+      if (nExp<0)
+        rv /= icPow10[-nExp];
+      else
+        rv *= icPow10[nExp];
+      return bNeg ? -rv : rv;
+    }
+  }
+
+  char num[256];
+  if (nLen>=sizeof(num))
+    nLen = sizeof(num)-1;
+  memcpy(num, szNum, nLen);
+  num[nLen] = 0;
+
+  return atof(num);
+}
+
+/**
+ ******************************************************************************
+ * Name: icXmlUIntToStr
+ *
+ * Purpose: Writes the decimal digits of an unsigned value followed by a null.
+ *
+ * Return:
+ *  number of characters written (not including the null)
+ ******************************************************************************
+ */
+icUInt32Number icXmlUIntToStr(char *szBuf, icUInt32Number nVal)
+{
+  char digits[12];
+  icUInt32Number n = 0, i;
+
+  do {
+    digits[n++] = (char)('0' + nVal%10);
+    nVal /= 10;
+  } while (nVal);
+
+  for (i=0; i<n; i++)
+    szBuf[i] = digits[n-1-i];
+  szBuf[n] = 0;
+
+  return n;
+}
+
+/**
+ ******************************************************************************
+ * Name: icXmlFloatToStr
+ *
+ * Purpose: Writes the shortest decimal string that reads back as exactly
+ *  fVal. Candidates with increasing numbers of significant digits are
+ *  checked by converting them back the same way icXmlStrToDouble does, so
+ *  no candidate is accepted that parses to a different float. Values that
+ *  are not finite or too small or large for this are written with sprintf.
+ *
+ * Args:
+ *  szBuf - destination of at least 32 characters
+ *  fVal - value to write
+ *
+ * Return:
+ *  number of characters written (not including the null)
+ ******************************************************************************
+ */
+icUInt32Number icXmlFloatToStr(char *szBuf, icFloat32Number fVal)
+{
+  icFloat64Number d = fVal;
+  char *ptr = szBuf;
+
+  if (d==0.0) {
+    if (1.0/d < 0)
+      *ptr++ = '-';
+    *ptr++ = '0';
+    *ptr = 0;
+    return (icUInt32Number)(ptr - szBuf);
+  }
+
+  if (d<0) {
+    *ptr++ = '-';
+    d = -d;
+  }
+
+  if (d>=1e-13 && d<1e13) {
+    int e = (int)floor(log10(d));
+    int p;
+
+    if (e>=0 ? d<icPow10[e] : d*icPow10[-e]<1.0)
+      e--;
+    else if (e+1>=0 ? d>=icPow10[e+1] : d*icPow10[-e-1]>=1.0)
+      e++;
+
+    for (p=1; p<=9; p++) {
+      int k = p - 1 - e;   //value is m * 10^-k
+      icFloat64Number m;
+
+      if (k<-22 || k>22)
+        break;
+
+      m = floor((k>=0 ? d*icPow10[k] : d/icPow10[-k]) + 0.5);
+
+      icFloat64Number v = k>=0 ? m/icPow10[k] : m*icPow10[-k];
+      if ((icFloat32Number)v != (icFloat32Number)d)
+        continue;
+
+      char digits[12];
+      int nDigits = (int)icXmlUIntToStr(digits, (icUInt32Number)m);
+      int nPoint = nDigits - k;  //digits before the decimal point
+      int i;
+
+      while (nDigits>1 && nDigits>nPoint && digits[nDigits-1]=='0')
+        nDigits--;
+
+      if (nPoint<=0) {
+        *ptr++ = '0';
+        *ptr++ = '.';
+        for (i=nPoint; i<0; i++)
+          *ptr++ = '0';
+        for (i=0; i<nDigits; i++)
+          *ptr++ = digits[i];
+      }
+      else {
+        for (i=0; i<nDigits; i++) {
+          if (i==nPoint)
+            *ptr++ = '.';
+          *ptr++ = digits[i];
+        }
+        for (; i<nPoint; i++)
+          *ptr++ = '0';
+      }
+      *ptr = 0;
+      return (icUInt32Number)(ptr - szBuf);
+    }
+  }
+
+  sprintf(szBuf, "%.9g", (icFloat64Number)fVal);
+  return (icUInt32Number)strlen(szBuf);
+}
+
+CIccXmlIOSink::CIccXmlIOSink(CIccIO *pIO, size_t nBufSize)
+{
+  m_pIO = pIO;
+  m_nBufSize = nBufSize ? nBufSize : 1;
+  m_pBuf = (char*)malloc(m_nBufSize);
+  m_nUsed = 0;
+  m_bOk = (m_pIO!=NULL && m_pBuf!=NULL);
+}
+
+CIccXmlIOSink::~CIccXmlIOSink()
+{
+  Flush();
+  if (m_pBuf)
+    free(m_pBuf);
+}
+
+bool CIccXmlIOSink::Write(const char *szText, size_t nLen)
+{
+  if (!m_bOk)
+    return false;
+
+  while (nLen) {
+    size_t n = m_nBufSize - m_nUsed;
+    if (n>nLen)
+      n = nLen;
+
+    memcpy(m_pBuf+m_nUsed, szText, n);
+    m_nUsed += n;
+    szText += n;
+    nLen -= n;
+
+    if (m_nUsed==m_nBufSize && !Flush())
+      return false;
+  }
+
+  return true;
+}
+
+bool CIccXmlIOSink::Flush()
+{
+  if (!m_bOk)
+    return false;
+
+  if (m_nUsed) {
+    if (m_pIO->Write8(m_pBuf, (icUInt32Number)m_nUsed)!=(icInt32Number)m_nUsed)
+      m_bOk = false;
+    m_nUsed = 0;
+  }
+
+  return m_bOk;
+}
+
+// for multi-platform support
+// replaced "_inline" with "inline"
+static inline bool icIsNumChar(char c)
+{
+  if ((c>='0' && c<='9') || c=='.' || c=='+' || c=='-' || c=='e')
+    return true;
+  return false;
+}
+
+static inline bool icIsXmlSpace(char c)
+{
+  return c==' ' || c=='\n' || c=='\t' || c=='\r';
+}
+
+void CIccXmlNumbers::Add(icFloat64Number v)
+{
+  if (!m_bDouble) {
+    icFloat32Number f = (icFloat32Number)v;
+
+    if ((icFloat64Number)f==v || v!=v) {
+      m_fVals.push_back(f);
+      return;
+    }
+
+    m_dVals.reserve(m_fVals.size()*2 + 16);
+    m_dVals.assign(m_fVals.begin(), m_fVals.end());
+    std::vector<icFloat32Number>().swap(m_fVals);
+    m_bDouble = true;
+  }
+  m_dVals.push_back(v);
+}
+
+CIccXmlDocReader::CIccXmlDocReader(size_t nMinStreamSize)
+{
+  m_nMinStreamSize = nMinStreamSize;
+}
+
+CIccXmlDocReader::~CIccXmlDocReader()
+{
+  size_t i;
+  for (i=0; i<m_blocks.size(); i++)
+    delete m_blocks[i];
+}
+
+/**
+ ******************************************************************************
+ * Name: CIccXmlDocReader::ReadFile
+ * 
+ * Purpose: Parses an XML file using SAX callbacks that build the same tree
+ *  as xmlReadFile(szFilename, NULL, 0) apart from large numeric arrays.
+ * 
+ * Args: 
+ *  szFilename - name of XML file to read
+ *
+ * Return: 
+ *  Document that the caller must free with xmlFreeDoc, or NULL on error.
+ ******************************************************************************
+ */
+xmlDoc *CIccXmlDocReader::ReadFile(const char *szFilename)
+{
+  xmlParserCtxtPtr ctxt = xmlCreateURLParserCtxt(szFilename, 0);
+
+  if (!ctxt)
+    return NULL;
+
+  xmlCtxtUseOptions(ctxt, 0);
+
+  ctxt->_private = this;
+  ctxt->sax->startElementNs = StartElementNs;
+  ctxt->sax->endElementNs = EndElementNs;
+  ctxt->sax->characters = Characters;
+  ctxt->sax->ignorableWhitespace = Characters;
+  ctxt->sax->cdataBlock = CDataBlock;
+  ctxt->sax->comment = Comment;
+  ctxt->sax->processingInstruction = ProcessingInstruction;
+  ctxt->sax->reference = Reference;
+
+  m_stack.clear();
+
+  xmlParseDocument(ctxt);
+
+  xmlDoc *doc = ctxt->myDoc;
+  if (!ctxt->wellFormed && doc) {
+    xmlFreeDoc(doc);
+    doc = NULL;
+  }
+  ctxt->myDoc = NULL;
+  xmlFreeParserCtxt(ctxt);
+
+  m_stack.clear();
+
+  return doc;
+}
+
+CIccXmlDocReader *CIccXmlDocReader::GetReader(void *ctx)
+{
+  return (CIccXmlDocReader*)((xmlParserCtxtPtr)ctx)->_private;
+}
+
+bool CIccXmlDocReader::IsArrayElement(const xmlChar *localname)
+{
+  static const char *szArrayNames[] = {
+    "TableData", "Curve", "SampledSegment", "SingleSampledSegment", "MatrixData",
+    "WhiteData", "OffsetData", "ObserverFuncs", "IlluminantSPD", "FullMatrix",
+    "PCSValues", "DeviceValues", NULL
+  };
+  int i;
+
+  for (i=0; szArrayNames[i]; i++) {
+    if (!icXmlStrCmp(localname, szArrayNames[i]))
+      return true;
+  }
+  return false;
+}
+
+void CIccXmlDocReader::EmitText(void *ctx, const char *szText, size_t nLen)
+{
+  while (nLen) {
+    int n = nLen > 0x40000000 ? 0x40000000 : (int)nLen;
+    xmlSAX2Characters(ctx, (const xmlChar*)szText, n);
+    szText += n;
+    nLen -= n;
+  }
+}
+
+void CIccXmlDocReader::AddToken(CElementState &state)
+{
+  if (!state.token.empty()) {
+    state.pNums->Add(icXmlStrToDouble(state.token.data(), state.token.size()));
+    state.token.clear();
+  }
+}
+
+/** Adds text to a numeric array. Returns false without using any of the
+ * text if it is not a whitespace separated list of numbers, in which case
+ * the caller must fall back to normal text handling. */
+bool CIccXmlDocReader::AddText(CElementState &state, const char *szText, size_t nLen)
+{
+  size_t i;
+
+  for (i=0; i<nLen; i++) {
+    if (!icIsNumChar(szText[i]) && !icIsXmlSpace(szText[i]))
+      return false;
+  }
+
+  const char *end = szText + nLen;
+  while (szText<end) {
+    if (icIsXmlSpace(*szText)) {
+      AddToken(state);
+    }
+    else if (state.token.size()<254) { //Same truncation as CIccXmlArrayType::ParseText()
+      state.token += *szText;
+    }
+    szText++;
+  }
+  return true;
+}
+
+/** Leaves numeric mode, turning what has been read so far back into text */
+void CIccXmlDocReader::EndText(void *ctx, CElementState &state)
+{
+  if (state.bNumeric) {
+    std::string text;
+    char num[40];
+    size_t i, n = state.pNums->GetSize();
+
+    text.reserve(n*12 + state.token.size() + state.text.size());
+    for (i=0; i<n; i++) {
+      icFloat64Number v = state.pNums->GetValue(i);
+      if (v>DBL_MAX || v<-DBL_MAX)
+        strcpy(num, v<0 ? "-1e999 " : "1e999 ");
+      else
+        sprintf(num, "%.17g ", v);
+      text += num;
+    }
+    text += state.token;
+    text += state.text;
+    state.text.swap(text);
+
+    m_blocks.pop_back();
+    delete state.pNums;
+    state.pNums = NULL;
+    state.token.clear();
+    state.bNumeric = false;
+  }
+
+  if (!state.text.empty()) {
+    EmitText(ctx, state.text.data(), state.text.size());
+    std::string().swap(state.text);
+  }
+  state.bArray = false;
+}
+
+void CIccXmlDocReader::StartElementNs(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI,
+                                      int nb_namespaces, const xmlChar **namespaces,
+                                      int nb_attributes, int nb_defaulted, const xmlChar **attributes)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (!pThis->m_stack.empty() && pThis->m_stack.back().bArray)
+    pThis->EndText(ctx, pThis->m_stack.back());
+
+  xmlSAX2StartElementNs(ctx, localname, prefix, URI, nb_namespaces, namespaces, nb_attributes, nb_defaulted, attributes);
+
+  CElementState state;
+  state.bArray = IsArrayElement(localname);
+  state.bNumeric = false;
+  state.pNums = NULL;
+  pThis->m_stack.push_back(state);
+}
+
+void CIccXmlDocReader::EndElementNs(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+  xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr)ctx;
+
+  if (!pThis->m_stack.empty()) {
+    CElementState &state = pThis->m_stack.back();
+
+    if (state.bNumeric) {
+      pThis->AddToken(state);
+
+      xmlNodePtr pText = xmlNewDocText(ctxt->myDoc, (const xmlChar*)"");
+      if (pText) {
+        pText->_private = state.pNums;
+        xmlAddChild(ctxt->node, pText);
+      }
+    }
+    else if (state.bArray) {
+      pThis->EndText(ctx, state);
+    }
+    pThis->m_stack.pop_back();
+  }
+
+  xmlSAX2EndElementNs(ctx, localname, prefix, URI);
+}
+
+void CIccXmlDocReader::Characters(void *ctx, const xmlChar *ch, int len)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (pThis->m_stack.empty() || !pThis->m_stack.back().bArray) {
+    xmlSAX2Characters(ctx, ch, len);
+    return;
+  }
+
+  CElementState &state = pThis->m_stack.back();
+
+  if (state.bNumeric) {
+    if (!pThis->AddText(state, (const char*)ch, len)) {
+      state.text.assign((const char*)ch, len);
+      pThis->EndText(ctx, state);
+    }
+    return;
+  }
+
+  state.text.append((const char*)ch, len);
+
+  if (state.text.size()>=pThis->m_nMinStreamSize) {
+    std::string text;
+    text.swap(state.text);
+
+    state.pNums = new CIccXmlNumbers;
+    pThis->m_blocks.push_back(state.pNums);
+    state.bNumeric = true;
+
+    if (!pThis->AddText(state, text.data(), text.size())) {
+      state.text.swap(text);
+      pThis->EndText(ctx, state);
+    }
+  }
+}
+
+void CIccXmlDocReader::CDataBlock(void *ctx, const xmlChar *value, int len)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (!pThis->m_stack.empty() && pThis->m_stack.back().bArray)
+    pThis->EndText(ctx, pThis->m_stack.back());
+
+  xmlSAX2CDataBlock(ctx, value, len);
+}
+
+void CIccXmlDocReader::Comment(void *ctx, const xmlChar *value)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (!pThis->m_stack.empty() && pThis->m_stack.back().bArray)
+    pThis->EndText(ctx, pThis->m_stack.back());
+
+  xmlSAX2Comment(ctx, value);
+}
+
+void CIccXmlDocReader::ProcessingInstruction(void *ctx, const xmlChar *target, const xmlChar *data)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (!pThis->m_stack.empty() && pThis->m_stack.back().bArray)
+    pThis->EndText(ctx, pThis->m_stack.back());
+
+  xmlSAX2ProcessingInstruction(ctx, target, data);
+}
+
+void CIccXmlDocReader::Reference(void *ctx, const xmlChar *name)
+{
+  CIccXmlDocReader *pThis = GetReader(ctx);
+
+  if (!pThis->m_stack.empty() && pThis->m_stack.back().bArray)
+    pThis->EndText(ctx, pThis->m_stack.back());
+
+  xmlSAX2Reference(ctx, name);
+}
+
 template <class T, icTagTypeSignature Tsig>
 CIccXmlArrayType<T, Tsig>::CIccXmlArrayType()
 {
@@ -732,6 +1323,15 @@ bool CIccXmlArrayType<T, Tsig>::ParseArray(xmlNode *pNode)
 
   for ( ;pNode && pNode->type!= XML_TEXT_NODE; pNode=pNode->next);
 
+  const CIccXmlNumbers *pNums = CIccXmlNumbers::FromNode(pNode);
+  if (pNums) {
+    n = (icUInt32Number)pNums->GetSize();
+    if (!n || !SetSize(n))
+      return false;
+    pNums->GetValues(m_pBuf, n);
+    return true;
+  }
+
   if (!pNode || !pNode->content)
     return false;
 
@@ -762,6 +1362,14 @@ template <class T, icTagTypeSignature Tsig>
 bool CIccXmlArrayType<T, Tsig>::ParseTextArray(xmlNode *pNode)
 {
   if (pNode->children && pNode->children->type==XML_TEXT_NODE) {
+    const CIccXmlNumbers *pNums = CIccXmlNumbers::FromNode(pNode->children);
+    if (pNums) {
+      icUInt32Number n = (icUInt32Number)pNums->GetSize();
+      if (!n || !SetSize(n))
+        return false;
+      pNums->GetValues(m_pBuf, n);
+      return true;
+    }
     return ParseTextArray((const char*)pNode->children->content);
   }
   return false;
@@ -787,14 +1395,17 @@ bool CIccXmlArrayType<T, Tsig>::DumpArray(std::string &xml, std::string blanks,
   char str[200];
 
   if (!nColumns) nColumns = 1;
-  icUInt32Number i;
+  icUInt32Number i, n=0;
+
+  xml.reserve(xml.size() + (size_t)nBufSize*(Tsig==icSigUInt8ArrayType ? 4 : 11) +
+              (size_t)(nBufSize/nColumns + 1)*(blanks.size() + 1));
 
   for (i=0; i<nBufSize; i++) {
     if (!(i%nColumns)) {
       xml += blanks;
     }
     else {
-      xml += " ";
+      xml += ' ';
     }
 
     switch (Tsig) {
@@ -802,15 +1413,15 @@ bool CIccXmlArrayType<T, Tsig>::DumpArray(std::string &xml, std::string blanks,
         switch (nType) {
           case icConvert8Bit:
           default:
-            sprintf(str, "%u", (icUInt8Number)buf[i]);
+            n = icXmlUIntToStr(str, (icUInt8Number)buf[i]);
             break;
 
           case icConvert16Bit:
-            sprintf(str, "%u", (icUInt16Number)((icFloatNumber)buf[i] * 65535.0 / 255.0 + 0.5));
+            n = icXmlUIntToStr(str, (icUInt16Number)((icFloatNumber)buf[i] * 65535.0 / 255.0 + 0.5));
             break;
 
           case icConvertFloat:
-            sprintf(str, "%.8f", (icFloatNumber)buf[i] / 255.0);
+            n = icXmlFloatToStr(str, (icFloat32Number)(buf[i] / 255.0));
             break;
         }
         break;
@@ -818,22 +1429,22 @@ bool CIccXmlArrayType<T, Tsig>::DumpArray(std::string &xml, std::string blanks,
       case icSigUInt16ArrayType:
         switch (nType) {
           case icConvert8Bit:
-            sprintf(str, "%u", (icUInt16Number)((icFloatNumber)buf[i] * 255.0 / 65535.0 + 0.5));
+            n = icXmlUIntToStr(str, (icUInt16Number)((icFloatNumber)buf[i] * 255.0 / 65535.0 + 0.5));
             break;
 
           case icConvert16Bit:
           default:
-            sprintf(str, "%u", (icUInt16Number)buf[i]);
+            n = icXmlUIntToStr(str, (icUInt16Number)buf[i]);
             break;
 
           case icConvertFloat:
-            sprintf(str, "%.8f", (icFloatNumber)buf[i] / 65535.0);
+            n = icXmlFloatToStr(str, (icFloat32Number)(buf[i] / 65535.0));
             break;
         }
         break;
 
       case icSigUInt32ArrayType:
-        sprintf(str, "%u", (icUInt32Number)buf[i]);
+        n = icXmlUIntToStr(str, (icUInt32Number)buf[i]);
         break;
 
       case icSigFloatArrayType:
@@ -841,22 +1452,22 @@ bool CIccXmlArrayType<T, Tsig>::DumpArray(std::string &xml, std::string blanks,
       case icSigFloat64ArrayType:
         switch (nType) {
           case icConvert8Bit:
-            sprintf(str, "%u", (icUInt8Number)(buf[i] * 255.0 + 0.5));
+            n = icXmlUIntToStr(str, (icUInt8Number)(buf[i] * 255.0 + 0.5));
             break;
 
           case icConvert16Bit:
-            sprintf(str, "%u", (icUInt16Number)(buf[i] * 65535.0 + 0.5));
+            n = icXmlUIntToStr(str, (icUInt16Number)(buf[i] * 65535.0 + 0.5));
             break;
 
           case icConvertFloat:
           default:
-            sprintf(str, "%.8f", (icFloatNumber)buf[i]);
+            n = icXmlFloatToStr(str, (icFloat32Number)buf[i]);
         }
         break;
     }
-    xml += str;
+    xml.append(str, n);
     if (i%nColumns == nColumns-1) {
-      xml += "\n";
+      xml += '\n';
     }
   }
 
@@ -867,14 +1478,6 @@ bool CIccXmlArrayType<T, Tsig>::DumpArray(std::string &xml, std::string blanks,
   return true;
 }
 
-// for multi-platform support
-// replaced "_inline" with "inline"
-static inline bool icIsNumChar(char c)
-{
-  if ((c>='0' && c<='9') || c=='.' || c=='+' || c=='-' || c=='e')
-    return true;
-  return false;
-}
 
 // function used when checking contents of a file
 // count the number of entries.
@@ -964,16 +1567,14 @@ icUInt32Number CIccXmlArrayType<T, Tsig>::ParseText(T* pBuf, icUInt32Number nSiz
         b++;
     }
     else if (bInNum) {
-      num[b] = 0;
-      pBuf[n] = (T)atof(num);
+      pBuf[n] = (T)icXmlStrToDouble(num, b);
       n++;
       bInNum = false;
     }
     szText++;
   }
   if (bInNum) {
-    num[b] = 0;
-    pBuf[n] = (T)atof(num);
+    pBuf[n] = (T)icXmlStrToDouble(num, b);
     n++;
   } 
 
@@ -988,6 +1589,15 @@ bool CIccXmlArrayType<T, Tsig>::ParseArray(T* pBuf, icUInt32Number nSize, xmlNod
     n = icXmlNodeCount(pNode, "f");
 
     if (!n) {
+      const CIccXmlNumbers *pNums = CIccXmlNumbers::FromNode(pNode);
+      if (pNums) {
+        n = (icUInt32Number)pNums->GetSize();
+        if (!n || n>nSize)
+          return false;
+        pNums->GetValues(pBuf, n);
+        return nSize==n;
+      }
+
       if (pNode->type!=XML_TEXT_NODE || !pNode->content)
         return false;
 
@@ -1019,6 +1629,15 @@ bool CIccXmlArrayType<T, Tsig>::ParseArray(T* pBuf, icUInt32Number nSize, xmlNod
     n = icXmlNodeCount(pNode, "n");
 
     if (!n) {
+      const CIccXmlNumbers *pNums = CIccXmlNumbers::FromNode(pNode);
+      if (pNums) {
+        n = (icUInt32Number)pNums->GetSize();
+        if (!n || n>nSize)
+          return false;
+        pNums->GetValues(pBuf, n);
+        return nSize==n;
+      }
+
       if (pNode->type!=XML_TEXT_NODE || !pNode->content)
         return false;
 
@@ -66,6 +66,7 @@
 
 #include "IccUtil.h"
 #include "IccTag.h"
+#include "IccIO.h"
 #include "IccXmlConfig.h"
 #include "libxml/parser.h"
 #include <vector>
@@ -138,6 +139,154 @@ xmlNode *icXmlFindNode(xmlNode *pNode, const char *szNodeName);
 
 icUInt32Number icXmlNodeCount(xmlNode *pNode, const char *szNodeName);
 
+icFloat64Number icXmlStrToDouble(const char *szNum, size_t nLen);
+
+icUInt32Number icXmlUIntToStr(char *szBuf, icUInt32Number nVal);
+icUInt32Number icXmlFloatToStr(char *szBuf, icFloat32Number fVal);
+
+/**
+ * Destination for generated XML text.
+ */
+class IIccXmlSink
+{
+public:
+  virtual ~IIccXmlSink() {}
+
+  virtual bool Write(const char *szText, size_t nLen)=0;
+  bool Write(const std::string &text) { return Write(text.data(), text.size()); }
+};
+
+/**
+ * Sink that appends XML text to a std::string.
+ */
+class CIccXmlStringSink : public IIccXmlSink
+{
+public:
+  CIccXmlStringSink(std::string &xml) : m_xml(xml) {}
+
+  virtual bool Write(const char *szText, size_t nLen) { m_xml.append(szText, nLen); return true; }
+
+protected:
+  std::string &m_xml;
+};
+
+/**
+ * Sink that writes XML text to a CIccIO in fixed size chunks. Data is only
+ * guaranteed to have been passed to the CIccIO after Flush() returns true.
+ * The CIccIO is not owned by the sink.
+ */
+class CIccXmlIOSink : public IIccXmlSink
+{
+public:
+  CIccXmlIOSink(CIccIO *pIO, size_t nBufSize=0x40000);
+  virtual ~CIccXmlIOSink();
+
+  virtual bool Write(const char *szText, size_t nLen);
+  bool Flush();
+
+protected:
+  CIccIO *m_pIO;
+  char *m_pBuf;
+  size_t m_nBufSize;
+  size_t m_nUsed;
+  bool m_bOk;
+};
+
+/**
+ * Numeric values of a large array element that were parsed while streaming
+ * the XML document. The element is given a single empty text node whose
+ * _private member points to the block, so that the array text never has to
+ * be held in the DOM. Values are kept as float until one is found that
+ * cannot be represented exactly.
+ */
+class CIccXmlNumbers
+{
+public:
+  CIccXmlNumbers() : m_bDouble(false) {}
+
+  void Add(icFloat64Number v);
+
+  size_t GetSize() const { return m_bDouble ? m_dVals.size() : m_fVals.size(); }
+  icFloat64Number GetValue(size_t i) const { return m_bDouble ? m_dVals[i] : (icFloat64Number)m_fVals[i]; }
+
+  template <class T>
+  void GetValues(T *pBuf, size_t n) const
+  {
+    size_t i;
+    if (m_bDouble) {
+      for (i=0; i<n; i++)
+        pBuf[i] = (T)m_dVals[i];
+    }
+    else {
+      for (i=0; i<n; i++)
+        pBuf[i] = (T)(icFloat64Number)m_fVals[i];
+    }
+  }
+
+  static const CIccXmlNumbers *FromNode(xmlNode *pNode)
+  {
+    return (pNode && pNode->type==XML_TEXT_NODE) ? (const CIccXmlNumbers*)pNode->_private : NULL;
+  }
+
+protected:
+  bool m_bDouble;
+  std::vector<icFloat32Number> m_fVals;
+  std::vector<icFloat64Number> m_dVals;
+};
+
+/**
+ * Builds a libxml2 document using a streaming SAX parser. Text content of
+ * large numeric array elements (CLUT TableData, sampled curves, spectral
+ * matrices and observer data, ...) is tokenized as it arrives and stored in
+ * CIccXmlNumbers blocks rather than as DOM text. All other content is passed
+ * to the default libxml2 tree builder unchanged.
+ *
+ * The blocks are owned by the reader so the reader must outlive any use of
+ * the document it returns.
+ */
+class CIccXmlDocReader
+{
+public:
+  CIccXmlDocReader(size_t nMinStreamSize=icXmlMinStreamSize);
+  ~CIccXmlDocReader();
+
+  xmlDoc *ReadFile(const char *szFilename);
+
+  static const size_t icXmlMinStreamSize = 0x10000;
+
+protected:
+  struct CElementState
+  {
+    bool bArray;
+    bool bNumeric;
+    std::string text;
+    std::string token;
+    CIccXmlNumbers *pNums;
+  };
+
+  static void StartElementNs(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI,
+                             int nb_namespaces, const xmlChar **namespaces,
+                             int nb_attributes, int nb_defaulted, const xmlChar **attributes);
+  static void EndElementNs(void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *URI);
+  static void Characters(void *ctx, const xmlChar *ch, int len);
+  static void CDataBlock(void *ctx, const xmlChar *value, int len);
+  static void Comment(void *ctx, const xmlChar *value);
+  static void ProcessingInstruction(void *ctx, const xmlChar *target, const xmlChar *data);
+  static void Reference(void *ctx, const xmlChar *name);
+
+  static CIccXmlDocReader *GetReader(void *ctx);
+
+  static bool IsArrayElement(const xmlChar *localname);
+  bool AddText(CElementState &state, const char *szText, size_t nLen);
+  void AddToken(CElementState &state);
+  void EndText(void *ctx, CElementState &state);
+  void EmitText(void *ctx, const char *szText, size_t nLen);
+
+  size_t m_nMinStreamSize;
+  std::vector<CElementState> m_stack;
+  std::vector<CIccXmlNumbers*> m_blocks;
+};
+
 template <class T, icTagTypeSignature Tsig>
 class CIccXmlArrayType
 {
@@ -0,0 +1,964 @@
+/*
+    File:       iccLibTests.cpp
+
+    Contains:   Tests of IccProfLib and IccXML features that the command
+                line tools cannot reach.  Run from the Testing directory after
+                CreateAllProfiles has built the test profiles.
+
+    Usage:      iccLibTests test_name {test arguments}
+
+    Returns 0 if the test passed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "IccCmm.h"
+#include "IccCmmCache.h"
+#include "IccImageEngine.h"
+#include "IccProfile.h"
+#include "IccTagLut.h"
+#include "IccTagMPE.h"
+#include "IccMpeBasic.h"
+#include "IccIO.h"
+#include "IccUtil.h"
+#include "IccProfileXml.h"
+#include "IccTagXmlFactory.h"
+#include "IccMpeXmlFactory.h"
+#include "IccUtilXml.h"
+
+//----------------------------------------------------
+// Function Definitions
+//----------------------------------------------------
+
+static bool Check(bool bOk, const char *szWhat)
+{
+  if (!bOk)
+    printf("  FAILED: %s\n", szWhat);
+
+  return bOk;
+}
+
+//Deterministic pseudo random numbers in the range 0..1 so failures can be reproduced
+static icFloatNumber TestRand(icUInt32Number &nSeed)
+{
+  nSeed = nSeed*1664525 + 1013904223;
+  return (icFloatNumber)((nSeed>>8) / 16777215.0);
+}
+
+static void InterpCLUT(CIccCLUT *pCLUT, icFloatNumber *pDst, const icFloatNumber *pSrc)
+{
+  switch(pCLUT->GetInputDim()) {
+    case 1: pCLUT->Interp1d(pDst, pSrc); break;
+    case 2: pCLUT->Interp2d(pDst, pSrc); break;
+    case 3: pCLUT->Interp3dTetra(pDst, pSrc); break;
+    case 4: pCLUT->Interp4d(pDst, pSrc); break;
+    case 5: pCLUT->Interp5d(pDst, pSrc); break;
+    case 6: pCLUT->Interp6d(pDst, pSrc); break;
+    default: pCLUT->InterpND(pDst, pSrc); break;
+  }
+}
+
+//===================================================
+
+/**
+ ******************************************************************************
+ * Name: TestCompactCLUT
+ *
+ * Purpose:
+ *  Loads a profile with float CLUT storage and with native (compact) CLUT
+ *  storage.  Grid values read with operator[] and CLUT interpolation must
+ *  match, and so must a CMM built from each profile.
+ *
+ * Args:
+ *  szProfile = profile with 8 or 16 bit CLUTs
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestCompactCLUT(const char *szProfile)
+{
+  const icFloatNumber fMaxDif = 0.00001f;
+  CIccProfile *pFloat = OpenIccProfile(szProfile);
+  CIccProfile *pCompact = OpenIccProfile(szProfile, true);
+  bool bOk = true;
+  int nCompact = 0;
+
+  if (!Check(pFloat && pCompact, "unable to open profile")) {
+    delete pFloat;
+    delete pCompact;
+    return false;
+  }
+
+  TagEntryList::iterator i;
+  for (i=pFloat->m_Tags->begin(); i!=pFloat->m_Tags->end(); i++) {
+    CIccTag *pTag = pFloat->FindTag(i->TagInfo.sig);
+    CIccTag *pCompactTag = pCompact->FindTag(i->TagInfo.sig);
+
+    if (!pTag || !pCompactTag || !pTag->IsMBBType())
+      continue;
+
+    CIccCLUT *pCLUT = ((CIccMBB*)pTag)->GetCLUT();
+    CIccCLUT *pCompactCLUT = ((CIccMBB*)pCompactTag)->GetCLUT();
+    if (!pCLUT || !pCompactCLUT)
+      continue;
+
+    if (pCompactCLUT->GetStorage()!=icCLUTStorageFloat)
+      nCompact++;
+
+    icUInt32Number n, nValues = pCLUT->NumPoints() * pCLUT->GetOutputChannels();
+    icFloatNumber fDif = 0;
+
+    for (n=0; n<nValues; n++) {
+      icFloatNumber d = (icFloatNumber)fabs((*pCLUT)[n] - (*pCompactCLUT)[n]);
+      if (d>fDif)
+        fDif = d;
+    }
+    bOk = Check(fDif<=fMaxDif, "operator[] differs between float and compact storage") && bOk;
+
+    pCLUT->Begin();
+    pCompactCLUT->Begin();
+
+    icFloatNumber src[16], dst[256], compactDst[256];
+    icUInt32Number nSeed = 1, k, c;
+    icUInt16Number nOutput = pCLUT->GetOutputChannels();
+
+    fDif = 0;
+    for (k=0; k<10000; k++) {
+      for (c=0; c<pCLUT->GetInputDim(); c++)
+        src[c] = TestRand(nSeed);
+
+      InterpCLUT(pCLUT, dst, src);
+      InterpCLUT(pCompactCLUT, compactDst, src);
+
+      for (c=0; c<nOutput; c++) {
+        icFloatNumber d = (icFloatNumber)fabs(dst[c] - compactDst[c]);
+        if (d>fDif)
+          fDif = d;
+      }
+    }
+    bOk = Check(fDif<=fMaxDif, "CLUT interpolation differs between float and compact storage") && bOk;
+  }
+
+  bOk = Check(nCompact>0, "profile has no CLUT with compact storage") && bOk;
+
+  //Both profiles are owned by the CMMs below
+  CIccCmm cmm, compactCmm;
+
+  if (Check(cmm.AddXform(pFloat, icPerceptual)==icCmmStatOk &&
+            compactCmm.AddXform(pCompact, icPerceptual)==icCmmStatOk &&
+            cmm.Begin()==icCmmStatOk && compactCmm.Begin()==icCmmStatOk, "unable to begin CMM")) {
+    icFloatNumber src[16], dst[16], compactDst[16];
+    icUInt32Number nSeed = 7, k, c;
+    icFloatNumber fDif = 0;
+
+    for (k=0; k<10000; k++) {
+      for (c=0; c<cmm.GetSourceSamples(); c++)
+        src[c] = TestRand(nSeed);
+
+      cmm.Apply(dst, src);
+      compactCmm.Apply(compactDst, src);
+
+      for (c=0; c<cmm.GetDestSamples(); c++) {
+        icFloatNumber d = (icFloatNumber)fabs(dst[c] - compactDst[c]);
+        if (d>fDif)
+          fDif = d;
+      }
+    }
+    bOk = Check(fDif<=fMaxDif, "CMM results differ between float and compact storage") && bOk;
+  }
+  else {
+    bOk = false;
+  }
+
+  return bOk;
+}
+
+//===================================================
+
+//Reads a whole file into memory
+static bool ReadFileData(const char *szFilename, std::vector<icUInt8Number> &data)
+{
+  FILE *f = fopen(szFilename, "rb");
+
+  if (!f)
+    return false;
+
+  fseek(f, 0, SEEK_END);
+  long nSize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  data.resize(nSize>0 ? nSize : 0);
+  bool bOk = nSize>0 && fread(&data[0], 1, nSize, f)==(size_t)nSize;
+  fclose(f);
+
+  return bOk;
+}
+
+//Makes a copy of a profile with its header profile ID replaced so the caches see it as a different profile
+static void SetTestProfileID(std::vector<icUInt8Number> &data, icUInt8Number nID)
+{
+  memset(&data[84], 0, sizeof(icProfileID));
+  data[84] = nID;
+}
+
+static bool SameID(const icProfileID &id1, const icProfileID &id2)
+{
+  return !memcmp(&id1.ID8[0], &id2.ID8[0], sizeof(id1.ID8));
+}
+
+/**
+ ******************************************************************************
+ * Name: TestProfileCache
+ *
+ * Purpose:
+ *  Tests hits and misses, least recently used eviction, profiles without an
+ *  ID and concurrent access of CIccProfileCache.  Distinct profiles are made
+ *  in memory from one profile file by changing the header profile ID.
+ *
+ * Args:
+ *  szProfile = profile file with a profile ID in its header
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestProfileCache(const char *szProfile)
+{
+  CIccProfileCache cache;
+  icProfileID profileID, fileID;
+  bool bOk = true;
+
+  //Hit and miss from a file
+  CIccProfile *pProfile = cache.GetProfile(szProfile, &profileID);
+  CIccProfile *pProfile2 = cache.GetProfile(szProfile);
+
+  bOk = Check(pProfile && pProfile2 && pProfile!=pProfile2, "file profiles must be distinct copies") && bOk;
+  bOk = Check(cache.GetMisses()==1 && cache.GetHits()==1, "expected one miss then one hit") && bOk;
+  bOk = Check(cache.GetNumProfiles()==1, "expected one cached profile") && bOk;
+  bOk = Check(cache.GetProfileID(szProfile, fileID) && SameID(fileID, profileID), "GetProfileID differs") && bOk;
+  if (pProfile)
+    bOk = Check(SameID(pProfile->m_Header.profileID, profileID), "profile is keyed by its header ID") && bOk;
+  delete pProfile;
+  delete pProfile2;
+
+  std::vector<icUInt8Number> data;
+  if (!Check(ReadFileData(szProfile, data) && data.size()>128, "unable to read profile"))
+    return false;
+
+  //A profile without an ID is keyed by the calculated ID
+  icProfileID calcID;
+  std::vector<icUInt8Number> noID(data);
+  CIccMemIO noIdIO;
+
+  memset(&noID[84], 0, sizeof(icProfileID));
+  noIdIO.Attach(&noID[0], (icUInt32Number)noID.size());
+  CalcProfileID(&noIdIO, &calcID);
+
+  pProfile = cache.GetProfile(&noID[0], (icUInt32Number)noID.size(), &profileID);
+  bOk = Check(pProfile && SameID(profileID, calcID), "profile without an ID must be keyed by the calculated ID") && bOk;
+  delete pProfile;
+
+  //Least recently used eviction with room for two profiles
+  icUInt32Number i;
+  icUInt64Number nHits, nMisses;
+  icProfileID ids[4];
+
+  cache.Clear();
+  cache.SetMaxBytes(2*data.size());
+
+  for (i=1; i<=3; i++) {
+    std::vector<icUInt8Number> variant(data);
+    SetTestProfileID(variant, (icUInt8Number)i);
+    delete cache.GetProfile(&variant[0], (icUInt32Number)variant.size(), &ids[i]);
+
+    if (i==2) {
+      //Touch profile 1 so profile 2 is the least recently used when profile 3 is added
+      pProfile = cache.FindProfile(ids[1]);
+      bOk = Check(pProfile!=NULL, "profile 1 must still be cached") && bOk;
+      delete pProfile;
+    }
+  }
+
+  bOk = Check(cache.GetNumProfiles()==2 && cache.GetBytes()<=cache.GetMaxBytes(), "cache must hold two profiles") && bOk;
+
+  nHits = cache.GetHits();
+  nMisses = cache.GetMisses();
+  pProfile = cache.FindProfile(ids[2]);
+  bOk = Check(!pProfile && cache.GetMisses()==nMisses+1, "least recently used profile must be evicted") && bOk;
+  delete pProfile;
+
+  pProfile = cache.FindProfile(ids[1]);
+  pProfile2 = cache.FindProfile(ids[3]);
+  bOk = Check(pProfile && pProfile2 && cache.GetHits()==nHits+2, "recently used profiles must be kept") && bOk;
+  delete pProfile;
+  delete pProfile2;
+
+  //Concurrent access with more profiles than fit in the cache
+  const int nThreads = 8, nVariants = 6, nCalls = 500;
+  std::vector<std::vector<icUInt8Number> > variants(nVariants, data);
+  std::vector<std::thread> threads;
+  int nFailed[nThreads];
+
+  for (i=0; i<(icUInt32Number)nVariants; i++)
+    SetTestProfileID(variants[i], (icUInt8Number)(i+1));
+
+  cache.Clear();
+  cache.SetMaxBytes(3*data.size());
+  nHits = cache.GetHits();
+  nMisses = cache.GetMisses();
+
+  for (int t=0; t<nThreads; t++) {
+    nFailed[t] = 0;
+    threads.push_back(std::thread([&, t]() {
+      icUInt32Number nSeed = t+1;
+
+      for (int n=0; n<nCalls; n++) {
+        int k = (int)(TestRand(nSeed)*(nVariants-1) + 0.5f);
+        icProfileID id;
+        CIccProfile *pCopy = cache.GetProfile(&variants[k][0], (icUInt32Number)variants[k].size(), &id);
+
+        if (!pCopy || pCopy->m_Header.profileID.ID8[0]!=k+1 || id.ID8[0]!=k+1 || !pCopy->FindTag(icSigMediaWhitePointTag))
+          nFailed[t]++;
+
+        delete pCopy;
+      }
+    }));
+  }
+
+  for (i=0; i<threads.size(); i++)
+    threads[i].join();
+
+  int nTotalFailed = 0;
+  for (i=0; i<(icUInt32Number)nThreads; i++)
+    nTotalFailed += nFailed[i];
+
+  bOk = Check(!nTotalFailed, "concurrent GetProfile() returned a wrong profile") && bOk;
+  bOk = Check(cache.GetHits()-nHits + cache.GetMisses()-nMisses == (icUInt64Number)nThreads*nCalls,
+              "every concurrent call must count as one hit or miss") && bOk;
+  bOk = Check(cache.GetNumProfiles()<=3 && cache.GetBytes()<=cache.GetMaxBytes(),
+              "concurrent access must stay within the memory budget") && bOk;
+
+  return bOk;
+}
+
+//===================================================
+
+//Applies random pixels with an apply object of a begun CMM
+static bool ApplyTestPixels(CIccCmm *pCmm, icUInt32Number nSeed, std::vector<icFloatNumber> &results)
+{
+  icStatusCMM stat;
+  CIccApplyCmm *pApply = pCmm->GetNewApplyCmm(stat);
+
+  if (!pApply)
+    return false;
+
+  icFloatNumber src[16], dst[16];
+  icUInt32Number n, c;
+
+  results.clear();
+  for (n=0; n<64; n++) {
+    for (c=0; c<pCmm->GetSourceSamples(); c++)
+      src[c] = TestRand(nSeed);
+
+    pApply->Apply(dst, src);
+
+    for (c=0; c<pCmm->GetDestSamples(); c++)
+      results.push_back(dst[c]);
+  }
+
+  delete pApply;
+
+  return true;
+}
+
+static CIccCmmCacheLink TestLink(const char *szProfile, icRenderingIntent nIntent, CIccCreateXformHintManager *pHint=NULL)
+{
+  CIccCmmCacheLink link;
+
+  link.AddXform(szProfile, nIntent);
+  link.AddXform(szProfile, nIntent, icInterpLinear, NULL, icXformLutColor, true, pHint);
+
+  return link;
+}
+
+/**
+ ******************************************************************************
+ * Name: TestCmmCache
+ *
+ * Purpose:
+ *  Tests hits and misses, links that cannot be cached, least recently used
+ *  eviction, eviction of links in use and concurrent access of CIccCmmCache.
+ *  Links from the profile to itself with different rendering intents give
+ *  distinct cache keys.  Results of cached CMMs are compared with CMMs built
+ *  directly.
+ *
+ * Args:
+ *  szProfile = RGB or CMYK profile file
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestCmmCache(const char *szProfile)
+{
+  const int nLinks = 4;
+  CIccProfileCache profileCache;
+  CIccCmmCache cache(&profileCache);
+  std::vector<icFloatNumber> expected[nLinks], results;
+  icStatusCMM stat;
+  bool bOk = true;
+  int i;
+
+  for (i=0; i<nLinks; i++) {
+    CIccCmm cmm;
+
+    if (!Check(cmm.AddXform(szProfile, (icRenderingIntent)i)==icCmmStatOk &&
+               cmm.AddXform(szProfile, (icRenderingIntent)i)==icCmmStatOk &&
+               cmm.Begin()==icCmmStatOk && ApplyTestPixels(&cmm, 1, expected[i]), "unable to build reference CMM"))
+      return false;
+  }
+
+  //Hit and miss
+  CIccCmm *pCmm = cache.GetCmm(TestLink(szProfile, icPerceptual), stat);
+  CIccCmm *pCmm2 = cache.GetCmm(TestLink(szProfile, icPerceptual), stat);
+
+  bOk = Check(pCmm && pCmm==pCmm2, "a cache hit must return the cached CMM") && bOk;
+  bOk = Check(cache.GetMisses()==1 && cache.GetHits()==1 && cache.GetNumLinks()==1, "expected one miss then one hit") && bOk;
+  if (pCmm)
+    bOk = Check(ApplyTestPixels(pCmm, 1, results) && results==expected[0], "cached CMM results differ") && bOk;
+  cache.ReleaseCmm(pCmm);
+  cache.ReleaseCmm(pCmm2);
+
+  //Links with hint managers are built but not cached
+  CIccCreateXformHintManager hints;
+  hints.AddHint(new CIccLuminanceMatchingHint());
+
+  pCmm = cache.GetCmm(TestLink(szProfile, icPerceptual, &hints), stat);
+  bOk = Check(pCmm && pCmm!=pCmm2 && cache.GetNumLinks()==1 && cache.GetMisses()==1 && cache.GetHits()==1,
+              "a link with a hint manager must not be cached") && bOk;
+  cache.ReleaseCmm(pCmm);
+
+  //Least recently used eviction with room for two links
+  icUInt64Number nHits, nMisses;
+
+  cache.SetMaxLinks(2);
+  for (i=0; i<3; i++) {
+    cache.ReleaseCmm(cache.GetCmm(TestLink(szProfile, (icRenderingIntent)i), stat));
+
+    //Touch link 0 so link 1 is the least recently used when link 2 is added
+    if (i==1)
+      cache.ReleaseCmm(cache.GetCmm(TestLink(szProfile, (icRenderingIntent)0), stat));
+  }
+  bOk = Check(cache.GetNumLinks()==2, "cache must hold two links") && bOk;
+
+  nHits = cache.GetHits();
+  nMisses = cache.GetMisses();
+  cache.ReleaseCmm(cache.GetCmm(TestLink(szProfile, (icRenderingIntent)0), stat));
+  cache.ReleaseCmm(cache.GetCmm(TestLink(szProfile, (icRenderingIntent)2), stat));
+  bOk = Check(cache.GetHits()==nHits+2 && cache.GetMisses()==nMisses, "recently used links must be kept") && bOk;
+
+  cache.ReleaseCmm(cache.GetCmm(TestLink(szProfile, (icRenderingIntent)1), stat));
+  bOk = Check(cache.GetMisses()==nMisses+1, "least recently used link must be evicted") && bOk;
+
+  //A link evicted while in use stays usable until it is released
+  pCmm = cache.GetCmm(TestLink(szProfile, (icRenderingIntent)1), stat);
+  cache.SetMaxLinks(0);
+  bOk = Check(pCmm && cache.GetNumLinks()==0, "all links must be evicted") && bOk;
+  if (pCmm)
+    bOk = Check(ApplyTestPixels(pCmm, 1, results) && results==expected[1], "evicted CMM results differ") && bOk;
+  cache.ReleaseCmm(pCmm);
+
+  //Concurrent access with more links than fit in the cache
+  const int nThreads = 8, nCalls = 200;
+  std::vector<std::thread> threads;
+  int t, nFailed[nThreads];
+
+  cache.SetMaxLinks(2);
+  nHits = cache.GetHits();
+  nMisses = cache.GetMisses();
+
+  for (t=0; t<nThreads; t++) {
+    nFailed[t] = 0;
+    threads.push_back(std::thread([&, t]() {
+      icUInt32Number nSeed = t+1;
+      std::vector<icFloatNumber> threadResults;
+      icStatusCMM threadStat;
+
+      for (int n=0; n<nCalls; n++) {
+        int k = (int)(TestRand(nSeed)*(nLinks-1) + 0.5f);
+        CIccCmm *pThreadCmm = cache.GetCmm(TestLink(szProfile, (icRenderingIntent)k), threadStat);
+
+        if (!pThreadCmm || !ApplyTestPixels(pThreadCmm, 1, threadResults) || threadResults!=expected[k])
+          nFailed[t]++;
+
+        cache.ReleaseCmm(pThreadCmm);
+      }
+    }));
+  }
+
+  for (t=0; t<nThreads; t++)
+    threads[t].join();
+
+  int nTotalFailed = 0;
+  for (t=0; t<nThreads; t++)
+    nTotalFailed += nFailed[t];
+
+  bOk = Check(!nTotalFailed, "concurrent GetCmm() returned a wrong or failing CMM") && bOk;
+  bOk = Check(cache.GetHits()-nHits + cache.GetMisses()-nMisses == (icUInt64Number)nThreads*nCalls,
+              "every concurrent call must count as one hit or miss") && bOk;
+  bOk = Check(cache.GetNumLinks()<=2, "concurrent access must stay within the link limit") && bOk;
+
+  return bOk;
+}
+
+//===================================================
+
+/**
+ **************************************************************************
+ * Type: Class
+ *
+ * Purpose: 8 bit codec that stores the samples of a pixel in reverse order
+ *  so the test can tell whether the engine uses the codecs it is given.
+ **************************************************************************
+ */
+class CReverseTestCodec : public CIccImageCodec
+{
+public:
+  CReverseTestCodec(icUInt32Number nSamples) : CIccImageCodec(nSamples, icEncode8Bit) {}
+
+  virtual void Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const
+  {
+    CIccImageCodec::Decode(pPixels, pData, nPixels);
+
+    for (icUInt32Number i=0; i<nPixels; i++, pPixels+=m_nSamples)
+      Reverse(pPixels);
+  }
+
+  virtual void Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const
+  {
+    icFloatNumber pixel[16];
+
+    for (icUInt32Number i=0; i<nPixels; i++, pPixels+=m_nSamples, pData+=m_nSamples) {
+      memcpy(pixel, pPixels, m_nSamples*sizeof(icFloatNumber));
+      Reverse(pixel);
+      CIccImageCodec::Encode(pData, pixel, 1);
+    }
+  }
+
+protected:
+  void Reverse(icFloatNumber *pPixel) const
+  {
+    for (icUInt32Number j=0; j<m_nSamples/2; j++) {
+      icFloatNumber v = pPixel[j];
+      pPixel[j] = pPixel[m_nSamples-1-j];
+      pPixel[m_nSamples-1-j] = v;
+    }
+  }
+};
+
+/**
+ ******************************************************************************
+ * Name: TestImageEngine
+ *
+ * Purpose:
+ *  Transforms an in-memory 8 bit image with CIccImageEngine using 0 (one per
+ *  hardware thread), 1 and 3 workers.  Strips are queued, read and written
+ *  in the same overlapped order as iccApplyProfiles.  The image has padded
+ *  rows, a width that is not a multiple of the work unit size and a partial
+ *  last strip.  Every output row must be in place and match the codecs and
+ *  CIccCmm::Apply() applied pixel by pixel, and row padding must be left
+ *  alone.  The floating point Apply() and ApplyStrip() entry points are
+ *  checked the same way.
+ *
+ * Args:
+ *  szProfile = profile used as source and destination
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestImageEngine(const char *szProfile)
+{
+  const icUInt32Number nWidth = 4099, nHeight = 37, nStripRows = 8;
+  const icUInt8Number nPad = 0xcd;
+  CIccCmm cmm;
+  bool bOk = true;
+
+  if (!Check(cmm.AddXform(szProfile, icPerceptual)==icCmmStatOk &&
+             cmm.AddXform(szProfile, icPerceptual)==icCmmStatOk &&
+             cmm.Begin()==icCmmStatOk, "unable to begin CMM"))
+    return false;
+
+  icUInt32Number nSrcSamples = cmm.GetSourceSamples(), nDstSamples = cmm.GetDestSamples();
+  CReverseTestCodec srcCodec(nSrcSamples);
+  CIccImageCodec dstCodec(nDstSamples, icEncode8Bit);
+  icUInt32Number nSrcRowBytes = nWidth*nSrcSamples + 5, nDstRowBytes = nWidth*nDstSamples + 7;
+  std::vector<icUInt8Number> srcImage(nSrcRowBytes*nHeight), expected(nDstRowBytes*nHeight, nPad);
+  icUInt32Number nSeed = 3, i, j, r;
+
+  for (i=0; i<srcImage.size(); i++)
+    srcImage[i] = (icUInt8Number)(TestRand(nSeed)*255.0f + 0.5f);
+
+  //Expected image from the codecs and the CMM applied one pixel at a time
+  icFloatNumber src[16], dst[16];
+  for (r=0; r<nHeight; r++) {
+    for (i=0; i<nWidth; i++) {
+      srcCodec.Decode(src, &srcImage[r*nSrcRowBytes + i*nSrcSamples], 1);
+      cmm.Apply(dst, src);
+      dstCodec.Encode(&expected[r*nDstRowBytes + i*nDstSamples], dst, 1);
+    }
+  }
+
+  icUInt32Number nThreads[3] = { 0, 1, 3 };
+  int t;
+
+  for (t=0; t<3; t++) {
+    CIccImageEngine engine;
+    char szWhat[256];
+
+    sprintf(szWhat, "image engine with %u threads", nThreads[t]);
+    if (!Check(engine.Begin(&cmm, nThreads[t])==icCmmStatOk, szWhat)) {
+      bOk = false;
+      continue;
+    }
+
+    icUInt32Number nExpectedThreads = nThreads[t] ? nThreads[t] : std::thread::hardware_concurrency();
+    if (nExpectedThreads)
+      bOk = Check(engine.GetNumThreads()==nExpectedThreads, "wrong number of worker threads") && bOk;
+
+    //Read, transform and write strips overlapped as iccApplyProfiles does
+    std::vector<icUInt8Number> srcStrips(2*nSrcRowBytes*nStripRows), dstStrips(2*nDstRowBytes*nStripRows, nPad);
+    std::vector<icUInt8Number> image;
+    icUInt32Number nRows, nPrevRows = 0, nReadRow = 0, k;
+    icStatusCMM stat = icCmmStatOk;
+    int nCur = 0;
+
+    nRows = nHeight < nStripRows ? nHeight : nStripRows;
+    for (j=0; j<nRows; j++, nReadRow++)
+      memcpy(&srcStrips[j*nSrcRowBytes], &srcImage[nReadRow*nSrcRowBytes], nSrcRowBytes);
+
+    for (i=0; i<nHeight; i+=nRows) {
+      nRows = nHeight - i;
+      if (nRows > nStripRows)
+        nRows = nStripRows;
+
+      stat = engine.StartStrip(&dstStrips[nCur*nDstRowBytes*nStripRows], nDstRowBytes, &dstCodec,
+                               &srcStrips[nCur*nSrcRowBytes*nStripRows], nSrcRowBytes, &srcCodec, nWidth, nRows);
+      if (stat)
+        break;
+
+      for (j=0; j<nPrevRows; j++) {
+        icUInt8Number *pRow = &dstStrips[((1-nCur)*nStripRows + j)*nDstRowBytes];
+        image.insert(image.end(), pRow, pRow + nDstRowBytes);
+      }
+
+      k = nHeight - (i + nRows);
+      if (k > nStripRows)
+        k = nStripRows;
+      for (j=0; j<k; j++, nReadRow++)
+        memcpy(&srcStrips[((1-nCur)*nStripRows + j)*nSrcRowBytes], &srcImage[nReadRow*nSrcRowBytes], nSrcRowBytes);
+
+      stat = engine.Wait();
+      if (stat)
+        break;
+
+      nPrevRows = nRows;
+      nCur = 1-nCur;
+    }
+
+    for (j=0; !stat && j<nPrevRows; j++) {
+      icUInt8Number *pRow = &dstStrips[((1-nCur)*nStripRows + j)*nDstRowBytes];
+      image.insert(image.end(), pRow, pRow + nDstRowBytes);
+    }
+
+    sprintf(szWhat, "strip results with %u threads differ from per pixel Apply()", nThreads[t]);
+    bOk = Check(!stat && image==expected, szWhat) && bOk;
+
+    //Floating point pixels through Apply() and through ApplyStrip() without codecs
+    const icUInt32Number nPixels = 3*icImageEngineChunkPixels + 17;
+    std::vector<icFloatNumber> srcPixels(nPixels*nSrcSamples), dstPixels(nPixels*nDstSamples);
+    std::vector<icFloatNumber> stripPixels(nPixels*nDstSamples), expectedPixels(nPixels*nDstSamples);
+
+    for (i=0; i<srcPixels.size(); i++)
+      srcPixels[i] = TestRand(nSeed);
+    for (i=0; i<nPixels; i++)
+      cmm.Apply(&expectedPixels[i*nDstSamples], &srcPixels[i*nSrcSamples]);
+
+    stat = engine.Apply(&dstPixels[0], &srcPixels[0], nPixels);
+    bOk = Check(!stat && dstPixels==expectedPixels, "engine Apply() differs from per pixel Apply()") && bOk;
+
+    stat = engine.ApplyStrip((icUInt8Number*)&stripPixels[0], nPixels/2*nDstSamples*sizeof(icFloatNumber), NULL,
+                             (const icUInt8Number*)&srcPixels[0], nPixels/2*nSrcSamples*sizeof(icFloatNumber), NULL,
+                             nPixels/2, 2);
+    stripPixels.resize(2*(nPixels/2)*nDstSamples);
+    expectedPixels.resize(stripPixels.size());
+    bOk = Check(!stat && stripPixels==expectedPixels, "ApplyStrip() without codecs differs from per pixel Apply()") && bOk;
+
+    engine.End();
+  }
+
+  return bOk;
+}
+
+//===================================================
+
+/**
+ ******************************************************************************
+ * Name: TestFloatToStr
+ *
+ * Purpose:
+ *  Every string written by icXmlFloatToStr() must read back as exactly the
+ *  same float, both with icXmlStrToDouble() as the XML parser does and with
+ *  strtod().  Checks zeros, denormals, the limits of the float range and
+ *  values at every exponent.
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestFloatToStr()
+{
+  icFloat32Number special[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.1f, 1.0f/3.0f, 65535.0f, 1e-13f, 1e13f,
+                                FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX, FLT_EPSILON, 1e-45f, 16777217.0f };
+  icUInt32Number nSpecial = sizeof(special)/sizeof(special[0]);
+  icUInt32Number nSeed = 7, i, nBad = 0;
+  char buf[64];
+
+  for (i=0; i<nSpecial+1000000; i++) {
+    icFloat32Number f;
+
+    if (i<nSpecial) {
+      f = special[i];
+    }
+    else {
+      nSeed = nSeed*1664525 + 1013904223;
+      memcpy(&f, &nSeed, sizeof(f));
+      if (f!=f || f>FLT_MAX || f<-FLT_MAX)
+        continue;
+    }
+
+    icUInt32Number n = icXmlFloatToStr(buf, f);
+    icFloat32Number fXml = (icFloat32Number)icXmlStrToDouble(buf, n);
+    icFloat32Number fStd = (icFloat32Number)strtod(buf, NULL);
+
+    if (n!=strlen(buf) || memcmp(&fXml, &f, sizeof(f)) || memcmp(&fStd, &f, sizeof(f))) {
+      if (nBad++<10)
+        printf("  %.9g written as \"%s\" reads back as %.9g / %.9g\n", f, buf, fXml, fStd);
+    }
+  }
+
+  return Check(!nBad, "icXmlFloatToStr() output does not read back exactly");
+}
+
+//Collects the names of elements whose text was parsed into CIccXmlNumbers while streaming
+static void FindStreamedArrays(xmlNode *pNode, std::set<std::string> &names)
+{
+  for (; pNode; pNode = pNode->next) {
+    if (pNode->type==XML_ELEMENT_NODE) {
+      if (CIccXmlNumbers::FromNode(pNode->children))
+        names.insert((const char*)pNode->name);
+      FindStreamedArrays(pNode->children, names);
+    }
+  }
+}
+
+static bool GetTagData(std::vector<icUInt8Number> &data, CIccProfile *pProfile, icTagSignature sig)
+{
+  CIccTag *pTag = pProfile->FindTag(sig);
+  CIccMemIO io;
+
+  data.clear();
+  if (!pTag || !io.Alloc(0x10000, true, true) || !pTag->Write(&io))
+    return false;
+
+  data.assign(io.GetData(), io.GetData() + io.GetLength());
+  return true;
+}
+
+/**
+ ******************************************************************************
+ * Name: TestXmlStream
+ *
+ * Purpose:
+ *  Writes a profile with a 16 bit curveType, a float CLUT element and long
+ *  sampled curve segments to XML.  Each of their arrays is larger than
+ *  CIccXmlDocReader::icXmlMinStreamSize.  The file is loaded with
+ *  CIccProfileXml::LoadXml(), which streams the arrays, and through a DOM
+ *  from xmlReadFile().  Streaming must be used for the TableData, Curve and
+ *  SampledSegment elements, and both loads must give back exactly the
+ *  binary tags that were written.
+ *
+ * Args:
+ *  szXmlFile = temporary XML file to write, removed afterwards
+ *
+ * Return:
+ *  true if the test passed
+ ******************************************************************************/
+static bool TestXmlStream(const char *szXmlFile)
+{
+  const icUInt32Number nCurveSize = 16384, nSamples = 8192;
+  icTagSignature sigs[2] = { icSigRedTRCTag, icSigDToB0Tag };
+  icUInt32Number nSeed = 11, i, c;
+  bool bOk = true;
+
+  CIccTagCreator::PushFactory(new CIccTagXmlFactory());
+  CIccMpeCreator::PushFactory(new CIccMpeXmlFactory());
+
+  //Build the profile with the base classes and convert it as IccToXml does
+  CIccProfile profile;
+  profile.InitHeader();
+  profile.m_Header.deviceClass = icSigDisplayClass;
+  profile.m_Header.colorSpace = icSigRgbData;
+  profile.m_Header.pcs = icSigXYZData;
+  profile.m_Header.version = icVersionNumberV5;
+
+  CIccTagCurve *pCurve = new CIccTagCurve(nCurveSize);
+  for (i=0; i<nCurveSize; i++)
+    (*pCurve)[i] = (icFloatNumber)((icUInt16Number)(TestRand(nSeed)*65535.0f + 0.5f) / 65535.0);
+  profile.AttachTag(icSigRedTRCTag, pCurve);
+
+  CIccTagMultiProcessElement *pMpe = new CIccTagMultiProcessElement(3, 3);
+  CIccMpeCurveSet *pCurves = new CIccMpeCurveSet(3);
+  for (c=0; c<3; c++) {
+    CIccSegmentedCurve *pSegCurve = new CIccSegmentedCurve();
+    CIccFormulaCurveSegment *pFormula = new CIccFormulaCurveSegment(icMinFloat32Number, 0);
+    icFloatNumber params[4] = { 1, 1, 0, 0 };
+    pFormula->SetFunction(0, 4, params);
+    pSegCurve->Insert(pFormula);
+
+    CIccSampledCurveSegment *pSampled = new CIccSampledCurveSegment(0, 1);
+    pSampled->SetSize(nSamples);
+    icFloatNumber *pSamples = pSampled->GetSamples();
+    //The first sample comes from the previous segment and is not saved
+    for (i=1; i<nSamples; i++)
+      pSamples[i] = TestRand(nSeed) * (c==2 ? 0.001f : 1.0f);
+    pSegCurve->Insert(pSampled);
+
+    pFormula = new CIccFormulaCurveSegment(1, icMaxFloat32Number);
+    pFormula->SetFunction(0, 4, params);
+    pSegCurve->Insert(pFormula);
+    pCurves->SetCurve(c, pSegCurve);
+  }
+  pMpe->Attach(pCurves);
+
+  CIccMpeCLUT *pMpeCLUT = new CIccMpeCLUT();
+  CIccCLUT *pCLUT = new CIccCLUT(3, 3);
+  pCLUT->Init(17);
+  icFloatNumber *pData = pCLUT->GetData(0);
+  for (i=0; i<pCLUT->NumPoints()*3; i++)
+    pData[i] = TestRand(nSeed);
+  pMpeCLUT->SetCLUT(pCLUT);
+  pMpe->Attach(pMpeCLUT);
+  profile.AttachTag(icSigDToB0Tag, pMpe);
+
+  CIccMemIO io;
+  CIccProfileXml xmlProfile;
+  std::string xml;
+
+  if (!Check(io.Alloc(0x10000, true, true) && profile.Write(&io) && io.Seek(0, icSeekSet)==0 &&
+             xmlProfile.Read(&io) && xmlProfile.ToXml(xml), "unable to convert test profile to XML"))
+    return false;
+
+  FILE *f = fopen(szXmlFile, "wb");
+  if (!Check(f && fwrite(xml.data(), 1, xml.size(), f)==xml.size(), "unable to write XML file")) {
+    if (f)
+      fclose(f);
+    return false;
+  }
+  fclose(f);
+
+  //The arrays must cross the threshold for streaming
+  CIccXmlDocReader reader;
+  xmlDoc *pStreamDoc = reader.ReadFile(szXmlFile);
+  std::set<std::string> streamed;
+
+  if (pStreamDoc) {
+    FindStreamedArrays(xmlDocGetRootElement(pStreamDoc), streamed);
+    xmlFreeDoc(pStreamDoc);
+  }
+  bOk = Check(streamed.count("TableData") && streamed.count("Curve") && streamed.count("SampledSegment"),
+              "large arrays were not streamed") && bOk;
+
+  CIccProfileXml streamProfile, domProfile;
+  std::string reason;
+
+  bOk = Check(streamProfile.LoadXml(szXmlFile, NULL, &reason), "unable to load XML with streaming") && bOk;
+
+  xmlDoc *pDomDoc = xmlReadFile(szXmlFile, NULL, 0);
+  bOk = Check(pDomDoc && domProfile.ParseXml(xmlDocGetRootElement(pDomDoc), reason), "unable to load XML DOM") && bOk;
+  if (pDomDoc)
+    xmlFreeDoc(pDomDoc);
+
+  remove(szXmlFile);
+
+  if (!bOk) {
+    printf("%s", reason.c_str());
+    return false;
+  }
+
+  for (i=0; i<sizeof(sigs)/sizeof(sigs[0]); i++) {
+    std::vector<icUInt8Number> orig, stream, dom;
+    char szWhat[256];
+
+    sprintf(szWhat, "tag %d differs after streamed load", i);
+    bOk = Check(GetTagData(orig, &profile, sigs[i]) && GetTagData(stream, &streamProfile, sigs[i]) &&
+                stream==orig, szWhat) && bOk;
+
+    sprintf(szWhat, "tag %d differs after DOM load", i);
+    bOk = Check(GetTagData(dom, &domProfile, sigs[i]) && dom==orig, szWhat) && bOk;
+  }
+
+  return bOk;
+}
+
+//===================================================
+
+void Usage()
+{
+  printf("Usage: iccLibTests test_name {test arguments}\n\n");
+  printf("  Tests:\n");
+  printf("    CompactCLUT profile_path\n");
+  printf("    ProfileCache profile_path\n");
+  printf("    CmmCache profile_path\n");
+  printf("    ImageEngine profile_path\n");
+  printf("    XmlStream temp_xml_path\n");
+}
+
+int main(int argc, icChar* argv[])
+{
+  if (argc<2) {
+    Usage();
+    return -1;
+  }
+
+  bool bOk;
+
+  if (!stricmp(argv[1], "CompactCLUT") && argc>2) {
+    bOk = TestCompactCLUT(argv[2]);
+  }
+  else if (!stricmp(argv[1], "ProfileCache") && argc>2) {
+    bOk = TestProfileCache(argv[2]);
+  }
+  else if (!stricmp(argv[1], "CmmCache") && argc>2) {
+    bOk = TestCmmCache(argv[2]);
+  }
+  else if (!stricmp(argv[1], "ImageEngine") && argc>2) {
+    bOk = TestImageEngine(argv[2]);
+  }
+  else if (!stricmp(argv[1], "XmlStream") && argc>2) {
+    bOk = TestFloatToStr();
+    bOk = TestXmlStream(argv[2]) && bOk;
+  }
+  else {
+    Usage();
+    return -1;
+  }
+
+  printf("%s: %s\n", argv[1], bOk ? "Passed" : "FAILED");
+
+  return bOk ? 0 : 1;
+}
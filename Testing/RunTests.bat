@@ -1,4 +1,5 @@
 @echo off
+set FAILED=0
 echo ===========================================================================
 echo Test CalcElement Operations return of zero's indicates that something bad happened
 iccApplyNamedCMM Calc\srgbCalcTest.txt 2 0 Calc\srgbCalcTest.icc 3 sRGB_v4_ICC_preference.icc 3
@@ -86,3 +87,67 @@ iccApplyNamedCmm.exe ApplyDataFiles\cc_ref-380_5_780.txt 1 0 pcc\Spec380_5_780-D
 echo ===========================================================================
 echo Test 380_10_730 Reflectance under D50 to XYZ
 iccApplyNamedCmm.exe ApplyDataFiles\cc_ref-380_10_730.txt 1 0 pcc\Spec380_10_730-D50_2deg.icc 3 pcc\XYZ-D50_2deg.icc 3
+
+echo ===========================================================================
+echo Test 8 bit RGB to 8 bit RGB using a 33 grid point integer pipeline (max difference 1)
+call :CheckIntPipeline 1 ApplyDataFiles\rgb8bit.txt 4 1 1:33 sRGB_v4_ICC_preference.icc 1 sRGB_v4_ICC_preference.icc 1
+
+echo ===========================================================================
+echo Test 16 bit RGB to 16 bit RGB using a 33 grid point integer pipeline (max difference 64)
+call :CheckIntPipeline 64 ApplyDataFiles\rgb16bit.txt 5 1 1:33 sRGB_v4_ICC_preference.icc 1 sRGB_v4_ICC_preference.icc 1
+
+echo ===========================================================================
+echo Test 16 bit RGB to 16 bit CMYK using a 17 grid point integer pipeline (max difference 655)
+call :CheckIntPipeline 655 ApplyDataFiles\rgb16bit.txt 5 1 1:17 sRGB_v4_ICC_preference.icc 1 CMYK-3DLUTs\CMYK-3DLUTs2.icc 1
+
+echo ===========================================================================
+echo Test 8 bit RGB to floating point CMYK through a 33 grid point device link
+iccApplyNamedCmm.exe ApplyDataFiles\rgb8bit.txt 3 1:0:33 sRGB_v4_ICC_preference.icc 1 CMYK-3DLUTs\CMYK-3DLUTs2.icc 1
+
+echo ===========================================================================
+echo Test CLUT values and interpolation with compact (native 16 bit) CLUT storage
+call :RunLibTest CompactCLUT sRGB_v4_ICC_preference.icc
+
+echo ===========================================================================
+echo Test profile cache hits, misses, eviction and concurrent access
+call :RunLibTest ProfileCache sRGB_v4_ICC_preference.icc
+
+echo ===========================================================================
+echo Test link cache hits, misses, eviction and concurrent access
+call :RunLibTest CmmCache sRGB_v4_ICC_preference.icc
+
+echo ===========================================================================
+echo Test threaded image strips against applying one pixel at a time
+call :RunLibTest ImageEngine sRGB_v4_ICC_preference.icc
+
+echo ===========================================================================
+echo Test streamed parsing of large XML arrays against the DOM
+call :RunLibTest XmlStream XmlStreamTest.xml
+
+exit /b %FAILED%
+
+rem Applies a data file with the integer pipeline given by the interpolation argument and with
+rem the floating point path, and fails if any output value differs by more than MaxDif.
+rem Usage: call :CheckIntPipeline MaxDif data_file final_data_encoding interpolation interpolation:IntGridPoints profile intent profile intent
+:CheckIntPipeline
+iccApplyNamedCmm.exe %2 %3 %4 %6 %7 %8 %9 > IntPipelineFloat.txt
+iccApplyNamedCmm.exe %2 %3 %5 %6 %7 %8 %9 > IntPipeline.txt
+type IntPipeline.txt
+powershell -NoProfile -Command "$f=Get-Content IntPipelineFloat.txt; $p=Get-Content IntPipeline.txt; $m=0; for ($i=0; $i -lt $f.Count; $i++) { $x=($f[$i] -split ';')[0] -split '\s+' | ?{$_}; $y=($p[$i] -split ';')[0] -split '\s+' | ?{$_}; for ($j=0; $j -lt @($x).Count; $j++) { $a=0.0; $b=0.0; if ([double]::TryParse(@($x)[$j], [ref]$a) -and [double]::TryParse(@($y)[$j], [ref]$b)) { $m=[math]::Max($m, [math]::Abs($a-$b)) } } }; Write-Output ('Max difference from floating point: ' + $m); if ($m -gt %1) { exit 1 }"
+if errorlevel 1 (
+  echo FAILED
+  set /a FAILED+=1
+)
+del IntPipelineFloat.txt IntPipeline.txt
+goto :eof
+
+rem Runs a test of iccLibTests if it has been built, and counts a failure if the test fails.
+rem Usage: call :RunLibTest test_name test_arguments
+:RunLibTest
+if not exist iccLibTests.exe (
+  echo iccLibTests not found - skipped
+  goto :eof
+)
+iccLibTests.exe %*
+if errorlevel 1 set /a FAILED+=1
+goto :eof
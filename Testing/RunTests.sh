@@ -1,5 +1,43 @@
 #!/bin/sh
 
+nFailed=0
+
+#Applies a data file with the integer pipeline given by the interpolation argument and with
+#the floating point path, and fails if any output value differs by more than MaxDif.
+#Usage: CheckIntPipeline MaxDif data_file final_data_encoding interpolation:IntGridPoints profiles...
+CheckIntPipeline() {
+  maxDif=$1
+  dataFile=$2
+  encoding=$3
+  interp=$4
+  shift 4
+  ./IccApplyNamedCmm $dataFile $encoding ${interp%%:*} "$@" > IntPipelineFloat.txt
+  ./IccApplyNamedCmm $dataFile $encoding $interp "$@" > IntPipeline.txt
+  cat IntPipeline.txt
+  if ! awk -v maxDif=$maxDif '
+    NR==FNR { line[FNR]=$0; next }
+    {
+      split(line[FNR], a, ";"); split($0, b, ";")
+      n = split(a[1], x, " "); split(b[1], y, " ")
+      for (i=1; i<=n; i++) { d = x[i]-y[i]; if (d<0) d = -d; if (d>m) m = d }
+    }
+    END { print "Max difference from floating point: " m+0; exit (m>maxDif) }' IntPipelineFloat.txt IntPipeline.txt; then
+    echo "FAILED"
+    nFailed=$((nFailed+1))
+  fi
+  rm -f IntPipelineFloat.txt IntPipeline.txt
+}
+
+#Runs a test of iccLibTests if it has been built, and counts a failure if the test fails.
+#Usage: RunLibTest test_name test_arguments...
+RunLibTest() {
+  if [ ! -x ./iccLibTests ]; then
+    echo "iccLibTests not found - skipped"
+  elif ! ./iccLibTests "$@"; then
+    nFailed=$((nFailed+1))
+  fi
+}
+
 echo "==========================================================================="
 echo "Test CalcElement Operations return of zero's indicates that something bad happened"
 ./IccApplyNamedCmm Calc/srgbCalcTest.txt 2 0 Calc/srgbCalcTest.icc 3 sRGB_v4_ICC_preference.icc 3
@@ -75,3 +113,41 @@ echo "Test Six Channel Reflectance Camera to Lab"
 echo "==========================================================================="
 echo "Test Six Channel Reflectance Camera reflectance under D93 to Lab"
 ./IccApplyNamedCmm SpecRef/sixChanTest.txt 3 0 SpecRef/SixChanCameraRef.icc 3 -pcc PCC/Spec400_10_700-D93-Abs_2deg.icc PCC/Lab-D50_2deg.icc 3
+
+echo "==========================================================================="
+echo "Test 8 bit RGB to 8 bit RGB using a 33 grid point integer pipeline (max difference 1)"
+CheckIntPipeline 1 ApplyDataFiles/rgb8bit.txt 4 1:33 sRGB_v4_ICC_preference.icc 1 sRGB_v4_ICC_preference.icc 1
+
+echo "==========================================================================="
+echo "Test 16 bit RGB to 16 bit RGB using a 33 grid point integer pipeline (max difference 64)"
+CheckIntPipeline 64 ApplyDataFiles/rgb16bit.txt 5 1:33 sRGB_v4_ICC_preference.icc 1 sRGB_v4_ICC_preference.icc 1
+
+echo "==========================================================================="
+echo "Test 16 bit RGB to 16 bit CMYK using a 17 grid point integer pipeline (max difference 655)"
+CheckIntPipeline 655 ApplyDataFiles/rgb16bit.txt 5 1:17 sRGB_v4_ICC_preference.icc 1 CMYK-3DLUTs/CMYK-3DLUTs2.icc 1
+
+echo "==========================================================================="
+echo "Test 8 bit RGB to floating point CMYK through a 33 grid point device link"
+./IccApplyNamedCmm ApplyDataFiles/rgb8bit.txt 3 1:0:33 sRGB_v4_ICC_preference.icc 1 CMYK-3DLUTs/CMYK-3DLUTs2.icc 1
+
+echo "==========================================================================="
+echo "Test CLUT values and interpolation with compact (native 16 bit) CLUT storage"
+RunLibTest CompactCLUT sRGB_v4_ICC_preference.icc
+
+echo "==========================================================================="
+echo "Test profile cache hits, misses, eviction and concurrent access"
+RunLibTest ProfileCache sRGB_v4_ICC_preference.icc
+
+echo "==========================================================================="
+echo "Test link cache hits, misses, eviction and concurrent access"
+RunLibTest CmmCache sRGB_v4_ICC_preference.icc
+
+echo "==========================================================================="
+echo "Test threaded image strips against applying one pixel at a time"
+RunLibTest ImageEngine sRGB_v4_ICC_preference.icc
+
+echo "==========================================================================="
+echo "Test streamed parsing of large XML arrays against the DOM"
+RunLibTest XmlStream XmlStreamTest.xml
+
+exit $nFailed
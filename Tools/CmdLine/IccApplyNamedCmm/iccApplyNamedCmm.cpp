@@ -84,11 +84,56 @@ bool ParseName(icChar* pName, icChar* pString)
   return true;
 }
 
+//===================================================
+
+template <class T>
+static void IntPixel(T *pDst, const icFloatNumber *pSrc, int nSamples, icFloatNumber fMax)
+{
+  for (int i=0; i<nSamples; i++) {
+    icFloatNumber v = pSrc[i];
+    if (v<0.0)
+      v = 0.0;
+    else if (v>fMax)
+      v = fMax;
+    pDst[i] = (T)(v + 0.5);
+  }
+}
+
+//Applies 8 or 16 bit source data to get 8 or 16 bit final data using the CMM's integer pipeline
+icStatusCMM ApplyIntPipeline(CIccCmm &cmm, icFloatNumber *DstPixel, icFloatColorEncoding destEncoding,
+                             const icFloatNumber *SrcPixel, icFloatColorEncoding srcEncoding)
+{
+  icUInt8Number Src8[icIntLinkMaxInputs], Dst8[icIntLinkMaxOutputs];
+  icUInt16Number Src16[icIntLinkMaxInputs], Dst16[icIntLinkMaxOutputs];
+  int i, nSrcSamples = cmm.GetSourceSamples(), nDestSamples = cmm.GetDestSamples();
+  icStatusCMM stat;
+
+  if (srcEncoding==icEncode8Bit) {
+    IntPixel(Src8, SrcPixel, nSrcSamples, 255.0);
+    if (destEncoding==icEncode8Bit)
+      stat = cmm.ApplyInt(Dst8, Src8, 1);
+    else
+      stat = cmm.ApplyInt(Dst16, Src8, 1);
+  }
+  else {
+    IntPixel(Src16, SrcPixel, nSrcSamples, 65535.0);
+    if (destEncoding==icEncode8Bit)
+      stat = cmm.ApplyInt(Dst8, Src16, 1);
+    else
+      stat = cmm.ApplyInt(Dst16, Src16, 1);
+  }
+
+  for (i=0; i<nDestSamples; i++)
+    DstPixel[i] = destEncoding==icEncode8Bit ? (icFloatNumber)Dst8[i] : (icFloatNumber)Dst16[i];
+
+  return stat;
+}
+
 typedef std::list<CIccProfile*> IccProfilePtrList;
 
 void Usage() 
 {
-  printf("Usage: iccApplyNamedCmm data_file_path final_data_encoding{:FmtPrecision{:FmtDigits}} interpolation {{-ENV:Name value} profile_file_path Rendering_intent {-PCC connection_conditions_path}}\n\n");
+  printf("Usage: iccApplyNamedCmm data_file_path final_data_encoding{:FmtPrecision{:FmtDigits}} interpolation{:IntGridPoints{:LinkGridPoints}} {{-ENV:Name value} profile_file_path Rendering_intent {-PCC connection_conditions_path}}\n\n");
 	printf("  For final_data_encoding:\n");
 	printf("    0 - icEncodeValue (converts to/from lab encoding when samples=3)\n");
 	printf("    1 - icEncodePercent\n");
@@ -105,6 +150,11 @@ void Usage()
 	printf("    0 - Linear\n");
 	printf("    1 - Tetrahedral\n\n");
 
+  printf("    IntGridPoints - when 8 or 16 bit pixel data is converted to 8 or 16 bit final data,\n");
+  printf("      apply it with an integer pipeline of IntGridPoints grid points per channel (default=none)\n");
+  printf("    LinkGridPoints - apply pixel data through a device link CLUT sampled from the profiles\n");
+  printf("      with LinkGridPoints grid points per channel (default=none)\n\n");
+
 	printf("  For Rendering_intent:\n");
 	printf("    0 - Perceptual\n");
 	printf("    1 - Relative\n");
@@ -219,6 +269,26 @@ int main(int argc, icChar* argv[])
 
 	icXformInterp nInterp = (icXformInterp)atoi(argv[3]);
 
+  int nIntGridPoints = 0;
+  int nLinkGridPoints = 0;
+  colon = strchr(argv[3], ':');
+  if (colon) {
+    colon++;
+    nIntGridPoints = atoi(colon);
+    if (nIntGridPoints==1 || nIntGridPoints<0 || nIntGridPoints>255) {
+      printf("Invalid number of integer pipeline grid points\n");
+      return -1;
+    }
+    colon = strchr(colon, ':');
+    if (colon) {
+      nLinkGridPoints = atoi(colon+1);
+      if (nLinkGridPoints<2 || nLinkGridPoints>255) {
+        printf("Invalid number of device link grid points\n");
+        return -1;
+      }
+    }
+  }
+
   int nIntent, nType, nLuminance;
 
   //Allocate a CIccCmm to use to apply profiles
@@ -295,6 +365,13 @@ int main(int argc, icChar* argv[])
 
   icStatusCMM stat;
 
+  if (nIntGridPoints && (srcEncoding==icEncode8Bit || srcEncoding==icEncode16Bit) &&
+      (destEncoding==icEncode8Bit || destEncoding==icEncode16Bit))
+    namedCmm.SetIntegerPipeline((icUInt8Number)nIntGridPoints);
+
+  if (nLinkGridPoints)
+    namedCmm.SetDeviceLink((icUInt8Number)nLinkGridPoints, nInterp);
+
   //All profiles have been added to CMM.  Tell CMM that we are ready to begin applying colors/pixels
   if((stat=namedCmm.Begin())) {
     printf("Error %d - Unable to begin profile application - Possibly invalid or incompatible profiles\n", stat);
@@ -450,13 +527,21 @@ int main(int argc, icChar* argv[])
       switch(namedCmm.GetInterface()) {
         case icApplyPixel2Pixel:
           {
-            if(namedCmm.Apply(DestPixel, SrcPixel)) {
-              printf("Profile application failed.\n");
-              return -1;
+            if (namedCmm.HasIntegerPipeline()) {
+              if(ApplyIntPipeline(namedCmm, DestPixel, destEncoding, Pixel, srcEncoding)) {
+                printf("Profile application failed.\n");
+                return -1;
+              }
             }
-            if(CIccCmm::FromInternalEncoding(DestspaceSig, destEncoding, DestPixel, DestPixel)) {
-              printf("Invalid final data encoding\n");
-              return -1;
+            else {
+              if(namedCmm.Apply(DestPixel, SrcPixel)) {
+                printf("Profile application failed.\n");
+                return -1;
+              }
+              if(CIccCmm::FromInternalEncoding(DestspaceSig, destEncoding, DestPixel, DestPixel)) {
+                printf("Invalid final data encoding\n");
+                return -1;
+              }
             }
 
             for(i = 0; i<nDestSamples; i++) {
@@ -76,6 +76,7 @@
 #include "IccDefs.h"
 #include "IccApplyBPC.h"
 #include "IccEnvVar.h"
+#include "IccImageEngine.h"
 #include "TiffImg.h"
 
 static icFloatNumber UnitClip(icFloatNumber v)
@@ -87,6 +88,130 @@ static icFloatNumber UnitClip(icFloatNumber v)
   return v;
 }
 
+//Number of image rows that are transformed together by the image engine
+#define ICC_APPLY_STRIP_ROWS 64
+
+/**
+ **************************************************************************
+ * Type: Class
+ * 
+ * Purpose: Converts between TIFF samples and the CMM's internal encoding.
+ *  TIFF CIELAB stores a* and b* as signed values, floating point Lab is
+ *  converted to/from the PCS encoding, and CIELAB images that are connected
+ *  to an XYZ color space are converted to/from XYZ.
+ **************************************************************************
+ */
+class CTiffPixelCodec : public CIccImageCodec
+{
+public:
+  CTiffPixelCodec(icUInt32Number nSamples, icFloatColorEncoding nEncode, unsigned long nPhoto, bool bXYZ) :
+    CIccImageCodec(nSamples, nEncode) { m_nPhoto = nPhoto; m_bXYZ = bXYZ; }
+
+  virtual void Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const;
+  virtual void Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const;
+
+protected:
+  unsigned long m_nPhoto;
+  bool m_bXYZ;
+};
+
+void CTiffPixelCodec::Decode(icFloatNumber *pPixels, const icUInt8Number *pData, icUInt32Number nPixels) const
+{
+  icUInt32Number i;
+  icFloatNumber *pPixel;
+
+  if (m_nPhoto!=PHOTO_CIELAB && m_nPhoto!=PHOTO_ICCLAB) {
+    CIccImageCodec::Decode(pPixels, pData, nPixels);
+    return;
+  }
+
+  switch(m_nEncode) {
+    case icEncode8Bit:
+      if (m_nPhoto!=PHOTO_CIELAB) {
+        CIccImageCodec::Decode(pPixels, pData, nPixels);
+        break;
+      }
+      for (i=0, pPixel=pPixels; i<nPixels; i++, pData+=m_nSamples, pPixel+=m_nSamples) {
+        pPixel[0]=(icFloatNumber)pData[0] / 255.0f;
+        pPixel[1]=(icFloatNumber)(pData[1]-128) / 255.0f;
+        pPixel[2]=(icFloatNumber)(pData[2]-128) / 255.0f;
+      }
+      break;
+
+    case icEncode16Bit:
+      if (m_nPhoto!=PHOTO_CIELAB) {
+        CIccImageCodec::Decode(pPixels, pData, nPixels);
+      }
+      else {
+        const icUInt16Number *pData16 = (const icUInt16Number*)pData;
+        for (i=0, pPixel=pPixels; i<nPixels; i++, pData16+=m_nSamples, pPixel+=m_nSamples) {
+          pPixel[0]=(icFloatNumber)pData16[0] / 65535.0f;
+          pPixel[1]=(icFloatNumber)(pData16[1]-0x8000) / 65535.0f;
+          pPixel[2]=(icFloatNumber)(pData16[2]-0x8000) / 65535.0f;
+        }
+      }
+      break;
+
+    default:
+      CIccImageCodec::Decode(pPixels, pData, nPixels);
+      for (i=0, pPixel=pPixels; i<nPixels; i++, pPixel+=m_nSamples)
+        icLabToPcs(pPixel);
+      break;
+  }
+
+  if (m_bXYZ) {
+    for (i=0, pPixel=pPixels; i<nPixels; i++, pPixel+=m_nSamples) {
+      icLabFromPcs(pPixel);
+      icLabtoXYZ(pPixel);
+      icXyzToPcs(pPixel);
+    }
+  }
+}
+
+void CTiffPixelCodec::Encode(icUInt8Number *pData, const icFloatNumber *pPixels, icUInt32Number nPixels) const
+{
+  icUInt32Number i;
+
+  if (m_nPhoto!=PHOTO_CIELAB) {
+    CIccImageCodec::Encode(pData, pPixels, nPixels);
+    return;
+  }
+
+  for (i=0; i<nPixels; i++, pPixels+=m_nSamples) {
+    icFloatNumber Pixel[3] = { pPixels[0], pPixels[1], pPixels[2] };
+
+    if (m_bXYZ) {
+      icXyzFromPcs(Pixel);
+      icXYZtoLab(Pixel);
+      icLabToPcs(Pixel);
+    }
+
+    switch(m_nEncode) {
+      case icEncode8Bit:
+        pData[0]=(icUInt8Number)(UnitClip(Pixel[0]) * 255.0f + 0.5f);
+        pData[1]=(icUInt8Number)(UnitClip(Pixel[1]) * 255.0f + 0.5f)+128;
+        pData[2]=(icUInt8Number)(UnitClip(Pixel[2]) * 255.0f + 0.5f)+128;
+        pData += m_nSamples;
+        break;
+
+      case icEncode16Bit:
+        {
+          icUInt16Number *pData16 = (icUInt16Number*)pData;
+          pData16[0]=(icUInt16Number)(UnitClip(Pixel[0]) * 65535.0f + 0.5f);
+          pData16[1]=(icUInt16Number)(UnitClip(Pixel[1]) * 65535.0f + 0.5f)+0x8000;
+          pData16[2]=(icUInt16Number)(UnitClip(Pixel[2]) * 65535.0f + 0.5f)+0x8000;
+          pData += m_nSamples * sizeof(icUInt16Number);
+        }
+        break;
+
+      default:
+        CIccImageCodec::Encode(pData, Pixel, 1);
+        pData += GetBytesPerPixel();
+        break;
+    }
+  }
+}
+
 
 typedef std::list<CIccProfile*> IccProfilePtrList;
 
@@ -171,7 +296,6 @@ int main(int argc, icChar* argv[])
 
   unsigned long i, j, k, sn, sphoto, photo, bps, dbps;
   CTiffImg SrcImg, DstImg;
-  unsigned char *sptr, *dptr;
   bool bSuccess = true;
   bool bConvert = false;
   char *last_path = NULL;
@@ -336,9 +460,17 @@ int main(int argc, icChar* argv[])
         //Remember last profile path so it can be embedded
         last_path = &argv[nCount][0];
 
-        //Read profile from path and add it to theCmm
-        stat = theCmm.AddXform(argv[nCount], nIntent<0 ? icUnknownIntent : (icRenderingIntent)nIntent, nInterp, pPccProfile, (icXformLutType)nType, bUseMPE, &Hint);
+        //Read profile from path keeping 8-bit and 16-bit CLUTs in their compact form
+        CIccProfile *pProfile = OpenIccProfile(argv[nCount], true);
+        if (!pProfile) {
+          printf("Invalid Profile(%d):  %s\n", icCmmStatCantOpenProfile, argv[nCount]);
+          return -1;
+        }
+
+        //Add profile to theCmm (transferring ownership)
+        stat = theCmm.AddXform(pProfile, nIntent<0 ? icUnknownIntent : (icRenderingIntent)nIntent, nInterp, pPccProfile, (icXformLutType)nType, bUseMPE, &Hint);
         if (stat) {
+          delete pProfile;
           printf("Invalid Profile(%d):  %s\n", stat, argv[nCount]);
           return -1;
         }
@@ -402,9 +534,6 @@ int main(int argc, icChar* argv[])
     break;
   }
 
-  unsigned long sbpp = (nSrcSamples * bps + 7) / 8;
-  unsigned long dbpp = (nDestSamples * dbps  + 7)/ 8;
-
   //Open up output image using information from SrcImg and theCmm
   if (!DstImg.Create(argv[2], SrcImg.GetWidth(), SrcImg.GetHeight(), dbps, photo, nDestSamples, SrcImg.GetXRes(), SrcImg.GetYRes(), bCompress, bSeparation)) {
     printf("Unable to create Tiff file - '%s'\n", argv[2]);
@@ -429,188 +558,115 @@ int main(int argc, icChar* argv[])
     }
   }
 
-  //Allocate buffer for reading source image pixels
-  unsigned char *pSBuf = (unsigned char *)malloc(SrcImg.GetBytesPerLine());  
-  if (!pSBuf) {
-    printf("Out of Memory!\n");
-    return false;
+  //Set up codecs that workers use to convert between image samples and the CMM's internal encoding
+  CTiffPixelCodec SrcCodec(nSrcSamples, srcEncoding, sphoto, sphoto==PHOTO_CIELAB && SrcspaceSig==icSigXYZData);
+  CTiffPixelCodec DstCodec(nDestSamples, destEncoding, photo, photo==PHOTO_CIELAB && DestspaceSig==icSigXYZData);
+
+  //Start up the worker threads (one per hardware thread) each with its own apply object
+  CIccImageEngine theEngine;
+  if ((stat=theEngine.Begin(&theCmm))) {
+    printf("Error %d - Unable to start image engine\n", stat);
+    return -1;
   }
 
-  //Allocate buffer for putting color managed pixels into that will be sent to output tiff image
-  unsigned char *pDBuf = (unsigned char *)malloc(DstImg.GetBytesPerLine());
-  if (!pDBuf) {
+  //Two strips of source and destination rows are allocated so that reading the next strip and
+  //writing the previous strip can be overlapped with transforming the current one
+  unsigned long nSrcBytesPerLine = SrcImg.GetBytesPerLine();
+  unsigned long nDstBytesPerLine = DstImg.GetBytesPerLine();
+  unsigned char *pSBuf[2], *pDBuf[2];
+
+  pSBuf[0] = (unsigned char *)malloc(nSrcBytesPerLine * ICC_APPLY_STRIP_ROWS * 2);
+  pDBuf[0] = (unsigned char *)malloc(nDstBytesPerLine * ICC_APPLY_STRIP_ROWS * 2);
+  if (!pSBuf[0] || !pDBuf[0]) {
     printf("Out of Memory!\n");
-    free(pSBuf);
+    if (pSBuf[0])
+      free(pSBuf[0]);
+    if (pDBuf[0])
+      free(pDBuf[0]);
     return false;
   }
+  pSBuf[1] = pSBuf[0] + nSrcBytesPerLine * ICC_APPLY_STRIP_ROWS;
+  pDBuf[1] = pDBuf[0] + nDstBytesPerLine * ICC_APPLY_STRIP_ROWS;
 
-  //Allocate pixel buffers for performing encoding transformations
-  CIccPixelBuf SrcPixel(nSrcSamples+16), DestPixel(nDestSamples+16), Pixel(icIntMax(nSrcSamples, nDestSamples)+16);
+  unsigned long nHeight = SrcImg.GetHeight();
+  unsigned long nRows, nPrevRows = 0;
+  int nCur = 0;
   int lastPer = -1;
   int curper;
 
-  //Read each line
-  for (i=0; i<SrcImg.GetHeight(); i++) {
-    if (!SrcImg.ReadLine(pSBuf)) {
+  //Read first strip
+  nRows = nHeight < ICC_APPLY_STRIP_ROWS ? nHeight : ICC_APPLY_STRIP_ROWS;
+  for (j=0; j<nRows; j++) {
+    if (!SrcImg.ReadLine(pSBuf[nCur] + j*nSrcBytesPerLine)) {
       bSuccess = false;
       break;
     }
-    for (sptr=pSBuf, dptr=pDBuf, j=0; j<SrcImg.GetWidth(); j++, sptr+=sbpp, dptr+=dbpp) {
-
-      //Special conversions need to be made to convert CIELAB and CIEXYZ to internal PCS encoding
-      switch(bps) {
-        case 8:
-          if (sphoto==PHOTO_CIELAB) {
-            unsigned char *pSPixel = sptr;
-            icFloatNumber *pPixel = SrcPixel;
-            pPixel[0]=(icFloatNumber)pSPixel[0] / 255.0f;
-            pPixel[1]=(icFloatNumber)(pSPixel[1]-128) / 255.0f;
-            pPixel[2]=(icFloatNumber)(pSPixel[2]-128) / 255.0f;
-          }
-          else {
-            unsigned char *pSPixel = sptr;
-            icFloatNumber *pPixel = SrcPixel;
-            for (k=0; k<nSrcSamples; k++) {
-              pPixel[k] = (icFloatNumber)pSPixel[k] / 255.0f;
-            }
-          }
-          break;
-
-        case 16:
-          if (sphoto==PHOTO_CIELAB) {
-            unsigned short *pSPixel = (unsigned short*)sptr;
-            icFloatNumber *pPixel = SrcPixel;
-            pPixel[0]=(icFloatNumber)pSPixel[0] / 65535.0f;
-            pPixel[1]=(icFloatNumber)(pSPixel[1]-0x8000) / 65535.0f;
-            pPixel[2]=(icFloatNumber)(pSPixel[2]-0x8000) / 65535.0f;
-          }
-          else {
-            unsigned short *pSPixel = (unsigned short*)sptr;
-            icFloatNumber *pPixel = SrcPixel;
-            for (k=0; k<nSrcSamples; k++) {
-              pPixel[k] = (icFloatNumber)pSPixel[k] / 65535.0f;
-            }
-          }
-          break;
-
-        case 32:
-          {
-            if (sizeof(icFloatNumber)==sizeof(icFloat32Number)) {
-              memcpy(SrcPixel.get(), sptr, sbpp);
-            }
-            else {
-              icFloat32Number *pSPixel = (icFloat32Number*)sptr;
-              icFloatNumber *pPixel = SrcPixel;
-              for (k=0; k<nSrcSamples; k++) {
-                pPixel[k] = (icFloatNumber)pSPixel[k];
-              }
-            }
-
-            if (sphoto==PHOTO_CIELAB || sphoto==PHOTO_ICCLAB) {
-              icLabToPcs(SrcPixel);
-            }
-          }
-          break;
-
-        default:
-          printf("Invalid source bit depth\n");
-          return -1;
-      }
-      if (sphoto == PHOTO_CIELAB && SrcspaceSig==icSigXYZData) {
-        icLabFromPcs(SrcPixel);
-        icLabtoXYZ(SrcPixel);
-        icXyzToPcs(SrcPixel);
-      }
+  }
+
+  for (i=0; bSuccess && i<nHeight; i+=nRows) {
+    nRows = nHeight - i;
+    if (nRows > ICC_APPLY_STRIP_ROWS)
+      nRows = ICC_APPLY_STRIP_ROWS;
 
-      //Use CMM to convert SrcPixel to DestPixel
-     theCmm.Apply(DestPixel, SrcPixel);
+    //Hand the current strip to the workers
+    if ((stat=theEngine.StartStrip(pDBuf[nCur], nDstBytesPerLine, &DstCodec, pSBuf[nCur], nSrcBytesPerLine, &SrcCodec,
+                                   SrcImg.GetWidth(), nRows))) {
+      printf("Error %d - Unable to apply profiles\n", stat);
+      bSuccess = false;
+      break;
+    }
 
-      //Special conversions need to be made to convert from internal PCS encoding CIELAB
-      if (photo==PHOTO_CIELAB && DestspaceSig==icSigXYZData) {
-        icXyzFromPcs(DestPixel);
-        icXYZtoLab(DestPixel);
-        icLabToPcs(DestPixel);
+    //Output the previous strip of converted pixels to the destination image
+    for (j=0; j<nPrevRows; j++) {
+      if (!DstImg.WriteLine(pDBuf[1-nCur] + j*nDstBytesPerLine)) {
+        bSuccess = false;
+        break;
       }
-      switch(dbps) {
-        case 8:
-          if (photo==PHOTO_CIELAB) {
-            unsigned char *pDPixel = dptr;
-            icFloatNumber *pPixel = DestPixel;
-            pDPixel[0]=(icUInt8Number)(UnitClip(pPixel[0]) * 255.0f + 0.5f);
-            pDPixel[1]=(icUInt8Number)(UnitClip(pPixel[1]) * 255.0f + 0.5f)+128;
-            pDPixel[2]=(icUInt8Number)(UnitClip(pPixel[2]) * 255.0f + 0.5f)+128;
-          }
-          else {
-            icUInt8Number *pDPixel = dptr;
-            icFloatNumber *pPixel = DestPixel;
-            for (k=0; k<nDestSamples; k++) {
-              pDPixel[k] = (icUInt8Number)(UnitClip(pPixel[k]) * 255.0f + 0.5f);
-            }
-          }
-          break;
-
-        case 16:
-          if (photo==PHOTO_CIELAB) {
-            unsigned short *pDPixel = (unsigned short*)dptr;
-            icFloatNumber *pPixel = DestPixel;
-            pDPixel[0]=(icUInt16Number)(UnitClip(pPixel[0]) * 65535.0f + 0.5f);
-            pDPixel[1]=(icUInt16Number)(UnitClip(pPixel[1]) * 65535.0f + 0.5f)+0x8000;
-            pDPixel[2]=(icUInt16Number)(UnitClip(pPixel[2]) * 65535.0f + 0.5f)+0x8000;
-          }
-          else {
-            icUInt16Number *pDPixel = (icUInt16Number*)dptr;
-            icFloatNumber *pPixel = DestPixel;
-            for (k=0; k<nDestSamples; k++) {
-              pDPixel[k] = (icUInt16Number)(UnitClip(pPixel[k]) * 65535.0f+0.5f);
-            }
-          }
-          break;
-
-        case 32:
-          {
-            if (photo==PHOTO_CIELAB || photo==PHOTO_ICCLAB) {
-              icLabFromPcs(SrcPixel);
-            }
-
-            if (sizeof(icFloatNumber)==sizeof(icFloat32Number)) {
-              memcpy(dptr, DestPixel.get(), dbpp);
-            }
-            else {
-              icFloat32Number *pDPixel = (icFloat32Number*)dptr;
-              icFloatNumber *pPixel = DestPixel;
-              for (k=0; k<nDestSamples; k++) {
-                pDPixel[k] = (icFloat32Number)pPixel[k];
-              }
-            }
-          }
-          break;
-
-        default:
-          printf("Invalid source bit depth\n");
-          return -1;
+    }
+
+    //Read the next strip
+    k = nHeight - (i + nRows);
+    if (k > ICC_APPLY_STRIP_ROWS)
+      k = ICC_APPLY_STRIP_ROWS;
+    for (j=0; bSuccess && j<k; j++) {
+      if (!SrcImg.ReadLine(pSBuf[1-nCur] + j*nSrcBytesPerLine)) {
+        bSuccess = false;
+        break;
       }
     }
 
-    //Output the converted pixels to the destination image
-    if (!DstImg.WriteLine(pDBuf)) {
+    if ((stat=theEngine.Wait())) {
+      printf("Error %d - Unable to apply profiles\n", stat);
       bSuccess = false;
-      break;
     }
 
+    nPrevRows = nRows;
+    nCur = 1-nCur;
+
     //Display status of how much we have accomplished
-    curper = (int)((float)(i+1)*100.0f/(float)SrcImg.GetHeight());
+    curper = (int)((float)(i+nRows)*100.0f/(float)nHeight);
     if (curper !=lastPer) {
       printf("\r%d%%", curper);
       lastPer = curper;
     }
   }
+
+  //Output the last strip
+  for (j=0; bSuccess && j<nPrevRows; j++) {
+    if (!DstImg.WriteLine(pDBuf[1-nCur] + j*nDstBytesPerLine)) {
+      bSuccess = false;
+      break;
+    }
+  }
   printf("\n");
 
   //Clean everything up by closeing files and freeing buffers
   SrcImg.Close();
 
-  free(pSBuf);
-  free(pDBuf);
+  theEngine.End();
+
+  free(pSBuf[0]);
+  free(pDBuf[0]);
 
   DstImg.Close();
 